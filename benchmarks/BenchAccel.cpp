@@ -0,0 +1,100 @@
+#include "Benchmark.h"
+#include "core/RayPacket.h"
+
+using namespace rt;
+
+namespace bench {
+	namespace {
+		// Procedural scene with a few thousand triangles, including the long thin triangles of a torus
+		void buildScene(CScene& scene)
+		{
+			auto pShader = std::make_shared<CShaderFlat>(RGB(1, 1, 1));
+			scene.add(CSolidQuad(pShader, Vec3f(0, -1, 0), Vec3f(0, 1, 0), Vec3f(1, 0, 0), 20.0f));
+			scene.add(CSolidTorus(pShader, Vec3f(0, 0.5f, 0), 2.0f, 0.5f, 64));
+			scene.add(CSolidSphere(pShader, Vec3f(-3, 0, 2), 1.0f, 48));
+			scene.add(CSolidCylinder(pShader, Vec3f(3, -1, 2), 0.7f, 3.0f, 8, 48));
+			scene.add(CSolidBox(pShader, Vec3f(0, 0, 4), 1.0f));
+		}
+	}
+
+	void benchAccel(CRunner& runner)
+	{
+		const Size resolution(256, 256);
+		CScene scene;
+		buildScene(scene);
+
+#ifdef ENABLE_BSP
+		runner.run("bsp/build", [&] { scene.buildAccelStructure(20, 3); });
+		
+		// Update of the tree after moving one small solid, as between the frames of an animation
+		if (runner.enabled("bsp/refit")) {
+			CScene animated;
+			buildScene(animated);
+			CSolidSphere ball(std::make_shared<CShaderFlat>(RGB(1, 0, 0)), Vec3f(0, 2, 0), 0.5f, 24);
+			animated.add(ball);
+			animated.buildAccelStructure(20, 3);
+			float step = 0.1f;
+			runner.run("bsp/refit", [&] {
+				ball.transform(CTransform().translate(step, 0, 0).get());
+				step = -step;
+				animated.updateAccelStructure();
+			});
+		}
+#endif
+		scene.buildAccelStructure(20, 3);
+
+		// Primary rays
+		auto pCamera = std::make_shared<CCameraPerspectiveTarget>(resolution, Vec3f(0, 5, -8), Vec3f(0, 0, 1), Vec3f(0, 1, 0), 45.0f);
+		std::vector<Ray> vRays(resolution.area());
+		for (int y = 0; y < resolution.height; y++)
+			for (int x = 0; x < resolution.width; x++)
+				pCamera->InitRay(vRays[y * resolution.width + x], x, y);
+
+		runner.run("rays/primary", [&] {
+			size_t nHits = 0;
+			for (const Ray& ray : vRays)
+				if (scene.intersect(lvalue_cast(Ray(ray)))) nHits++;
+			doNotOptimize(nHits);
+		}, 1e-6 * vRays.size(), "Mrays/s");
+
+#ifdef ENABLE_PACKETS
+		// Primary rays in square packets of neighbouring pixels, as in the renderer
+		const int packet = static_cast<int>(packetSize);
+		std::vector<RayPacket> vPackets;
+		for (int y = 0; y < resolution.height; y += packet)
+			for (int x = 0; x < resolution.width; x += packet) {
+				RayPacket p;
+				for (int dy = 0; dy < packet; dy++)
+					for (int dx = 0; dx < packet; dx++)
+						p.add(vRays[(y + dy) * resolution.width + x + dx]);
+				p.update();
+				vPackets.push_back(p);
+			}
+
+		runner.run("rays/primary_packets", [&] {
+			size_t nHits = 0;
+			for (const RayPacket& p : vPackets)
+				nHits += scene.intersect(lvalue_cast(RayPacket(p))) ? 1 : 0;
+			doNotOptimize(nHits);
+		}, 1e-6 * vRays.size(), "Mrays/s");
+#endif
+
+		// Shadow rays from the visible points toward a point light source
+		CLightOmni light(RGB(1, 1, 1), Vec3f(2, 8, -2));
+		std::vector<Ray> vShadowRays;
+		for (const Ray& ray : vRays) {
+			Ray r = ray;
+			if (!scene.intersect(r)) continue;
+			Ray I(r.hitPoint());
+			I.hit = r.hit;
+			if (light.illuminate(I)) vShadowRays.push_back(I);
+		}
+
+		runner.run("rays/shadow", [&] {
+			size_t nOccluded = 0;
+			for (const Ray& ray : vShadowRays)
+				if (scene.if_intersect(ray)) nOccluded++;
+			doNotOptimize(nOccluded);
+		}, 1e-6 * vShadowRays.size(), "Mrays/s");
+	}
+}
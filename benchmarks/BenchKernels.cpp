@@ -0,0 +1,47 @@
+#include "Benchmark.h"
+#include "core/Ray.h"
+#include "core/random.h"
+
+using namespace rt;
+
+namespace bench {
+	namespace {
+		// Random rays from the points in front of the primitive toward the points around its center, so that a part of them misses it
+		std::vector<Ray> generateRays(const Vec3f& center, float spread, size_t nRays)
+		{
+			random::seed(0x5EED);
+			std::vector<Ray> vRays(nRays);
+			for (Ray& ray : vRays) {
+				ray.org = center + Vec3f(random::U<float>(-spread, spread), random::U<float>(-spread, spread), -10.0f);
+				Vec3f target = center + Vec3f(random::U<float>(-spread, spread), random::U<float>(-spread, spread), random::U<float>(-spread, spread));
+				ray.dir = normalize(target - ray.org);
+			}
+			return vRays;
+		}
+
+		void runKernel(CRunner& runner, const std::string& name, const ptr_prim_t& pPrim, const std::vector<Ray>& vRays)
+		{
+			runner.run(name, [&] {
+				size_t nHits = 0;
+				for (const Ray& ray : vRays)
+					if (pPrim->intersect(lvalue_cast(Ray(ray)))) nHits++;
+				doNotOptimize(nHits);
+			}, 1e-6 * vRays.size(), "Mrays/s");
+		}
+	}
+
+	void benchKernels(CRunner& runner)
+	{
+		const size_t nRays = 1 << 16;
+		auto pShader = std::make_shared<CShaderFlat>(RGB(1, 1, 1));
+		const std::vector<Ray> vRays = generateRays(Vec3f::all(0), 1.5f, nRays);
+
+		runKernel(runner, "kernels/triangle", std::make_shared<CPrimTriangle>(pShader, Vec3f(-1, -1, 0), Vec3f(1, -1, 0), Vec3f(0, 1, 0)), vRays);
+		runKernel(runner, "kernels/sphere", std::make_shared<CPrimSphere>(pShader, Vec3f::all(0), 1.0f), vRays);
+		runKernel(runner, "kernels/plane", std::make_shared<CPrimPlane>(pShader, Vec3f::all(0), Vec3f(0, 0, -1)), vRays);
+		if (runner.enabled("kernels/composite")) {
+			auto pComposite = std::make_shared<CCompositeGeometry>(CSolidBox(pShader, Vec3f::all(0), 1.0f), CSolidSphere(pShader, Vec3f::all(0), 1.3f, 24), BoolOp::Difference);
+			runKernel(runner, "kernels/composite", pComposite, vRays);
+		}
+	}
+}
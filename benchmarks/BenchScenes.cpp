@@ -0,0 +1,194 @@
+#include "Benchmark.h"
+#include "core/Ray.h"
+#include <fstream>
+
+using namespace rt;
+
+namespace bench {
+	namespace {
+		// The scenes of the demos at a lower resolution
+		void buildCornellBox(CScene& scene, const Size& resolution)
+		{
+			const float intensity = 5000;
+			auto pShaderLight	= std::make_shared<CShaderFlat>(RGB(1, 1, 1));
+			auto pShaderWhite	= std::make_shared<CShaderPhong>(scene, RGB(1, 1, 1), 0.2f, 0.8f, 0.0f, 0.0f);
+			auto pShaderRed		= std::make_shared<CShaderPhong>(scene, RGB(1, 0, 0), 0.2f, 0.8f, 0.0f, 0.0f);
+			auto pShaderGreen	= std::make_shared<CShaderPhong>(scene, RGB(0, 1, 0), 0.2f, 0.8f, 0.0f, 0.0f);
+
+			CSolidBox shortBlock(pShaderWhite, Vec3f(185.5f, 82.5f, 169), 165, 165, 168);
+			CSolidBox tallBlock(pShaderWhite, Vec3f(368.5f, 165, 351.25f), 165, 330, 167);
+			shortBlock.transform(CTransform().rotate(Vec3f(0, 1, 0), -16.7f).get());
+			tallBlock.transform(CTransform().rotate(Vec3f(0, 1, 0), 17.1f).get());
+
+			scene.add(std::make_shared<CCameraPerspective>(resolution, Vec3f(278, 273, -800), Vec3f(0, 0, 1), Vec3f(0, 1, 0), 39.3f));
+			scene.add(std::make_shared<CLightArea>(intensity * RGB(1.0f, 0.839f, 0.494f), Vec3f(343, 548.78f, 227), Vec3f(343, 548.78f, 332), Vec3f(213, 548.78f, 332), Vec3f(213, 548.78f, 227), std::make_shared<CSamplerStratified>(4, true, true)));
+			scene.add(CSolidQuad(pShaderWhite, Vec3f(552.8f, 0, 0), Vec3f(0, 0, 0), Vec3f(0, 0, 559.2f), Vec3f(549.6f, 0, 559.2f)));					// floor
+			scene.add(CSolidQuad(pShaderWhite, Vec3f(556, 548.8f, 0), Vec3f(556, 548.8f, 559.2f), Vec3f(0, 548.8f, 559.2f), Vec3f(0, 548.8f, 0)));		// ceiling
+			scene.add(CSolidQuad(pShaderWhite, Vec3f(549.6f, 0, 559.2f), Vec3f(0, 0, 559.2f), Vec3f(0, 548.8f, 559.2f), Vec3f(556, 548.8f, 559.2f)));	// back wall
+			scene.add(CSolidQuad(pShaderGreen, Vec3f(0, 0, 559.2f), Vec3f(0, 0, 0), Vec3f(0, 548.8f, 0), Vec3f(0, 548.8f, 559.2f)));					// right wall
+			scene.add(CSolidQuad(pShaderRed, Vec3f(552.8f, 0, 0), Vec3f(549.6f, 0, 559.2f), Vec3f(556, 548.8f, 559.2f), Vec3f(556, 548.8f, 0)));		// left wall
+			scene.add(CSolidQuad(pShaderLight, Vec3f(343, 548.79f, 227), Vec3f(343, 548.79f, 332), Vec3f(213, 548.79f, 332), Vec3f(213, 548.79f, 227)));// light
+			scene.add(shortBlock);
+			scene.add(tallBlock);
+			scene.buildAccelStructure(0, 3);
+		}
+
+		void buildSpotLight(CScene& scene, const Size& resolution)
+		{
+			auto pShaderFloor = std::make_shared<CShaderPhong>(scene, RGB(1, 1, 1), 0.1f, 0.9f, 0.0f, 40.0f);
+			auto pShaderBall  = std::make_shared<CShaderPhong>(scene, RGB(1, 1, 1), 0.1f, 0.9f, 0.9f, 40.0f);
+			const float s = 50;
+			const float r = 4;
+			scene.add(CSolidQuad(pShaderFloor, Vec3f(-s, 0, -s), Vec3f(-s, 0, s), Vec3f(s, 0, s), Vec3f(s, 0, -s)));
+			scene.add(std::make_shared<CPrimSphere>(pShaderBall, Vec3f(0, 0.5f, 0), 0.5f));
+			scene.add(std::make_shared<CCameraPerspectiveTarget>(resolution, Vec3f(4, 4, 4), Vec3f(0, 0.5f, 0), Vec3f(0, 1, 0), 45.0f));
+			scene.add(std::make_shared<CLightSpotTarget>(RGB(20, 0, 0), Vec3f(r, 3, 0), Vec3f(0, 0, 0), 20.0f, 10.0f));
+			scene.add(std::make_shared<CLightSpotTarget>(RGB(0, 0, 20), Vec3f(0, 3, r), Vec3f(0, 0, 0), 20.0f, 10.0f));
+			scene.add(std::make_shared<CLightSpotTarget>(RGB(0, 20, 0), Vec3f(r, 3, 0), Vec3f(0, 0, 0), 20.0f, 10.0f));
+			scene.buildAccelStructure();
+		}
+
+		void buildCSG(CScene& scene, const Size& resolution)
+		{
+			auto pShaderBlue	= std::make_shared<CShaderEyelight>(RGB(240 / 255.0f, 240 / 255.0f, 230 / 255.0f));
+			auto pShaderOrange	= std::make_shared<CShaderEyelight>(RGB(217 / 255.0f, 4 / 255.0f, 41 / 255.0f));
+			auto pComposite		= std::make_shared<CCompositeGeometry>(CSolidBox(pShaderOrange, Vec3f(1, 0.1f, -13), 2, 2, 2), CSolidSphere(pShaderBlue, Vec3f(1, 0.1f, -13), 1.3f, 30, false), BoolOp::Difference);
+			scene.add(pComposite);
+			scene.add(std::make_shared<CCameraPerspectiveTarget>(resolution, Vec3f(-2, 3, -3), pComposite->getBoundingBox().getCenter(), Vec3f(0, 1, 0), 45.0f));
+			scene.add(std::make_shared<CLightOmni>(5e4f * RGB(1.0f, 0.839f, 0.494f), Vec3f(100, 150.0f, 100), false));
+			scene.buildAccelStructure(20, 2);
+		}
+
+		void buildTorusKnot(CScene& scene, const Size& resolution, const CSolid& torusKnot)
+		{
+			auto pShaderFloor = std::make_shared<CShaderPhong>(scene, RGB(1, 1, 1), 0.1f, 0.9f, 0.0f, 40.0f);
+			const float s = 500;
+			scene.add(CSolidQuad(pShaderFloor, Vec3f(-s, 0, -s), Vec3f(-s, 0, s), Vec3f(s, 0, s), Vec3f(s, 0, -s)));
+			scene.add(torusKnot);
+			CBoundingBox box;
+			for (const auto& pPrim : torusKnot.getPrims()) box.extend(pPrim->getBoundingBox());
+			const Vec3f center = box.getCenter();
+			const float size = static_cast<float>(norm(box.getMaxPoint() - box.getMinPoint()));
+			scene.add(std::make_shared<CCameraPerspectiveTarget>(resolution, center + Vec3f(1, 0.8f, -1) * size, center, Vec3f(0, 1, 0), 45.0f));
+			scene.add(std::make_shared<CLightOmni>(Vec3f::all(2 * size * size), center + Vec3f(0, 2 * size, 0)));
+			scene.buildAccelStructure(20, 3);
+		}
+
+		void buildInstances(CScene& scene, const Size& resolution, bool moving = false)
+		{
+			// A forest of the instances of one tessellated sphere, which optionally sway during the shutter interval
+			auto pShaderFloor = std::make_shared<CShaderEyelight>(RGB(1, 1, 1));
+			auto pShaderTree  = std::make_shared<CShaderEyelight>(RGB(0.2f, 0.6f, 0.2f));
+			auto pMesh = std::make_shared<CMesh>(CSolidSphere(pShaderTree, Vec3f(0, 1, 0), 1.0f, 32));
+			const int n = 50;
+			const float s = 3.0f * n;
+			scene.add(CSolidQuad(pShaderFloor, Vec3f(-s, 0, -s), Vec3f(-s, 0, s), Vec3f(s, 0, s), Vec3f(s, 0, -s)));
+			for (int i = 0; i < n; i++)
+				for (int j = 0; j < n; j++) {
+					Mat T = CTransform().scale(1, 1.5f + (i * 7 + j * 3) % 5 * 0.25f, 1).translate(3.0f * (i - n / 2), 0, 3.0f * (j - n / 2)).get();
+					if (moving)	scene.add(std::make_shared<CPrimInstance>(pShaderTree, pMesh, std::vector<Mat>{ T, CTransform().translate(0.5f, 0, 0.5f).get() * T }));
+					else		scene.add(std::make_shared<CPrimInstance>(pShaderTree, pMesh, T));
+				}
+			auto pCamera = std::make_shared<CCameraPerspectiveTarget>(resolution, Vec3f(-s / 2, 20, -s / 2), Vec3f(0, 0, 0), Vec3f(0, 1, 0), 60.0f);
+			if (moving) pCamera->setShutter(0, 1);
+			scene.add(pCamera);
+			scene.buildAccelStructure(20, 3);
+		}
+
+		void buildCAD(CScene& scene, const Size& resolution, bool analytic)
+		{
+			// Rows of cylinders, cones and tori, tessellated finely enough for smooth silhouettes or analytic
+			auto pShaderFloor = std::make_shared<CShaderEyelight>(RGB(1, 1, 1));
+			auto pShaderPart  = std::make_shared<CShaderEyelight>(RGB(0.6f, 0.6f, 0.7f));
+			const int n = 10;
+			const size_t sides = 64;
+			const float s = 3.0f * n;
+			scene.add(CSolidQuad(pShaderFloor, Vec3f(-s, 0, -s), Vec3f(-s, 0, s), Vec3f(s, 0, s), Vec3f(s, 0, -s)));
+			for (int i = 0; i < n; i++)
+				for (int j = 0; j < n; j++) {
+					const Vec3f origin(3.0f * (i - n / 2), 0, 3.0f * (j - n / 2));
+					switch ((i + j) % 3) {
+						case 0:
+							if (analytic)	scene.add(std::make_shared<CPrimCylinder>(pShaderPart, origin, 0.8f, 2.0f));
+							else			scene.add(CSolidCylinder(pShaderPart, origin, 0.8f, 2.0f, 1, sides));
+							break;
+						case 1:
+							if (analytic)	scene.add(std::make_shared<CPrimCone>(pShaderPart, origin, 1.0f, 2.0f));
+							else			scene.add(CSolidCone(pShaderPart, origin, 1.0f, 2.0f, 1, sides));
+							break;
+						case 2: {
+							const Vec3f center = origin + Vec3f(0, 1.2f, 0);
+							if (analytic)	scene.add(std::make_shared<CPrimTorus>(pShaderPart, center, 1.0f, 0.3f));
+							else			scene.add(CSolidTorus(pShaderPart, center, 1.0f, 0.3f, sides / 2));
+							break;
+						}
+					}
+				}
+			scene.add(std::make_shared<CCameraPerspectiveTarget>(resolution, Vec3f(-s / 2, 15, -s / 2), Vec3f(0, 0, 0), Vec3f(0, 1, 0), 60.0f));
+			scene.buildAccelStructure(20, 3);
+		}
+
+		// Silences std::cout for its lifetime, e.g. the progress messages of the OBJ parser
+		struct CMuteOutput {
+			CMuteOutput(void) : m_pBuf(std::cout.rdbuf(nullptr)) {}
+			~CMuteOutput(void) { std::cout.rdbuf(m_pBuf); }
+			std::streambuf* m_pBuf;
+		};
+
+		void runRender(CRunner& runner, const std::string& name, const CScene& scene, ptr_sampler_t pSampler = nullptr)
+		{
+			runner.run(name, [&] { scene.render(pSampler); }, 1e-6 * scene.getResolution().area() * (pSampler ? pSampler->getNumSamples() : 1), "Msamples/s");
+		}
+	}
+
+	void benchScenes(CRunner& runner, const std::string& dataPath)
+	{
+		const Size resolution(320, 240);
+
+		// OBJ parsing
+		const std::string objFile = dataPath + "Torus Knot.obj";
+		std::shared_ptr<CSolid> pTorusKnot;
+		auto parse = [&] {
+			CMuteOutput mute;
+			pTorusKnot = std::make_shared<CSolid>(std::make_shared<CShaderEyelight>(RGB(0.8f, 0.6f, 0.2f)), objFile);
+		};
+		// Building and teardown of a scene with the primitives and the BSP Tree nodes on the heap or in the arena of the scene
+		auto buildTeardown = [&](bool arena) {
+			CScene scene;
+			{
+				CArena::CScope scope(arena ? scene.getArena() : nullptr);
+				CMuteOutput mute;
+				scene.add(CSolid(std::make_shared<CShaderEyelight>(RGB(0.8f, 0.6f, 0.2f)), objFile));
+			}
+			scene.buildAccelStructure(20, 3);
+		};
+
+		if (runner.enabled("obj/parse") || runner.enabled("obj/build_teardown") || runner.enabled("scenes/torus_knot")) {
+			if (!std::ifstream(objFile).good())
+				RT_WARNING("The OBJ file %s is not found. The corresponding benchmarks are skipped", objFile.c_str());
+			else {
+				runner.run("obj/parse", parse);
+				runner.run("obj/build_teardown", [&] { buildTeardown(false); });
+				runner.run("obj/build_teardown_arena", [&] { buildTeardown(true); });
+				if (!pTorusKnot && runner.enabled("scenes/torus_knot")) parse();
+			}
+		}
+
+		auto benchScene = [&](const std::string& name, const std::function<void(CScene&)>& build, ptr_sampler_t pSampler = nullptr) {
+			if (!runner.enabled(name)) return;
+			CScene scene;
+			build(scene);
+			runRender(runner, name, scene, pSampler);
+		};
+
+		benchScene("scenes/cornell_box", [&](CScene& scene) { buildCornellBox(scene, resolution); }, std::make_shared<CSamplerStratified>(2, true, true));
+		benchScene("scenes/spot_light", [&](CScene& scene) { buildSpotLight(scene, resolution); });
+		benchScene("scenes/csg", [&](CScene& scene) { buildCSG(scene, resolution); });
+		benchScene("scenes/instances", [&](CScene& scene) { buildInstances(scene, resolution); });
+		benchScene("scenes/instances_motion_blur", [&](CScene& scene) { buildInstances(scene, resolution, true); }, std::make_shared<CSamplerStratified>(2, true, true));
+		benchScene("scenes/cad_tessellated", [&](CScene& scene) { buildCAD(scene, resolution, false); });
+		benchScene("scenes/cad_analytic", [&](CScene& scene) { buildCAD(scene, resolution, true); });
+		if (pTorusKnot)
+			benchScene("scenes/torus_knot", [&](CScene& scene) { buildTorusKnot(scene, resolution, *pTorusKnot); });
+	}
+}
@@ -0,0 +1,120 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <thread>
+
+namespace bench {
+	namespace {
+		double now(void)
+		{
+			return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		std::string quote(const std::string& str)
+		{
+			std::string res = "\"";
+			for (char c : str) {
+				if (c == '"' || c == '\\') res += '\\';
+				res += c;
+			}
+			return res + "\"";
+		}
+
+		volatile size_t sink = 0;
+	}
+
+	void doNotOptimize(size_t value)
+	{
+		sink = sink + value;
+	}
+
+	// Constructor
+	CRunner::CRunner(double minTime, size_t nRepetitions, const std::string& filter)
+		: m_minTime(minTime)
+		, m_nRepetitions(MAX(nRepetitions, static_cast<size_t>(1)))
+		, m_filter(filter)
+	{}
+
+	void CRunner::run(const std::string& name, const std::function<void(void)>& fn, double work, const std::string& unit)
+	{
+		if (!enabled(name)) return;
+		std::cout << name << "... " << std::flush;
+
+		// warm-up call, which also estimates the number of calls per repetition
+		double t = now();
+		fn();
+		t = now() - t;
+		const size_t nIterations = t > 0 ? MAX(static_cast<size_t>(1), static_cast<size_t>(std::ceil(m_minTime / t))) : 1;
+
+		std::vector<double> vTimes;
+		for (size_t r = 0; r < m_nRepetitions; r++) {
+			t = now();
+			for (size_t i = 0; i < nIterations; i++) fn();
+			vTimes.push_back((now() - t) / nIterations);
+		}
+		std::sort(vTimes.begin(), vTimes.end());
+
+		Result res = { name, nIterations, vTimes[vTimes.size() / 2], vTimes.front(), vTimes.back(), work, unit };
+		std::cout << std::fixed << std::setprecision(3) << 1000 * res.median << " ms";
+		if (work > 0) std::cout << " (" << work / res.median << " " << unit << ")";
+		std::cout << std::endl;
+		m_vResults.push_back(res);
+	}
+
+	void CRunner::writeJSON(std::ostream& os) const
+	{
+		std::vector<std::string> vOptions;
+#ifdef ENABLE_PDP
+		vOptions.push_back("ENABLE_PDP");
+#endif
+#ifdef ENABLE_BSP
+		vOptions.push_back("ENABLE_BSP");
+#endif
+#ifdef ENABLE_CACHE
+		vOptions.push_back("ENABLE_CACHE");
+#endif
+#ifdef ENABLE_PACKETS
+		vOptions.push_back("ENABLE_PACKETS");
+#endif
+#ifdef ENABLE_STATS
+		vOptions.push_back("ENABLE_STATS");
+#endif
+		char timestamp[32];
+		std::time_t time = std::time(nullptr);
+		std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&time));
+
+		os << std::setprecision(9);
+		os << "{" << std::endl;
+		os << "  \"context\": {" << std::endl;
+		os << "    \"version\": " << quote(std::to_string(OPENRT_VERSION_MAJOR) + "." + std::to_string(OPENRT_VERSION_MINOR) + "." + std::to_string(OPENRT_VERSION_PATCH)) << "," << std::endl;
+		os << "    \"date\": " << quote(timestamp) << "," << std::endl;
+		os << "    \"threads\": " << std::thread::hardware_concurrency() << "," << std::endl;
+		os << "    \"packet_size\": " << rt::packetSize << "," << std::endl;
+		os << "    \"max_ray_counter\": " << rt::maxRayCounter << "," << std::endl;
+		os << "    \"options\": [";
+		for (size_t i = 0; i < vOptions.size(); i++) os << (i ? ", " : "") << quote(vOptions[i]);
+		os << "]" << std::endl;
+		os << "  }," << std::endl;
+		os << "  \"benchmarks\": [" << std::endl;
+		for (size_t i = 0; i < m_vResults.size(); i++) {
+			const Result& res = m_vResults[i];
+			os << "    {" << std::endl;
+			os << "      \"name\": " << quote(res.name) << "," << std::endl;
+			os << "      \"iterations\": " << res.iterations << "," << std::endl;
+			os << "      \"repetitions\": " << m_nRepetitions << "," << std::endl;
+			os << "      \"median_ms\": " << 1000 * res.median << "," << std::endl;
+			os << "      \"min_ms\": " << 1000 * res.min << "," << std::endl;
+			os << "      \"max_ms\": " << 1000 * res.max;
+			if (res.work > 0) {
+				os << "," << std::endl;
+				os << "      \"throughput\": " << res.work / res.median << "," << std::endl;
+				os << "      \"unit\": " << quote(res.unit);
+			}
+			os << std::endl << "    }" << (i + 1 < m_vResults.size() ? "," : "") << std::endl;
+		}
+		os << "  ]" << std::endl;
+		os << "}" << std::endl;
+	}
+}
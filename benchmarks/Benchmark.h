@@ -0,0 +1,77 @@
+// Benchmark runner
+// Written by Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "openrt.h"
+#include "macroses.h"
+#include <functional>
+
+namespace bench {
+	// ================================ Benchmark Runner Class ================================
+	/**
+	 * @brief Runner of the benchmarks
+	 * @details Every benchmark is a function, which is timed over several repetitions. In every repetition the function is called so many times,
+	 * that the repetition takes at least the given minimal time. The median, minimal and maximal times per call are reported as JSON
+	 */
+	class CRunner
+	{
+	public:
+		/**
+		 * @brief Constructor
+		 * @param minTime The minimal time of one repetition in seconds
+		 * @param nRepetitions The number of repetitions of every benchmark
+		 * @param filter Only the benchmarks, whose names contain this string, are run
+		 */
+		CRunner(double minTime = 0.5, size_t nRepetitions = 5, const std::string& filter = "");
+
+		/**
+		 * @brief Checks whether the benchmark \b name will be run
+		 * @details Use this method to skip an expensive setup of the filtered out benchmarks
+		 * @param name The name of the benchmark
+		 * @retval true If the benchmark passes the filter
+		 * @retval false Otherwise
+		 */
+		bool	enabled(const std::string& name) const { return m_filter.empty() || name.find(m_filter) != std::string::npos; }
+		/**
+		 * @brief Times the function \b fn
+		 * @param name The name of the benchmark in format "group/name"
+		 * @param fn The function to be timed
+		 * @param work The amount of work, done by one call of \b fn, e.g. the number of traced rays in millions. If it is 0, no throughput is reported
+		 * @param unit The unit of the throughput, e.g. "Mrays/s"
+		 */
+		void	run(const std::string& name, const std::function<void(void)>& fn, double work = 0, const std::string& unit = "");
+		/**
+		 * @brief Writes the results and the build configuration as JSON
+		 * @param os The output stream
+		 */
+		void	writeJSON(std::ostream& os) const;
+
+
+	private:
+		/// Result of one benchmark
+		struct Result {
+			std::string	name;
+			size_t		iterations;		///< Number of calls per repetition
+			double		median;			///< Median time per call in seconds
+			double		min;			///< Minimal time per call in seconds
+			double		max;			///< Maximal time per call in seconds
+			double		work;
+			std::string	unit;
+		};
+
+		const double		m_minTime;
+		const size_t		m_nRepetitions;
+		const std::string	m_filter;
+		std::vector<Result>	m_vResults;
+	};
+
+	/// Times the construction of the BSP Tree and the throughput of the primary and shadow rays
+	void benchAccel(CRunner& runner);
+	/// Times the ray - primitive intersection kernels
+	void benchKernels(CRunner& runner);
+	/// Times the parsing of the OBJ files and the full renders of the demo scenes
+	void benchScenes(CRunner& runner, const std::string& dataPath);
+
+	/// Prevents the compiler from optimizing away the result of a benchmarked computation
+	void doNotOptimize(size_t value);
+}
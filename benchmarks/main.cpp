@@ -0,0 +1,64 @@
+#include "Benchmark.h"
+#include <fstream>
+
+namespace {
+	void printUsage(const char* app)
+	{
+		std::cout << "Usage: " << app << " [options]" << std::endl;
+		std::cout << "  --out <file>          JSON output file (default: benchmarks.json)" << std::endl;
+		std::cout << "  --filter <string>     Run only the benchmarks, whose names contain the string" << std::endl;
+		std::cout << "  --min-time <seconds>  Minimal time of one repetition (default: 0.5)" << std::endl;
+		std::cout << "  --repetitions <n>     Number of repetitions of every benchmark (default: 5)" << std::endl;
+		std::cout << "  --data <path>         Path to the data folder (default: " << dataPath << ")" << std::endl;
+#ifdef ENABLE_TRACE
+		std::cout << "  --trace <file>        Chrome trace output file" << std::endl;
+#endif
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string outFile		= "benchmarks.json";
+	std::string filter;
+	std::string data		= dataPath;
+	std::string traceFile;
+	double		minTime		= 0.5;
+	size_t		nRepetitions = 5;
+
+	for (int i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+		if (i + 1 < argc && arg == "--out")					outFile = argv[++i];
+		else if (i + 1 < argc && arg == "--filter")			filter = argv[++i];
+		else if (i + 1 < argc && arg == "--min-time")		minTime = std::stod(argv[++i]);
+		else if (i + 1 < argc && arg == "--repetitions")	nRepetitions = std::stoul(argv[++i]);
+		else if (i + 1 < argc && arg == "--data")			data = std::string(argv[++i]) + "/";
+#ifdef ENABLE_TRACE
+		else if (i + 1 < argc && arg == "--trace")			traceFile = argv[++i];
+#endif
+		else {
+			printUsage(argv[0]);
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+
+	bench::CRunner runner(minTime, nRepetitions, filter);
+#ifdef ENABLE_TRACE
+	if (!traceFile.empty()) rt::trace::start();
+#endif
+	bench::benchKernels(runner);
+	bench::benchAccel(runner);
+	bench::benchScenes(runner, data);
+#ifdef ENABLE_TRACE
+	if (!traceFile.empty() && rt::trace::stop(traceFile)) 
+		std::cout << "The trace is written to " << traceFile << std::endl;
+#endif
+
+	std::ofstream file(outFile);
+	if (!file.is_open()) {
+		std::cout << "ERROR: Can't open the output file " << outFile << std::endl;
+		return 1;
+	}
+	runner.writeJSON(file);
+	std::cout << "The results are written to " << outFile << std::endl;
+	return 0;
+}
@@ -16,11 +16,16 @@
 
 #include "core/LightArea.h"
 #include "core/LightSky.h"
+#include "core/LightEnvironment.h"
 
 #include "core/PrimSphere.h"
 #include "core/PrimPlane.h"
 #include "core/PrimTriangle.h"
+#include "core/PrimCylinder.h"
+#include "core/PrimCone.h"
+#include "core/PrimTorus.h"
 #include "core/CompositeGeometry.h"
+#include "core/PrimInstance.h"
 
 #include "core/SolidQuad.h"
 #include "core/SolidBox.h"
@@ -44,6 +49,17 @@
 #include "core/Transform.h"
 
 #include "core/Texture.h"
+#include "core/TextureCache.h"
+
+#include "core/RenderCache.h"
+#include "core/SequenceRenderer.h"
+#include "core/RenderCoordinator.h"
+#include "core/RenderWorker.h"
+
+#include "core/Stats.h"
+#include "core/Trace.h"
+#include "core/MemoryReport.h"
+#include "core/Arena.h"
 
 #include "core/LightSpot.h"
 
@@ -73,6 +89,7 @@ The OpenRT framework consist of the following essential blocks:
 	- <b>Directional spot light source:</b> @ref rt::CLightSpot
 	- <b>Area light source:</b> @ref rt::CLightArea
 	- <b>Skylight (ambient occlusion) light source:</b> @ref rt::CLightSky
+	- <b>Environment (image-based) light source:</b> @ref rt::CLightEnvironment
 	@todo Implement class CLightDirect
 
 @subsection sec_main_geometry Geometry
@@ -80,6 +97,10 @@ The OpenRT framework consist of the following essential blocks:
 	- <b>Plane:</b> @ref rt::CPrimPlane
 	- <b>Sphere:</b> @ref rt::CPrimSphere
 	- <b>Triangle:</b> @ref rt::CPrimTriangle
+	- <b>Cylinder:</b> @ref rt::CPrimCylinder
+	- <b>Cone:</b> @ref rt::CPrimCone
+	- <b>Torus:</b> @ref rt::CPrimTorus
+	- <b>Instance:</b> @ref rt::CPrimInstance
 @subsubsection sec_main_solids Solids
  - @b Quadrilateral: @ref rt::CSolidQuad
  - @b Box: @ref rt::CSolidBox
@@ -0,0 +1,30 @@
+#include "Arena.h"
+
+namespace rt {
+	namespace {
+		thread_local CArena* pActive = nullptr;
+	}
+
+	void* CArena::do_allocate(size_t bytes, size_t alignment)
+	{
+		m_size += bytes;
+		return m_resource.allocate(bytes, alignment);
+	}
+
+	CArena* CArena::getActive(void)
+	{
+		return pActive;
+	}
+
+	CArena::CScope::CScope(const std::shared_ptr<CArena>& pArena)
+		: m_pArena(pArena)
+		, m_pPrevious(pActive)
+	{
+		pActive = m_pArena.get();
+	}
+
+	CArena::CScope::~CScope(void)
+	{
+		pActive = m_pPrevious;
+	}
+}
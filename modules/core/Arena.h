@@ -0,0 +1,146 @@
+// Arena allocation of the scene objects
+// Written by Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "types.h"
+#include <memory_resource>
+
+namespace rt {
+	class CArena;
+
+	// ================================ Arena Allocator Class ================================
+	/**
+	 * @brief Allocator, which takes the memory from an arena
+	 * @details The allocator shares the ownership of the arena, thus the objects, created with std::allocate_shared() and this allocator,
+	 * keep the arena alive and remain valid after the owner of the arena has released it. The deallocation is a no-op
+	 */
+	template <class T>
+	class CArenaAllocator
+	{
+	public:
+		using value_type = T;
+
+		/**
+		 * @brief Constructor
+		 * @param pArena Pointer to the arena
+		 */
+		CArenaAllocator(const std::shared_ptr<CArena>& pArena) : m_pArena(pArena) {}
+		template <class U>
+		CArenaAllocator(const CArenaAllocator<U>& other) : m_pArena(other.getArena()) {}
+
+		T*		allocate(size_t n);
+		void	deallocate(T*, size_t) {}
+
+		/**
+		 * @brief Returns the arena of the allocator
+		 * @return The pointer to the arena
+		 */
+		const std::shared_ptr<CArena>& getArena(void) const { return m_pArena; }
+
+		template <class U>
+		bool	operator==(const CArenaAllocator<U>& other) const { return m_pArena == other.getArena(); }
+		template <class U>
+		bool	operator!=(const CArenaAllocator<U>& other) const { return m_pArena != other.getArena(); }
+
+
+	private:
+		std::shared_ptr<CArena>	m_pArena;		///< Pointer to the arena
+	};
+
+	// ================================ Arena Class ================================
+	/**
+	 * @brief Monotonic memory arena for the primitives and the acceleration structure nodes
+	 * @details Objects, allocated in the arena, are packed in large memory blocks, which are released all together when the arena is destroyed.
+	 * This avoids the heap fragmentation and makes the destruction of millions of small objects cheap. The objects, created with make(), share the ownership
+	 * of the arena, thus the arena must be created with std::make_shared(). The owner of the arena may also use it directly as a memory resource, e.g. with 
+	 * std::pmr::polymorphic_allocator, if the objects do not outlive the owner
+	 * > This class is not thread-safe: an arena should be used by one thread at a time
+	 */
+	class CArena : public std::pmr::memory_resource, public std::enable_shared_from_this<CArena>
+	{
+	public:
+		/**
+		 * @brief Constructor
+		 * @param blockSize The size of the first memory block in bytes. The next blocks grow geometrically
+		 */
+		DllExport CArena(size_t blockSize = 1 << 20) : m_resource(blockSize) {}
+		DllExport CArena(const CArena&) = delete;
+		DllExport ~CArena(void) = default;
+		DllExport const CArena& operator=(const CArena&) = delete;
+
+		/**
+		 * @brief Returns the size of the memory, allocated in the arena
+		 * @return The total size of the allocations in bytes
+		 */
+		DllExport size_t	getSize(void) const { return m_size; }
+		/**
+		 * @brief Creates a new object in the arena
+		 * @param args The arguments of the constructor of \b T
+		 * @return The shared pointer to the new object
+		 */
+		template <class T, class... Args>
+		std::shared_ptr<T>	make(Args&&... args) { return std::allocate_shared<T>(CArenaAllocator<T>(shared_from_this()), std::forward<Args>(args)...); }
+
+		/**
+		 * @brief Returns the active arena of the calling thread (Ref. @ref CScope)
+		 * @return The pointer to the active arena, or nullptr if no arena is active
+		 */
+		DllExport static CArena*	getActive(void);
+
+		// ================================ Scope Class ================================
+		/**
+		 * @brief Makes the arena active in the calling thread for the lifetime of the object
+		 * @details The primitives, created by the solids within the scope, are allocated in the active arena (Ref. @ref makeShared()):
+		 * @code
+		 * {
+		 *     CArena::CScope scope(scene.getArena());
+		 *     scene.add(CSolid(pShader, "dragon.obj"));
+		 * }
+		 * @endcode
+		 */
+		class CScope {
+		public:
+			/**
+			 * @brief Constructor
+			 * @param pArena Pointer to the arena to be activated. If it is nullptr, the objects are allocated on the heap within the scope
+			 */
+			DllExport CScope(const std::shared_ptr<CArena>& pArena);
+			DllExport ~CScope(void);
+			CScope(const CScope&) = delete;
+			const CScope& operator=(const CScope&) = delete;
+
+		private:
+			std::shared_ptr<CArena>	m_pArena;		///< The activated arena, which is kept alive by the scope
+			CArena*					m_pPrevious;	///< The previously active arena
+		};
+
+
+	protected:
+		DllExport virtual void*	do_allocate(size_t bytes, size_t alignment) override;
+		DllExport virtual void	do_deallocate(void*, size_t, size_t) override {}
+		DllExport virtual bool	do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+
+	private:
+		std::pmr::monotonic_buffer_resource	m_resource;		///< The memory blocks
+		size_t								m_size	= 0;	///< The total size of the allocations in bytes
+	};
+
+	template <class T>
+	T* CArenaAllocator<T>::allocate(size_t n)
+	{
+		return static_cast<T*>(m_pArena->allocate(n * sizeof(T), alignof(T)));
+	}
+
+	/**
+	 * @brief Creates a new object in the active arena of the calling thread, or on the heap if no arena is active
+	 * @param args The arguments of the constructor of \b T
+	 * @return The shared pointer to the new object
+	 */
+	template <class T, class... Args>
+	std::shared_ptr<T> makeShared(Args&&... args)
+	{
+		CArena* pArena = CArena::getActive();
+		return pArena ? pArena->make<T>(std::forward<Args>(args)...) : std::make_shared<T>(std::forward<Args>(args)...);
+	}
+}
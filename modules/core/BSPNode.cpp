@@ -1,12 +1,25 @@
 #include "BSPNode.h"
-#include "Ray.h"
+#include "RayPacket.h"
+#include "Stats.h"
+#include "Mailbox.h"
+#include "MemoryReport.h"
+#include "HitCollector.h"
+#include <algorithm>
 
 namespace rt {
-    bool CBSPNode::intersect(Ray& ray, double t0, double t1) const
+    bool CBSPNode::intersect(Ray& ray, double t0, double t1, dword rayMask) const
     {
+        RT_STATS_INC(nodesVisited);
         if (isLeaf()) {
-            for (auto& pPrim : m_vpPrims)
+            RT_STATS_INC(leavesVisited);
+            for (auto& pPrim : m_vpPrims) {
+                if (!CMailbox::local.test(pPrim.get(), rayMask)) {
+                    RT_STATS_INC(mailboxHits);
+                    continue;
+                }
+                RT_STATS_INC(primitiveTests);
                 pPrim->intersect(ray);
+            }
             return (ray.hit && ray.t < t1 + Epsilon);
         }
         else {
@@ -18,44 +31,37 @@ namespace rt {
 
             if (d <= t0) {
                 // t0..t1 is totally behind d, only go to back side
-                return backNode->intersect(ray, t0, t1);
+                return backNode->intersect(ray, t0, t1, rayMask);
             }
             else if (d >= t1) {
                 // t0..t1 is totally in front of d, only go to front side
-                return frontNode->intersect(ray, t0, t1);
+                return frontNode->intersect(ray, t0, t1, rayMask);
             }
             else {
                 // travese both children. front one first, back one last
-                if (frontNode->intersect(ray, t0, d))
+                if (frontNode->intersect(ray, t0, d, rayMask))
                     return true;
 
-                return backNode->intersect(ray, d, t1);
+                return backNode->intersect(ray, d, t1, rayMask);
             }
         }
     }
 
-    bool CBSPNode::intersect_furthest(Ray &ray, double t0, double t1) const {
+    bool CBSPNode::intersectAll(const Ray& ray, double t0, double t1, CHitCollector& collector) const
+    {
+        RT_STATS_INC(nodesVisited);
         if (isLeaf()) {
-            // main difference between the two functions resides here.
-            // instead of looking for the closest intersection
-            // we look for the furthest intersection in the leaf node.
-            bool hasIntersection = false;
-            auto mainCopy = ray;
-            Ray range = ray;
-            range.t = -Infty;
-            for (const auto &prim : m_vpPrims) {
-                Ray r = mainCopy;
-                if (prim->intersect(r)) {
-                    if (r.t > range.t) {
-                        range = r;
-                    }
-                    hasIntersection = true;
+            RT_STATS_INC(leavesVisited);
+            for (auto& pPrim : m_vpPrims) {
+                if (!CMailbox::local.test(pPrim.get(), 1)) {
+                    RT_STATS_INC(mailboxHits);
+                    continue;
                 }
+                RT_STATS_INC(primitiveTests);
+                pPrim->intersectAll(ray, collector.getHits());
             }
-            if (range.t > -Infty) {
-                ray = range;
-            }
-            return (hasIntersection && ray.t < t1 + Epsilon);
+            // no hit closer than t1 may be found in the following leaves (up to the round-off errors of the distances)
+            return collector.flush(t1 - Epsilon * Epsilon);
         }
         else {
             // distance from ray origin to the split plane of the current volume (may be negative)
@@ -66,19 +72,167 @@ namespace rt {
 
             if (d <= t0) {
                 // t0..t1 is totally behind d, only go to back side
-                return backNode->intersect_furthest(ray, t0, t1);
+                return backNode->intersectAll(ray, t0, t1, collector);
             }
             else if (d >= t1) {
                 // t0..t1 is totally in front of d, only go to front side
-                return frontNode->intersect_furthest(ray, t0, t1);
+                return frontNode->intersectAll(ray, t0, t1, collector);
             }
             else {
-                // travese both children. back one first since we're looking for the furthest intersection, front one last
-                if (backNode->intersect_furthest(ray, d, t1))
+                // travese both children. front one first, back one last
+                if (frontNode->intersectAll(ray, t0, d, collector))
                     return true;
 
-                return frontNode->intersect_furthest(ray, t0, d);
+                return backNode->intersectAll(ray, d, t1, collector);
+            }
+        }
+    }
+
+    dword CBSPNode::intersect(RayPacket& packet, const double* t0, const double* t1, dword mask) const
+    {
+        // a single active ray is cheaper to traverse alone
+        if ((mask & (mask - 1)) == 0) {
+            for (size_t i = 0; i < packet.size; i++)
+                if (mask & (1u << i))
+                    return intersect(packet.rays[i], t0[i], t1[i], mask) ? mask : 0;
+            return 0;
+        }
+
+        if (isLeaf()) {
+            RT_STATS_ADD(nodesVisited, stats::countBits(mask));
+            RT_STATS_ADD(leavesVisited, stats::countBits(mask));
+            // frustum culling: the bounding box of the ray segments inside the current volume
+            CBoundingBox frustum;
+            bool finite = true;
+            for (size_t i = 0; i < packet.size; i++)
+                if (mask & (1u << i)) {
+                    if (!std::isfinite(t0[i]) || !std::isfinite(t1[i])) {
+                        finite = false;
+                        break;
+                    }
+                    const Ray& ray = packet.rays[i];
+                    frustum.extend(ray.org + static_cast<float>(t0[i]) * ray.dir);
+                    frustum.extend(ray.org + static_cast<float>(t1[i]) * ray.dir);
+                }
+
+            for (auto& pPrim : m_vpPrims) {
+                if (finite && !pPrim->getBoundingBox().overlaps(frustum))
+                    continue;
+                const dword primMask = CMailbox::local.test(pPrim.get(), mask);
+                RT_STATS_ADD(mailboxHits, stats::countBits(mask & ~primMask));
+                RT_STATS_ADD(primitiveTests, stats::countBits(primMask));
+                for (size_t i = 0; i < packet.size; i++)
+                    if (primMask & (1u << i))
+                        pPrim->intersect(packet.rays[i]);
+            }
+
+            dword res = 0;
+            for (size_t i = 0; i < packet.size; i++)
+                if ((mask & (1u << i)) && packet.rays[i].hit && packet.rays[i].t < t1[i] + Epsilon)
+                    res |= 1u << i;
+            return res;
+        }
+        else {
+            // the packet is coherent if all the active rays cross the split plane in the same direction
+            int sign = -1;
+            bool coherent = true;
+            for (size_t i = 0; i < packet.size; i++)
+                if (mask & (1u << i)) {
+                    int s = packet.rays[i].dir[m_splitDim] < 0 ? 1 : 0;
+                    if (sign < 0) sign = s;
+                    else if (sign != s) {
+                        coherent = false;
+                        break;
+                    }
+                }
+
+            if (!coherent) {
+                // fall back to the single ray traversal
+                dword res = 0;
+                for (size_t i = 0; i < packet.size; i++)
+                    if ((mask & (1u << i)) && intersect(packet.rays[i], t0[i], t1[i], 1u << i))
+                        res |= 1u << i;
+                return res;
             }
+
+            RT_STATS_ADD(nodesVisited, stats::countBits(mask));
+            
+            // distances from rays origins to the split plane of the current volume (may be negative)
+            const float* org    = packet.org[m_splitDim];
+            const float* invDir = packet.invDir[m_splitDim];
+            double d[RayPacket::capacity];
+            double frontT1[RayPacket::capacity];
+            double backT0[RayPacket::capacity];
+            for (size_t i = 0; i < packet.size; i++) {
+                d[i]        = (m_splitVal - org[i]) * invDir[i];
+                frontT1[i]  = d[i] >= t1[i] ? t1[i] : d[i];
+                backT0[i]   = d[i] <= t0[i] ? t0[i] : d[i];
+            }
+
+            dword frontMask = 0;
+            dword backMask  = 0;
+            for (size_t i = 0; i < packet.size; i++) {
+                if (!(d[i] <= t0[i])) frontMask |= 1u << i;   // a part of t0..t1 is in front of d
+                if (!(d[i] >= t1[i])) backMask  |= 1u << i;   // a part of t0..t1 is behind d
+            }
+            frontMask &= mask;
+            backMask  &= mask;
+
+            auto frontNode = sign ? Right() : Left();
+            auto backNode  = sign ? Left() : Right();
+
+            // travese both children. front one first, back one last
+            dword res = frontMask ? frontNode->intersect(packet, t0, frontT1, frontMask) : 0;
+            backMask &= ~res;
+            if (backMask)
+                res |= backNode->intersect(packet, backT0, t1, backMask);
+            return res;
+        }
+    }
+
+    void CBSPNode::accountMemory(MemoryReport& report) const
+    {
+        const size_t bytes = sizeof(CBSPNode) + MemoryReport::sharedControlBlock + sizeof(std::pmr::polymorphic_allocator<CBSPNode>);   // the nodes are allocated in the arena of the tree
+        if (isLeaf()) {
+            report.bspLeaves.add(bytes);
+            report.leafReferences.add(m_vpPrims.capacity() * sizeof(ptr_prim_t), m_vpPrims.size());
+        }
+        else {
+            report.bspNodes.add(bytes);
+            if (Left()) Left()->accountMemory(report);
+            if (Right()) Right()->accountMemory(report);
+        }
+    }
+
+    size_t CBSPNode::insert(const ptr_prim_t& pPrim, const CBoundingBox& box)
+    {
+        if (isLeaf()) {
+            m_vpPrims.push_back(pPrim);
+            return 1;
+        }
+        auto splitBoxes = box.split(m_splitDim, m_splitVal);
+        size_t res = 0;
+        if (!pPrim->getClippedBoundingBox(splitBoxes.first).isEmpty())
+            res += m_pLeft->insert(pPrim, splitBoxes.first);
+        if (!pPrim->getClippedBoundingBox(splitBoxes.second).isEmpty())
+            res += m_pRight->insert(pPrim, splitBoxes.second);
+        return res;
+    }
+
+    size_t CBSPNode::remove(const IPrim* pPrim, const CBoundingBox& bounds, const CBoundingBox& box)
+    {
+        if (isLeaf()) {
+            auto it = std::find_if(m_vpPrims.begin(), m_vpPrims.end(), [pPrim](const ptr_prim_t& p) { return p.get() == pPrim; });
+            if (it == m_vpPrims.end()) return 0;
+            m_vpPrims.erase(it);
+            return 1;
         }
+        auto splitBoxes = box.split(m_splitDim, m_splitVal);
+        size_t res = 0;
+        if (!splitBoxes.first.clip(bounds).isEmpty())
+            res += m_pLeft->remove(pPrim, bounds, splitBoxes.first);
+        if (!splitBoxes.second.clip(bounds).isEmpty())
+            res += m_pRight->remove(pPrim, bounds, splitBoxes.second);
+        return res;
     }
 }
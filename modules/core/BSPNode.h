@@ -3,9 +3,14 @@
 #pragma once
 
 #include "types.h"
+#include "BoundingBox.h"
+#include <memory_resource>
 
 namespace rt {
 	struct Ray;
+	struct RayPacket;
+	struct MemoryReport;
+	class CHitCollector;
     
     // ================================ BSP Node Class ================================
     /**
@@ -18,9 +23,10 @@ namespace rt {
 		/**
 		 * @brief Leaf node constructor
 		 * @param vpPrims The vector of pointers to the primitives included in the leaf node
+		 * @param pResource The memory resource for the vector of pointers to the primitives, e.g. the arena of the tree
 		 */
-		CBSPNode(const std::vector<ptr_prim_t>& vpPrims)
-			: CBSPNode(vpPrims, 0, 0, nullptr, nullptr)
+		CBSPNode(const std::vector<ptr_prim_t>& vpPrims, std::pmr::memory_resource* pResource = std::pmr::get_default_resource())
+			: CBSPNode(std::pmr::vector<ptr_prim_t>(vpPrims.begin(), vpPrims.end(), pResource), 0, 0, nullptr, nullptr)
 		{}
 		/**
 		 * @brief Branch node constructor
@@ -30,7 +36,7 @@ namespace rt {
 		 * @param right Pointer to the right sub-tree
 		 */
 		CBSPNode(int splitDim, float splitVal, ptr_bspnode_t left, ptr_bspnode_t right)
-			: CBSPNode(std::nullopt, splitDim, splitVal, left, right)
+			: CBSPNode(std::pmr::vector<ptr_prim_t>(), splitDim, splitVal, left, right)
 		{}
 		CBSPNode(const CBSPNode&) = delete;
 		~CBSPNode(void) = default;
@@ -38,16 +44,60 @@ namespace rt {
 
 		/**
 		 * @brief Traverses the ray \b ray and checks for intersection with a primitive
-		 * @details If the intersection is found, \b ray.t is updated
+		 * @details If the intersection is found, \b ray.t is updated. The primitives, which the ray has already tested in the current traversal, are skipped (Ref. @ref CMailbox)
 		 * @param[in,out] ray The ray
 		 * @param[in] t0 The distance from ray origin at which the ray enters the scene
 		 * @param[in] t1 The distance from ray origin at which the ray leaves the scene
+		 * @param[in] rayMask The bit of the ray in the traversed packet, or 1 for a single ray
 		 * @retval true If ray \b ray intersects any object
 		 * @retval false otherwise
 		 */
-        bool intersect(Ray& ray, double t0, double t1) const;
+        bool intersect(Ray& ray, double t0, double t1, dword rayMask = 1) const;
 
-        bool intersect_furthest(Ray& ray, double t0, double t1) const;
+		/**
+		 * @brief Traverses the ray \b ray front-to-back and collects all its intersections with the primitives
+		 * @details The hits of every leaf are appended with IPrim::intersectAll() to the pending hits of \b collector, which is flushed at the exit distance of the leaf.
+		 * The primitives, which the ray has already tested in the current traversal, are skipped (Ref. @ref CMailbox)
+		 * @param[in] ray The ray
+		 * @param[in] t0 The distance from ray origin at which the ray enters the node
+		 * @param[in] t1 The distance from ray origin at which the ray leaves the node
+		 * @param[in,out] collector The collector of the hits
+		 * @retval true If the query is complete and the traversal should stop
+		 * @retval false Otherwise
+		 */
+		bool intersectAll(const Ray& ray, double t0, double t1, CHitCollector& collector) const;
+		/**
+		 * @brief Traverses the rays of packet \b packet together and checks for intersections with the primitives
+		 * @details The packet is traversed as a whole as long as all its active rays have the same direction sign along the splitting dimension.
+		 * Otherwise the remaining rays are traversed one by one with intersect(Ray&, double, double). If an intersection is found, \b ray.t of the corresponding ray is updated
+		 * @param[in,out] packet The ray packet
+		 * @param[in] t0 The distances from the rays origins at which the rays enter the node
+		 * @param[in] t1 The distances from the rays origins at which the rays leave the node
+		 * @param[in] mask The mask of the active rays in the packet
+		 * @returns The mask of the rays, for which the closest intersection was found
+		 */
+		dword intersect(RayPacket& packet, const double* t0, const double* t1, dword mask) const;
+		/**
+		 * @brief Recursively accounts the memory, occupied by the node and its sub-trees, in the report \b report
+		 * @param report The memory report
+		 */
+		void accountMemory(MemoryReport& report) const;
+		/**
+		 * @brief Recursively inserts the primitive \b pPrim into the leaves of the node, which it overlaps
+		 * @details The primitive is assigned to the leaves in the same way as by CBSPTree::build()
+		 * @param pPrim Pointer to the primitive
+		 * @param box The bounding box of the node
+		 * @returns The number of the leaves, the primitive was inserted into
+		 */
+		size_t insert(const ptr_prim_t& pPrim, const CBoundingBox& box);
+		/**
+		 * @brief Recursively removes the primitive \b pPrim from the leaves of the node
+		 * @param pPrim Pointer to the primitive
+		 * @param bounds The bounding box of the primitive at the time it was inserted into the tree. Only the leaves overlapping \b bounds are visited
+		 * @param box The bounding box of the node
+		 * @returns The number of the leaves, the primitive was removed from
+		 */
+		size_t remove(const IPrim* pPrim, const CBoundingBox& bounds, const CBoundingBox& box);
 
 		/**
 		 * @brief Returns the pointer to the \a left child
@@ -71,8 +121,8 @@ namespace rt {
 		 * @param left Pointer to the left sub-tree
 		 * @param right Pointer to the right sub-tree
 		 */
-		CBSPNode(std::optional<std::vector<ptr_prim_t>> vpPrims, int splitDim, float splitVal, ptr_bspnode_t left, ptr_bspnode_t right)
-			: m_vpPrims(vpPrims.value_or(std::vector<ptr_prim_t>()))
+		CBSPNode(std::pmr::vector<ptr_prim_t>&& vpPrims, int splitDim, float splitVal, ptr_bspnode_t left, ptr_bspnode_t right)
+			: m_vpPrims(std::move(vpPrims))
 			, m_splitDim(splitDim)
 			, m_splitVal(splitVal)
 			, m_pLeft(left)
@@ -88,7 +138,7 @@ namespace rt {
 		
 		
 	private:
-		std::vector<ptr_prim_t>	m_vpPrims;		///< The vector of pointers to the primitives included in the leaf node
+		std::pmr::vector<ptr_prim_t> m_vpPrims;	///< The vector of pointers to the primitives included in the leaf node
 		int 					m_splitDim;		///< The splitting dimension
 		float 					m_splitVal;		///< The splitting value
         ptr_bspnode_t 	        m_pLeft;		///< Pointer to the left sub-tree
@@ -1,6 +1,9 @@
 #include "BSPTree.h"
 #include "IPrim.h"
-#include "Ray.h"
+#include "MemoryReport.h"
+#include "Mailbox.h"
+#include "RayPacket.h"
+#include "Trace.h"
 #include "macroses.h"
 
 namespace rt {
@@ -23,13 +26,64 @@ namespace rt {
 
     void CBSPTree::build(const std::vector<ptr_prim_t>& vpPrims, size_t maxDepth, size_t minPrimitives)
     {
+        RT_TRACE_SCOPE("Build BSP Tree", "build");
         m_treeBoundingBox = calcBoundingBox(vpPrims);
         m_maxDepth = maxDepth;
         m_minPrimitives = minPrimitives;
+        m_nPrims = vpPrims.size();
+        m_root = nullptr;
+        m_pArena = std::make_shared<CArena>();
 #ifdef DEBUG_PRINT_INFO
         std::cout << "Scene bounds are : " << m_treeBoundingBox << std::endl;
 #endif
+        m_nRefs = 0;
+        m_vBounds.clear();
+        m_vBounds.reserve(vpPrims.size());
+        m_vDigests.clear();
+        m_vDigests.reserve(vpPrims.size());
+        for (const auto& pPrim : vpPrims) {
+            m_vBounds.push_back(pPrim->getBoundingBox());
+            m_vDigests.push_back(pPrim->getDigest());
+        }
         m_root = build(m_treeBoundingBox, vpPrims, 0);
+        m_nBuildRefs = m_nRefs;
+    }
+
+    bool CBSPTree::refit(const std::vector<ptr_prim_t>& vpPrims, float maxGrowth)
+    {
+        RT_TRACE_SCOPE("Refit BSP Tree", "build");
+        auto rebuild = [&] { build(vpPrims, m_maxDepth, m_minPrimitives); return false; };
+        if (!m_root || vpPrims.size() < m_vBounds.size()) return rebuild();
+
+        // Find the changed and the new primitives. The digests account for the geometry, so that the primitives, which changed the shape within the same
+        // bounding box, are found as well: they may be referenced by other leaves, since the leaves are assigned from the clipped geometry
+        std::vector<size_t> vDirty;
+        std::vector<qword> vDigests(vpPrims.size());
+        for (size_t i = 0; i < vpPrims.size(); i++) {
+            vDigests[i] = vpPrims[i]->getDigest();
+            if (i < m_vDigests.size() && vDigests[i] == m_vDigests[i]) continue;
+            vDirty.push_back(i);
+        }
+        if (vDirty.empty()) return true;
+        if (2 * vDirty.size() > vpPrims.size()) return rebuild();
+
+        // Remove the changed primitives from the leaves they were inserted into
+        for (size_t i : vDirty)
+            if (i < m_vBounds.size()) m_nRefs -= m_root->remove(vpPrims[i].get(), m_vBounds[i], m_treeBoundingBox);
+        
+        // The outer leaves grow with the bounding box of the tree
+        m_vBounds.resize(vpPrims.size());
+        m_vDigests = std::move(vDigests);
+        for (size_t i : vDirty) {
+            m_vBounds[i] = vpPrims[i]->getBoundingBox();
+            m_treeBoundingBox.extend(m_vBounds[i]);
+        }
+        for (size_t i : vDirty)
+            m_nRefs += m_root->insert(vpPrims[i], m_treeBoundingBox);
+        m_nPrims = vpPrims.size();
+
+        if (m_nRefs > maxGrowth * m_nBuildRefs) return rebuild();
+        return true;
     }
 
     bool CBSPTree::intersect(Ray& ray) const
@@ -41,41 +95,85 @@ namespace rt {
         m_treeBoundingBox.clip(ray, t0, t1);
         if (t1 < t0) return false;  // no intersection with the bounding box
 
+        CMailbox::CScope mailboxScope;
         return m_root->intersect(ray, t0, t1);
     }
 
-    bool CBSPTree::intersect_furthest(Ray &ray) const {
-        RT_ASSERT(!ray.hit);
-
-        double t0 = 0;
+    void CBSPTree::intersectAll(const Ray& ray, std::vector<Ray>& vHits, double tMin, size_t maxHits, const hit_filter_t& filter) const
+    {
+        double t0 = tMin;
         double t1 = ray.t;
         m_treeBoundingBox.clip(ray, t0, t1);
-        if (t1 < t0) return false;  // no intersection with the bounding box
+        if (t1 < t0) return;  // no intersection with the bounding box
+
+        CHitCollector collector(vHits, tMin, maxHits, filter);
+        CMailbox::CScope mailboxScope;
+        if (!m_root->intersectAll(ray, t0, t1, collector))
+            collector.flush(Infty);
+    }
+
+    dword CBSPTree::intersect(RayPacket& packet) const
+    {
+        packet.update();
 
-        return m_root->intersect_furthest(ray, t0, t1);
+        double t0[RayPacket::capacity];
+        double t1[RayPacket::capacity];
+        dword mask = 0;
+        for (size_t i = 0; i < packet.size; i++) {
+            RT_ASSERT(!packet.rays[i].hit);
+            t0[i] = 0;
+            t1[i] = packet.rays[i].t;
+            m_treeBoundingBox.clip(packet.rays[i], t0[i], t1[i]);
+            if (t0[i] <= t1[i]) mask |= 1u << i;
+        }
+        if (mask) {
+            CMailbox::CScope mailboxScope;
+            m_root->intersect(packet, t0, t1, mask);
+        }
+
+        dword res = 0;
+        for (size_t i = 0; i < packet.size; i++)
+            if (packet.rays[i].hit) res |= 1u << i;
+        return res;
+    }
+
+    void CBSPTree::accountMemory(MemoryReport& report) const
+    {
+        if (!m_root) return;
+        report.bspPrimitives += m_nPrims;
+        report.bspNodes.add(m_vBounds.capacity() * sizeof(CBoundingBox) + m_vDigests.capacity() * sizeof(qword), 0);   // the bounds and the digests of the primitives for refit()
+        m_root->accountMemory(report);
     }
 
     ptr_bspnode_t CBSPTree::build(const CBoundingBox& box, const std::vector<ptr_prim_t>& vpPrims, size_t depth)
     {
+        auto createLeaf = [&] {
+            m_nRefs += vpPrims.size();
+            return std::allocate_shared<CBSPNode>(std::pmr::polymorphic_allocator<CBSPNode>(m_pArena.get()), vpPrims, m_pArena.get());
+        };
+        
         // Check for stoppong criteria
         if (depth >= m_maxDepth || vpPrims.size() <= m_minPrimitives)
-            return std::make_shared<CBSPNode>(vpPrims);                                     // => Create a leaf node and break recursion
+            return createLeaf();                                                            // => Create a leaf node and break recursion
 
         // else -> prepare for creating a branch node
         // First split the bounding volume into two halfes
         int     splitDim = MaxDim(box.getMaxPoint() - box.getMinPoint());                   // Calculate split dimension as the dimension where the aabb is the widest
         float   splitVal = (box.getMinPoint()[splitDim] + box.getMaxPoint()[splitDim]) / 2; // Split the aabb exactly in two halfes
+        if (!(splitVal > box.getMinPoint()[splitDim] && splitVal < box.getMaxPoint()[splitDim]))
+            return createLeaf();                                                            // => The aabb is too thin to be split
         auto    splitBoxes = box.split(splitDim, splitVal);
         CBoundingBox& lBox = splitBoxes.first;
         CBoundingBox& rBox = splitBoxes.second;
 
-        // Second order the primitives into new nounding boxes
+        // Second order the primitives into new nounding boxes. The primitives are clipped with the boxes, 
+        // so that they are assigned only to the boxes they actually touch
         std::vector<ptr_prim_t> lPrim;
         std::vector<ptr_prim_t> rPrim;
         for (auto pPrim : vpPrims) {
-            if (pPrim->getBoundingBox().overlaps(lBox))
+            if (!pPrim->getClippedBoundingBox(lBox).isEmpty())
                 lPrim.push_back(pPrim);
-            if (pPrim->getBoundingBox().overlaps(rBox))
+            if (!pPrim->getClippedBoundingBox(rBox).isEmpty())
                 rPrim.push_back(pPrim);
         }
 
@@ -83,6 +181,6 @@ namespace rt {
         auto pLeft = build(lBox, lPrim, depth + 1);
         auto pRight = build(rBox, rPrim, depth + 1);
 
-        return std::make_shared<CBSPNode>(splitDim, splitVal, pLeft, pRight);
+        return std::allocate_shared<CBSPNode>(std::pmr::polymorphic_allocator<CBSPNode>(m_pArena.get()), splitDim, splitVal, pLeft, pRight);
     }
 }
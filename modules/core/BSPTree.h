@@ -4,6 +4,8 @@
 
 #include "BSPNode.h"
 #include "BoundingBox.h"
+#include "Arena.h"
+#include "HitCollector.h"
 
 namespace rt {
     // ================================ BSP Tree Class ================================
@@ -28,6 +30,18 @@ namespace rt {
 		* This parameters should be alway above 1.
 		*/
 		void build(const std::vector<ptr_prim_t>& vpPrims, size_t maxDepth = 20, size_t minPrimitives = 3);
+		/**
+		 * @brief Updates the tree after the primitives \b vpPrims have been changed
+		 * @details The primitives, whose digests (Ref. @ref IPrim::getDigest()) have changed since they were inserted into the tree, are removed from the leaves and inserted again,
+		 * while the splitting planes of the tree are kept. The primitives appended to \b vpPrims since the last build are inserted as well.
+		 * The tree is rebuilt from scratch instead, if more than a half of the primitives have changed, if some primitives were removed or if the number of the
+		 * leaf references has grown by more than \b maxGrowth times since the last build, \a i.e. the splitting planes do not fit the geometry anymore
+		 * @param vpPrims The vector of pointers to the primitives, the tree was built for, with the new primitives appended at the end
+		 * @param maxGrowth The maximum allowed ratio between the numbers of the leaf references after and right after the last build
+		 * @retval true If the tree was updated in place
+		 * @retval false If the tree was rebuilt
+		 */
+		bool refit(const std::vector<ptr_prim_t>& vpPrims, float maxGrowth = 1.5f);
 		/**
 		 * @brief Checks whether the ray \b ray intersects a primitive.
 		 * @details If ray \b ray intersects a primitive, the \b ray.t value will be updated
@@ -36,11 +50,28 @@ namespace rt {
 		bool intersect(Ray& ray) const;
 
 		/**
-		 * @brief Checks whether the ray \b ray intersects a primitive.
-		 * @details If ray \b ray intersects a primitive, the \b ray.t value will be updated
-		 * @param[in,out] ray The ray
+		 * @brief Collects the intersections of the ray \b ray with the primitives in order of their distance from the ray origin
+		 * @details The tree is traversed only once, front-to-back, and stops as soon as \b maxHits hits are collected or the filter stops the query (Ref. @ref CHitCollector).
+		 * Every primitive contributes all of its hits with IPrim::intersectAll()
+		 * @param[in] ray The ray. Only the hits closer than \b ray.t are collected
+		 * @param[in,out] vHits The vector, where the hits are appended to
+		 * @param[in] tMin The minimal distance of the collected hits
+		 * @param[in] maxHits The maximal number of the hits to be collected
+		 * @param[in] filter The hit filter, or nullptr to collect every hit
+		 */
+		void intersectAll(const Ray& ray, std::vector<Ray>& vHits, double tMin = 0, size_t maxHits = std::numeric_limits<size_t>::max(), const hit_filter_t& filter = nullptr) const;
+		/**
+		 * @brief Checks whether the rays of packet \b packet intersect the primitives.
+		 * @details The rays are traversed together as long as the packet remains coherent. For every ray intersecting a primitive, the \b ray.t value will be updated
+		 * @param[in,out] packet The ray packet
+		 * @returns The mask of the rays in \b packet, which intersect a primitive
+		 */
+		dword intersect(RayPacket& packet) const;
+		/**
+		 * @brief Accounts the memory, occupied by the nodes and the leaf references of the tree, in the report \b report
+		 * @param report The memory report
 		 */
-		bool intersect_furthest(Ray& ray) const;
+		void accountMemory(MemoryReport& report) const;
 
 	private:
         /**
@@ -55,8 +86,14 @@ namespace rt {
 		
 	private:
 		CBoundingBox 	m_treeBoundingBox;			///< The scene bounding box
-		size_t			m_maxDepth		= 0;		///< The maximum allowed depth of the tree
-		size_t			m_minPrimitives = 0;		///< The minimum number of primitives in a leaf-node
+		size_t			m_maxDepth		= 20;		///< The maximum allowed depth of the tree
+		size_t			m_minPrimitives = 3;		///< The minimum number of primitives in a leaf-node
+		size_t			m_nPrims		= 0;		///< The number of primitives the tree is built for
+		size_t			m_nRefs			= 0;		///< The number of the leaf references
+		size_t			m_nBuildRefs	= 0;		///< The number of the leaf references right after the last build
+		std::vector<CBoundingBox>	m_vBounds;		///< The bounding boxes of the primitives at the time they were inserted into the tree
+		std::vector<qword>			m_vDigests;		///< The digests of the primitives at the time they were inserted into the tree
+		std::shared_ptr<CArena>	m_pArena	= nullptr;	///< The arena for the nodes and the leaf vectors. It is replaced at every build, releasing the previous tree at once
 		ptr_bspnode_t   m_root			= nullptr;	///< Pointer to the root node of the BSP tree
 	};
 }
@@ -49,6 +49,12 @@ namespace rt {
 		return true;
 	}
 
+    CBoundingBox CBoundingBox::clip(const CBoundingBox& box) const
+    {
+        CBoundingBox res(Max3f(m_minPoint, box.m_minPoint), Min3f(m_maxPoint, box.m_maxPoint));
+        return res.isEmpty() ? CBoundingBox() : res;
+    }
+
     void CBoundingBox::clip(const Ray& ray, double& t0, double& t1) const
     {
         float d, den;
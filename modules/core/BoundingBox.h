@@ -61,6 +61,19 @@ namespace rt {
          * @param[in,out] t1 The distance from ray origin at which the ray leaves the bounding box
          */
         DllExport void clip(const Ray& ray, double& t0, double& t1) const;
+        /**
+         * @brief Clips the bounding box \b box with the bounding box
+         * @details Unlike overlaps(), this method uses no tolerance: the boxes, which only touch each other, result in a flat box
+         * @param box The bounding box to be clipped
+         * @returns The part of \b box inside the bounding box, or an empty box if the boxes do not intersect
+         */
+        DllExport CBoundingBox clip(const CBoundingBox& box) const;
+        /**
+         * @brief Checks whether the bounding box is empty
+         * @retval true If the bounding box does not contain any point, \a e.g. it was default-constructed
+         * @retval false Otherwise
+         */
+        DllExport bool isEmpty(void) const { return m_minPoint[0] > m_maxPoint[0] || m_minPoint[1] > m_maxPoint[1] || m_minPoint[2] > m_maxPoint[2]; }
         /**
          * @brief Returns the minimal point defying the size of the bounding box
          * @returns The minimal point defying the size of the bounding box
@@ -35,6 +35,7 @@ namespace rt {
         DllExport virtual ~CCameraEnvironment(void) = default;
 
         DllExport void    InitRay(Ray& ray, int x, int y, const Vec2f& sample = Vec2f::all(0.5f)) override;
+        DllExport qword   getDigest(void) const override { return (CDigest() << ICamera::getDigest() << m_pos << m_dir << m_up).get(); }
 
         /**
          * @brief Sets new camera position
@@ -27,5 +27,10 @@ namespace rt {
 		ray.dir = m_dir;
 		ray.t	= std::numeric_limits<double>::infinity();
 		ray.hit = nullptr;
+		ray.hasDifferentials = true;
+		ray.dOdx = m_size * 2 * getAspectRatio() / width * m_xAxis;
+		ray.dOdy = m_size * 2.0f / height * m_yAxis;
+		ray.dDdx = Vec3f::all(0);
+		ray.dDdy = Vec3f::all(0);
 	}
 }
@@ -38,6 +38,7 @@ namespace rt {
 		DllExport virtual ~CCameraOrthographic(void) = default;
 		
 		DllExport virtual void	InitRay(Ray& ray, int x, int y, const Vec2f& sample = Vec2f::all(0.5f)) override;
+		DllExport virtual qword	getDigest(void) const override { return (CDigest() << ICamera::getDigest() << m_pos << m_dir << m_up << m_size).get(); }
 		
 		/**
 		 * @brief Sets new camera position
@@ -1,5 +1,6 @@
 #include "CameraPerspective.h"
 #include "Ray.h"
+#include "random.h"
 #include "macroses.h"
 
 namespace rt
@@ -25,9 +26,20 @@ namespace rt
 			m_needUpdateAxes = false;
 		}
 
+		const Vec3f v = getAspectRatio() * sscx * m_xAxis + sscy * m_yAxis + m_focus * m_zAxis;
 		ray.org = m_pos;
-		ray.dir = normalize(getAspectRatio() * sscx * m_xAxis + sscy * m_yAxis + m_focus * m_zAxis);
+		ray.dir = normalize(v);
+		
+		// Derivatives of the normalized direction v / |v| with respect to the pixel coordinates
+		const float vv = v.dot(v);
+		auto derivative = [&](const Vec3f& dv) { return (vv * dv - v.dot(dv) * v) / (vv * sqrtf(vv)); };
+		ray.hasDifferentials = true;
+		ray.dOdx = Vec3f::all(0);
+		ray.dOdy = Vec3f::all(0);
+		ray.dDdx = derivative(2 * getAspectRatio() / width * m_xAxis);
+		ray.dDdy = derivative(2.0f / height * m_yAxis);
 		ray.t	= std::numeric_limits<double>::infinity();
 		ray.hit = nullptr;
+		ray.time = m_shutterOpen < m_shutterClose ? m_shutterOpen + (m_shutterClose - m_shutterOpen) * random::U<float>() : m_shutterOpen;
 	} 
 }
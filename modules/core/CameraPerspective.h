@@ -3,6 +3,7 @@
 #pragma once
 
 #include "ICamera.h"
+#include "macroses.h"
 
 namespace rt {
 	// ================================ Perspective Camera Class ================================
@@ -38,6 +39,7 @@ namespace rt {
 		DllExport virtual ~CCameraPerspective(void) = default;
 
 		DllExport virtual void	InitRay(Ray& ray, int x, int y, const Vec2f& sample = Vec2f::all(0.5f)) override;
+		DllExport virtual qword	getDigest(void) const override { return (CDigest() << ICamera::getDigest() << m_pos << m_dir << m_up << m_focus << m_shutterOpen << m_shutterClose).get(); }
 
 		/**
 		 * @brief Sets new camera position
@@ -65,6 +67,19 @@ namespace rt {
 		 * @param angle Camera opening angle
 		 */
 		DllExport virtual void	setAngle(float angle) { m_focus = 1.0f / tanf(angle * Pif / 360); }
+		/**
+		 * @brief Sets the shutter interval for motion blur
+		 * @details The time of every primary ray (Ref. @ref Ray::time) is sampled uniformly between  open and  close, 
+		 * where 0 and 1 are the moments of the first and the last transformations of the moving primitives (Ref. @ref CPrimInstance). 
+		 * By default the shutter is closed at the moment 0,  i.e. the moving primitives are rendered in their first position
+		 * @param open The moment of opening the shutter
+		 * @param close The moment of closing the shutter
+		 */
+		DllExport void			setShutter(float open, float close) {
+			RT_ASSERT_MSG(0 <= open && open <= close && close <= 1, "The shutter interval [%f; %f] must lie within [0; 1]", open, close);
+			m_shutterOpen = open;
+			m_shutterClose = close;
+		}
 		
 		/**
 		 * @brief Returns the camera position
@@ -86,6 +101,11 @@ namespace rt {
 		 * @return The camera opening angle
 		 */
 		DllExport float			getAngle(void) const { return 360 * atanf(1.0f / m_focus) / Pif; }
+		/**
+		 * @brief Returns the shutter interval
+		 * @return The moments of opening and closing the shutter
+		 */
+		DllExport std::pair<float, float> getShutter(void) const { return std::make_pair(m_shutterOpen, m_shutterClose); }
 
 
 	private:
@@ -94,6 +114,8 @@ namespace rt {
 		Vec3f m_dir		= Vec3f(0, 0, 1);	///< Camera viewing direction
 		Vec3f m_up		= Vec3f(0, 1, 0);	///< Camera up-vector
 		float m_focus	= 1;				///< The focal length
+		float m_shutterOpen		= 0;		///< The moment of opening the shutter
+		float m_shutterClose	= 0;		///< The moment of closing the shutter
 
 		// preprocessed values
 		bool  m_needUpdateAxes = true;		///< Flag indicating that the axes must me updated
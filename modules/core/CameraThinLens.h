@@ -33,6 +33,7 @@ namespace rt {
 		DllExport virtual ~CCameraThinLens(void) = default;
 			
 		DllExport void			InitRay(Ray& ray, int x, int y, const Vec2f& sample = Vec2f::all(0.5f)) override;
+		DllExport qword			getDigest(void) const override { return (CDigest() << CCameraPerspective::getDigest() << m_lensRadius << m_focalDistance << m_nBlades).get(); }
 		/**
 		 * @brief Returns the lens radius
 		 * @return The lens radius
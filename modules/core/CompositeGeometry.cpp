@@ -1,11 +1,51 @@
 #include "CompositeGeometry.h"
 
 #include <utility>
+#include <algorithm>
+#include <deque>
 #include <macroses.h>
 #include "Ray.h"
 #include "Transform.h"
 
 namespace rt {
+    namespace {
+        // Returns the state of the composite geometry from the states of its operands
+        bool apply(BoolOp operationType, bool inside1, bool inside2) {
+            switch (operationType) {
+                case BoolOp::Union:         return inside1 || inside2;
+                case BoolOp::Intersection:  return inside1 && inside2;
+                case BoolOp::Difference:    return inside1 && !inside2;
+                default:                    return false;
+            }
+        }
+
+        // Returns true if the ray enters the surface at the hit
+        bool isEntering(const Ray &hit) {
+            return hit.hit->getNormal(hit).dot(hit.dir) < 0;
+        }
+
+        // Scratch hit list of the calling thread. The nested composites get their own lists, since they are traced while the enclosing list is filled
+        class CScratchHits {
+        public:
+            CScratchHits(void) {
+                if (m_vvHits.size() <= m_depth) m_vvHits.emplace_back();
+                m_vvHits[m_depth].clear();
+                m_depth++;
+            }
+            ~CScratchHits(void) { m_depth--; }
+            CScratchHits(const CScratchHits &) = delete;
+            const CScratchHits &operator=(const CScratchHits &) = delete;
+
+            std::vector<Ray> &get(void) const { return m_vvHits[m_depth - 1]; }
+
+        private:
+            static thread_local std::deque<std::vector<Ray>> m_vvHits;     // deque keeps the references valid while it grows
+            static thread_local size_t m_depth;
+        };
+
+        thread_local std::deque<std::vector<Ray>> CScratchHits::m_vvHits;
+        thread_local size_t CScratchHits::m_depth = 0;
+    }
 
     // Constructor
     CCompositeGeometry::CCompositeGeometry(const CSolid &s1, const CSolid &s2, BoolOp operationType, int maxDepth,
@@ -15,37 +55,7 @@ namespace rt {
     , m_pBSPTree1(new CBSPTree()), m_pBSPTree2(new CBSPTree())
 #endif
     {
-        // Initializing the bounding box
-        CBoundingBox boxA, boxB;
-        for (const auto &prim : s1.getPrims())
-            boxA.extend(prim->getBoundingBox());
-        for (const auto &prim : s2.getPrims())
-            boxB.extend(prim->getBoundingBox());
-        Vec3f minPt = Vec3f::all(0);
-        Vec3f maxPt = Vec3f::all(0);
-        switch (m_operationType) {
-            case BoolOp::Union:
-                for (int i = 0; i < 3; i++) {
-                    minPt[i] = MIN(boxA.getMinPoint()[i], boxB.getMinPoint()[i]);
-                    maxPt[i] = MAX(boxA.getMaxPoint()[i], boxB.getMaxPoint()[i]);
-                }
-                break;
-            case BoolOp::Intersection:
-                for (int i = 0; i < 3; i++) {
-                    minPt[i] = MAX(boxA.getMinPoint()[i], boxB.getMinPoint()[i]);
-                    maxPt[i] = MIN(boxA.getMaxPoint()[i], boxB.getMaxPoint()[i]);
-                }
-                break;
-            case BoolOp::Difference:
-                for (int i = 0; i < 3; i++) {
-                    minPt[i] = boxA.getMinPoint()[i];
-                    maxPt[i] = boxA.getMaxPoint()[i];
-                }
-                break;
-            default:
-                break;
-        }
-        m_boundingBox = CBoundingBox(minPt, maxPt);
+        updateBoundingBox();
         m_origin = m_boundingBox.getCenter();
 #ifdef ENABLE_BSP
         m_pBSPTree1->build(m_vPrims1, maxPrimitives, maxDepth);
@@ -54,127 +64,24 @@ namespace rt {
     }
 
     bool CCompositeGeometry::intersect(Ray &ray) const {
-        std::pair<Ray, Ray> range1(ray, ray);
-        std::pair<Ray, Ray> range2(ray, ray);
-        range1.second.t = -Infty;
-        range2.second.t = -Infty;
-        bool hasIntersection = false;
-#ifdef ENABLE_BSP
-        hasIntersection = m_pBSPTree1->intersect(range1.first);
-        hasIntersection |= m_pBSPTree2->intersect(range2.first);
-        if (m_operationType == BoolOp::Difference) {
-            Ray r1 = ray;
-            Ray r2 = ray;
-            if (m_pBSPTree1->intersect_furthest(r1)) {
-                range1.second = r1;
-                hasIntersection = true;
-            }
-            if (m_pBSPTree2->intersect_furthest(r2)) {
-                range2.second = r2;
-                hasIntersection = true;
-            }
-        }
-#else
-        for (const auto &prim : m_vPrims1) {
-            Ray r = ray;
-            if (prim->intersect(r)) {
-                if (r.t < range1.first.t)
-                    range1.first = r;
-                if (r.t > range1.second.t)
-                    range1.second = r;
-                hasIntersection = true;
-            }
-        }
-        for (const auto &prim : m_vPrims2) {
-            Ray r = ray;
-            if (prim->intersect(r)) {
-                if (r.t < range2.first.t)
-                    range2.first = r;
-                if (r.t > range2.second.t)
-                    range2.second = r;
-                hasIntersection = true;
-            }
-        }
-#endif
-        if (!hasIntersection)
+        CScratchHits scratch;
+        std::vector<Ray> &vHits = scratch.get();
+        trace(ray, vHits, 1);
+        if (vHits.empty())
             return false;
-        double t;
-        switch (m_operationType) {
-            case BoolOp::Union:
-                t = MIN(range1.first.t, range2.first.t);
-                if (abs(t - range1.first.t) < Epsilon)
-                    ray = range1.first;
-                else if (abs(t - range2.first.t) < Epsilon)
-                    ray = range2.first;
-                break;
-            case BoolOp::Intersection:
-                t = MAX(range1.first.t, range2.first.t);
-                if (abs(t) >= Infty)
-                    return false;
-                if (abs(t - range1.first.t) < Epsilon)
-                    ray = range1.first;
-                else if (abs(t - range2.first.t) < Epsilon)
-                    ray = range2.first;
-                break;
-            case BoolOp::Difference:
-                if (!range2.first.hit && !range2.second.hit) {
-                    if (range1.first.hit && range1.second.hit) {
-                        ray = range1.first.t < range1.second.t ? range1.first : range1.second;
-                        return true;
-                    }
-                    else {
-                        ray = range1.first.hit ? range1.first : range1.second;
-                        return true;
-                    }
-                }
-                if (range1.second.hit && range2.second.hit) {
-                    if (range1.first.hit) {
-                        if (range2.first.hit) {
-                            if (range1.first.t < range2.first.t) {
-                                ray = range1.first;
-                                return true;
-                            } else {
-                                if (range2.second.t < range1.second.t) {
-                                    if (range2.second.t < range1.first.t) {
-                                        ray = range1.first;
-                                        return true;
-                                    } else {
-                                        ray = range2.second;
-                                        return true;
-                                    }
-                                } else {
-                                    return false;
-                                }
-                            }
-                        } else {
-                            if (range1.first.t < range2.second.t && range2.second.t < range1.second.t) {
-                                ray = range2.second;
-                                return true;
-                            }
-                        }
-                    } else {
-                        if (range2.first.hit) {
-                            if (range2.first.t < range1.second.t) {
-                                ray = range2.first;
-                                return true;
-                            }
-                        } else {
-                            if (range2.second.t < range1.second.t) {
-                                ray = range2.second;
-                                return true;
-                            }
-                        }
-                    }
-                }
-                return false;
-            default:
-                break;
-        }
+        ray = vHits.front();
         return true;
     }
 
     bool CCompositeGeometry::if_intersect(const Ray &ray) const {
-        return intersect(lvalue_cast(Ray(ray)));
+        CScratchHits scratch;
+        std::vector<Ray> &vHits = scratch.get();
+        trace(ray, vHits, 1);
+        return !vHits.empty();
+    }
+
+    void CCompositeGeometry::intersectAll(const Ray &ray, std::vector<Ray> &vHits) const {
+        trace(ray, vHits, std::numeric_limits<size_t>::max());
     }
 
     void CCompositeGeometry::transform(const Mat &T) {
@@ -193,6 +100,30 @@ namespace rt {
         // update pivots point
         for (int i = 0; i < 3; i++)
             m_origin.val[i] += T.at<float>(i, 3);
+
+        updateBoundingBox();
+#ifdef ENABLE_BSP
+        m_pBSPTree1->refit(m_vPrims1);
+        m_pBSPTree2->refit(m_vPrims2);
+#endif
+    }
+
+    qword CCompositeGeometry::getDigest(void) const {
+        CDigest digest;
+        digest << IPrim::getDigest() << m_operationType << m_origin;
+        for (const auto &pPrim : m_vPrims1) digest << pPrim->getDigest() << (pPrim->getShader() ? pPrim->getShader()->getDigest() : 0);
+        for (const auto &pPrim : m_vPrims2) digest << pPrim->getDigest() << (pPrim->getShader() ? pPrim->getShader()->getDigest() : 0);
+        return digest.get();
+    }
+
+    void CCompositeGeometry::accountMemory(MemoryReport& report) const {
+        report.addPrimitive(*this, sizeof(CCompositeGeometry) + (m_vPrims1.capacity() + m_vPrims2.capacity()) * sizeof(ptr_prim_t));
+        for (const auto &pPrim : m_vPrims1) pPrim->accountMemory(report);
+        for (const auto &pPrim : m_vPrims2) pPrim->accountMemory(report);
+#ifdef ENABLE_BSP
+        m_pBSPTree1->accountMemory(report);
+        m_pBSPTree2->accountMemory(report);
+#endif
     }
 
     Vec3f CCompositeGeometry::getNormal(const Ray &ray) const {
@@ -202,4 +133,97 @@ namespace rt {
     Vec2f CCompositeGeometry::getTextureCoords(const Ray &ray) const {
         RT_ASSERT_MSG(false, "This method should never be called. Aborting...");
     }
+
+    // ------------------------------------------------ Private ------------------------------------------------
+    void CCompositeGeometry::updateBoundingBox(void) {
+        CBoundingBox boxA, boxB;
+        for (const auto &prim : m_vPrims1)
+            boxA.extend(prim->getBoundingBox());
+        for (const auto &prim : m_vPrims2)
+            boxB.extend(prim->getBoundingBox());
+        Vec3f minPt = Vec3f::all(0);
+        Vec3f maxPt = Vec3f::all(0);
+        switch (m_operationType) {
+            case BoolOp::Union:
+                for (int i = 0; i < 3; i++) {
+                    minPt[i] = MIN(boxA.getMinPoint()[i], boxB.getMinPoint()[i]);
+                    maxPt[i] = MAX(boxA.getMaxPoint()[i], boxB.getMaxPoint()[i]);
+                }
+                break;
+            case BoolOp::Intersection:
+                for (int i = 0; i < 3; i++) {
+                    minPt[i] = MAX(boxA.getMinPoint()[i], boxB.getMinPoint()[i]);
+                    maxPt[i] = MIN(boxA.getMaxPoint()[i], boxB.getMaxPoint()[i]);
+                }
+                break;
+            case BoolOp::Difference:
+                for (int i = 0; i < 3; i++) {
+                    minPt[i] = boxA.getMinPoint()[i];
+                    maxPt[i] = boxA.getMaxPoint()[i];
+                }
+                break;
+            default:
+                break;
+        }
+        m_boundingBox = CBoundingBox(minPt, maxPt);
+    }
+
+    void CCompositeGeometry::collectHits(const std::vector<ptr_prim_t> &vpPrims, const CBSPTree *pBSPTree, const Ray &ray, std::vector<Ray> &vHits) {
+        if (pBSPTree)
+            pBSPTree->intersectAll(ray, vHits);
+        else {
+            CHitCollector collector(vHits);
+            for (const auto &pPrim : vpPrims)
+                pPrim->intersectAll(ray, collector.getHits());
+            collector.flush(Infty);
+        }
+
+        // A ray crossing an edge hits both triangles sharing the edge at the same point in the same direction
+        auto duplicate = [](const Ray &a, const Ray &b) {
+            return b.t - a.t < Epsilon * Epsilon && a.hit != b.hit && isEntering(a) == isEntering(b);
+        };
+        vHits.erase(std::unique(vHits.begin(), vHits.end(), duplicate), vHits.end());
+    }
+
+    void CCompositeGeometry::trace(const Ray &ray, std::vector<Ray> &vHits, size_t maxHits) const {
+        // The operands are intersected up to infinity: the parity of the number of hits gives the state of an operand at the ray origin
+        Ray r = ray;
+        r.t = Infty;
+        r.hit = nullptr;
+
+        const CBSPTree *pBSPTree1 = nullptr;
+        const CBSPTree *pBSPTree2 = nullptr;
+#ifdef ENABLE_BSP
+        pBSPTree1 = m_pBSPTree1.get();
+        pBSPTree2 = m_pBSPTree2.get();
+#endif
+        CScratchHits scratch1, scratch2;
+        std::vector<Ray> &vHits1 = scratch1.get();
+        std::vector<Ray> &vHits2 = scratch2.get();
+        collectHits(m_vPrims1, pBSPTree1, r, vHits1);
+        if (vHits1.empty() && m_operationType != BoolOp::Union)
+            return;     // the ray does not meet the first operand, which bounds the result
+        collectHits(m_vPrims2, pBSPTree2, r, vHits2);
+
+        // Merge the span lists of the operands
+        bool inside1 = vHits1.size() % 2 == 1;
+        bool inside2 = vHits2.size() % 2 == 1;
+        bool inside = apply(m_operationType, inside1, inside2);
+        size_t nHits = 0;
+        auto it1 = vHits1.cbegin();
+        auto it2 = vHits2.cbegin();
+        while (nHits < maxHits && (it1 != vHits1.cend() || it2 != vHits2.cend())) {
+            const bool first = it2 == vHits2.cend() || (it1 != vHits1.cend() && it1->t <= it2->t);
+            const Ray &hit = first ? *it1++ : *it2++;
+            if (hit.t >= ray.t)
+                break;
+            if (first) inside1 = !inside1;
+            else       inside2 = !inside2;
+            if (apply(m_operationType, inside1, inside2) != inside) {
+                inside = !inside;
+                vHits.push_back(hit);
+                nHits++;
+            }
+        }
+    }
 }
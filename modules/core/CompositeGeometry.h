@@ -9,6 +9,15 @@ namespace rt {
         Intersection, Difference, Union
     };
 
+    /**
+     * @brief Composite geometry: the boolean combination of two solids (Constructive Solid Geometry)
+     * @details The composite is evaluated along the ray with the span lists of its operands: all the hits of an operand are collected from its
+     * acceleration structure and sorted by distance, so that they alternate between entering and leaving the operand. The boolean operation is then
+     * applied while the two span lists are merged, and every change of the composite state is a hit of the composite. Since the spans are exact for
+     * any closed operand, the operands may be non-convex, and the composites may be nested, \a e.g. by using CSolid(pComposite) as an operand.
+     * The hits on the edges shared by the neighbouring triangles of a mesh are counted only once.
+     * @ingroup modulePrimitive
+     */
     class CCompositeGeometry : public IPrim {
     public:
         /*
@@ -31,6 +40,8 @@ namespace rt {
 
         DllExport virtual bool if_intersect(const Ray &ray) const override;
 
+        DllExport virtual void intersectAll(const Ray &ray, std::vector<Ray> &vHits) const override;
+
         DllExport virtual void transform(const Mat &T) override;
 
         DllExport virtual Vec3f getOrigin(void) const override { return m_origin; }
@@ -41,6 +52,31 @@ namespace rt {
 
         DllExport virtual CBoundingBox getBoundingBox(void) const override { return m_boundingBox; }
 
+        DllExport virtual qword getDigest(void) const override;
+
+        DllExport virtual void accountMemory(MemoryReport& report) const override;
+
+    private:
+        /**
+         * @brief Updates the bounding box of the composite geometry from the bounding boxes of the operands
+         */
+        void updateBoundingBox(void);
+        /**
+         * @brief Collects all the hits of ray \b ray with the primitives \b vpPrims of an operand
+         * @param[in] vpPrims The primitives of the operand
+         * @param[in] pBSPTree Pointer to the acceleration structure of the operand, or nullptr if BSP support is disabled
+         * @param[in] ray The ray
+         * @param[out] vHits The hits sorted by distance, without the duplicates on the shared edges
+         */
+        static void collectHits(const std::vector<ptr_prim_t> &vpPrims, const CBSPTree *pBSPTree, const Ray &ray, std::vector<Ray> &vHits);
+        /**
+         * @brief Collects the hits of ray \b ray with the surface of the composite geometry
+         * @param[in] ray The ray
+         * @param[in,out] vHits The vector, where the hits in the interval (epsilon; Ray::t) are appended to in order of their distance
+         * @param[in] maxHits The maximal number of the hits to be appended
+         */
+        void trace(const Ray &ray, std::vector<Ray> &vHits, size_t maxHits) const;
+
     private:
         std::vector<ptr_prim_t> m_vPrims1;                ///< Vector of primitives of the first geometry.
         std::vector<ptr_prim_t> m_vPrims2;                ///< Vector of primitives of the second geometry.
@@ -0,0 +1,41 @@
+#include "HitCollector.h"
+#include <algorithm>
+
+namespace rt {
+	bool CHitCollector::flush(double t)
+	{
+		if (m_done) return true;
+
+		// Sort the pending hits, which are final now
+		auto first = m_vHits.begin() + m_end;
+		std::sort(first, m_vHits.end(), [](const Ray& a, const Ray& b) { return a.t < b.t || (a.t == b.t && a.hit < b.hit); });
+		auto last = std::upper_bound(first, m_vHits.end(), t, [](double t, const Ray& hit) { return t < hit.t; });
+
+		// A primitive evicted from the mailbox may be tested twice
+		auto same = [](const Ray& a, const Ray& b) { return a.t == b.t && a.hit == b.hit; };
+		auto unique = std::unique(first, last, same);
+
+		size_t res = m_end;
+		for (auto it = first; it != unique; it++) {
+			if (it->t < m_tMin) continue;
+			bool duplicate = false;
+			for (size_t k = res; k > m_begin && m_vHits[k - 1].t >= it->t; k--)
+				if (same(m_vHits[k - 1], *it)) duplicate = true;
+			if (duplicate) continue;
+
+			HitDecision decision = m_filter ? m_filter(*it) : HitDecision::Accept;
+			if (decision == HitDecision::Reject) continue;
+			if (static_cast<size_t>(it - m_vHits.begin()) != res) m_vHits[res] = std::move(*it);
+			res++;
+			if (decision == HitDecision::AcceptAndStop || res - m_begin == m_maxHits) {
+				m_done = true;
+				break;
+			}
+		}
+
+		if (m_done) m_vHits.resize(res);
+		else m_vHits.erase(m_vHits.begin() + res, last);
+		m_end = res;
+		return m_done;
+	}
+}
@@ -0,0 +1,80 @@
+// Collector of the hits of the all-hits ray query
+// Written by Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "Ray.h"
+#include <functional>
+
+namespace rt {
+	/// Decision of the hit filter on a hit of the all-hits query (Ref. @ref CScene::intersectAll())
+	enum class HitDecision {
+		Accept,				///< The hit is collected
+		Reject,				///< The hit is skipped
+		AcceptAndStop		///< The hit is collected and the query stops
+	};
+
+	/// Filter of the all-hits query. It is called for every hit in order of the distance from the ray origin
+	using hit_filter_t = std::function<HitDecision(const Ray&)>;
+
+	// ================================ Hit Collector Class ================================
+	/**
+	 * @brief Collector of the hits of the all-hits query
+	 * @details The acceleration structure appends the hits of the primitives to the pending part of the output vector (Ref. @ref getHits()) in any order.
+	 * Once the traversal has passed the distance \a t along the ray, no hit closer than \a t may be found anymore: flush(t) sorts the pending hits up to \a t,
+	 * passes them through the filter and moves the accepted ones to the collected part of the vector. Thus the hits are collected in order of the distance
+	 * within a single front-to-back traversal, which stops as soon as enough hits are collected
+	 */
+	class CHitCollector
+	{
+	public:
+		/**
+		 * @brief Constructor
+		 * @param vHits The vector, where the collected hits are appended to
+		 * @param tMin The minimal distance of the collected hits
+		 * @param maxHits The maximal number of the hits to be collected
+		 * @param filter The hit filter, or nullptr to accept every hit
+		 */
+		DllExport CHitCollector(std::vector<Ray>& vHits, double tMin = 0, size_t maxHits = std::numeric_limits<size_t>::max(), const hit_filter_t& filter = nullptr)
+			: m_vHits(vHits)
+			, m_tMin(tMin)
+			, m_maxHits(maxHits)
+			, m_filter(filter)
+			, m_begin(vHits.size())
+			, m_end(vHits.size())
+			, m_done(maxHits == 0)
+		{}
+		DllExport CHitCollector(const CHitCollector&) = delete;
+		DllExport ~CHitCollector(void) = default;
+		DllExport const CHitCollector& operator=(const CHitCollector&) = delete;
+
+		/**
+		 * @brief Returns the vector, where the primitives append their hits to
+		 * @return The output vector
+		 */
+		DllExport std::vector<Ray>&	getHits(void) { return m_vHits; }
+		/**
+		 * @brief Collects the pending hits, which are not further than \b t from the ray origin
+		 * @details The duplicated hits of the same primitive, which has been tested more than once, are collected only once
+		 * @param t The distance, which the traversal has passed
+		 * @retval true If the query is complete and the traversal should stop. The pending hits are discarded in this case
+		 * @retval false Otherwise
+		 */
+		DllExport bool				flush(double t);
+		/**
+		 * @brief Checks whether the query is complete
+		 * @retval true If the maximal number of the hits has been collected or the filter has stopped the query
+		 * @retval false Otherwise
+		 */
+		DllExport bool				isDone(void) const { return m_done; }
+
+
+	private:
+		std::vector<Ray>&	m_vHits;			///< The output vector
+		const double		m_tMin;				///< The minimal distance of the collected hits
+		const size_t		m_maxHits;			///< The maximal number of the hits to be collected
+		const hit_filter_t	m_filter;			///< The hit filter
+		const size_t		m_begin;			///< The index of the first collected hit in the output vector
+		size_t				m_end;				///< The index after the last collected hit, \a i.e. of the first pending hit, in the output vector
+		bool				m_done;				///< Flag indicating that the query is complete
+	};
+}
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "types.h"
+#include "digest.h"
 
 namespace rt {
 	struct Ray;
@@ -49,6 +50,12 @@ namespace rt {
 		 * @return The camera aspect ratio
 		 */
 		DllExport float getAspectRatio(void) const { return m_aspectRatio; }
+		/**
+		 * @brief Returns the digest of the camera parameters
+		 * @details The digest is used for addressing the render results by the content of the scene. The derived classes should add their parameters
+		 * @return The 64-bit hash value of the camera parameters
+		 */
+		DllExport virtual qword getDigest(void) const { return (CDigest() << typeid(*this).name() << m_resolution.width << m_resolution.height).get(); }
 		
 
 	private:
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "types.h"
+#include "digest.h"
 
 namespace rt {
 	struct Ray;
@@ -43,6 +44,20 @@ namespace rt {
 		 * @retval false Otherwise
 		 */
 		DllExport virtual bool 					shadow(void) const { return m_shadow; }
+		/**
+		 * @brief Flag indicating if the light source is a point light source
+		 * @details A point light source illuminates the scene from a single position, thus its illuminate() method is deterministic 
+		 * and the shadow rays from neighbouring points toward it are coherent and may be traced in ray packets
+		 * @retval true If the light source is a point light source
+		 * @retval false Otherwise
+		 */
+		DllExport virtual bool					isPoint(void) const { return false; }
+		/**
+		 * @brief Returns the digest of the light source parameters
+		 * @details The digest is used for addressing the render results by the content of the scene. The derived classes should add their parameters
+		 * @return The 64-bit hash value of the light source parameters
+		 */
+		DllExport virtual qword					getDigest(void) const { return (CDigest() << typeid(*this).name() << m_shadow).get(); }
 		/**
 		 * @brief Turns the shadow casting on
 		 */
@@ -0,0 +1,38 @@
+#include "IPrim.h"
+#include "Ray.h"
+
+namespace rt {
+	void IPrim::intersectAll(const Ray& ray, std::vector<Ray>& vHits) const
+	{
+		// The search continues past every hit by an offset relative to the magnitude of the coordinates, which only covers the rounding errors of the hit
+		const double scale = 1 + norm(ray.org);
+		Ray r = ray;
+		double t = 0;		// distance from the origin of ray to the last hit
+		for (;;) {
+			// intersect() ignores the hits closer than Epsilon, thus the origin of r is placed Epsilon before the point, where the search continues
+			const double start = t > 0 ? t + 1e-5 * (scale + t) - Epsilon : 0;
+			r.org = ray.org + static_cast<float>(start) * ray.dir;
+			r.t = ray.t - start;
+			r.hit = nullptr;
+			r.instancedHit = nullptr;
+			if (!intersect(r)) break;
+
+			t = start + r.t;
+			vHits.push_back(r);
+			vHits.back().org = ray.org;
+			vHits.back().t = t;
+		}
+	}
+
+	std::pair<Vec2f, Vec2f> IPrim::getTextureDifferentials(const Ray& ray) const
+	{
+		if (!ray.hasDifferentials) return std::make_pair(Vec2f::all(0), Vec2f::all(0));
+
+		const Vec2f uv = getTextureCoords(ray);
+		auto differential = [&](const Vec3f& dO, const Vec3f& dD) {
+			Ray r(ray.org + dO, normalize(ray.dir + dD), ray.counter, ray.time);
+			return intersect(r) ? getTextureCoords(r) - uv : Vec2f::all(0);
+		};
+		return std::make_pair(differential(ray.dOdx, ray.dDdx), differential(ray.dOdy, ray.dDdy));
+	}
+}
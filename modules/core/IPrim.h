@@ -5,6 +5,8 @@
 #include "types.h"
 #include "IShader.h"
 #include "BoundingBox.h"
+#include "digest.h"
+#include "MemoryReport.h"
 
 namespace rt {
 	struct Ray;
@@ -45,6 +47,15 @@ namespace rt {
 		 * @retval false Otherwise
 		 */
 		DllExport virtual bool				if_intersect(const Ray& ray) const = 0;
+		/**
+		 * @brief Collects all intersections between ray \b ray and the primitive
+		 * @details The default implementation calls intersect() repeatedly, continuing the search just past every found hit by an offset relative to the magnitude
+		 * of the coordinates, so that the surfaces closer than epsilon to each other are found as well. The derived classes may provide a direct implementation
+		 * @param[in] ray The ray (Ref. @ref Ray for details)
+		 * @param[in,out] vHits The vector, where the hits in the interval (epsilon; Ray::t) are appended to in order of their distance. 
+		 * Every hit is a copy of \b ray with Ray::t, Ray::hit and the surface parameters set as by intersect()
+		 */
+		DllExport virtual void				intersectAll(const Ray& ray, std::vector<Ray>& vHits) const;
 		/**
 		 * @brief Performs affine transformation
 		 * @param T Transformation matrix (size: 4 x 4; type: CV_32FC1)
@@ -67,11 +78,41 @@ namespace rt {
 		 * @return The texture coordinates
 		 */
 		DllExport virtual Vec2f				getTextureCoords(const Ray& ray) const = 0;
+		/**
+		 * @brief Returns the derivatives of the texture coordinates in the ray - primitive intersection point with respect to the image coordinates
+		 * @details The default implementation intersects the primitive with the differential rays of \b ray (Ref. @ref Ray::hasDifferentials) and differentiates
+		 * the texture coordinates by finite differences. A differential ray, which misses the primitive, \a e.g. at the silhouette, gives zero derivative.
+		 * The derived classes may provide the analytic derivatives
+		 * @param ray The ray intersected with the primitive
+		 * @return The derivatives of the texture coordinates with respect to the image x- and y-coordinates, or zeros if the ray has no differentials
+		 */
+		DllExport virtual std::pair<Vec2f, Vec2f>	getTextureDifferentials(const Ray& ray) const;
 		/**
 		 * @brief Returns the minimum axis-aligned bounding box, which contain the primitive
 		 * @returns The bounding box, which contain the primitive
 		 */
 		DllExport virtual CBoundingBox		getBoundingBox(void) const = 0;
+		/**
+		 * @brief Returns the minimum axis-aligned bounding box, which contain the part of the primitive inside the box \b box
+		 * @details This method is used by the BSP Tree builder to assign the primitive only to the nodes it actually touches.
+		 * The default implementation clips the bounding box of the primitive, thus the derived classes may provide tighter bounds
+		 * @param box The box, \a e.g. of a BSP node
+		 * @returns The bounding box of the clipped primitive, or an empty box if the primitive does not overlap \b box
+		 */
+		DllExport virtual CBoundingBox		getClippedBoundingBox(const CBoundingBox& box) const { return box.clip(getBoundingBox()); }
+		/**
+		 * @brief Returns the digest of the primitive's geometry
+		 * @details The digest is used for addressing the render results by the content of the scene. 
+		 * The default implementation accounts only for the type and the bounding box of the primitive, thus the derived classes should add their geometry
+		 * @return The 64-bit hash value of the geometry
+		 */
+		DllExport virtual qword				getDigest(void) const { return (CDigest() << typeid(*this).name() << getBoundingBox().getMinPoint() << getBoundingBox().getMaxPoint()).get(); }
+		/**
+		 * @brief Accounts the memory, occupied by the primitive, in the report \b report
+		 * @details The default implementation accounts only for the base class, thus the derived classes should account for their size and the data they own
+		 * @param report The memory report
+		 */
+		DllExport virtual void				accountMemory(MemoryReport& report) const { report.addPrimitive(*this, sizeof(IPrim)); }
 //		/**
 //		 * @brief Sets the new shader to the prim
 //		 * @param pShader Pointer to the shader to be applied for the prim
@@ -3,9 +3,11 @@
 #pragma once
 
 #include "types.h"
+#include "digest.h"
 
 namespace rt {
 	struct Ray;
+	struct MemoryReport;
 	// ================================ Shader Interface Class ================================
 	/**
 	 * @brief Basic shader abstract interface class
@@ -27,6 +29,25 @@ namespace rt {
 		 * @return The color of the hit objesct
 		 */
 		DllExport virtual Vec3f shade(const Ray& ray) const = 0;
+		/**
+		 * @brief Returns the unlit surface color of the hit by the ray \b ray object
+		 * @details The default implementation returns white color
+		 * @param ray The ray hitting the primitive. ray.hit must point to the primitive
+		 * @return The albedo of the hit object
+		 */
+		DllExport virtual Vec3f getAlbedo(const Ray& ray) const { return Vec3f::all(1); }
+		/**
+		 * @brief Returns the digest of the shader parameters
+		 * @details The digest is used for addressing the render results by the content of the scene. The derived classes should add their parameters
+		 * @return The 64-bit hash value of the shader parameters
+		 */
+		DllExport virtual qword getDigest(void) const { return (CDigest() << typeid(*this).name()).get(); }
+		/**
+		 * @brief Accounts the memory, owned by the shader, e.g. its textures, in the report \b report
+		 * @details The default implementation does nothing, thus the derived classes, which own large data, should account for it
+		 * @param report The memory report
+		 */
+		DllExport virtual void	accountMemory(MemoryReport& report) const {}
 	};
 
 	using ptr_shader_t = std::shared_ptr<IShader>;
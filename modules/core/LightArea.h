@@ -41,6 +41,8 @@ namespace rt {
 
 		DllExport virtual std::optional<Vec3f>	illuminate(Ray& ray) override;
 		DllExport virtual size_t				getNumSamples(void) const override { return m_pSampler->getNumSamples(); }
+		DllExport virtual bool					isPoint(void) const override { return false; }
+		DllExport virtual qword					getDigest(void) const override { return (CDigest() << CLightOmni::getDigest() << m_org << m_edge1 << m_edge2 << m_pSampler->getDigest()).get(); }
 
 		/**
 		 * @brief Returns the normal of area light surface
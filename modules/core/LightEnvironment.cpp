@@ -0,0 +1,126 @@
+#include "LightEnvironment.h"
+#include "Sampler.h"
+#include "Ray.h"
+#include "macroses.h"
+#include <algorithm>
+
+namespace rt {
+	namespace {
+		// Returns the luminance of the BGR color
+		float getLuminance(const Vec3f& color) { return 0.0722f * color[0] + 0.7152f * color[1] + 0.2126f * color[2]; }
+
+		// Returns the coordinates of direction dir in the equirectangular image, u, v in [0; 1]
+		Vec2f getUV(const Vec3f& dir)
+		{
+			const float theta = acosf(MIN(MAX(dir[1], -1.0f), 1.0f));
+			const float phi = atan2f(dir[0], -dir[2]);
+			return Vec2f(0.5f + 0.5f * phi / Pif, theta / Pif);
+		}
+	}
+
+	// Constructor
+	CLightEnvironment::CLightEnvironment(const Mat& img, Vec3f intensity, ptr_sampler_t pSampler, bool castShadow)
+		: ILight(castShadow)
+		, m_intensity(intensity)
+		, m_pSampler(pSampler)
+	{
+		RT_ASSERT_MSG(!img.empty(), "Can't create environment light from an empty image");
+		RT_ASSERT_MSG(img.channels() == 1 || img.channels() == 3, "Can't create environment light from %d-channels images. A 1- or 3-channels image is needed.", img.channels());
+		img.convertTo(m_img, CV_MAKETYPE(CV_32F, img.channels()), img.depth() == CV_8U ? 1.0 / 255 : img.depth() == CV_16U ? 1.0 / 65535 : 1.0);
+		if (m_img.channels() == 1) cvtColor(m_img, m_img, COLOR_GRAY2BGR);
+		m_digest = (CDigest() << m_img).get();
+
+		// Distribution of the directions: the luminance of the texels is weighted by the solid angle of the rows.
+		// A small fraction of the average luminance is added to every texel, so that no direction with non-zero radiance has zero probability
+		const int rows = m_img.rows;
+		const int cols = m_img.cols;
+		const Scalar avg = mean(m_img);
+		const float average = getLuminance(Vec3f(static_cast<float>(avg[0]), static_cast<float>(avg[1]), static_cast<float>(avg[2])));
+		const float minWeight = average > 0 ? 1e-3f * average : 1.0f;
+		m_vMarginalCdf.assign(rows + 1, 0);
+		m_vConditionalCdf.assign(static_cast<size_t>(rows) * (cols + 1), 0);
+		for (int y = 0; y < rows; y++) {
+			const Vec3f* pImg = m_img.ptr<Vec3f>(y);
+			float* pCdf = &m_vConditionalCdf[static_cast<size_t>(y) * (cols + 1)];
+			for (int x = 0; x < cols; x++)
+				pCdf[x + 1] = pCdf[x] + MAX(getLuminance(pImg[x]), 0.0f) + minWeight;
+			const float sum = pCdf[cols];
+			for (int x = 1; x < cols; x++) pCdf[x] /= sum;
+			pCdf[cols] = 1;
+			m_vMarginalCdf[y + 1] = m_vMarginalCdf[y] + sum * sinf(Pif * (y + 0.5f) / rows);
+		}
+		const float sum = m_vMarginalCdf[rows];
+		for (int y = 1; y < rows; y++) m_vMarginalCdf[y] /= sum;
+		m_vMarginalCdf[rows] = 1;
+	}
+
+	// Constructor
+	CLightEnvironment::CLightEnvironment(const std::string& fileName, Vec3f intensity, ptr_sampler_t pSampler, bool castShadow)
+		: CLightEnvironment(imread(fileName, IMREAD_ANYDEPTH | IMREAD_ANYCOLOR), intensity, pSampler, castShadow)
+	{}
+
+	std::optional<Vec3f> CLightEnvironment::illuminate(Ray& ray)
+	{
+		float pdf;
+		ray.dir = sample(m_pSampler->getNextSample(), pdf);
+		ray.t = std::numeric_limits<double>::infinity();
+		ray.hit = nullptr;
+
+		if (pdf > 0)	return (1.0f / (Pif * pdf)) * getRadiance(ray.dir);
+		else			return std::nullopt;
+	}
+
+	Vec3f CLightEnvironment::getRadiance(const Vec3f& dir) const
+	{
+		// the texel centers are at half-integer coordinates, the image is repeated horizontally and clamped vertically
+		const Vec2f uv = getUV(normalize(dir));
+		const float x = uv[0] * m_img.cols - 0.5f;
+		const float y = uv[1] * m_img.rows - 0.5f;
+		const float x0 = floorf(x);
+		const float y0 = floorf(y);
+		const float wx = x - x0;
+		const float wy = y - y0;
+		const int x1 = (static_cast<int>(x0) % m_img.cols + m_img.cols) % m_img.cols;
+		const int x2 = (x1 + 1) % m_img.cols;
+		const int y1 = MAX(static_cast<int>(y0), 0);
+		const int y2 = MIN(static_cast<int>(y0) + 1, m_img.rows - 1);
+
+		const Vec3f* pRow1 = m_img.ptr<Vec3f>(y1);
+		const Vec3f* pRow2 = m_img.ptr<Vec3f>(y2);
+		const Vec3f res = (1 - wy) * ((1 - wx) * pRow1[x1] + wx * pRow1[x2]) + wy * ((1 - wx) * pRow2[x1] + wx * pRow2[x2]);
+		return m_intensity.mul(res);
+	}
+
+	float CLightEnvironment::getPdf(const Vec3f& dir) const
+	{
+		const Vec2f uv = getUV(normalize(dir));
+		const float sinTheta = sinf(Pif * uv[1]);
+		if (sinTheta <= 0) return 0;
+
+		const int x = MIN(static_cast<int>(uv[0] * m_img.cols), m_img.cols - 1);
+		const int y = MIN(static_cast<int>(uv[1] * m_img.rows), m_img.rows - 1);
+		const float* pCdf = &m_vConditionalCdf[static_cast<size_t>(y) * (m_img.cols + 1)];
+		const float p = (m_vMarginalCdf[y + 1] - m_vMarginalCdf[y]) * (pCdf[x + 1] - pCdf[x]) * m_img.rows * m_img.cols;
+		return p / (2 * Pif * Pif * sinTheta);
+	}
+
+	Vec3f CLightEnvironment::sample(const Vec2f& sample, float& pdf) const
+	{
+		// the row is chosen by the marginal distribution and the column by the conditional distribution within the row
+		const int y = MIN(static_cast<int>(std::upper_bound(m_vMarginalCdf.begin(), m_vMarginalCdf.end(), sample[1]) - m_vMarginalCdf.begin()) - 1, m_img.rows - 1);
+		const float* pCdf = &m_vConditionalCdf[static_cast<size_t>(y) * (m_img.cols + 1)];
+		const int x = MIN(static_cast<int>(std::upper_bound(pCdf, pCdf + m_img.cols + 1, sample[0]) - pCdf) - 1, m_img.cols - 1);
+
+		// the sample is distributed uniformly within the texel
+		const float pRow = m_vMarginalCdf[y + 1] - m_vMarginalCdf[y];
+		const float pCol = pCdf[x + 1] - pCdf[x];
+		const float u = (x + MIN((sample[0] - pCdf[x]) / pCol, 1.0f)) / m_img.cols;
+		const float v = (y + MIN((sample[1] - m_vMarginalCdf[y]) / pRow, 1.0f)) / m_img.rows;
+
+		const float theta = Pif * v;
+		const float phi = 2 * Pif * (u - 0.5f);
+		const float sinTheta = sinf(theta);
+		pdf = sinTheta > 0 ? pRow * pCol * m_img.rows * m_img.cols / (2 * Pif * Pif * sinTheta) : 0;
+		return Vec3f(sinTheta * sinf(phi), cosf(theta), -sinTheta * cosf(phi));
+	}
+}
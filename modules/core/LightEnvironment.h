@@ -0,0 +1,78 @@
+// Environment light source class
+// Written by Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "ILight.h"
+#include "SamplerStratified.h"
+
+namespace rt {
+	// ================================ Environment Light Class ================================
+	/**
+	 * @brief Environment (image-based) light source class
+	 * @details The light arrives from the infinitely distant sphere around the scene, which is given by an equirectangular (latitude-longitude) image:
+	 * the image columns span the azimuth around the y-axis, and the rows span the polar angle from the +y direction (top row) to the -y direction (bottom row).
+	 * The directions are importance-sampled according to the luminance of the image, using the marginal distribution of the rows and the conditional distributions
+	 * of the columns within the rows. The same environment is seen by the rays, which miss the geometry of the scene (Ref. @ref CScene::setEnvironment())
+	 * @ingroup moduleLight
+	 * @author Sergey G. Kosov, sergey.kosov@project-10.de
+	 */
+	class CLightEnvironment : public ILight
+	{
+	public:
+		/**
+		 * @brief Constructor
+		 * @param img The equirectangular environment image with linear (HDR) radiance
+		 * @param intensity The scale factor of the radiance (red, green, blue)
+		 * @param pSampler Pointer to the sampler to be used with the environment light
+		 * @param castShadow Flag indicating whether the light source casts shadow
+		 */
+		DllExport CLightEnvironment(const Mat& img, Vec3f intensity = Vec3f::all(1), ptr_sampler_t pSampler = std::make_shared<CSamplerStratified>(4, true, true), bool castShadow = true);
+		/**
+		 * @brief Constructor
+		 * @param fileName The path to the equirectangular environment image, \a e.g. in the \a .hdr or \a .exr format
+		 * @param intensity The scale factor of the radiance (red, green, blue)
+		 * @param pSampler Pointer to the sampler to be used with the environment light
+		 * @param castShadow Flag indicating whether the light source casts shadow
+		 */
+		DllExport CLightEnvironment(const std::string& fileName, Vec3f intensity = Vec3f::all(1), ptr_sampler_t pSampler = std::make_shared<CSamplerStratified>(4, true, true), bool castShadow = true);
+
+		/**
+		 * @copydoc ILight::illuminate()
+		 * @details The direction is importance-sampled and the returned intensity is the radiance divided by the probability density,
+		 * scaled such that a white diffuse surface under a uniform environment has the brightness of the environment
+		 */
+		DllExport virtual std::optional<Vec3f>	illuminate(Ray& ray) override;
+		DllExport virtual size_t				getNumSamples(void) const override { return m_pSampler->getNumSamples(); }
+		DllExport virtual qword					getDigest(void) const override { return (CDigest() << ILight::getDigest() << m_digest << m_intensity << m_pSampler->getDigest()).get(); }
+		/**
+		 * @brief Returns the radiance arriving from direction \b dir
+		 * @param dir The direction from the scene towards the environment
+		 * @return The bilinearly interpolated radiance (red, green, blue)
+		 */
+		DllExport Vec3f							getRadiance(const Vec3f& dir) const;
+		/**
+		 * @brief Returns the probability density of sampling direction \b dir
+		 * @param dir The normalized direction
+		 * @return The probability density with respect to the solid angle
+		 */
+		DllExport float							getPdf(const Vec3f& dir) const;
+		/**
+		 * @brief Samples a direction according to the luminance of the environment
+		 * @param sample The sample in the unit square
+		 * @param[out] pdf The probability density of the sampled direction with respect to the solid angle
+		 * @return The normalized direction towards the environment
+		 */
+		DllExport Vec3f							sample(const Vec2f& sample, float& pdf) const;
+
+
+	private:
+		Mat					m_img;					///< The environment image (type: CV_32FC3)
+		Vec3f				m_intensity;			///< The scale factor of the radiance
+		ptr_sampler_t		m_pSampler;				///< Pointer to the sampler ref @ref CSampler
+		qword				m_digest;				///< The digest of the environment image
+		std::vector<float>	m_vMarginalCdf;			///< The cumulative distribution of the rows (size: rows + 1)
+		std::vector<float>	m_vConditionalCdf;		///< The cumulative distributions of the columns within every row (size: rows x (cols + 1))
+	};
+
+	using ptr_light_environment_t = std::shared_ptr<CLightEnvironment>;
+}
@@ -29,6 +29,8 @@ namespace rt {
 
 		DllExport virtual std::optional<Vec3f>	illuminate(Ray& ray) override;
 		DllExport virtual size_t				getNumSamples(void) const override { return 1; }
+		DllExport virtual bool					isPoint(void) const override { return true; }
+		DllExport virtual qword					getDigest(void) const override { return (CDigest() << ILight::getDigest() << m_intensity << m_org).get(); }
 		
 		// Accessors
 		/**
@@ -32,6 +32,7 @@ namespace rt {
 
 		DllExport virtual std::optional<Vec3f>	illuminate(Ray& ray) override;
 		DllExport virtual size_t				getNumSamples(void) const override { return m_pSampler->getNumSamples(); }
+		DllExport virtual qword					getDigest(void) const override { return (CDigest() << ILight::getDigest() << m_intensity << m_maxDistance << m_pSampler->getDigest()).get(); }
 
 
 
@@ -30,6 +30,7 @@ namespace rt {
 		DllExport virtual ~CLightSpot(void) = default;
 
 		DllExport virtual std::optional<Vec3f>	illuminate(Ray& ray) override;
+		DllExport virtual qword					getDigest(void) const override { return (CDigest() << CLightOmni::getDigest() << m_dir << m_alpha << m_beta).get(); }
 
 		// Accessors
 		/**
@@ -0,0 +1,73 @@
+// Mailboxing of the ray - primitive intersection tests
+// Written by Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "types.h"
+
+namespace rt {
+	// ================================ Mailbox Class ================================
+	/**
+	 * @brief Mailbox of the primitives, which have already been tested against the current ray or ray packet
+	 * @details The BSP Tree references a primitive in every leaf, which the primitive overlaps, thus a ray crossing several such leaves would test
+	 * the same primitive several times. Every thread has its own mailbox: a small direct-mapped table of the recently tested primitives, stamped with
+	 * the id of the traversal. A new traversal gets a new stamp, which invalidates the whole table at once. A primitive evicted by a collision is simply tested again
+	 */
+	class CMailbox
+	{
+	public:
+		// ================================ Scope Class ================================
+		/**
+		 * @brief Traversal of one ray or one ray packet
+		 * @details The scope gets a new stamp for the mailbox of the calling thread and restores the previous stamp at the end,
+		 * so the nested traversals, e.g. of the composite geometries, do not affect the enclosing one
+		 */
+		class CScope {
+		public:
+			CScope(void) : m_prevStamp(local.m_stamp) { local.m_stamp = ++local.m_counter; }
+			~CScope(void) { local.m_stamp = m_prevStamp; }
+			CScope(const CScope&) = delete;
+			const CScope& operator=(const CScope&) = delete;
+
+		private:
+			qword	m_prevStamp;		///< The stamp of the enclosing traversal
+		};
+
+		/**
+		 * @brief Marks the primitive \b pPrim as tested by the rays \b mask of the current traversal
+		 * @param pPrim Pointer to the primitive
+		 * @param mask The mask of the rays in the packet, or 1 for a single ray
+		 * @return The mask of the rays from \b mask, which have not tested the primitive yet
+		 */
+		dword test(const IPrim* pPrim, dword mask)
+		{
+			Entry& entry = m_vEntries[(reinterpret_cast<qword>(pPrim) * 0x9E3779B97F4A7C15ull) >> (64 - sizeLog2)];
+			if (entry.pPrim != pPrim || entry.stamp != m_stamp) {
+				entry = { pPrim, m_stamp, mask };
+				return mask;
+			}
+			dword res = mask & ~entry.mask;
+			entry.mask |= mask;
+			return res;
+		}
+
+		/// The mailbox of the calling thread
+		static thread_local CMailbox local;
+
+
+	private:
+		/// Primitive tested in the traversal with the stamp \b stamp
+		struct Entry {
+			const IPrim*	pPrim	= nullptr;
+			qword			stamp	= 0;
+			dword			mask	= 0;		///< The rays, which have tested the primitive
+		};
+
+		static constexpr size_t	sizeLog2 = 8;
+
+		Entry	m_vEntries[1 << sizeLog2];
+		qword	m_stamp		= 0;		///< The stamp of the current traversal
+		qword	m_counter	= 0;		///< The last issued stamp
+	};
+
+	inline thread_local CMailbox CMailbox::local;
+}
@@ -0,0 +1,88 @@
+#include "MemoryReport.h"
+#include "IPrim.h"
+#include "Texture.h"
+#include <iomanip>
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+
+namespace rt {
+	namespace {
+		// Returns the readable name of the type without the namespace, e.g. "CPrimTriangle"
+		std::string getTypeName(const std::type_info& type)
+		{
+			std::string res = type.name();
+#ifdef __GNUG__
+			int status = 0;
+			char* name = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+			if (status == 0 && name) res = name;
+			free(name);
+#endif
+			size_t pos = res.rfind("::");
+			if (pos != std::string::npos) res = res.substr(pos + 2);
+			pos = res.rfind(' ');			// "class CPrimTriangle" for MSVC
+			if (pos != std::string::npos) res = res.substr(pos + 1);
+			return res;
+		}
+
+		std::ostream& print(std::ostream& os, const std::string& name, const MemoryItem& item)
+		{
+			return os << name << ": " << item.count << " (" << item.bytes / 1024.0 << " KB)" << std::endl;
+		}
+	}
+
+	double MemoryReport::getDuplicationFactor(void) const
+	{
+		return bspPrimitives ? static_cast<double>(leafReferences.count) / bspPrimitives : 0;
+	}
+
+	size_t MemoryReport::getTotal(void) const
+	{
+		size_t res = sceneReferences.bytes + bspNodes.bytes + bspLeaves.bytes + leafReferences.bytes + textures.bytes + renderCache.bytes;
+		for (const auto& primitive : primitives) res += primitive.second.bytes;
+		return res;
+	}
+
+	void MemoryReport::addPrimitive(const IPrim& prim, size_t bytes)
+	{
+		primitives[getTypeName(typeid(prim))].add(bytes + sharedControlBlock);
+		auto pShader = prim.getShader();
+		if (pShader && accountOnce(pShader.get())) pShader->accountMemory(*this);
+	}
+
+	void MemoryReport::addTexture(const CTexture& texture)
+	{
+		if (!accountOnce(&texture)) return;
+		size_t bytes = sizeof(CTexture) + sharedControlBlock;
+		auto pCache = texture.getCache();
+		if (pCache) {	// the tiles in memory are shared by all the textures of the cache
+			if (accountOnce(pCache.get())) bytes += sizeof(CTextureCache) + sharedControlBlock + pCache->getSize();
+		}
+		else
+			for (size_t level = 0; level < texture.getNumLevels(); level++)
+				bytes += texture.getLevel(level).total() * texture.getLevel(level).elemSize();
+		textures.add(bytes);
+	}
+
+	std::ostream& operator<<(std::ostream& os, const MemoryReport& report)
+	{
+		// the format of the caller's stream is restored at the end
+		const std::ios_base::fmtflags flags = os.flags();
+		const std::streamsize precision = os.precision();
+		os << std::fixed << std::setprecision(2);
+		for (const auto& primitive : report.primitives)
+			print(os, primitive.first, primitive.second);
+		print(os, "Scene references", report.sceneReferences);
+		print(os, "BSP branch nodes", report.bspNodes);
+		print(os, "BSP leaf nodes", report.bspLeaves);
+		print(os, "BSP leaf references", report.leafReferences);
+		os << "BSP duplication factor: " << report.getDuplicationFactor() << std::endl;
+		print(os, "Textures", report.textures);
+		print(os, "Render cache", report.renderCache);
+		os << "Render cache on disk: " << report.renderCacheDisk / 1024.0 << " KB" << std::endl;
+		os << "Total memory: " << report.getTotal() / 1024.0 << " KB" << std::endl;
+		os.flags(flags);
+		os.precision(precision);
+		return os;
+	}
+}
@@ -0,0 +1,86 @@
+// Memory accounting
+// Written by Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "types.h"
+#include <map>
+#include <unordered_set>
+
+namespace rt {
+	class CTexture;
+
+	/// Number of the objects of one kind and the bytes they occupy
+	struct MemoryItem
+	{
+		size_t	count	= 0;	///< Number of the objects
+		size_t	bytes	= 0;	///< Memory occupied by the objects in bytes
+
+		/**
+		 * @brief Accounts for \b count objects, occupying \b bytes bytes
+		 * @param bytes The memory in bytes
+		 * @param count The number of the objects
+		 */
+		void add(size_t bytes, size_t count = 1) { this->bytes += bytes; this->count += count; }
+	};
+
+	// ================================ Memory Report Structure ================================
+	/**
+	 * @brief Itemised memory usage of a scene
+	 * @details The sizes are estimated from the sizes of the objects, the capacities of the containers and the shared pointer control blocks,
+	 * which accompany every primitive, BSP node and texture. The heap overhead of the allocator is not accounted (Ref. @ref CScene::getMemoryReport())
+	 */
+	struct MemoryReport
+	{
+		/// Approximate size of the control block of a shared pointer, created with std::make_shared()
+		static constexpr size_t sharedControlBlock = sizeof(void*) + 2 * sizeof(int);
+
+		std::map<std::string, MemoryItem>	primitives;			///< The primitives per type, including the nested primitives of the composite geometries
+		MemoryItem							sceneReferences;	///< Pointers to the primitives, lights and cameras, held by the scene
+		MemoryItem							bspNodes;			///< Branch nodes of the BSP Trees
+		MemoryItem							bspLeaves;			///< Leaf nodes of the BSP Trees
+		MemoryItem							leafReferences;		///< Pointers to the primitives, held by the leaf nodes
+		size_t								bspPrimitives = 0;	///< Number of the primitives, the BSP Trees were built for
+		MemoryItem							textures;			///< Unique textures, used by the shaders
+		MemoryItem							renderCache;		///< Index and pending images of the render cache
+		size_t								renderCacheDisk = 0;///< Size of the render cache on disk in bytes. It is not included in getTotal()
+
+		/**
+		 * @brief Returns the number of the leaf references per primitive
+		 * @details Splitting of the BSP nodes duplicates the references to the primitives straddling the splitting plane. The factor is 1 if no primitive is duplicated
+		 * @return The duplication factor, or 0 if no BSP Tree was built
+		 */
+		DllExport double	getDuplicationFactor(void) const;
+		/**
+		 * @brief Returns the total memory usage
+		 * @return The sum of all the items in bytes
+		 */
+		DllExport size_t	getTotal(void) const;
+
+		/**
+		 * @brief Accounts for the primitive \b prim and its shader
+		 * @param prim The primitive
+		 * @param bytes The memory occupied by the primitive object and the data it owns
+		 */
+		DllExport void		addPrimitive(const IPrim& prim, size_t bytes);
+		/**
+		 * @brief Accounts for the texture \b texture, unless it has already been accounted
+		 * @details All the mipmap levels of the texture are accounted
+		 * @param texture The texture
+		 */
+		DllExport void		addTexture(const CTexture& texture);
+		/**
+		 * @brief Marks the shared object \b pObject as accounted
+		 * @details The objects, which are shared by several primitives, \a e.g. the meshes of the instances, should be accounted only once
+		 * @param pObject Pointer to the object
+		 * @retval true If the object has not been accounted yet and thus should be accounted by the caller
+		 * @retval false Otherwise
+		 */
+		DllExport bool		accountOnce(const void* pObject) { return m_accounted.insert(pObject).second; }
+
+		DllExport friend std::ostream& operator<<(std::ostream& os, const MemoryReport& report);
+
+
+	private:
+		std::unordered_set<const void*>		m_accounted;		///< The shaders, textures and other shared objects, which are already accounted
+	};
+}
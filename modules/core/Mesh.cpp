@@ -0,0 +1,58 @@
+#include "Mesh.h"
+#include "Solid.h"
+#include "Ray.h"
+
+namespace rt {
+	// Constructor
+	CMesh::CMesh(const CSolid& solid, size_t maxDepth, size_t minPrimitives)
+		: m_vpPrims(solid.getPrims())
+		, m_origin(solid.getPivot())
+#ifdef ENABLE_BSP
+		, m_pBSPTree(new CBSPTree())
+#endif
+	{
+		CDigest digest;
+		for (const auto& pPrim : m_vpPrims) {
+			m_boundingBox.extend(pPrim->getBoundingBox());
+			digest << pPrim->getDigest() << pPrim->getShader()->getDigest();
+		}
+		m_digest = digest.get();
+#ifdef ENABLE_BSP
+		m_pBSPTree->build(m_vpPrims, maxDepth, minPrimitives);
+#endif
+	}
+
+	bool CMesh::intersect(Ray& ray) const
+	{
+#ifdef ENABLE_BSP
+		return m_pBSPTree->intersect(ray);
+#else
+		RT_STATS_ADD(primitiveTests, m_vpPrims.size());
+		bool hit = false;
+		for (const auto& pPrim : m_vpPrims)
+			hit |= pPrim->intersect(ray);
+		return hit;
+#endif
+	}
+
+	bool CMesh::if_intersect(const Ray& ray) const
+	{
+#ifdef ENABLE_BSP
+		return m_pBSPTree->intersect(lvalue_cast(Ray(ray)));
+#else
+		for (const auto& pPrim : m_vpPrims) {
+			RT_STATS_INC(primitiveTests);
+			if (pPrim->if_intersect(ray)) return true;
+		}
+		return false;
+#endif
+	}
+
+	void CMesh::accountMemory(MemoryReport& report) const
+	{
+		for (const auto& pPrim : m_vpPrims) pPrim->accountMemory(report);
+#ifdef ENABLE_BSP
+		m_pBSPTree->accountMemory(report);
+#endif
+	}
+}
@@ -0,0 +1,95 @@
+// Shared geometry for instancing
+// Written by Dr. Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "IPrim.h"
+#ifdef ENABLE_BSP
+#include "BSPTree.h"
+#endif
+
+namespace rt {
+	class CSolid;
+
+	// ================================ Mesh Class ================================
+	/**
+	 * @brief Geometry, which is shared by several instances (Ref. @ref CPrimInstance)
+	 * @details The mesh keeps the primitives of a solid in their object space together with their own acceleration structure,
+	 * which is built once on construction. Every instance of the mesh references the same primitives and the same tree, thus
+	 * placing the mesh many times in a scene costs the memory of one mesh and one tree only:
+	 * @code
+	 * auto pMesh = std::make_shared<CMesh>(CSolid(pShader, dataPath + "tree.obj"));
+	 * for (auto& T : vTransforms)
+	 *     scene.add(std::make_shared<CPrimInstance>(pShader, pMesh, T));
+	 * @endcode
+	 * @note The primitives of the solid should not be transformed after the mesh was created
+	 * @ingroup modulePrimitive
+	 */
+	class CMesh
+	{
+	public:
+		/**
+		 * @brief Constructor
+		 * @param solid The solid in its object space
+		 * @param maxDepth The maximum depth of the BSP tree of the mesh. Only used if BSP support is enabled.
+		 * @param minPrimitives The minimum number of primitives in the leaf nodes of the BSP tree of the mesh. Only used if BSP support is enabled.
+		 */
+		DllExport explicit CMesh(const CSolid& solid, size_t maxDepth = 20, size_t minPrimitives = 3);
+		DllExport CMesh(const CMesh&) = delete;
+		DllExport ~CMesh(void) = default;
+		DllExport const CMesh& operator=(const CMesh&) = delete;
+
+		/**
+		 * @brief Checks for intersection between ray \b ray, given in the object space, and the mesh
+		 * @details Ray::hit is set to point to the primitive of the mesh
+		 * @param[in,out] ray The ray (Ref. @ref Ray for details)
+		 * @retval true If the ray intersects a primitive of the mesh
+		 * @retval false Otherwise
+		 */
+		DllExport bool							intersect(Ray& ray) const;
+		/**
+		 * @brief Checks for intersection between ray \b ray, given in the object space, and the mesh
+		 * @param ray The ray (Ref. @ref Ray for details)
+		 * @retval true If the ray intersects a primitive of the mesh
+		 * @retval false Otherwise
+		 */
+		DllExport bool							if_intersect(const Ray& ray) const;
+		/**
+		 * @brief Returns the primitives of the mesh
+		 * @return The vector with pointers to the primitives
+		 */
+		DllExport const std::vector<ptr_prim_t>&	getPrims(void) const { return m_vpPrims; }
+		/**
+		 * @brief Returns the pivot point of the mesh in the object space
+		 * @return The pivot point of the solid, the mesh was created from
+		 */
+		DllExport Vec3f							getOrigin(void) const { return m_origin; }
+		/**
+		 * @brief Returns the bounding box of the mesh in the object space
+		 * @return The bounding box, which contain all the primitives of the mesh
+		 */
+		DllExport CBoundingBox					getBoundingBox(void) const { return m_boundingBox; }
+		/**
+		 * @brief Returns the digest of the mesh
+		 * @details The digest accounts for the geometry of the primitives and their shaders. It is calculated once on construction
+		 * @return The 64-bit hash value of the mesh
+		 */
+		DllExport qword							getDigest(void) const { return m_digest; }
+		/**
+		 * @brief Accounts the memory, occupied by the primitives and the tree of the mesh, in the report \b report
+		 * @param report The memory report
+		 */
+		DllExport void							accountMemory(MemoryReport& report) const;
+
+
+	private:
+		std::vector<ptr_prim_t>		m_vpPrims;					///< The primitives of the mesh
+		Vec3f						m_origin;					///< The pivot point of the mesh
+		CBoundingBox				m_boundingBox;				///< The bounding box of the mesh
+		qword						m_digest		= 0;		///< The digest of the mesh
+#ifdef ENABLE_BSP
+		std::unique_ptr<CBSPTree>	m_pBSPTree		= nullptr;	///< Pointer to the spatial index structure of the mesh
+#endif
+	};
+
+	using ptr_mesh_t = std::shared_ptr<CMesh>;
+}
@@ -0,0 +1,155 @@
+#include "PrimCone.h"
+#include "Ray.h"
+#include "Transform.h"
+#include "macroses.h"
+
+namespace rt {
+	// Constructor
+	CPrimCone::CPrimCone(const ptr_shader_t pShader, const Vec3f& origin, float radius, float height, const Vec3f& axis)
+		: IPrim(pShader)
+		, m_origin(origin)
+		, m_axis(normalize(axis))
+		, m_radius(radius)
+		, m_height(height)
+	{
+		RT_ASSERT_MSG(radius > 0 && height > 0, "The radius and the height of the cone must be positive");
+		const Vec3f x = fabs(m_axis[0]) < 0.9f ? Vec3f(1, 0, 0) : Vec3f(0, 0, 1);
+		m_xAxis = normalize(x - x.dot(m_axis) * m_axis);
+	}
+
+	bool CPrimCone::intersect(Ray& ray) const
+	{
+		double t[3];
+		if (hits(ray, t) == 0) return false;
+		
+		ray.t = t[0];
+		ray.hit = shared_from_this();
+		return true;
+	}
+
+	bool CPrimCone::if_intersect(const Ray& ray) const
+	{
+		double t[3];
+		return hits(ray, t) > 0;
+	}
+
+	void CPrimCone::intersectAll(const Ray& ray, std::vector<Ray>& vHits) const
+	{
+		double t[3];
+		const size_t n = hits(ray, t);
+		for (size_t i = 0; i < n; i++) {
+			Ray r = ray;
+			r.t = t[i];
+			r.hit = shared_from_this();
+			vHits.push_back(r);
+		}
+	}
+
+	void CPrimCone::transform(const Mat& T)
+	{
+		m_origin = CTransform::point(m_origin, T);
+		
+		// The cross-section stays a circle only if the directions orthogonal to the axis are scaled uniformly and stay orthogonal to it
+		const Vec3f x = CTransform::vector(m_xAxis, T);
+		const Vec3f y = CTransform::vector(m_axis.cross(m_xAxis), T);
+		const Vec3f axis = CTransform::vector(m_height * m_axis, T);
+		m_height = static_cast<float>(norm(axis));
+		m_axis = axis / m_height;
+		
+		const float scale = static_cast<float>(norm(x));
+		RT_ASSERT_MSG(fabsf(static_cast<float>(norm(y)) - scale) < 1e-3f * scale && fabsf(x.dot(y)) < 1e-3f * scale * scale && fabsf(x.dot(m_axis)) < 1e-3f * scale && fabsf(y.dot(m_axis)) < 1e-3f * scale,
+			"The cone can only be transformed with a uniform scale orthogonal to its axis");
+		
+		// Transform radius
+		m_radius *= scale;
+		m_xAxis = normalize(x - x.dot(m_axis) * m_axis);
+	}
+
+	Vec3f CPrimCone::getNormal(const Ray& ray) const
+	{
+		const Vec3f p = ray.hitPoint() - m_origin;
+		const float y = p.dot(m_axis);
+		const Vec3f radial = p - y * m_axis;
+		const float slope = m_radius / m_height;
+		
+		// The normal of the closest surface: the side or the bottom cap
+		const float dSide = fabsf(static_cast<float>(norm(radial)) - slope * (m_height - y)) / sqrtf(1 + slope * slope);
+		if (fabsf(y) < dSide) return -m_axis;
+		
+		const float r = static_cast<float>(norm(radial));
+		return r > 0 ? normalize(radial / r + slope * m_axis) : m_axis;		// the apex
+	}
+
+	Vec2f CPrimCone::getTextureCoords(const Ray& ray) const
+	{
+		const Vec3f p = ray.hitPoint() - m_origin;
+		const float y = p.dot(m_axis);
+		const Vec3f radial = p - y * m_axis;
+		const float slope = m_radius / m_height;
+		float u = -atan2f(radial.dot(m_xAxis.cross(m_axis)), radial.dot(m_xAxis)) / (2 * Pif);
+		if (u < 0) u += 1;
+
+		const float dSide = fabsf(static_cast<float>(norm(radial)) - slope * (m_height - y)) / sqrtf(1 + slope * slope);
+		if (fabsf(y) >= dSide) return Vec2f(u, 1 - y / m_height);		// side
+		
+		// cap: from the center (0.5) to the rim (u)
+		const float k = static_cast<float>(norm(radial)) / m_radius;
+		return Vec2f(0.5f + k * (u - 0.5f), 1.0f);
+	}
+
+	CBoundingBox CPrimCone::getBoundingBox(void) const
+	{
+		// The extent of a disk with the normal n along the axis i is radius * sqrt(1 - n_i^2)
+		Vec3f extent;
+		for (int i = 0; i < 3; i++) extent[i] = m_radius * sqrtf(std::max(0.0f, 1.0f - m_axis[i] * m_axis[i]));
+		CBoundingBox res(m_origin - extent, m_origin + extent);
+		res.extend(m_origin + m_height * m_axis);
+		return res;
+	}
+
+	// ------------------------------------------------ Private ------------------------------------------------
+	size_t CPrimCone::hits(const Ray& ray, double t[3]) const
+	{
+		const Vec3f o = ray.org - m_origin;
+		const double da = ray.dir.dot(m_axis);
+		const double oa = o.dot(m_axis);
+		const Vec3f dRad = ray.dir - static_cast<float>(da) * m_axis;		// radial components
+		const Vec3f oRad = o - static_cast<float>(oa) * m_axis;
+		const double r2 = static_cast<double>(m_radius) * m_radius;
+		const double k2 = r2 / (static_cast<double>(m_height) * m_height);	// squared slope
+		const double w = m_height - oa;										// height of the apex above the ray origin
+
+		size_t n = 0;
+		auto check = [&](double root) { if (root > Epsilon && root < ray.t) t[n++] = root; };
+
+		// side: |oRad + t * dRad|^2 = k^2 (height - y)^2 for 0 < y <= height; the rim belongs to the cap, so that it is hit only once
+		const double a = static_cast<double>(dRad.dot(dRad)) - k2 * da * da;
+		const double b = 2 * (static_cast<double>(dRad.dot(oRad)) + k2 * w * da);
+		const double c = static_cast<double>(oRad.dot(oRad)) - k2 * w * w;
+		auto checkSide = [&](double root) {
+			const double y = oa + root * da;
+			if (y > 0 && y <= m_height) check(root);
+		};
+		if (fabs(a) < 1e-12) {
+			if (b != 0) checkSide(-c / b);						// the ray is parallel to the side
+		}
+		else {
+			const double D = b * b - 4 * a * c;
+			if (D >= 0) {
+				const double sqrtD = sqrt(D);
+				checkSide((-b - sqrtD) / (2 * a));
+				checkSide((-b + sqrtD) / (2 * a));
+			}
+		}
+
+		// cap
+		if (da != 0) {
+			const double root = -oa / da;
+			const Vec3f p = oRad + static_cast<float>(root) * dRad;
+			if (p.dot(p) <= r2) check(root);
+		}
+
+		std::sort(t, t + n);
+		return n;
+	}
+}
@@ -0,0 +1,62 @@
+// Cylinder Geaometrical Primitive class
+// Written by Dr. Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "IPrim.h"
+
+namespace rt {
+	// ================================ Cylinder Primitive Class ================================
+	/**
+	 * @brief Cylinder Geometrical Primitive class
+	 * @details The closed cylinder with the caps is intersected analytically, thus it may be used instead of the tessellated CSolidCylinder,
+	 * which needs many triangles for a smooth silhouette. The texture coordinates follow the ones of CSolidCylinder
+	 * @ingroup modulePrimitive
+	 */
+	class CPrimCylinder : public IPrim
+	{
+	public:
+		/**
+		 * @brief Constructor
+		 * @param pShader Pointer to the shader to be applied for the primitive
+		 * @param origin The center of the bottom cap of the cylinder
+		 * @param radius The radius of the cylinder
+		 * @param height The height of the cylinder
+		 * @param axis The axis of the cylinder, pointing from the bottom cap to the top cap
+		 */
+		DllExport CPrimCylinder(const ptr_shader_t pShader, const Vec3f& origin = Vec3f::all(0), float radius = 1, float height = 1, const Vec3f& axis = Vec3f(0, 1, 0));
+		DllExport virtual ~CPrimCylinder(void) = default;
+
+		DllExport virtual bool 			intersect(Ray& ray) const override;
+		DllExport virtual bool 			if_intersect(const Ray& ray) const override;
+		DllExport virtual void			intersectAll(const Ray& ray, std::vector<Ray>& vHits) const override;
+		/**
+		 * @copydoc IPrim::transform()
+		 * @note The transformation must scale the directions orthogonal to the axis uniformly, otherwise the cross-section would not be circular
+		 */
+		DllExport virtual void 			transform(const Mat& T) override;
+		DllExport virtual Vec3f			getOrigin(void) const override { return m_origin; }
+		DllExport virtual Vec3f 		getNormal(const Ray& ray) const override;
+		DllExport virtual Vec2f			getTextureCoords(const Ray& ray) const override;
+		DllExport virtual CBoundingBox	getBoundingBox(void) const override;
+		DllExport virtual qword			getDigest(void) const override { return (CDigest() << IPrim::getDigest() << m_origin << m_axis << m_xAxis << m_radius << m_height).get(); }
+		DllExport virtual void			accountMemory(MemoryReport& report) const override { report.addPrimitive(*this, sizeof(CPrimCylinder)); }
+
+
+	private:
+		/**
+		 * @brief Finds all the intersections of ray \b ray with the cylinder
+		 * @param ray The ray
+		 * @param[out] t The distances to the intersections in the interval (Epsilon; Ray::t) in ascending order
+		 * @return The number of the intersections (at most 4)
+		 */
+		size_t	hits(const Ray& ray, double t[4]) const;
+
+
+	private:
+		Vec3f m_origin;		///< The center of the bottom cap
+		Vec3f m_axis;		///< The normalized axis
+		Vec3f m_xAxis;		///< The normalized direction, orthogonal to the axis, where the texture coordinate u is 0
+		float m_radius;		///< The radius
+		float m_height;		///< The height
+	};
+}
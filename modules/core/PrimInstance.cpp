@@ -0,0 +1,277 @@
+#include "PrimInstance.h"
+#include "Ray.h"
+#include "Transform.h"
+#include "macroses.h"
+
+namespace rt {
+	namespace {
+		// Returns the unit quaternion (x, y, z, w) of the rotation matrix with the columns \b c
+		Vec4f toQuaternion(const Vec3f c[3])
+		{
+			auto m = [&](int i, int j) { return c[j][i]; };
+			const float trace = m(0, 0) + m(1, 1) + m(2, 2);
+			if (trace > 0) {
+				const float s = 2 * sqrtf(trace + 1);
+				return Vec4f((m(2, 1) - m(1, 2)) / s, (m(0, 2) - m(2, 0)) / s, (m(1, 0) - m(0, 1)) / s, 0.25f * s);
+			}
+			if (m(0, 0) > m(1, 1) && m(0, 0) > m(2, 2)) {
+				const float s = 2 * sqrtf(1 + m(0, 0) - m(1, 1) - m(2, 2));
+				return Vec4f(0.25f * s, (m(0, 1) + m(1, 0)) / s, (m(0, 2) + m(2, 0)) / s, (m(2, 1) - m(1, 2)) / s);
+			}
+			if (m(1, 1) > m(2, 2)) {
+				const float s = 2 * sqrtf(1 + m(1, 1) - m(0, 0) - m(2, 2));
+				return Vec4f((m(0, 1) + m(1, 0)) / s, 0.25f * s, (m(1, 2) + m(2, 1)) / s, (m(0, 2) - m(2, 0)) / s);
+			}
+			const float s = 2 * sqrtf(1 + m(2, 2) - m(0, 0) - m(1, 1));
+			return Vec4f((m(0, 2) + m(2, 0)) / s, (m(1, 2) + m(2, 1)) / s, 0.25f * s, (m(1, 0) - m(0, 1)) / s);
+		}
+
+		// Spherical linear interpolation between the unit quaternions \b a and \b b along the shorter arc
+		Vec4f slerp(const Vec4f& a, Vec4f b, float k)
+		{
+			float cosTheta = a.dot(b);
+			if (cosTheta < 0) {
+				b = -b;
+				cosTheta = -cosTheta;
+			}
+			if (cosTheta > 0.9995f) return normalize((1 - k) * a + k * b);
+			const float theta = acosf(cosTheta);
+			const float sinTheta = sinf(theta);
+			return (sinf((1 - k) * theta) / sinTheta) * a + (sinf(k * theta) / sinTheta) * b;
+		}
+
+		// Multiplies vector \b v by the matrix with the rows \b rows
+		Vec3f multiply(const Vec3f rows[3], const Vec3f& v) { return Vec3f(rows[0].dot(v), rows[1].dot(v), rows[2].dot(v)); }
+	}
+
+	// Constructor
+	CPrimInstance::CPrimInstance(const ptr_shader_t pShader, const ptr_mesh_t pMesh, const std::vector<Mat>& vT)
+		: IPrim(pShader)
+		, m_pMesh(pMesh)
+	{
+		RT_ASSERT(m_pMesh);
+		RT_ASSERT_MSG(!vT.empty(), "At least one transformation matrix is required");
+		for (const Mat& T : vT) m_vT.push_back(T.clone());
+		update();
+	}
+
+	bool CPrimInstance::intersect(Ray& ray) const
+	{
+		if (!mayHit(ray)) return false;
+
+		double scale;
+		Ray r = toObjectSpace(ray, scale);
+		if (!m_pMesh->intersect(r)) return false;
+
+		ray.t = r.t / scale;
+		ray.u = r.u;
+		ray.v = r.v;
+		ray.hit = shared_from_this();
+		ray.instancedHit = r.hit;
+		return true;
+	}
+
+	bool CPrimInstance::if_intersect(const Ray& ray) const
+	{
+		if (!mayHit(ray)) return false;
+
+		double scale;
+		return m_pMesh->if_intersect(toObjectSpace(ray, scale));
+	}
+
+	void CPrimInstance::transform(const Mat& T)
+	{
+		for (Mat& key : m_vT) key = T * key;
+		update();
+	}
+
+	Vec3f CPrimInstance::getNormal(const Ray& ray) const
+	{
+		RT_ASSERT(ray.instancedHit);
+		double scale;
+		Vec3f n = ray.instancedHit->getNormal(toObjectSpace(ray, scale));
+
+		// The normals are transformed with the transposed inverse matrix
+		const Affine inverse = getInverse(ray.time);
+		return normalize(n.val[0] * inverse.rows[0] + n.val[1] * inverse.rows[1] + n.val[2] * inverse.rows[2]);
+	}
+
+	Vec2f CPrimInstance::getTextureCoords(const Ray& ray) const
+	{
+		RT_ASSERT(ray.instancedHit);
+		double scale;
+		return ray.instancedHit->getTextureCoords(toObjectSpace(ray, scale));
+	}
+
+	std::pair<Vec2f, Vec2f> CPrimInstance::getTextureDifferentials(const Ray& ray) const
+	{
+		RT_ASSERT(ray.instancedHit);
+		double scale;
+		return ray.instancedHit->getTextureDifferentials(toObjectSpace(ray, scale));
+	}
+
+	qword CPrimInstance::getDigest(void) const
+	{
+		CDigest digest;
+		digest << IPrim::getDigest() << m_pMesh->getDigest();
+		for (const Mat& T : m_vT) digest << T;
+		return digest.get();
+	}
+
+	void CPrimInstance::accountMemory(MemoryReport& report) const
+	{
+		size_t bytes = sizeof(CPrimInstance);
+		for (const Mat& T : m_vT) bytes += T.total() * T.elemSize();
+		bytes += m_vKeys.capacity() * sizeof(Key) + m_vBoundingBoxes.capacity() * sizeof(CBoundingBox);
+		report.addPrimitive(*this, bytes);
+		if (report.accountOnce(m_pMesh.get())) m_pMesh->accountMemory(report);
+	}
+
+	// ------------------------------------------------ Private ------------------------------------------------
+	void CPrimInstance::update(void)
+	{
+		const CBoundingBox box = m_pMesh->getBoundingBox();
+		m_vKeys.clear();
+		m_vBoundingBoxes.clear();
+		m_boundingBox = CBoundingBox();
+		std::vector<CBoundingBox> vKeyBoxes;
+		for (const Mat& T : m_vT) {
+			// The rotation is found by the Gram-Schmidt orthonormalization of the columns of the linear part, and the stretch is the rest of the linear part.
+			// The reflection, if any, is kept in the stretch, so that the rotation is always proper
+			Vec3f c[3];
+			for (int j = 0; j < 3; j++) c[j] = Vec3f(T.at<float>(0, j), T.at<float>(1, j), T.at<float>(2, j));
+			Vec3f r[3];
+			r[0] = normalize(c[0]);
+			r[1] = normalize(c[1] - r[0].dot(c[1]) * r[0]);
+			r[2] = r[0].cross(r[1]);
+			Key key;
+			key.rotation = toQuaternion(r);
+			key.stretch[0] = Vec3f(r[0].dot(c[0]), r[0].dot(c[1]), r[0].dot(c[2]));
+			key.stretch[1] = Vec3f(0, r[1].dot(c[1]), r[1].dot(c[2]));
+			key.stretch[2] = Vec3f(0, 0, r[2].dot(c[2]));
+			key.translation = Vec3f(T.at<float>(0, 3), T.at<float>(1, 3), T.at<float>(2, 3));
+			m_vKeys.push_back(key);
+
+			// Bounding box of the 8 transformed corners of the mesh's bounding box
+			CBoundingBox keyBox;
+			for (int corner = 0; corner < 8; corner++) {
+				Vec3f p;
+				for (int dim = 0; dim < 3; dim++)
+					p[dim] = (corner & (1 << dim)) ? box.getMaxPoint()[dim] : box.getMinPoint()[dim];
+				keyBox.extend(CTransform::point(p, T));
+			}
+			vKeyBoxes.push_back(keyBox);
+			m_boundingBox.extend(keyBox);
+		}
+
+		// Bounding boxes of the motion segments
+		for (size_t s = 0; s + 1 < m_vKeys.size(); s++) {
+			const Key& a = m_vKeys[s];
+			const Key& b = m_vKeys[s + 1];
+			if (a.rotation == b.rotation) {
+				// Every point of the mesh moves along a straight line
+				m_vBoundingBoxes.push_back(vKeyBoxes[s]);
+				m_vBoundingBoxes.push_back(vKeyBoxes[s + 1]);
+				continue;
+			}
+			// Every point of the rotating mesh stays within the sphere around the interpolated translation, whose radius is the longest stretched corner of the mesh's bounding box
+			float radius = 0;
+			for (int corner = 0; corner < 8; corner++) {
+				Vec3f p;
+				for (int dim = 0; dim < 3; dim++)
+					p[dim] = (corner & (1 << dim)) ? box.getMaxPoint()[dim] : box.getMinPoint()[dim];
+				radius = MAX(radius, static_cast<float>(MAX(norm(multiply(a.stretch, p)), norm(multiply(b.stretch, p)))));
+			}
+			const Vec3f r = Vec3f::all(radius);
+			m_vBoundingBoxes.emplace_back(a.translation - r, a.translation + r);
+			m_vBoundingBoxes.emplace_back(b.translation - r, b.translation + r);
+			m_boundingBox.extend(m_vBoundingBoxes[2 * s]);
+			m_boundingBox.extend(m_vBoundingBoxes[2 * s + 1]);
+		}
+
+		Mat invT = m_vT.front().inv();
+		for (int i = 0; i < 3; i++) {
+			m_inverse.rows[i] = Vec3f(invT.at<float>(i, 0), invT.at<float>(i, 1), invT.at<float>(i, 2));
+			m_inverse.translation[i] = invT.at<float>(i, 3);
+		}
+
+		m_origin = CTransform::point(m_pMesh->getOrigin(), m_vT.front());
+	}
+
+	std::pair<size_t, float> CPrimInstance::getSegment(float time) const
+	{
+		const float s = std::min(std::max(time, 0.0f), 1.0f) * (m_vKeys.size() - 1);
+		const size_t segment = std::min(static_cast<size_t>(s), m_vKeys.size() - 2);
+		return std::make_pair(segment, s - segment);
+	}
+
+	CPrimInstance::Affine CPrimInstance::getInverse(float time) const
+	{
+		if (!isMoving()) return m_inverse;
+
+		// Spherical interpolation of the rotation and linear interpolation of the stretch and the translation
+		const auto [segment, k] = getSegment(time);
+		const Key& a = m_vKeys[segment];
+		const Key& b = m_vKeys[segment + 1];
+		const Vec4f q = slerp(a.rotation, b.rotation, k);
+		const float x = q[0], y = q[1], z = q[2], w = q[3];
+		const Vec3f rotation[3] = {
+			Vec3f(1 - 2 * (y * y + z * z), 2 * (x * y - z * w), 2 * (x * z + y * w)),
+			Vec3f(2 * (x * y + z * w), 1 - 2 * (x * x + z * z), 2 * (y * z - x * w)),
+			Vec3f(2 * (x * z - y * w), 2 * (y * z + x * w), 1 - 2 * (x * x + y * y))
+		};
+		Vec3f stretch[3];
+		for (int i = 0; i < 3; i++) stretch[i] = (1 - k) * a.stretch[i] + k * b.stretch[i];
+		Vec3f rows[3];
+		for (int i = 0; i < 3; i++) rows[i] = rotation[i][0] * stretch[0] + rotation[i][1] * stretch[1] + rotation[i][2] * stretch[2];
+		const Vec3f translation = (1 - k) * a.translation + k * b.translation;
+
+		// The columns of the inverse matrix are the cross products of the rows, divided by the determinant
+		const Vec3f c[3] = { rows[1].cross(rows[2]), rows[2].cross(rows[0]), rows[0].cross(rows[1]) };
+		const float invDet = 1.0f / rows[0].dot(c[0]);
+		Affine res;
+		for (int i = 0; i < 3; i++) res.rows[i] = invDet * Vec3f(c[0][i], c[1][i], c[2][i]);
+		for (int i = 0; i < 3; i++) res.translation[i] = -res.rows[i].dot(translation);
+		return res;
+	}
+
+	bool CPrimInstance::mayHit(const Ray& ray) const
+	{
+		if (!isMoving()) return true;
+
+		const auto [segment, k] = getSegment(ray.time);
+		const CBoundingBox& a = m_vBoundingBoxes[2 * segment];
+		const CBoundingBox& b = m_vBoundingBoxes[2 * segment + 1];
+		const CBoundingBox box((1 - k) * a.getMinPoint() + k * b.getMinPoint() - Vec3f::all(Epsilon), (1 - k) * a.getMaxPoint() + k * b.getMaxPoint() + Vec3f::all(Epsilon));
+		double t0 = 0;
+		double t1 = ray.t;
+		box.clip(ray, t0, t1);
+		return t0 <= t1;
+	}
+
+	Ray CPrimInstance::toObjectSpace(const Ray& ray, double& scale) const
+	{
+		const Affine inverse = getInverse(ray.time);
+		Vec3f org = inverse.translation + Vec3f(inverse.rows[0].dot(ray.org), inverse.rows[1].dot(ray.org), inverse.rows[2].dot(ray.org));
+		Vec3f dir = Vec3f(inverse.rows[0].dot(ray.dir), inverse.rows[1].dot(ray.dir), inverse.rows[2].dot(ray.dir));
+		scale = norm(dir);
+
+		Ray res(org, dir / scale, ray.counter, ray.time);
+		res.t = ray.t * scale;
+		res.u = ray.u;
+		res.v = ray.v;
+		if (ray.hasDifferentials) {
+			auto linear = [&](const Vec3f& v) { return Vec3f(inverse.rows[0].dot(v), inverse.rows[1].dot(v), inverse.rows[2].dot(v)); };
+			auto direction = [&](const Vec3f& dD) { Vec3f d = linear(dD) / scale; return d - d.dot(res.dir) * res.dir; };
+			res.hasDifferentials = true;
+			res.dOdx = linear(ray.dOdx);
+			res.dOdy = linear(ray.dOdy);
+			res.dDdx = direction(ray.dDdx);
+			res.dDdy = direction(ray.dDdy);
+		}
+#ifdef ENABLE_STATS
+		res.type = ray.type;
+#endif
+		return res;
+	}
+}
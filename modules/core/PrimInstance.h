@@ -0,0 +1,123 @@
+// Instance Geometrical Primitive class
+// Written by Dr. Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "IPrim.h"
+#include "Mesh.h"
+
+namespace rt {
+	// ================================ Instance Primitive Class ================================
+	/**
+	 * @brief Instance Geometrical Primitive class
+	 * @details The instance places a shared mesh (Ref. @ref CMesh) into the scene with its own affine transformation. The rays are transformed into the
+	 * object space of the mesh and traverse the acceleration structure of the mesh, thus the scene's acceleration structure is built over the instances only.
+	 * If the ray hits the mesh, Ray::hit points to the instance and Ray::instancedHit points to the primitive of the mesh. The instance is shaded with its own shader,
+	 * so the instances of the same mesh may look differently.
+	 * 
+	 * The instance may also move during the shutter interval of the camera (Ref. @ref CCameraPerspective::setShutter()): its transformation is then interpolated
+	 * between a few transformations at the evenly spaced moments of time, which produces motion blur. Every transformation is decomposed into the rotation, the stretch 
+	 * (scaling and shear) and the translation: the rotations are interpolated spherically and the rest linearly, so the instance moves rigidly even between the keys with large rotations.
+	 * The interpolated bounding boxes of the motion segments bound the instance at any moment of time
+	 * @ingroup modulePrimitive
+	 */
+	class CPrimInstance : public IPrim
+	{
+	public:
+		/**
+		 * @brief Constructor
+		 * @param pShader Pointer to the shader to be applied for the instance
+		 * @param pMesh Pointer to the shared mesh
+		 * @param T The transformation matrix from the object space of the mesh to the world space (size: 4 x 4; type: CV_32FC1)
+		 */
+		DllExport CPrimInstance(const ptr_shader_t pShader, const ptr_mesh_t pMesh, const Mat& T = Mat::eye(4, 4, CV_32FC1))
+			: CPrimInstance(pShader, pMesh, std::vector<Mat>{ T })
+		{}
+		/**
+		 * @brief Constructor of a moving instance
+		 * @param pShader Pointer to the shader to be applied for the instance
+		 * @param pMesh Pointer to the shared mesh
+		 * @param vT The transformation matrices at the evenly spaced moments of time from 0 to 1 (size: 4 x 4; type: CV_32FC1). 
+		 * Two matrices describe a linear motion, more matrices describe a motion along a polyline
+		 */
+		DllExport CPrimInstance(const ptr_shader_t pShader, const ptr_mesh_t pMesh, const std::vector<Mat>& vT);
+		DllExport virtual ~CPrimInstance(void) = default;
+
+		DllExport virtual bool			intersect(Ray& ray) const override;
+		DllExport virtual bool			if_intersect(const Ray& ray) const override;
+		DllExport virtual void			transform(const Mat& T) override;
+		DllExport virtual Vec3f			getOrigin(void) const override { return m_origin; }
+		DllExport virtual Vec3f			getNormal(const Ray& ray) const override;
+		DllExport virtual Vec2f			getTextureCoords(const Ray& ray) const override;
+		DllExport virtual std::pair<Vec2f, Vec2f> getTextureDifferentials(const Ray& ray) const override;
+		DllExport virtual CBoundingBox	getBoundingBox(void) const override { return m_boundingBox; }
+		DllExport virtual qword			getDigest(void) const override;
+		DllExport virtual void			accountMemory(MemoryReport& report) const override;
+		/**
+		 * @brief Returns the shared mesh of the instance
+		 * @return The pointer to the mesh
+		 */
+		DllExport ptr_mesh_t			getMesh(void) const { return m_pMesh; }
+		/**
+		 * @brief Checks whether the instance moves during the shutter interval
+		 * @retval true If the instance has more than one transformation
+		 * @retval false Otherwise
+		 */
+		DllExport bool					isMoving(void) const { return m_vKeys.size() > 1; }
+
+
+	private:
+		/// Affine transformation
+		struct Affine {
+			Vec3f	rows[3];				///< The rows of the linear part
+			Vec3f	translation;			///< The translation part
+		};
+		/// Affine transformation decomposed into the rotation \a R, the upper triangular stretch matrix \a K and the translation \a t: \f$ x \mapsto R K x + t \f$
+		struct Key {
+			Vec4f	rotation;				///< The rotation as a unit quaternion (x, y, z, w)
+			Vec3f	stretch[3];				///< The rows of the stretch matrix
+			Vec3f	translation;			///< The translation
+		};
+		
+		/**
+		 * @brief Updates the transformations, the origin and the bounding boxes after changing the transformation matrices
+		 */
+		void	update(void);
+		/**
+		 * @brief Returns the index of the motion segment and the interpolation weight of its end at the moment \b time
+		 * @param time The moment of time
+		 * @return The pair: index of the first transformation of the segment and the weight of the second one
+		 */
+		std::pair<size_t, float>	getSegment(float time) const;
+		/**
+		 * @brief Returns the inverse transformation at the moment \b time
+		 * @param time The moment of time
+		 * @return The transformation from the world space to the object space
+		 */
+		Affine	getInverse(float time) const;
+		/**
+		 * @brief Checks whether ray \b ray may hit the moving instance at the moment of the ray
+		 * @param ray The ray in the world space
+		 * @retval true If the ray intersects the bounding box of the instance at the moment of the ray, or if the instance does not move
+		 * @retval false Otherwise
+		 */
+		bool	mayHit(const Ray& ray) const;
+		/**
+		 * @brief Transforms ray \b ray into the object space of the mesh
+		 * @details The direction of the transformed ray is normalized, thus the distances to the hit points are scaled by factor \b scale
+		 * @param[in] ray The ray in the world space
+		 * @param[out] scale The ratio between the distances in the object and world spaces
+		 * @return The ray in the object space with Ray::t, Ray::u, Ray::v, Ray::time and the differentials taken from \b ray
+		 */
+		Ray		toObjectSpace(const Ray& ray, double& scale) const;
+
+
+	private:
+		ptr_mesh_t					m_pMesh;			///< Pointer to the shared mesh
+		std::vector<Mat>			m_vT;				///< The transformation matrices from the object space to the world space at the evenly spaced moments of time
+		std::vector<Key>			m_vKeys;			///< The decomposed transformations from the object space to the world space (one per matrix)
+		std::vector<CBoundingBox>	m_vBoundingBoxes;	///< The bounding boxes of the transformed mesh at the beginning and at the end of every motion segment
+		Affine						m_inverse;			///< The inverse of the first transformation
+		Vec3f						m_origin;			///< The pivot point of the mesh in the world space at the moment 0
+		CBoundingBox				m_boundingBox;		///< The bounding box of the transformed mesh over the whole motion
+	};
+}
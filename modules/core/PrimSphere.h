@@ -34,6 +34,8 @@ namespace rt {
 		DllExport virtual Vec3f 		getNormal(const Ray& ray) const override;
 		DllExport virtual Vec2f			getTextureCoords(const Ray& ray) const override;
 		DllExport virtual CBoundingBox	getBoundingBox(void) const override;
+		DllExport virtual qword			getDigest(void) const override { return (CDigest() << IPrim::getDigest() << m_origin << m_radius).get(); }
+		DllExport virtual void			accountMemory(MemoryReport& report) const override { report.addPrimitive(*this, sizeof(CPrimSphere)); }
 
 
 	private:
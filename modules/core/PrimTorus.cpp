@@ -0,0 +1,262 @@
+#include "PrimTorus.h"
+#include "Ray.h"
+#include "Transform.h"
+#include "macroses.h"
+
+namespace rt {
+	namespace {
+		// The solvers of the polynomial equations c[n] x^n + ... + c[1] x + c[0] = 0 with the real roots
+		// after J. Schwarze, "Cubic and Quartic Roots", Graphics Gems, 1990
+		inline bool isZero(double x) { return fabs(x) < 1e-9; }
+
+		int solveQuadric(const double c[3], double s[2])
+		{
+			const double p = c[1] / (2 * c[2]);
+			const double q = c[0] / c[2];
+			const double D = p * p - q;
+			if (isZero(D)) {
+				s[0] = -p;
+				return 1;
+			}
+			if (D < 0) return 0;
+			const double sqrtD = sqrt(D);
+			s[0] = sqrtD - p;
+			s[1] = -sqrtD - p;
+			return 2;
+		}
+
+		int solveCubic(const double c[4], double s[3])
+		{
+			// normal form: x^3 + Ax^2 + Bx + C = 0 and substitution x = y - A/3 to eliminate the quadric term: y^3 + 3py + 2q = 0
+			const double A = c[2] / c[3];
+			const double B = c[1] / c[3];
+			const double C = c[0] / c[3];
+			const double sqA = A * A;
+			const double p = (-sqA / 3 + B) / 3;
+			const double q = (2.0 / 27 * A * sqA - A * B / 3 + C) / 2;
+			const double cbp = p * p * p;
+			const double D = q * q + cbp;
+
+			int n;
+			if (isZero(D)) {
+				if (isZero(q)) {				// one triple solution
+					s[0] = 0;
+					n = 1;
+				}
+				else {							// one single and one double solution
+					const double u = cbrt(-q);
+					s[0] = 2 * u;
+					s[1] = -u;
+					n = 2;
+				}
+			}
+			else if (D < 0) {					// three real solutions
+				const double phi = acos(-q / sqrt(-cbp)) / 3;
+				const double t = 2 * sqrt(-p);
+				s[0] = t * cos(phi);
+				s[1] = -t * cos(phi + Pi / 3);
+				s[2] = -t * cos(phi - Pi / 3);
+				n = 3;
+			}
+			else {								// one real solution
+				const double sqrtD = sqrt(D);
+				s[0] = cbrt(sqrtD - q) - cbrt(sqrtD + q);
+				n = 1;
+			}
+
+			for (int i = 0; i < n; i++) s[i] -= A / 3;
+			return n;
+		}
+
+		int solveQuartic(const double c[5], double s[4])
+		{
+			// normal form: x^4 + Ax^3 + Bx^2 + Cx + D = 0 and substitution x = y - A/4 to eliminate the cubic term: y^4 + py^2 + qy + r = 0
+			const double A = c[3] / c[4];
+			const double B = c[2] / c[4];
+			const double C = c[1] / c[4];
+			const double D = c[0] / c[4];
+			const double sqA = A * A;
+			const double p = -3.0 / 8 * sqA + B;
+			const double q = sqA * A / 8 - A * B / 2 + C;
+			const double r = -3.0 / 256 * sqA * sqA + sqA * B / 16 - A * C / 4 + D;
+
+			int n;
+			double coeffs[4];
+			if (isZero(r)) {					// no absolute term: y(y^3 + py + q) = 0
+				coeffs[0] = q;
+				coeffs[1] = p;
+				coeffs[2] = 0;
+				coeffs[3] = 1;
+				n = solveCubic(coeffs, s);
+				s[n++] = 0;
+			}
+			else {
+				// solve the resolvent cubic and take the one real solution to build two quadric equations
+				coeffs[0] = r * p / 2 - q * q / 8;
+				coeffs[1] = -r;
+				coeffs[2] = -p / 2;
+				coeffs[3] = 1;
+				solveCubic(coeffs, s);
+				const double z = s[0];
+				double u = z * z - r;
+				double v = 2 * z - p;
+				if (isZero(u))	u = 0;
+				else if (u > 0)	u = sqrt(u);
+				else			return 0;
+				if (isZero(v))	v = 0;
+				else if (v > 0)	v = sqrt(v);
+				else			return 0;
+
+				double quadric[3] = { z - u, q < 0 ? -v : v, 1 };
+				n = solveQuadric(quadric, s);
+				quadric[0] = z + u;
+				quadric[1] = q < 0 ? v : -v;
+				n += solveQuadric(quadric, s + n);
+			}
+
+			for (int i = 0; i < n; i++) s[i] -= A / 4;
+			return n;
+		}
+	}
+
+	// Constructor
+	CPrimTorus::CPrimTorus(const ptr_shader_t pShader, const Vec3f& origin, float radius1, float radius2, const Vec3f& axis)
+		: IPrim(pShader)
+		, m_origin(origin)
+		, m_axis(normalize(axis))
+		, m_radius1(radius1)
+		, m_radius2(radius2)
+	{
+		RT_ASSERT_MSG(radius1 > radius2 && radius2 > 0, "A torus can only be modeled when the cross-section radius is positive and smaller than the outer radius");
+		const Vec3f x = fabs(m_axis[0]) < 0.9f ? Vec3f(1, 0, 0) : Vec3f(0, 1, 0);
+		m_xAxis = normalize(x - x.dot(m_axis) * m_axis);
+	}
+
+	bool CPrimTorus::intersect(Ray& ray) const
+	{
+		double t[4];
+		if (hits(ray, t) == 0) return false;
+		
+		ray.t = t[0];
+		ray.hit = shared_from_this();
+		return true;
+	}
+
+	bool CPrimTorus::if_intersect(const Ray& ray) const
+	{
+		double t[4];
+		return hits(ray, t) > 0;
+	}
+
+	void CPrimTorus::intersectAll(const Ray& ray, std::vector<Ray>& vHits) const
+	{
+		double t[4];
+		const size_t n = hits(ray, t);
+		for (size_t i = 0; i < n; i++) {
+			Ray r = ray;
+			r.t = t[i];
+			r.hit = shared_from_this();
+			vHits.push_back(r);
+		}
+	}
+
+	void CPrimTorus::transform(const Mat& T)
+	{
+		m_origin = CTransform::point(m_origin, T);
+		
+		// The torus stays a torus only under a uniform scale: the transformed local basis must stay orthogonal with equal lengths
+		const Vec3f x = CTransform::vector(m_xAxis, T);
+		const Vec3f y = CTransform::vector(m_axis.cross(m_xAxis), T);
+		const Vec3f z = CTransform::vector(m_axis, T);
+		const float scale = static_cast<float>(norm(x));
+		RT_ASSERT_MSG(fabsf(static_cast<float>(norm(y)) - scale) < 1e-3f * scale && fabsf(static_cast<float>(norm(z)) - scale) < 1e-3f * scale
+			&& fabsf(x.dot(y)) < 1e-3f * scale * scale && fabsf(x.dot(z)) < 1e-3f * scale * scale && fabsf(y.dot(z)) < 1e-3f * scale * scale,
+			"The torus can only be transformed with a uniform scale");
+		
+		// Transform radii
+		m_radius1 *= scale;
+		m_radius2 *= scale;
+		
+		m_axis = normalize(z);
+		m_xAxis = normalize(x - x.dot(m_axis) * m_axis);
+	}
+
+	Vec3f CPrimTorus::getNormal(const Ray& ray) const
+	{
+		// The normal points from the closest point of the central circle to the hit point
+		const Vec3f p = toLocal(ray.hitPoint() - m_origin);
+		const Vec3f center = m_radius1 * normalize(Vec3f(p[0], p[1], 0));
+		const Vec3f n = p - center;
+		return normalize(n[0] * m_xAxis + n[1] * m_axis.cross(m_xAxis) + n[2] * m_axis);
+	}
+
+	Vec2f CPrimTorus::getTextureCoords(const Ray& ray) const
+	{
+		const Vec3f p = toLocal(ray.hitPoint() - m_origin);
+		float u = atan2f(p[1], p[0]) / (2 * Pif);
+		float v = atan2f(p[2], sqrtf(p[0] * p[0] + p[1] * p[1]) - m_radius1) / (2 * Pif);
+		if (u < 0) u += 1;
+		if (v < 0) v += 1;
+		return Vec2f(u, v);
+	}
+
+	CBoundingBox CPrimTorus::getBoundingBox(void) const
+	{
+		// The extent of a circle with the normal n along the axis i is radius * sqrt(1 - n_i^2)
+		Vec3f extent;
+		for (int i = 0; i < 3; i++) extent[i] = m_radius1 * sqrtf(std::max(0.0f, 1.0f - m_axis[i] * m_axis[i])) + m_radius2;
+		return CBoundingBox(m_origin - extent, m_origin + extent);
+	}
+
+	// ------------------------------------------------ Private ------------------------------------------------
+	size_t CPrimTorus::hits(const Ray& ray, double t[4]) const
+	{
+		const Vec3f o = toLocal(ray.org - m_origin);
+		const Vec3f d = toLocal(ray.dir);
+
+		// Clip the ray with the bounding sphere and move its origin close to the torus, which keeps the roots small and the quartic well-conditioned
+		const double R = m_radius1;
+		const double r = m_radius2;
+		const double od = o.dot(d);
+		const double dd = d.dot(d);
+		const double Dsphere = od * od - dd * (static_cast<double>(o.dot(o)) - (R + r) * (R + r));
+		if (Dsphere < 0) return 0;
+		const double tExit = (-od + sqrt(Dsphere)) / dd;
+		if (tExit < Epsilon) return 0;
+		const double tShift = std::max(0.0, (-od - sqrt(Dsphere)) / dd);
+
+		const double ox = o[0] + tShift * d[0];
+		const double oy = o[1] + tShift * d[1];
+		const double oz = o[2] + tShift * d[2];
+
+		// (|p|^2 - R^2 - r^2)^2 = 4R^2 (r^2 - p_z^2) for p = o + t * d
+		const double e = ox * ox + oy * oy + oz * oz - R * R - r * r;
+		const double f = ox * d[0] + oy * d[1] + oz * d[2];
+		const double fourR2 = 4 * R * R;
+		const double c[5] = {
+			e * e - fourR2 * (r * r - oz * oz),
+			4 * f * e + 2 * fourR2 * oz * d[2],
+			2 * dd * e + 4 * f * f + fourR2 * d[2] * d[2],
+			4 * dd * f,
+			dd * dd
+		};
+
+		double roots[4];
+		const int n = solveQuartic(c, roots);
+
+		size_t res = 0;
+		for (int i = 0; i < n; i++) {
+			// polish the root with Newton's method
+			double root = roots[i];
+			for (int iter = 0; iter < 2; iter++) {
+				const double value = (((c[4] * root + c[3]) * root + c[2]) * root + c[1]) * root + c[0];
+				const double derivative = ((4 * c[4] * root + 3 * c[3]) * root + 2 * c[2]) * root + c[1];
+				if (derivative != 0) root -= value / derivative;
+			}
+			root += tShift;
+			if (root > Epsilon && root < ray.t) t[res++] = root;
+		}
+		std::sort(t, t + res);
+		return res;
+	}
+}
@@ -0,0 +1,68 @@
+// Torus Geaometrical Primitive class
+// Written by Dr. Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "IPrim.h"
+
+namespace rt {
+	// ================================ Torus Primitive Class ================================
+	/**
+	 * @brief Torus Geometrical Primitive class
+	 * @details The torus is intersected analytically by solving a quartic equation, thus it may be used instead of the tessellated CSolidTorus,
+	 * which needs \f$ 4 \cdot sides^2 \f$ triangles. The texture coordinates follow the ones of CSolidTorus
+	 * @ingroup modulePrimitive
+	 */
+	class CPrimTorus : public IPrim
+	{
+	public:
+		/**
+		 * @brief Constructor
+		 * @param pShader Pointer to the shader to be applied for the primitive
+		 * @param origin The center of the torus
+		 * @param radius1 The major radius of the torus
+		 * @param radius2 The minor (cross sectional) radius of the torus
+		 * @param axis The axis of the torus
+		 */
+		DllExport CPrimTorus(const ptr_shader_t pShader, const Vec3f& origin, float radius1, float radius2, const Vec3f& axis = Vec3f(0, 0, 1));
+		DllExport virtual ~CPrimTorus(void) = default;
+
+		DllExport virtual bool 			intersect(Ray& ray) const override;
+		DllExport virtual bool 			if_intersect(const Ray& ray) const override;
+		DllExport virtual void			intersectAll(const Ray& ray, std::vector<Ray>& vHits) const override;
+		/**
+		 * @copydoc IPrim::transform()
+		 * @note The transformation must scale uniformly, otherwise the shape would not be a torus
+		 */
+		DllExport virtual void 			transform(const Mat& T) override;
+		DllExport virtual Vec3f			getOrigin(void) const override { return m_origin; }
+		DllExport virtual Vec3f 		getNormal(const Ray& ray) const override;
+		DllExport virtual Vec2f			getTextureCoords(const Ray& ray) const override;
+		DllExport virtual CBoundingBox	getBoundingBox(void) const override;
+		DllExport virtual qword			getDigest(void) const override { return (CDigest() << IPrim::getDigest() << m_origin << m_axis << m_xAxis << m_radius1 << m_radius2).get(); }
+		DllExport virtual void			accountMemory(MemoryReport& report) const override { report.addPrimitive(*this, sizeof(CPrimTorus)); }
+
+
+	private:
+		/**
+		 * @brief Finds all the intersections of ray \b ray with the torus
+		 * @param ray The ray
+		 * @param[out] t The distances to the intersections in the interval (Epsilon; Ray::t) in ascending order
+		 * @return The number of the intersections (at most 4)
+		 */
+		size_t	hits(const Ray& ray, double t[4]) const;
+		/**
+		 * @brief Transforms the vector \b v into the local coordinate system of the torus, where the axis of the torus is the z-axis
+		 * @param v The vector
+		 * @return The vector in the local coordinate system
+		 */
+		Vec3f	toLocal(const Vec3f& v) const { return Vec3f(v.dot(m_xAxis), v.dot(m_axis.cross(m_xAxis)), v.dot(m_axis)); }
+
+
+	private:
+		Vec3f m_origin;		///< The center
+		Vec3f m_axis;		///< The normalized axis
+		Vec3f m_xAxis;		///< The normalized direction, orthogonal to the axis, where the texture coordinate u is 0
+		float m_radius1;	///< The major radius
+		float m_radius2;	///< The minor radius
+	};
+}
@@ -17,6 +17,14 @@ namespace rt {
 			return false;
 	}
 
+	void CPrimTriangle::intersectAll(const Ray& ray, std::vector<Ray>& vHits) const
+	{
+		// a triangle has at most one hit
+		Ray r = ray;
+		r.hit = nullptr;
+		if (intersect(r)) vHits.push_back(r);
+	}
+
 	void CPrimTriangle::transform(const Mat& T)
 	{
 		// Transform vertexes
@@ -54,6 +62,24 @@ namespace rt {
 		return (1.0f - ray.u - ray.v) * m_ta + ray.u * m_tb + ray.v * m_tc;
 	}
 
+	std::pair<Vec2f, Vec2f> CPrimTriangle::getTextureDifferentials(const Ray& ray) const
+	{
+		// The barycentric coordinates are linear on the plane of the triangle, thus the derivatives of the hitpoint give the exact derivatives
+		auto [dPdx, dPdy] = ray.hitPointDifferentials(m_normal);
+		const float d00 = m_edge1.dot(m_edge1);
+		const float d01 = m_edge1.dot(m_edge2);
+		const float d11 = m_edge2.dot(m_edge2);
+		const float inv_den = 1.0f / (d00 * d11 - d01 * d01);
+		auto differential = [&](const Vec3f& dP) {
+			const float d20 = dP.dot(m_edge1);
+			const float d21 = dP.dot(m_edge2);
+			const float du = (d11 * d20 - d01 * d21) * inv_den;
+			const float dv = (d00 * d21 - d01 * d20) * inv_den;
+			return du * (m_tb - m_ta) + dv * (m_tc - m_ta);
+		};
+		return std::make_pair(differential(dPdx), differential(dPdy));
+	}
+
 	CBoundingBox CPrimTriangle::getBoundingBox(void) const
 	{
 		CBoundingBox res;
@@ -62,6 +88,43 @@ namespace rt {
 		res.extend(m_c);
 		return res;
 	}
+
+	CBoundingBox CPrimTriangle::getClippedBoundingBox(const CBoundingBox& box) const
+	{
+		const CBoundingBox bounds = getBoundingBox();
+		if (box.clip(bounds).isEmpty()) return CBoundingBox();
+		
+		bool inside = true;
+		for (int dim = 0; dim < 3; dim++)
+			if (bounds.getMinPoint()[dim] < box.getMinPoint()[dim] || bounds.getMaxPoint()[dim] > box.getMaxPoint()[dim]) inside = false;
+		if (inside) return bounds;
+
+		// Sutherland-Hodgman clipping of the triangle with the 6 planes of the box
+		Vec3f polygon[2][9] = { { m_a, m_b, m_c } };	// every plane adds at most one vertex
+		size_t n = 3;
+		int src = 0;
+		for (int dim = 0; dim < 3; dim++)
+			for (int side = 0; side < 2; side++) {
+				const float val = side ? box.getMaxPoint()[dim] : box.getMinPoint()[dim];
+				auto isInside = [&](const Vec3f& p) { return side ? p[dim] <= val : p[dim] >= val; };
+				const Vec3f* in = polygon[src];
+				Vec3f* out = polygon[1 - src];
+				size_t m = 0;
+				for (size_t i = 0; i < n; i++) {
+					const Vec3f& p = in[i];
+					const Vec3f& q = in[(i + 1) % n];
+					if (isInside(p)) out[m++] = p;
+					if (isInside(p) != isInside(q)) out[m++] = p + (q - p) * ((val - p[dim]) / (q[dim] - p[dim]));
+				}
+				if (m == 0) return CBoundingBox();
+				n = m;
+				src = 1 - src;
+			}
+
+		CBoundingBox res;
+		for (size_t i = 0; i < n; i++) res.extend(polygon[src][i]);
+		return box.clip(res);
+	}
 	
 	// ---------------------- private ----------------------
 	std::optional<Vec3f> CPrimTriangle::MoellerTrumbore(const Ray& ray) const
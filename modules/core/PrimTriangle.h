@@ -46,11 +46,16 @@ namespace rt {
 		
 		DllExport virtual bool	intersect(Ray& ray) const override;
 		DllExport virtual bool	if_intersect(const Ray& ray) const override { return MoellerTrumbore(ray).has_value(); }
+		DllExport virtual void	intersectAll(const Ray& ray, std::vector<Ray>& vHits) const override;
 		DllExport virtual void	transform(const Mat& t) override;
 		DllExport virtual Vec3f	getOrigin(void) const override;
 		DllExport virtual Vec3f getNormal(const Ray& ray) const override;
 		DllExport virtual Vec2f	getTextureCoords(const Ray& ray) const override;
+		DllExport virtual std::pair<Vec2f, Vec2f> getTextureDifferentials(const Ray& ray) const override;
 		DllExport CBoundingBox	getBoundingBox(void) const override;
+		DllExport virtual CBoundingBox getClippedBoundingBox(const CBoundingBox& box) const override;
+		DllExport virtual qword	getDigest(void) const override { return (CDigest() << IPrim::getDigest() << m_a << m_b << m_c << m_ta << m_tb << m_tc << m_na << m_nb << m_nc).get(); }
+		DllExport virtual void	accountMemory(MemoryReport& report) const override { report.addPrimitive(*this, sizeof(CPrimTriangle)); }
 		
 		
 	private:
@@ -1,5 +1,6 @@
 #include "Ray.h"
 #include "Scene.h"
+#include <tuple>
 
 namespace rt {
 	Vec3f Ray::hitPoint(void) const 
@@ -7,21 +8,68 @@ namespace rt {
 		return org + dir * t; 
 	}
 
+	std::pair<Vec3f, Vec3f> Ray::hitPointDifferentials(Vec3f normal) const
+	{
+		if (!hasDifferentials) return std::make_pair(Vec3f::all(0), Vec3f::all(0));
+		const float den = dir.dot(normal);
+		if (fabs(den) < std::numeric_limits<float>::epsilon()) return std::make_pair(Vec3f::all(0), Vec3f::all(0));
+		
+		auto transfer = [&](const Vec3f& dO, const Vec3f& dD) {
+			Vec3f dP = dO + static_cast<float>(t) * dD;
+			return dP - (dP.dot(normal) / den) * dir;
+		};
+		return std::make_pair(transfer(dOdx, dDdx), transfer(dOdy, dDdy));
+	}
+
 	Ray Ray::reflected(Vec3f normal) const
 	{
-		return Ray(hitPoint(), normalize(dir - 2 * normal.dot(dir) * normal), counter);
+		Ray res(hitPoint(), normalize(dir - 2 * normal.dot(dir) * normal), counter, time);
+		if (hasDifferentials) {
+			std::tie(res.dOdx, res.dOdy) = hitPointDifferentials(normal);
+			res.dDdx = dDdx - 2 * normal.dot(dDdx) * normal;
+			res.dDdy = dDdy - 2 * normal.dot(dDdy) * normal;
+			res.hasDifferentials = true;
+		}
+#ifdef ENABLE_STATS
+		res.type = RayType::Reflection;
+#endif
+		return res;
 	}
 
 	std::optional<Ray>	Ray::refracted(Vec3f normal, float k) const 
 	{
-		if (k == 1) return Ray(hitPoint(), dir, counter);
+		if (k == 1) {
+			Ray res(hitPoint(), dir, counter, time);
+			if (hasDifferentials) {
+				std::tie(res.dOdx, res.dOdy) = hitPointDifferentials(normal);
+				res.dDdx = dDdx;
+				res.dDdy = dDdy;
+				res.hasDifferentials = true;
+			}
+#ifdef ENABLE_STATS
+			res.type = RayType::Refraction;
+#endif
+			return res;
+		}
 		
 		float cos_alpha = -dir.dot(normal);
 		float sin_2_alpha = 1.0f - cos_alpha * cos_alpha;
 		float k_2_sin_2_alpha = k * k * sin_2_alpha;
 		if (k_2_sin_2_alpha <= 1) {
 			float cos_beta = sqrtf(1.0f - k * k * sin_2_alpha);
-			return Ray(hitPoint(), normalize((k * cos_alpha - cos_beta) * normal + k * dir), counter);
+			Ray res(hitPoint(), normalize((k * cos_alpha - cos_beta) * normal + k * dir), counter, time);
+			if (hasDifferentials) {
+				// the derivative of (k * cos_alpha - cos_beta) with respect to cos_alpha
+				const float dmu = k - k * k * cos_alpha / cos_beta;
+				std::tie(res.dOdx, res.dOdy) = hitPointDifferentials(normal);
+				res.dDdx = k * dDdx - dmu * dDdx.dot(normal) * normal;
+				res.dDdy = k * dDdy - dmu * dDdy.dot(normal) * normal;
+				res.hasDifferentials = true;
+			}
+#ifdef ENABLE_STATS
+			res.type = RayType::Refraction;
+#endif
+			return res;
 		}
 		else
 			return std::nullopt;
@@ -29,7 +77,21 @@ namespace rt {
 
 	Vec3f Ray::reTrace(const CScene& scene) const
 	{
-		return counter >= maxRayCounter ? exitColor : scene.rayTrace(lvalue_cast(Ray(org, dir, counter + 1)));
+#ifdef ENABLE_STATS
+		if (counter < maxRayCounter) {
+			if (type == RayType::Refraction)	RT_STATS_INC(refractionRays);
+			else								RT_STATS_INC(reflectionRays);
+		}
+#endif
+		if (counter >= maxRayCounter) return exitColor;
+		
+		Ray ray(org, dir, counter + 1, time);
+		ray.hasDifferentials = hasDifferentials;
+		ray.dOdx = dOdx;
+		ray.dOdy = dOdy;
+		ray.dDdx = dDdx;
+		ray.dDdy = dDdy;
+		return scene.rayTrace(ray);
 	}
 }
 
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "IPrim.h"
+#include "Stats.h"
 
 namespace rt {
 	class CScene;
@@ -19,19 +20,31 @@ namespace rt {
 		
 		double							t		= std::numeric_limits<double>::infinity();	///< Current/maximum hit distance
 		std::shared_ptr<const IPrim>	hit		= nullptr;									///< Pointer to currently closest primitive
+		std::shared_ptr<const IPrim>	instancedHit = nullptr;								///< Pointer to the primitive of the shared mesh, if Ray::hit is an instance (Ref. @ref CPrimInstance)
 		float							u		= 0;										///< Barycentric u coordinate
 		float							v		= 0;										///< Barycentric v coordinate
+		float							time	= 0;										///< Time of the ray within the shutter interval: from 0 to 1 (Ref. @ref CCameraPerspective::setShutter())
+		bool							hasDifferentials = false;							///< Flag indicating that the ray carries the differentials below
+		Vec3f							dOdx	= Vec3f::all(0);							///< Derivative of the origin with respect to the image x-coordinate
+		Vec3f							dOdy	= Vec3f::all(0);							///< Derivative of the origin with respect to the image y-coordinate
+		Vec3f							dDdx	= Vec3f::all(0);							///< Derivative of the direction with respect to the image x-coordinate
+		Vec3f							dDdy	= Vec3f::all(0);							///< Derivative of the direction with respect to the image y-coordinate
+#ifdef ENABLE_STATS
+		RayType							type	= RayType::Primary;							///< Type of the ray for the statistics
+#endif
 		
 		/**
 		 * @brief Constructor
 		 * @param _org %Ray origin
 		 * @param _dir %Ray direction
 		 * @param _counter Number of re-traces
+		 * @param _time Time of the ray
 		 */
-		explicit Ray(Vec3f _org = Vec3f::all(0), Vec3f _dir = Vec3f::all(0), size_t _counter = 0)
+		explicit Ray(Vec3f _org = Vec3f::all(0), Vec3f _dir = Vec3f::all(0), size_t _counter = 0, float _time = 0)
 			: org(_org)
 			, dir(_dir)
 			, counter(_counter)
+			, time(_time)
 		{}
 		friend std::ostream& operator<<(std::ostream& os, const Ray& ray) {
 			os << "org: " << ray.org << std::endl << "dir: " << ray.dir << std::endl << "t: " << ray.t << std::endl;
@@ -43,16 +56,25 @@ namespace rt {
 		 * @return The hitpoint
 		 */
 		Vec3f 				hitPoint(void) const;
+		/**
+		 * @brief Returns the derivatives of the hitpoint with respect to the image coordinates
+		 * @details The differential rays are intersected with the tangent plane of the surface at the hitpoint (Ref. Igehy, "Tracing Ray Differentials", 1999)
+		 * @param normal Normal vector at the ray's hitpoint
+		 * @return The derivatives of the hitpoint with respect to the image x- and y-coordinates, or zeros if the ray has no differentials
+		 */
+		std::pair<Vec3f, Vec3f>	hitPointDifferentials(Vec3f normal) const;
 		/**
 		 * @brief Creates and returns the reflected ray
-		 * @details This function calculates the reflected ray at the hitpoint of the surface with the normal \b normal
+		 * @details This function calculates the reflected ray at the hitpoint of the surface with the normal \b normal.
+		 * The differentials are transferred to the hitpoint and reflected as by a locally flat mirror
 		 * @param normal Normal vector at the ray's hitpoint
 		 * @return The reflected ray
 		 */
 		Ray					reflected(Vec3f normal) const;
 		/**
 		 * @brief Creates and returns the refracted ray
-		 * @details This function calculates the refracted ray at the hitpoint of the surface with the normal \b normal
+		 * @details This function calculates the refracted ray at the hitpoint of the surface with the normal \b normal.
+		 * The differentials are transferred to the hitpoint and refracted as by a locally flat surface
 		 * @param normal Normal vector at the ray's hitpoint
 		 * @param k The refractive index
 		 * @return The refracted ray
@@ -60,7 +82,7 @@ namespace rt {
 		std::optional<Ray>	refracted(Vec3f normal, float k) const;
 		/**
 		 * @brief Traces the given ray and shades it
-		 * @details This function implicetly creates a new ray with the increased by one counter and traces it within the scene \b scene
+		 * @details This function implicetly creates a new ray with the increased by one counter and the same differentials and traces it within the scene \b scene
 		 * @note This is an auxiliary function to perform recursive ray-tracing
 		 * @param scene The reference to the scene
 		 * @return The color value of the shaded ray
@@ -0,0 +1,58 @@
+// Ray packet structure
+// Written by Sergey Kosov in 2019 for Jacobs University
+#pragma once
+
+#include "Ray.h"
+#include "macroses.h"
+
+namespace rt {
+	// ================================ Ray Packet Structure ================================
+	/**
+	 * @brief Packet of coherent rays
+	 * @details The packet holds up to \b packetSize x \b packetSize rays, which are traversed through the acceleration structure together.
+	 * In addition to the rays themselves, the origins and inverse directions are stored in the structure-of-arrays (SoA) layout,
+	 * so that the per-node slab tests run over contiguous arrays and may be vectorized by the compiler.
+	 * Packets are built for neighbouring primary rays and for the shadow rays toward the same point light source.
+	 */
+	struct RayPacket
+	{
+		static constexpr size_t			capacity = packetSize * packetSize;		///< The maximal number of rays in the packet
+		static_assert(capacity <= 32, "The ray packet may contain at most 32 rays");
+
+		std::array<Ray, capacity>		rays;									///< The rays
+		size_t							size	= 0;							///< The number of rays in the packet
+		float							org[3][capacity];						///< Ray origins (SoA)
+		float							invDir[3][capacity];					///< Inverse ray directions (SoA)
+
+		/**
+		 * @brief Removes all the rays from the packet
+		 */
+		void	clear(void) { size = 0; }
+		/**
+		 * @brief Adds a new ray to the packet
+		 * @param ray The ray
+		 */
+		void	add(const Ray& ray)
+		{
+			RT_ASSERT_MSG(size < capacity, "The ray packet is full");
+			rays[size++] = ray;
+		}
+		/**
+		 * @brief Updates the SoA arrays from the rays in the packet
+		 * @note This method should be called every time the origins or the directions of the rays are modified
+		 */
+		void	update(void)
+		{
+			for (int dim = 0; dim < 3; dim++)
+				for (size_t i = 0; i < size; i++) {
+					org[dim][i]		= rays[i].org.val[dim];
+					invDir[dim][i]	= 1.0f / rays[i].dir.val[dim];
+				}
+		}
+		/**
+		 * @brief Returns the mask of all the rays in the packet
+		 * @return The mask where the \a i-th bit is set for every ray \a i in the packet
+		 */
+		dword	getMask(void) const { return size >= 32 ? 0xFFFFFFFF : (1u << size) - 1; }
+	};
+}
@@ -0,0 +1,217 @@
+#include "RenderCache.h"
+#include "macroses.h"
+#include "serialize.h"
+#include "Trace.h"
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace rt {
+	namespace {
+		bool writeImage(const fs::path& path, const Mat& img)
+		{
+			RT_TRACE_SCOPE("Write cache", "io");
+			std::ofstream file(path, std::ios::binary);
+			if (!file) return false;
+			serialize::writeMat(file, img);
+			return file.good();
+		}
+
+		Mat readImage(const fs::path& path)
+		{
+			RT_TRACE_SCOPE("Read cache", "io");
+			std::ifstream file(path, std::ios::binary);
+			return file ? serialize::readMat(file) : Mat();
+		}
+	}
+
+	// Constructor
+	CRenderCache::CRenderCache(const std::string& path, size_t maxSize, int bandHeight)
+		: m_path(path)
+		, m_maxSize(maxSize)
+		, m_bandHeight(bandHeight)
+	{
+		RT_ASSERT(bandHeight >= 0);
+		std::error_code ec;
+		fs::create_directories(m_path, ec);
+		if (ec) RT_WARNING("Unable to create the render cache folder \"%s\"", m_path.c_str());
+
+		// Index the existing files in the order of their last access
+		std::vector<std::tuple<fs::file_time_type, std::string, size_t>> vFiles;
+		for (const auto& file : fs::directory_iterator(m_path, ec))
+			if (file.is_regular_file(ec) && file.path().extension() == ".bin")
+				vFiles.emplace_back(file.last_write_time(ec), file.path().filename().string(), static_cast<size_t>(file.file_size(ec)));
+		std::sort(vFiles.begin(), vFiles.end());
+		for (const auto& [time, fileName, size] : vFiles) {
+			m_entries[fileName] = { size, ++m_clock };
+			m_size += size;
+		}
+		evict();
+	}
+
+	// Destructor
+	CRenderCache::~CRenderCache(void)
+	{
+		flush();
+	}
+
+	Mat CRenderCache::get(qword key, int band)
+	{
+		const std::string fileName = getFileName(key, band);
+		std::lock_guard<std::mutex> lck(m_mutex);
+
+		auto itPending = m_pending.find(fileName);
+		if (itPending != m_pending.end()) return itPending->second.clone();
+
+		auto it = m_entries.find(fileName);
+		if (it == m_entries.end()) return Mat();
+
+		const fs::path path = fs::path(m_path) / fileName;
+		Mat res = readImage(path);
+		if (res.empty()) {											// the file is corrupted or was removed from outside
+			m_size -= it->second.size;
+			m_entries.erase(it);
+			return Mat();
+		}
+		it->second.stamp = ++m_clock;
+		std::error_code ec;
+		fs::last_write_time(path, fs::file_time_type::clock::now(), ec);	// keep the access order for the next sessions
+		return res;
+	}
+
+	void CRenderCache::put(qword key, const Mat& img, int band)
+	{
+		RT_ASSERT(!img.empty());
+		const std::string fileName = getFileName(key, band);
+		waitPending(fileName);
+
+		std::lock_guard<std::mutex> lck(m_mutex);
+		auto it = m_entries.find(fileName);
+		if (it != m_entries.end()) {
+			m_size -= it->second.size;
+			m_entries.erase(it);
+		}
+
+		// Forget the finished writers
+		for (auto itWriter = m_writers.begin(); itWriter != m_writers.end();)
+			if (itWriter->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready) itWriter = m_writers.erase(itWriter);
+			else itWriter++;
+
+		Mat data = img.clone();
+		m_pending[fileName] = data;
+		m_writers[fileName] = std::async(std::launch::async, [this, fileName, data]() {
+			const fs::path path = fs::path(m_path) / fileName;
+			const bool success = writeImage(path, data);
+			if (!success) RT_WARNING("Unable to write the render cache file \"%s\"", path.string().c_str());
+
+			std::lock_guard<std::mutex> lck(m_mutex);
+			m_pending.erase(fileName);
+			if (success) {
+				const size_t size = 3 * sizeof(int) + data.total() * data.elemSize();
+				m_entries[fileName] = { size, ++m_clock };
+				m_size += size;
+				evict();
+			}
+		}).share();
+	}
+
+	void CRenderCache::remove(qword key, int band)
+	{
+		const std::string fileName = getFileName(key, band);
+		waitPending(fileName);
+
+		std::lock_guard<std::mutex> lck(m_mutex);
+		auto it = m_entries.find(fileName);
+		if (it == m_entries.end()) return;
+		std::error_code ec;
+		fs::remove(fs::path(m_path) / fileName, ec);
+		m_size -= it->second.size;
+		m_entries.erase(it);
+	}
+
+	void CRenderCache::clear(void)
+	{
+		flush();
+
+		std::lock_guard<std::mutex> lck(m_mutex);
+		std::error_code ec;
+		for (const auto& [fileName, entry] : m_entries)
+			fs::remove(fs::path(m_path) / fileName, ec);
+		m_entries.clear();
+		m_size = 0;
+	}
+
+	void CRenderCache::flush(void)
+	{
+		std::vector<std::shared_future<void>> vWriters;
+		{
+			std::lock_guard<std::mutex> lck(m_mutex);
+			for (const auto& [fileName, writer] : m_writers)
+				vWriters.push_back(writer);
+		}
+		for (auto& writer : vWriters) writer.wait();
+	}
+
+	void CRenderCache::setMaxSize(size_t maxSize)
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_maxSize = maxSize;
+		evict();
+	}
+
+	size_t CRenderCache::getSize(void) const
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		return m_size;
+	}
+
+	size_t CRenderCache::getMemoryUsage(void) const
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		size_t res = sizeof(CRenderCache);
+		for (const auto& entry : m_entries) res += sizeof(entry) + entry.first.capacity();
+		for (const auto& pending : m_pending) res += sizeof(pending) + pending.first.capacity() + pending.second.total() * pending.second.elemSize();
+		return res;
+	}
+
+	// ------------------------ Private ------------------------
+	std::string CRenderCache::getFileName(qword key, int band) const
+	{
+		char fileName[64];
+		if (band < 0) sprintf(fileName, "%016llx.bin", static_cast<unsigned long long>(key));
+		else sprintf(fileName, "%016llx_%d.bin", static_cast<unsigned long long>(key), band);
+		return fileName;
+	}
+
+	// Assumes that the mutex is locked
+	void CRenderCache::evict(void)
+	{
+		if (m_size <= m_maxSize) return;
+
+		std::vector<std::pair<qword, std::string>> vStamps;
+		vStamps.reserve(m_entries.size());
+		for (const auto& [fileName, entry] : m_entries)
+			vStamps.emplace_back(entry.stamp, fileName);
+		std::sort(vStamps.begin(), vStamps.end());
+
+		std::error_code ec;
+		for (const auto& [stamp, fileName] : vStamps) {
+			if (m_size <= m_maxSize) break;
+			fs::remove(fs::path(m_path) / fileName, ec);
+			m_size -= m_entries[fileName].size;
+			m_entries.erase(fileName);
+		}
+	}
+
+	void CRenderCache::waitPending(const std::string& fileName)
+	{
+		std::shared_future<void> writer;
+		{
+			std::lock_guard<std::mutex> lck(m_mutex);
+			auto it = m_writers.find(fileName);
+			if (it != m_writers.end()) writer = it->second;
+		}
+		if (writer.valid()) writer.wait();
+	}
+}
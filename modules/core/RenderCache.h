@@ -0,0 +1,117 @@
+// Render cache class
+// Written by Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "types.h"
+#include <future>
+#include <mutex>
+#include <unordered_map>
+
+namespace rt {
+	// ================================ Render Cache Class ================================
+	/**
+	 * @brief Content-addressed cache of the render results
+	 * @details The cache stores floating-point images on disk, addressed by a 64-bit digest of the scene content (Ref. @ref CScene::getDigest()).
+	 * Besides the whole frames, the cache may hold the partial results of a frame - the horizontal bands of \b bandHeight rows -
+	 * so that an interrupted render may be resumed from the last finished band.
+	 * The images are written to disk asynchronously. When the total size of the cache exceeds the limit, the least recently used entries are evicted.
+	 * > This class is thread-safe
+	 * @author Sergey G. Kosov, sergey.kosov@project-10.de
+	 */
+	class CRenderCache
+	{
+	public:
+		/**
+		 * @brief Constructor
+		 * @details If the folder \b path already contains cached images, they are indexed and become available
+		 * @param path The path to the cache folder
+		 * @param maxSize The maximal size of the cache in bytes
+		 * @param bandHeight The height of the bands in pixels for storing the partial results. If it is 0, the partial results are not stored
+		 */
+		DllExport CRenderCache(const std::string& path = "render_cache", size_t maxSize = 1024 * 1024 * 1024, int bandHeight = 32);
+		DllExport CRenderCache(const CRenderCache&) = delete;
+		DllExport ~CRenderCache(void);
+		DllExport const CRenderCache& operator=(const CRenderCache&) = delete;
+
+		/**
+		 * @brief Looks up an image in the cache
+		 * @param key The digest of the content
+		 * @param band The index of the band for the partial results, or -1 for the whole frame
+		 * @return The cached image, or an empty matrix if the image is not found
+		 */
+		DllExport Mat		get(qword key, int band = -1);
+		/**
+		 * @brief Adds an image to the cache
+		 * @details The image is written to disk asynchronously. If the total size of the cache exceeds the limit, the least recently used images are evicted
+		 * @param key The digest of the content
+		 * @param img The image
+		 * @param band The index of the band for the partial results, or -1 for the whole frame
+		 */
+		DllExport void		put(qword key, const Mat& img, int band = -1);
+		/**
+		 * @brief Removes an image from the cache
+		 * @param key The digest of the content
+		 * @param band The index of the band for the partial results, or -1 for the whole frame
+		 */
+		DllExport void		remove(qword key, int band = -1);
+		/**
+		 * @brief Removes all the images from the cache
+		 */
+		DllExport void		clear(void);
+		/**
+		 * @brief Waits until all the images added to the cache are written to disk
+		 */
+		DllExport void		flush(void);
+		/**
+		 * @brief Sets the maximal size of the cache
+		 * @details If the current size of the cache exceeds the new limit, the least recently used images are evicted
+		 * @param maxSize The maximal size of the cache in bytes
+		 */
+		DllExport void		setMaxSize(size_t maxSize);
+		/**
+		 * @brief Returns the maximal size of the cache
+		 * @return The maximal size of the cache in bytes
+		 */
+		DllExport size_t	getMaxSize(void) const { return m_maxSize; }
+		/**
+		 * @brief Returns the current size of the cache
+		 * @return The total size of the cached images in bytes
+		 */
+		DllExport size_t	getSize(void) const;
+		/**
+		 * @brief Returns the memory, occupied by the cache
+		 * @details The memory is occupied by the index of the cached images and by the images, which are being written
+		 * @return The approximate memory usage in bytes
+		 */
+		DllExport size_t	getMemoryUsage(void) const;
+		/**
+		 * @brief Returns the height of the bands for the partial results
+		 * @return The height of the bands in pixels, or 0 if the partial results are not stored
+		 */
+		DllExport int		getBandHeight(void) const { return m_bandHeight; }
+
+
+	private:
+		/// Cache entry
+		struct Entry {
+			size_t	size;		///< The size of the file in bytes
+			qword	stamp;		///< The time of the last access
+		};
+
+		std::string			getFileName(qword key, int band) const;
+		void				evict(void);
+		void				waitPending(const std::string& fileName);
+
+
+	private:
+		const std::string								m_path;					///< The path to the cache folder
+		size_t											m_maxSize;				///< The maximal size of the cache in bytes
+		const int										m_bandHeight;			///< The height of the bands for the partial results
+		size_t											m_size		= 0;		///< The current size of the cache in bytes
+		qword											m_clock		= 0;		///< The access counter
+		std::unordered_map<std::string, Entry>			m_entries;				///< The cached images
+		std::unordered_map<std::string, Mat>			m_pending;				///< The images which are being written
+		std::unordered_map<std::string, std::shared_future<void>> m_writers;	///< The asynchronous writers
+		mutable std::mutex								m_mutex;				///< Mutex guarding the members
+	};
+}
@@ -0,0 +1,148 @@
+#include "RenderCoordinator.h"
+#include "RenderProtocol.h"
+#include "Scene.h"
+#include "macroses.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+namespace rt {
+	// Constructor
+	CRenderCoordinator::CRenderCoordinator(unsigned short port, int tileSize, double tileTimeout)
+		: m_socket(CSocket::listen(port))
+		, m_tileSize(tileSize)
+		, m_tileTimeout(tileTimeout)
+	{
+		RT_ASSERT(tileSize > 0);
+		RT_IF_WARNING(!m_socket.isValid(), "The render coordinator is not able to accept the workers");
+	}
+
+	Mat CRenderCoordinator::render(const CScene& scene, ptr_sampler_t pSampler, double timeout) const
+	{
+		RT_ASSERT_MSG(m_socket.isValid(), "The render coordinator is not listening");
+		const Size resolution = scene.getResolution();
+		const qword key = (CDigest() << scene.getDigest() << (pSampler ? pSampler->getDigest() : qword(0))).get();
+
+		std::vector<Rect> vTiles;
+		for (int y = 0; y < resolution.height; y += m_tileSize)
+			for (int x = 0; x < resolution.width; x += m_tileSize)
+				vTiles.push_back(Rect(x, y, m_tileSize, m_tileSize) & Rect(Point(0, 0), resolution));
+		const size_t nTiles = vTiles.size();
+
+		Mat res(resolution, CV_32FC3, Scalar(0));
+		std::mutex							mtx;
+		std::condition_variable				cv;
+		std::deque<size_t>					queue;						// tiles waiting for a worker
+		std::vector<int>					vWorkers(nTiles, 0);		// number of workers rendering the tile
+		std::vector<bool>					vDone(nTiles, false);
+		size_t								nDone = 0;
+		bool								finished = false;
+		std::unordered_set<const CSocket*>	busy;						// connections, which are not waiting for a tile
+		std::vector<std::shared_ptr<CSocket>> vConnections;
+		std::vector<std::thread>			vThreads;
+		for (size_t t = 0; t < nTiles; t++) queue.push_back(t);
+
+		// Returns the next tile for the worker on connection \b pSocket, or -1 if the image is finished
+		auto nextTile = [&](const CSocket* pSocket) -> int {
+			std::unique_lock<std::mutex> lck(mtx);
+			busy.erase(pSocket);
+			for (;;) {
+				if (finished) return -1;
+				while (!queue.empty()) {
+					size_t t = queue.front();
+					queue.pop_front();
+					if (vDone[t]) continue;
+					vWorkers[t]++;
+					busy.insert(pSocket);
+					return static_cast<int>(t);
+				}
+				// Take over an unfinished tile from another worker
+				for (size_t t = 0; t < nTiles; t++)
+					if (!vDone[t] && vWorkers[t] == 1) {
+						vWorkers[t]++;
+						busy.insert(pSocket);
+						return static_cast<int>(t);
+					}
+				cv.wait(lck);
+			}
+		};
+
+		// Serves one worker connection
+		auto serve = [&](std::shared_ptr<CSocket> pSocket) {
+			pSocket->setTimeout(m_tileTimeout);
+			protocol::Hello hello;
+			if (!pSocket->recv(hello)) return;
+			if (memcmp(hello.signature, protocol::signature, sizeof(hello.signature)) != 0 || hello.version != protocol::version || hello.key != key) {
+				RT_WARNING("A render worker with a different scene was rejected");
+				pSocket->send(protocol::Tile{ protocol::tileReject, 0, 0, 0, 0 });
+				return;
+			}
+
+			for (;;) {
+				const int t = nextTile(pSocket.get());
+				if (t < 0) {
+					pSocket->send(protocol::Tile{ protocol::tileDone, 0, 0, 0, 0 });
+					return;
+				}
+
+				const Rect& tile = vTiles[t];
+				const protocol::Tile request = { t, tile.x, tile.y, tile.width, tile.height };
+				protocol::Tile reply;
+				int32_t header[3];
+				bool success = pSocket->send(request) && pSocket->recv(reply) && reply.id == t && pSocket->recv(header) 
+					&& header[0] == tile.height && header[1] == tile.width && header[2] == CV_32FC3;
+				Mat img(tile.size(), CV_32FC3);
+				for (int y = 0; y < img.rows && success; y++)
+					success = pSocket->recv(img.ptr(y), img.cols * img.elemSize());
+
+				std::lock_guard<std::mutex> lck(mtx);
+				vWorkers[t]--;
+				if (success && !vDone[t]) {
+					img.copyTo(lvalue_cast(res(tile)));
+					vDone[t] = true;
+					nDone++;
+				} else if (!success) {
+					if (!vDone[t] && vWorkers[t] == 0) queue.push_front(t);
+					RT_IF_WARNING(!finished, "A render worker failed on tile %d. The tile will be rendered again", t);
+				}
+				cv.notify_all();
+				if (!success) return;
+			}
+		};
+
+		const auto start = std::chrono::steady_clock::now();
+		for (;;) {
+			{
+				std::lock_guard<std::mutex> lck(mtx);
+				if (nDone == nTiles) break;
+				if (timeout > 0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > timeout) {
+					RT_WARNING("Distributed rendering timed out: %zu of %zu tiles are rendered", nDone, nTiles);
+					break;
+				}
+			}
+			CSocket socket = m_socket.accept(0.05);
+			if (socket.isValid()) {
+				auto pSocket = std::make_shared<CSocket>(std::move(socket));
+				std::lock_guard<std::mutex> lck(mtx);
+				busy.insert(pSocket.get());
+				vConnections.push_back(pSocket);
+				vThreads.emplace_back(serve, pSocket);
+			}
+		}
+
+		{
+			// The idle workers are released, and the workers still rendering the redundant tiles are disconnected
+			std::lock_guard<std::mutex> lck(mtx);
+			finished = true;
+			for (const auto& pSocket : vConnections)
+				if (busy.count(pSocket.get())) pSocket->shutdown();
+			cv.notify_all();
+		}
+		for (auto& thread : vThreads) thread.join();
+		
+		return res;
+	}
+}
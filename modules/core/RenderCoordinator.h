@@ -0,0 +1,56 @@
+// Render coordinator class
+// Written by Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "Socket.h"
+#include "Sampler.h"
+
+namespace rt {
+	class CScene;
+
+	// ================================ Render Coordinator Class ================================
+	/**
+	 * @brief Coordinator of the distributed rendering
+	 * @details The coordinator splits the image into square tiles and dispatches them to the render workers (Ref. @ref CRenderWorker),
+	 * which connect to it over TCP. Every worker must hold the same scene and sampler as the coordinator, which is verified with their digests.
+	 * The tiles are handed out on demand, so the faster workers render more tiles. When no tiles are left, the idle workers take over the tiles,
+	 * which are still being rendered by the other workers, so a slow worker does not delay the whole image.
+	 * If a worker fails, i.e. its connection is lost or it does not return a tile within the timeout, its tile is rendered by another worker.
+	 * @author Sergey G. Kosov, sergey.kosov@project-10.de
+	 */
+	class CRenderCoordinator
+	{
+	public:
+		/**
+		 * @brief Constructor
+		 * @param port The port number, where the coordinator listens for the workers. If it is 0, a free port is chosen (Ref. @ref getPort())
+		 * @param tileSize The size of the tiles in pixels
+		 * @param tileTimeout The maximal time in seconds for rendering a tile by a worker
+		 */
+		DllExport CRenderCoordinator(unsigned short port = 0, int tileSize = 32, double tileTimeout = 600);
+		DllExport CRenderCoordinator(const CRenderCoordinator&) = delete;
+		DllExport ~CRenderCoordinator(void) = default;
+		DllExport const CRenderCoordinator& operator=(const CRenderCoordinator&) = delete;
+
+		/**
+		 * @brief Renders the view from the active camera of the scene with the connected workers
+		 * @details This method returns when all the tiles are rendered. The workers may connect and disconnect at any time during rendering
+		 * @param scene The scene
+		 * @param pSampler Pointer to the sampler to be used for anti-aliasing.
+		 * @param timeout The maximal rendering time in seconds, or 0 for waiting infinitely. If it expires, the unfinished tiles are left black
+		 * @returns The rendered image in linear color space (type: CV_32FC3)
+		 */
+		DllExport Mat				render(const CScene& scene, ptr_sampler_t pSampler = nullptr, double timeout = 0) const;
+		/**
+		 * @brief Returns the port number, where the coordinator listens for the workers
+		 * @return The port number
+		 */
+		DllExport unsigned short	getPort(void) const { return m_socket.getPort(); }
+
+
+	private:
+		CSocket			m_socket;			///< The listening socket
+		const int		m_tileSize;			///< The size of the tiles in pixels
+		const double	m_tileTimeout;		///< The maximal time for rendering a tile in seconds
+	};
+}
@@ -0,0 +1,37 @@
+// Messages of the distributed rendering
+// Written by Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "types.h"
+
+namespace rt {
+	/**
+	 * @brief Messages exchanged between the render coordinator and the render workers
+	 * @details The worker opens the connection with a Hello message. The coordinator answers with a Tile message for every tile to be rendered, 
+	 * and the worker replies with the same Tile message followed by the rendered tile (rows, cols and type as 32-bit integers and the raw pixels).
+	 * The session is finished with a Tile message, whose id is \b tileDone or \b tileReject.
+	 * The messages are sent in the native byte order, so all the machines of the cluster should share the same architecture
+	 */
+	namespace protocol {
+		const char		signature[4]	= { 'O', 'R', 'T', 'W' };
+		const int32_t	version			= 1;
+		const int32_t	tileDone		= -1;		///< There are no more tiles to render
+		const int32_t	tileReject		= -2;		///< The scene of the worker does not match the scene of the coordinator
+
+		/// Greeting of the worker
+		struct Hello {
+			char		signature[4];
+			int32_t		version;
+			qword		key;						///< Digest of the worker's scene and sampler
+		};
+
+		/// Tile to be rendered
+		struct Tile {
+			int32_t		id;
+			int32_t		x;
+			int32_t		y;
+			int32_t		width;
+			int32_t		height;
+		};
+	}
+}
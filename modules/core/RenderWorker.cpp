@@ -0,0 +1,43 @@
+#include "RenderWorker.h"
+#include "RenderProtocol.h"
+#include "Scene.h"
+#include "macroses.h"
+
+namespace rt {
+	bool CRenderWorker::run(const std::string& host, unsigned short port) const
+	{
+		CSocket socket = CSocket::connect(host, port);
+		if (!socket.isValid()) {
+			RT_WARNING("Unable to connect to the render coordinator at %s:%u", host.c_str(), port);
+			return false;
+		}
+
+		protocol::Hello hello;
+		memcpy(hello.signature, protocol::signature, sizeof(hello.signature));
+		hello.version	= protocol::version;
+		hello.key		= (CDigest() << m_scene.getDigest() << (m_pSampler ? m_pSampler->getDigest() : qword(0))).get();
+		if (!socket.send(hello)) return false;
+
+		for (;;) {
+			protocol::Tile tile;
+			if (!socket.recv(tile)) return false;
+			if (tile.id == protocol::tileDone) return true;
+			if (tile.id == protocol::tileReject) {
+				RT_WARNING("The render coordinator rejected the scene of the worker");
+				return false;
+			}
+			// A malformed message drops the connection instead of rendering outside of the image
+			const Rect rect(tile.x, tile.y, tile.width, tile.height);
+			if (tile.id < 0 || rect.empty() || (rect & Rect(Point(0, 0), m_scene.getResolution())) != rect) {
+				RT_WARNING("The render coordinator sent a malformed tile");
+				return false;
+			}
+
+			Mat img = m_scene.renderTile(rect, m_pSampler);
+			const int32_t header[3] = { img.rows, img.cols, img.type() };
+			if (!socket.send(tile) || !socket.send(header)) return false;
+			for (int y = 0; y < img.rows; y++)
+				if (!socket.send(img.ptr(y), img.cols * img.elemSize())) return false;
+		}
+	}
+}
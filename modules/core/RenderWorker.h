@@ -0,0 +1,45 @@
+// Render worker class
+// Written by Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "Socket.h"
+#include "Sampler.h"
+
+namespace rt {
+	class CScene;
+
+	// ================================ Render Worker Class ================================
+	/**
+	 * @brief Worker of the distributed rendering
+	 * @details The worker connects to a render coordinator (Ref. @ref CRenderCoordinator) and renders the tiles it receives.
+	 * Every tile is rendered with all the cores of the machine if ENABLE_PDP is on
+	 * @author Sergey G. Kosov, sergey.kosov@project-10.de
+	 */
+	class CRenderWorker
+	{
+	public:
+		/**
+		 * @brief Constructor
+		 * @param scene The scene, which must be the same as the scene of the coordinator
+		 * @param pSampler Pointer to the sampler to be used for anti-aliasing, which must be the same as the sampler of the coordinator
+		 */
+		DllExport CRenderWorker(const CScene& scene, ptr_sampler_t pSampler = nullptr) : m_scene(scene), m_pSampler(pSampler) {}
+		DllExport CRenderWorker(const CRenderWorker&) = delete;
+		DllExport ~CRenderWorker(void) = default;
+		DllExport const CRenderWorker& operator=(const CRenderWorker&) = delete;
+
+		/**
+		 * @brief Connects to the coordinator and renders the tiles until the coordinator finishes the image
+		 * @param host The host name or address of the coordinator
+		 * @param port The port number of the coordinator
+		 * @retval true If the image was finished
+		 * @retval false If the connection failed or the coordinator rejected the scene
+		 */
+		DllExport bool		run(const std::string& host, unsigned short port) const;
+
+
+	private:
+		const CScene&		m_scene;		///< The scene
+		ptr_sampler_t		m_pSampler;		///< The sampler
+	};
+}
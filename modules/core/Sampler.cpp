@@ -1,5 +1,6 @@
 #include "Sampler.h"
 #include "macroses.h"
+#include "random.h"
 
 namespace rt {
 #ifdef ENABLE_PDP
@@ -38,6 +39,28 @@ namespace rt {
 		return res;
 	}
 
+	std::vector<Vec2f> CSampler::getSeries(void) const {
+		if (m_vSamples.empty())
+			return std::vector<Vec2f>(1, Vec2f::all(0.5f));
+		
+		std::vector<Vec2f> res(m_vSamples.size());
+		generateSeries(res);
+		return res;
+	}
+
+	Vec2f CSampler::getSample(qword seed, size_t index) const {
+		if (m_vSamples.empty())
+			return Vec2f::all(0.5f);
+		
+		RT_ASSERT(index < m_vSamples.size());
+		return generateSample(seed, index);
+	}
+
+	Vec2f CSampler::generateSample(qword seed, size_t index) const {
+		random::seed(seed);
+		return getSeries()[index];
+	}
+
 	// ---------------- Static functions ----------------
 	// --------- from PBR book ---------
 	Vec2f CSampler::uniformSampleDisk(const Vec2f& sample) {
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "types.h"
+#include "digest.h"
 
 namespace rt {
 	// ================================ Sampler Class ================================
@@ -35,6 +36,35 @@ namespace rt {
 		* @return The number of samples in a series 
 		*/
 		DllExport size_t		getNumSamples(void) const { return MAX(1, m_vSamples.size()); }
+		/**
+		* @brief Generates a new series of samples
+		* @details In contrast to getNextSample() method, this method does not change the state of the sampler and thus may be called from several threads.
+		* The random samples are drawn from the generator of the calling thread (Ref. @ref random::seed())
+		* @return The new series of getNumSamples() samples
+		*/
+		DllExport std::vector<Vec2f>	getSeries(void) const;
+		/**
+		* @brief Returns a single sample of a series
+		* @details The series is identified by \b seed, so the same pair of \b seed and \b index always gives the same sample. In contrast to getSeries() method, 
+		* the other samples of the series are not generated, thus a progressive render may take one sample per pixel and pass at a constant cost.
+		* This method does not change the state of the sampler and thus may be called from several threads
+		* @param seed The seed identifying the series
+		* @param index The index of the sample in the series, \f$ index < getNumSamples() \f$
+		* @return The sample \b index of the series
+		*/
+		DllExport Vec2f			getSample(qword seed, size_t index) const;
+		/**
+		* @brief Checks whether the series is renewed after exhaustion
+		* @retval true If a new series is generated after every getNumSamples() samples
+		* @retval false If the same series is repeated
+		*/
+		DllExport bool			isRenewable(void) const { return m_renewable; }
+		/**
+		* @brief Returns the digest of the sampler parameters
+		* @details The digest is used for addressing the render results by the content of the scene. The derived classes should add their parameters
+		* @return The 64-bit hash value of the sampler parameters
+		*/
+		DllExport virtual qword	getDigest(void) const { return (CDigest() << typeid(*this).name() << m_vSamples.size() << m_renewable).get(); }
 		
 		
 		// ---------------- Static functions ----------------
@@ -102,6 +132,23 @@ namespace rt {
 		* @param[in,out] samples The container for new samples
 		*/
 		virtual void generateSeries(std::vector<Vec2f>& samples) const = 0;
+		/**
+		* @brief Generates a single sample of the series identified by \b seed
+		* @details The default implementation generates the whole series from the seeded generator of the calling thread. 
+		* The derived classes should override this method with a constant-time implementation
+		* @param seed The seed identifying the series
+		* @param index The index of the sample in the series
+		* @return The sample
+		*/
+		virtual Vec2f generateSample(qword seed, size_t index) const;
+		/**
+		* @brief Returns a uniformly distributed random number, which depends only on its arguments
+		* @param seed The seed identifying the series
+		* @param index The index of the sample in the series
+		* @param dim The dimension of the sample
+		* @return The random number in interval [0; 1)
+		*/
+		static float hashToUnit(qword seed, size_t index, int dim) { return static_cast<float>((CDigest() << seed << index << dim).get() >> 40) / (1 << 24); }
 
 	
 	private:
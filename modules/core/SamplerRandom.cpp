@@ -8,4 +8,9 @@ namespace rt {
 			for (int i = 0; i < 2; i++)
 				sample.val[i] = random::U<float>();
 	}
+
+	Vec2f CSamplerRandom::generateSample(qword seed, size_t index) const
+	{
+		return Vec2f(hashToUnit(seed, index, 0), hashToUnit(seed, index, 1));
+	}
 }
\ No newline at end of file
@@ -24,5 +24,6 @@ namespace rt {
 
 	protected:
 		DllExport virtual void generateSeries(std::vector<Vec2f>& samples) const override;
+		DllExport virtual Vec2f generateSample(qword seed, size_t index) const override;
 	};
 }
\ No newline at end of file
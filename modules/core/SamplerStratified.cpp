@@ -16,4 +16,12 @@ namespace rt {
 				s++;
 			}
 	}
+
+	Vec2f CSamplerStratified::generateSample(qword seed, size_t index) const
+	{
+		const size_t nSamples = static_cast<size_t>(sqrt(getNumSamples()));
+		const float fx = static_cast<float>(index % nSamples) + (m_jitter ? hashToUnit(seed, index, 0) : 0.5f);
+		const float fy = static_cast<float>(index / nSamples) + (m_jitter ? hashToUnit(seed, index, 1) : 0.5f);
+		return Vec2f(fx, fy) / static_cast<float>(nSamples);
+	}
 }
\ No newline at end of file
@@ -25,9 +25,12 @@ namespace rt {
 		{}
 		DllExport virtual ~CSamplerStratified(void) = default;
 
+		DllExport virtual qword	getDigest(void) const override { return (CDigest() << CSampler::getDigest() << m_jitter).get(); }
+
 
 	protected:
 		DllExport virtual void generateSeries(std::vector<Vec2f>& samples) const override;
+		DllExport virtual Vec2f generateSample(qword seed, size_t index) const override;
 
 
 	private:
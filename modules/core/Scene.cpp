@@ -1,16 +1,165 @@
 #include "Scene.h"
 #include "Ray.h"
+#include "RayPacket.h"
 #include "Solid.h"
+#include "Stats.h"
+#include "Trace.h"
 #include "macroses.h"
+#include "random.h"
+#include "serialize.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
 
 namespace rt {
+	namespace {
+		// Compresses the dynamic range of a linear image (type: CV_32FC3) with the global Reinhard operator
+		void reinhard(Mat& img)
+		{
+			for (int y = 0; y < img.rows; y++) {
+				Vec3f* pImg = img.ptr<Vec3f>(y);
+				for (int x = 0; x < img.cols; x++) {
+					float luminance = 0.0722f * pImg[x][0] + 0.7152f * pImg[x][1] + 0.2126f * pImg[x][2];
+					pImg[x] = (1.0f / (1.0f + luminance)) * pImg[x];
+				}
+			}
+		}
+
+		// Converts a linear image (type: CV_32FC3) to the output image of type \b type
+		Mat toOutput(const Mat& img, int type, ToneMapping toneMapping)
+		{
+			RT_TRACE_SCOPE("Convert image", "output");
+			if (type == CV_32FC3) return img;
+			Mat res = img.clone();
+			if (toneMapping == ToneMapping::Reinhard)
+				reinhard(res);
+			res.convertTo(res, type, type == CV_16UC3 ? 65535 : 255);
+			return res;
+		}
+
+#ifdef ENABLE_STATS
+		// Collects the ray-tracing statistics of the render call, which created it. The nested render calls are accounted by the outermost one.
+		// The counters of the threads are never reset: every thread adds its increments within the scopes of the render work to the collector (Ref. CStatsScope),
+		// so that the concurrent renders do not disturb each other's statistics
+		class CStatsCollector {
+		public:
+			CStatsCollector(RayStats& res, std::mutex& resMutex) : m_res(res), m_resMutex(resMutex) { if (!pCurrent) pCurrent = this; }
+			~CStatsCollector(void) 
+			{
+				if (pCurrent != this) return;
+				pCurrent = nullptr;
+				std::lock_guard<std::mutex> lck(m_resMutex);
+				m_res = m_stats;
+#ifdef DEBUG_PRINT_INFO
+				std::cout << m_res;
+#endif
+			}
+			void add(const RayStats& stats)
+			{
+				std::lock_guard<std::mutex> lck(m_mutex);
+				m_stats += stats;
+			}
+			// Returns the collector of the outermost render call of the calling thread, or nullptr
+			static CStatsCollector* getCurrent(void) { return pCurrent; }
+
+		private:
+			RayStats&							m_res;
+			std::mutex&							m_resMutex;
+			RayStats							m_stats;
+			std::mutex							m_mutex;
+			static thread_local CStatsCollector* pCurrent;
+		};
+		thread_local CStatsCollector* CStatsCollector::pCurrent = nullptr;
+
+		// Adds the counters, which the calling thread increments within the lifetime of the scope, to the collector \b pCollector
+		class CStatsScope {
+		public:
+			CStatsScope(CStatsCollector* pCollector) : m_pCollector(pCollector), m_start(stats::local) {}
+			~CStatsScope(void)
+			{
+				if (!m_pCollector) return;
+				RayStats res = stats::local;
+				m_pCollector->add(res -= m_start);
+			}
+
+		private:
+			CStatsCollector*	m_pCollector;
+			const RayStats		m_start;
+		};
+#endif
+
+		const char checkpointSignature[8] = { 'O', 'R', 'T', 'C', 'K', 'P', 'T', '1' };
+
+		// Writes the checkpoint of the render. The file is replaced atomically, so a crash while writing leaves the previous checkpoint intact
+		bool saveCheckpoint(const std::string& fileName, qword key, qword nPasses, const Mat& acc, const Mat& count)
+		{
+			RT_TRACE_SCOPE("Save checkpoint", "io");
+			const std::string tmpFileName = fileName + ".tmp";
+			{
+				std::ofstream file(tmpFileName, std::ios::binary);
+				if (!file) return false;
+				file.write(checkpointSignature, sizeof(checkpointSignature));
+				file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+				file.write(reinterpret_cast<const char*>(&nPasses), sizeof(nPasses));
+				serialize::writeMat(file, acc);
+				serialize::writeMat(file, count);
+				if (!file.good()) return false;
+			}
+			std::error_code ec;
+			std::filesystem::rename(tmpFileName, fileName, ec);
+			return !ec;
+		}
+
+		// Reads the checkpoint of the render with key \b key. Returns false if the file is not found, corrupted or belongs to another render
+		bool loadCheckpoint(const std::string& fileName, qword key, qword& nPasses, Mat& acc, Mat& count)
+		{
+			RT_TRACE_SCOPE("Load checkpoint", "io");
+			std::ifstream file(fileName, std::ios::binary);
+			if (!file) return false;
+			char signature[sizeof(checkpointSignature)];
+			qword fileKey;
+			qword fileNPasses;
+			if (!file.read(signature, sizeof(signature)) || memcmp(signature, checkpointSignature, sizeof(signature)) != 0) return false;
+			if (!file.read(reinterpret_cast<char*>(&fileKey), sizeof(fileKey)) || fileKey != key) return false;
+			if (!file.read(reinterpret_cast<char*>(&fileNPasses), sizeof(fileNPasses))) return false;
+			Mat fileAcc = serialize::readMat(file);
+			Mat fileCount = serialize::readMat(file);
+			if (fileAcc.size() != acc.size() || fileAcc.type() != acc.type()) return false;
+			if (fileCount.size() != count.size() || fileCount.type() != count.type()) return false;
+			nPasses = fileNPasses;
+			acc = fileAcc;
+			count = fileCount;
+			return true;
+		}
+	}
+
+#ifdef ENABLE_PACKETS
+	namespace {
+		// Occlusion of a shadow ray traced within a shadow packet
+		struct ShadowRecord {
+			Vec3f	org;
+			Vec3f	dir;
+			double	t;
+			bool	occluded;
+		};
+		// Shadow rays traced for the packet of primary rays which is currently shaded by the calling thread
+		thread_local std::vector<ShadowRecord> shadowRecords;
+	}
+#endif
 
 	void CScene::clear(void) 
 	{
 		m_vpPrims.clear();
 		m_vpLights.clear();
+		m_pEnvironment = nullptr;
 		m_vpCameras.clear();
 		m_activeCamera = 0;
+#ifdef ENABLE_BSP
+		m_pBSPTree.reset(new CBSPTree());
+#endif
+		m_pArena = std::make_shared<CArena>();
 	}
 	
 	void CScene::add(const ptr_prim_t pPrim) 
@@ -29,6 +178,13 @@ namespace rt {
 		m_vpLights.push_back(pLight); 
 	}
 
+	void CScene::setEnvironment(const ptr_light_environment_t pEnvironment)
+	{
+		m_vpLights.erase(std::remove(m_vpLights.begin(), m_vpLights.end(), m_pEnvironment), m_vpLights.end());
+		m_pEnvironment = pEnvironment;
+		if (pEnvironment) add(pEnvironment);
+	}
+
 	void CScene::add(const ptr_camera_t pCamera) 
 	{
 		m_vpCameras.push_back(pCamera);
@@ -47,122 +203,569 @@ namespace rt {
 	{ 
 #ifdef ENABLE_BSP
 		m_pBSPTree->build(m_vpPrims, maxDepth, minPrimitives);
+#ifdef DEBUG_PRINT_INFO
+		std::cout << getMemoryReport();
+#endif
+#else 
+		RT_WARNING("BSP support is not enabled");
+#endif		
+	}
+
+	bool CScene::updateAccelStructure(void)
+	{
+#ifdef ENABLE_BSP
+		return m_pBSPTree->refit(m_vpPrims);
 #else 
 		RT_WARNING("BSP support is not enabled");
+		return false;
 #endif		
 	}
 
-	Mat CScene::render(ptr_sampler_t pSampler) const
+	Mat CScene::render(ptr_sampler_t pSampler, int type, ToneMapping toneMapping) const
+	{
+		RT_ASSERT_MSG(type == CV_32FC3 || type == CV_16UC3 || type == CV_8UC3, "Unsupported output image type: %d", type);
+		RT_TRACE_SCOPE("Render", "render");
+#ifdef ENABLE_STATS
+		CStatsCollector statsCollector(m_stats, m_statsMutex);
+#endif
+#ifdef ENABLE_CACHE
+		if (!m_pRenderCache) 
+			return toOutput(render(std::vector<Aov>{ Aov::Beauty }, pSampler).front(), type, toneMapping);
+		
+		ptr_camera_t activeCamera = getActiveCamera();
+		RT_ASSERT_MSG(activeCamera, "Camera is not found. Add at least one camera to the scene.");
+		const Size resolution = activeCamera->getResolution();
+		const qword samplerDigest = pSampler ? pSampler->getDigest() : 0;
+		const qword key = (CDigest() << getDigest() << samplerDigest).get();
+
+		Mat img = m_pRenderCache->get(key);
+		if (img.empty() || img.size() != resolution) {
+			const int bandHeight = m_pRenderCache->getBandHeight() > 0 ? m_pRenderCache->getBandHeight() : resolution.height;
+			const int nBands = (resolution.height + bandHeight - 1) / bandHeight;
+			auto getBand = [&](int b) { return Rect(0, b * bandHeight, resolution.width, bandHeight) & Rect(Point(0, 0), resolution); };
+			
+			// The bands, finished by an interrupted render, are reused
+			img = Mat(resolution, CV_32FC3);
+			std::vector<bool> vCached(nBands, false);
+			int firstMissing = nBands;
+			int lastMissing = -1;
+			for (int b = 0; b < nBands && nBands > 1; b++) {
+				Mat band = m_pRenderCache->get(key, b);
+				if (band.size() == getBand(b).size()) {
+					band.copyTo(lvalue_cast(img(getBand(b))));
+					vCached[b] = true;
+				}
+			}
+			for (int b = 0; b < nBands; b++)
+				if (!vCached[b]) {
+					firstMissing = MIN(firstMissing, b);
+					lastMissing = b;
+				}
+
+			// The remaining rows are rendered in a single pass, and every band is cached as soon as all its rows are finished
+			if (lastMissing >= 0) {
+				const Rect span = getBand(firstMissing) | getBand(lastMissing);
+				const float scale = 1.0f / (pSampler ? pSampler->getNumSamples() : 1);
+				std::vector<std::atomic<int>> vRowsDone(nBands);
+				auto onRowsDone = [&](const Range& rows, const std::vector<Mat>& vBuffers) {
+					if (nBands == 1) return;
+					for (int y = span.y + rows.start; y < span.y + rows.end; y++) {
+						const int b = y / bandHeight;
+						const Rect band = getBand(b);
+						if (++vRowsDone[b] == band.height && !vCached[b])
+							m_pRenderCache->put(key, scale * vBuffers.front()(band - span.tl()), b);
+					}
+				};
+				renderRegion(std::vector<Aov>{ Aov::Beauty }, pSampler, span, onRowsDone).front().copyTo(lvalue_cast(img(span)));
+			}
+			m_pRenderCache->put(key, img);
+			for (int b = 0; b < nBands && nBands > 1; b++)		// the partial results are not needed anymore
+				m_pRenderCache->remove(key, b);
+		}
+
+		std::lock_guard<std::mutex> lock(m_lriMutex);
+		m_lriKey			= key;
+		m_lriSamplerDigest	= samplerDigest;
+		m_lriType			= type;
+		m_lriToneMapping	= toneMapping;
+		return toOutput(img, type, toneMapping);
+#else
+		return toOutput(render(std::vector<Aov>{ Aov::Beauty }, pSampler).front(), type, toneMapping);
+#endif
+	}
+			
+	Mat CScene::renderTile(const Rect& tile, ptr_sampler_t pSampler) const
+	{
+		ptr_camera_t activeCamera = getActiveCamera();
+		RT_ASSERT_MSG(activeCamera, "Camera is not found. Add at least one camera to the scene.");
+		RT_ASSERT_MSG((tile & Rect(Point(0, 0), activeCamera->getResolution())) == tile, "The tile exceeds the image");
+		RT_TRACE_SCOPE("Render tile", "render");
+#ifdef ENABLE_STATS
+		CStatsCollector statsCollector(m_stats, m_statsMutex);
+#endif
+		return renderRegion(std::vector<Aov>{ Aov::Beauty }, pSampler, tile).front();
+	}
+
+	Mat CScene::renderCheckpointed(const std::string& fileName, ptr_sampler_t pSampler, double interval, int type, ToneMapping toneMapping) const
+	{
+		RT_ASSERT_MSG(type == CV_32FC3 || type == CV_16UC3 || type == CV_8UC3, "Unsupported output image type: %d", type);
+		ptr_camera_t activeCamera = getActiveCamera();
+		RT_ASSERT_MSG(activeCamera, "Camera is not found. Add at least one camera to the scene.");
+		const Size resolution = activeCamera->getResolution();
+		const size_t nSamples = pSampler ? pSampler->getNumSamples() : 1;
+		const qword key = (CDigest() << getDigest() << (pSampler ? pSampler->getDigest() : qword(0))).get();
+		RT_TRACE_SCOPE("Render", "render");
+#ifdef ENABLE_STATS
+		CStatsCollector statsCollector(m_stats, m_statsMutex);
+#endif
+		
+		m_interruptRender = false;
+		
+		Mat acc(resolution, CV_32FC3, Scalar(0));			// sum of the samples
+		Mat count(resolution, CV_32SC1, Scalar(0));			// number of the samples
+		qword nPasses = 0;
+		if (!loadCheckpoint(fileName, key, nPasses, acc, count) && std::filesystem::exists(fileName))
+			RT_WARNING("The checkpoint \"%s\" belongs to another scene and will be overwritten", fileName.c_str());
+
+		auto lastCheckpoint = std::chrono::steady_clock::now();
+		qword nSavedPasses = nPasses;
+		while (nPasses < nSamples) {
+			Mat img = renderPass(key, pSampler, nPasses);
+			if (img.empty()) break;										// interrupted
+			
+			for (int y = 0; y < resolution.height; y++) {
+				const Vec3f* pImg = img.ptr<Vec3f>(y);
+				Vec3f* pAcc = acc.ptr<Vec3f>(y);
+				int* pCount = count.ptr<int>(y);
+				for (int x = 0; x < resolution.width; x++) {
+					pAcc[x] += pImg[x];
+					pCount[x]++;
+				}
+			}
+			nPasses++;
+
+			const auto now = std::chrono::steady_clock::now();
+			if (std::chrono::duration<double>(now - lastCheckpoint).count() >= interval) {
+				RT_IF_WARNING(!saveCheckpoint(fileName, key, nPasses, acc, count), "Unable to write the checkpoint \"%s\"", fileName.c_str());
+				lastCheckpoint = now;
+				nSavedPasses = nPasses;
+			}
+		}
+		if (nSavedPasses != nPasses || !std::filesystem::exists(fileName))
+			RT_IF_WARNING(!saveCheckpoint(fileName, key, nPasses, acc, count), "Unable to write the checkpoint \"%s\"", fileName.c_str());
+
+		// Average the accumulated samples
+		Mat res(resolution, CV_32FC3, Scalar(0));
+		for (int y = 0; y < resolution.height; y++) {
+			const Vec3f* pAcc = acc.ptr<Vec3f>(y);
+			const int* pCount = count.ptr<int>(y);
+			Vec3f* pRes = res.ptr<Vec3f>(y);
+			for (int x = 0; x < resolution.width; x++)
+				if (pCount[x]) pRes[x] = (1.0f / pCount[x]) * pAcc[x];
+		}
+		return toOutput(res, type, toneMapping);
+	}
+
+	Mat CScene::renderDepth(ptr_sampler_t pSampler) const 
+	{
+		return render(std::vector<Aov>{ Aov::Depth }, pSampler).front();
+	}
+
+	std::vector<Mat> CScene::render(const std::vector<Aov>& vAovs, ptr_sampler_t pSampler) const
+	{
+		ptr_camera_t activeCamera = getActiveCamera();
+		RT_ASSERT_MSG(activeCamera, "Camera is not found. Add at least one camera to the scene.");
+		RT_TRACE_SCOPE("Render", "render");
+#ifdef ENABLE_STATS
+		CStatsCollector statsCollector(m_stats, m_statsMutex);
+#endif
+		return renderRegion(vAovs, pSampler, Rect(Point(0, 0), activeCamera->getResolution()));
+	}
+
+	std::vector<Mat> CScene::renderRegion(const std::vector<Aov>& vAovs, ptr_sampler_t pSampler, const Rect& roi, const std::function<void(const Range&, const std::vector<Mat>&)>& onRowsDone) const
 	{
+		RT_TRACE_SCOPE("Render region", "render");
 		ptr_camera_t activeCamera = getActiveCamera();
 		RT_ASSERT_MSG(activeCamera, "Camera is not found. Add at least one camera to the scene.");
-		Mat img(activeCamera->getResolution(), CV_32FC3, Scalar(0)); 	// image array
+		const Size resolution = roi.size();
+		const size_t nSamples = pSampler ? pSampler->getNumSamples() : 1;
+
+		bool needBeauty = false;
+		std::vector<Mat> vBuffers;
+		for (Aov aov : vAovs) {
+			switch (aov) {
+				case Aov::Beauty:		vBuffers.emplace_back(resolution, CV_32FC3, Scalar(0)); needBeauty = true; break;
+				case Aov::Depth:		vBuffers.emplace_back(resolution, CV_64FC1, Scalar(0)); break;
+				case Aov::Normal:		vBuffers.emplace_back(resolution, CV_32FC3, Scalar(0)); break;
+				case Aov::Albedo:		vBuffers.emplace_back(resolution, CV_32FC3, Scalar(0)); break;
+				case Aov::PrimitiveId:	vBuffers.emplace_back(resolution, CV_32SC1, Scalar(-1)); break;
+				case Aov::ShaderId:		vBuffers.emplace_back(resolution, CV_32SC1, Scalar(-1)); break;
+				case Aov::SampleCount:	vBuffers.emplace_back(resolution, CV_32SC1, Scalar(0)); break;
+				case Aov::NodeCount:
+				case Aov::PrimitiveTestCount:
+				case Aov::RayTreeNodeCount:
+				case Aov::RayTreePrimitiveTestCount:
+#ifndef ENABLE_STATS
+					RT_WARNING("Statistics support is not enabled. The traversal costs are not counted");
+#endif
+					vBuffers.emplace_back(resolution, CV_32SC1, Scalar(0)); 
+					break;
+			}
+		}
+
+		// Ids of the primitives and shaders are their indexes in order of adding them to the scene
+		std::unordered_map<const IPrim*, int>	primIds;
+		std::unordered_map<const IShader*, int> shaderIds;
+		for (const auto& aov : vAovs) 
+			if (aov == Aov::PrimitiveId || aov == Aov::ShaderId) {
+				for (const auto& pPrim : m_vpPrims) {
+					primIds.emplace(pPrim.get(), static_cast<int>(primIds.size()));
+					shaderIds.emplace(pPrim->getShader().get(), static_cast<int>(shaderIds.size()));
+				}
+				break;
+			}
+		auto getId = [](const auto& ids, const auto* ptr) {
+			auto it = ids.find(ptr);
+			return it == ids.end() ? -1 : it->second;
+		};
 		
 #ifdef DEBUG_PRINT_INFO
 		std::cout << "\nNumber of Primitives: " << m_vpPrims.size() << std::endl;
 		std::cout << "Number of light sources: " << m_vpLights.size() << std::endl;
-		size_t nSamples = 0;
-		for (const auto& pLight : m_vpLights) nSamples += pLight->getNumSamples();
-		if (pSampler) nSamples *= pSampler->getNumSamples();
-		std::cout << "Rays per Pixel: " << nSamples << std::endl;
+		size_t nRays = 0;
+		for (const auto& pLight : m_vpLights) nRays += pLight->getNumSamples();
+		nRays *= nSamples;
+		std::cout << "Rays per Pixel: " << nRays << std::endl;
+#endif
+
+		// Traces the primary ray \b ray once more on its own (and shades it if \b rayTree is true) and returns its traversal costs,
+		// leaving the statistics of the thread untouched. The packet traversal counts the costs per packet, thus the ray is re-traced,
+		// and its shadow rays are traced as well instead of being answered from the shadow packets, so that the costs do not depend on ENABLE_PACKETS
+		auto traceCost = [&](const Ray& ray, bool rayTree) {
+			RayStats res;
+#ifdef ENABLE_STATS
+			const RayStats saved = stats::local;
+			static_cast<RayStats&>(stats::local) = RayStats();
+#ifdef ENABLE_PACKETS
+			std::vector<ShadowRecord> records;
+			records.swap(shadowRecords);
+#endif
+			Ray r(ray.org, ray.dir, ray.counter, ray.time);
+			if (intersect(r) && rayTree) r.hit->getShader()->shade(r);
+#ifdef ENABLE_PACKETS
+			records.swap(shadowRecords);
+#endif
+			res = stats::local;
+			static_cast<RayStats&>(stats::local) = saved;
+#endif
+			return res;
+		};
+
+		// Accumulates the sample, given by the primary ray \b ray intersected with the scene, in the output buffers
+		const std::function<void(const Point&, const Ray&)> addSample = [&](const Point& imagePixel, const Ray& ray) {
+			const Point pixel = imagePixel - roi.tl();
+			std::optional<RayStats> primaryCost, rayTreeCost;
+			for (size_t i = 0; i < vAovs.size(); i++) {
+				switch (vAovs[i]) {
+					case Aov::Beauty:
+						if (ray.hit) RT_STATS_INC(shadingCalls);
+						vBuffers[i].at<Vec3f>(pixel) += ray.hit ? ray.hit->getShader()->shade(ray) : getBackgroundColor(ray.dir);
+						break;
+					case Aov::Depth:
+						vBuffers[i].at<double>(pixel) += ray.hit ? ray.t : std::numeric_limits<double>::infinity();
+						break;
+					case Aov::Normal:
+						if (ray.hit) {
+							Vec3f normal = normalize(ray.hit->getNormal(ray));
+							vBuffers[i].at<Vec3f>(pixel) += normal.dot(ray.dir) > 0 ? -normal : normal;
+						}
+						break;
+					case Aov::Albedo:
+						if (ray.hit) vBuffers[i].at<Vec3f>(pixel) += ray.hit->getShader()->getAlbedo(ray);
+						break;
+					case Aov::PrimitiveId:
+						if (ray.hit && vBuffers[i].at<int>(pixel) < 0) vBuffers[i].at<int>(pixel) = getId(primIds, ray.hit.get());
+						break;
+					case Aov::ShaderId:
+						if (ray.hit && vBuffers[i].at<int>(pixel) < 0) vBuffers[i].at<int>(pixel) = getId(shaderIds, ray.hit->getShader().get());
+						break;
+					case Aov::SampleCount:
+						vBuffers[i].at<int>(pixel)++;
+						break;
+					case Aov::NodeCount:
+					case Aov::PrimitiveTestCount:
+						if (!primaryCost) primaryCost = traceCost(ray, false);
+						vBuffers[i].at<int>(pixel) += static_cast<int>(vAovs[i] == Aov::NodeCount ? primaryCost->nodesVisited : primaryCost->primitiveTests);
+						break;
+					case Aov::RayTreeNodeCount:
+					case Aov::RayTreePrimitiveTestCount:
+						if (!rayTreeCost) rayTreeCost = traceCost(ray, true);
+						vBuffers[i].at<int>(pixel) += static_cast<int>(vAovs[i] == Aov::RayTreeNodeCount ? rayTreeCost->nodesVisited : rayTreeCost->primitiveTests);
+						break;
+				}
+			}
+		};
+
+#ifdef ENABLE_PACKETS
+		// rows of packetSize x packetSize tiles
+		const int packet = static_cast<int>(packetSize);
+		const int nRows = (resolution.height + packet - 1) / packet;
+#else
+		const int nRows = resolution.height;
+#endif
+
+#ifdef ENABLE_STATS
+		CStatsCollector* pStatsCollector = CStatsCollector::getCurrent();
 #endif
-		
 #ifdef ENABLE_PDP
-		parallel_for_(Range(0, img.rows), [&](const Range& range) {
+		parallel_for_(Range(0, nRows), [&](const Range& range) {
 #else
-		const Range range(0, img.rows);
+		const Range range(0, nRows);
 #endif
-		Ray ray;
+		RT_TRACE_SCOPE("Render rows", "render");
+#ifdef ENABLE_STATS
+		CStatsScope statsScope(pStatsCollector);
+#endif
+#ifdef ENABLE_PACKETS
 		for (int y = range.start; y < range.end; y++) {
-			Vec3f* pImg = img.ptr<Vec3f>(y);
-			for (int x = 0; x < img.cols; x++) {
-				size_t nSamples = pSampler ? pSampler->getNumSamples() : 1;
+			for (int x = 0; x < resolution.width; x += packet)
+				renderPacket(Rect(roi.x + x, roi.y + y * packet, packet, packet) & roi, pSampler, needBeauty, addSample);
+			if (onRowsDone) onRowsDone(Range(y * packet, MIN((y + 1) * packet, resolution.height)), vBuffers);
+		}
+#else
+		Ray ray;
+		for (int y = roi.y + range.start; y < roi.y + range.end; y++) {
+			for (int x = roi.x; x < roi.x + roi.width; x++)
 				for (size_t s = 0; s < nSamples; s++) {
 					activeCamera->InitRay(ray, x, y, pSampler ? pSampler->getNextSample() : Vec2f::all(0.5f));
-					pImg[x] += rayTrace(ray);
+					RT_STATS_INC(primaryRays);
+					intersect(ray);
+					addSample(Point(x, y), ray);
 				}
-				pImg[x] = (1.0f / nSamples) * pImg[x];
-			}
+			if (onRowsDone) onRowsDone(Range(y - roi.y, y - roi.y + 1), vBuffers);
 		}
+#endif
 #ifdef ENABLE_PDP
 		});
 #endif
-		img.convertTo(img, CV_8UC3, 255);
-#ifdef ENABLE_CACHE
-		imwrite(m_lriFileName, img);
-#endif
-		return img;
+
+		// Average the accumulated samples
+		RT_TRACE_SCOPE("Average samples", "render");
+		for (size_t i = 0; i < vAovs.size(); i++)
+			if (vAovs[i] == Aov::Beauty || vAovs[i] == Aov::Depth || vAovs[i] == Aov::Normal || vAovs[i] == Aov::Albedo)
+				vBuffers[i].convertTo(vBuffers[i], -1, 1.0 / nSamples);
+
+		return vBuffers;
 	}
-			
-	Mat CScene::renderDepth(ptr_sampler_t pSampler) const 
+
+	Mat CScene::renderPass(qword key, ptr_sampler_t pSampler, size_t pass) const
 	{
+		RT_TRACE_SCOPE("Render pass", "render");
 		ptr_camera_t activeCamera = getActiveCamera();
-		RT_ASSERT_MSG(activeCamera, "Camera is not found. Add at least one camera to the scene.");
-		Mat depth(activeCamera->getResolution(), CV_64FC1, Scalar(0)); 	// depth-image array
-
+		const Size resolution = activeCamera->getResolution();
+		Mat res(resolution, CV_32FC3, Scalar(0));
+		
+#ifdef ENABLE_STATS
+		CStatsCollector* pStatsCollector = CStatsCollector::getCurrent();
+#endif
 #ifdef ENABLE_PDP
-		parallel_for_(Range(0, depth.rows), [&](const Range& range) {
+		parallel_for_(Range(0, resolution.height), [&](const Range& range) {
 #else
-		const Range range(0, depth.rows);
+		const Range range(0, resolution.height);
+#endif
+		RT_TRACE_SCOPE("Render rows", "render");
+#ifdef ENABLE_STATS
+		CStatsScope statsScope(pStatsCollector);
 #endif
 		Ray ray;
-		for (int y = 0; y < depth.rows; y++) {
-			double* pDepth = depth.ptr<double>(y);
-			for (int x = 0; x < depth.cols; x++) {
-				size_t nSamples = pSampler ? pSampler->getNumSamples() : 1;
-				for (size_t s = 0; s < nSamples; s++) {
-					activeCamera->InitRay(ray, x, y, pSampler ? pSampler->getNextSample() : Vec2f::all(0.5f));
-					pDepth[x] += rayTraceDepth(ray);
-				}
-				pDepth[x] = (1.0f / nSamples) * pDepth[x];
+		for (int y = range.start; y < range.end; y++) {
+			if (m_interruptRender) break;
+			Vec3f* pRes = res.ptr<Vec3f>(y);
+			for (int x = 0; x < resolution.width; x++) {
+				// A renewable sampler gets its own series for every pixel, otherwise all the pixels share the same series
+				Vec2f sample = Vec2f::all(0.5f);
+				if (pSampler) sample = pSampler->getSample(pSampler->isRenewable() ? (CDigest() << key << x << y).get() : key, pass);
+				random::seed((CDigest() << key << x << y << pass).get());
+				activeCamera->InitRay(ray, x, y, sample);
+				RT_STATS_INC(primaryRays);
+				pRes[x] = rayTrace(ray);
 			}
 		}
 #ifdef ENABLE_PDP
-			});
+		});
 #endif
-		return depth;
+		return m_interruptRender ? Mat() : res;
 	}
 
 	Mat CScene::getLastRenderedImage(void) const
 	{
 #ifdef ENABLE_CACHE
-		Mat res = imread(m_lriFileName, IMREAD_COLOR);   // Read the file
+		std::lock_guard<std::mutex> lock(m_lriMutex);
+		if (!m_pRenderCache) {
+			RT_WARNING("Failed to read last saved image: no render cache is set (Ref. setRenderCache()).");
+			return Mat();
+		}
+		if (!m_lriKey) {
+			RT_WARNING("Failed to read last saved image: nothing has been rendered yet.");
+			return Mat();
+		}
+		if ((CDigest() << getDigest() << m_lriSamplerDigest).get() != m_lriKey.value()) {
+			RT_WARNING("Failed to read last saved image: the scene has been changed since the last render.");
+			return Mat();
+		}
+		Mat res = m_pRenderCache->get(m_lriKey.value());
 		RT_IF_WARNING(res.empty(), "Failed to read last saved image: image not found.");
-		return res;
+		return res.empty() ? res : toOutput(res, m_lriType, m_lriToneMapping);
 #else
 		RT_WARNING("Caching support is not enabled");
 		return Mat();
 #endif
 	}
 
+	RayStats CScene::getStats(void) const
+	{
+#ifndef ENABLE_STATS
+		RT_WARNING("Statistics support is not enabled");
+#endif
+		std::lock_guard<std::mutex> lck(m_statsMutex);
+		return m_stats;
+	}
+
+	MemoryReport CScene::getMemoryReport(void) const
+	{
+		MemoryReport res;
+		for (const auto& pPrim : m_vpPrims) pPrim->accountMemory(res);
+		res.sceneReferences.add(m_vpPrims.capacity() * sizeof(ptr_prim_t), m_vpPrims.size());
+		res.sceneReferences.add(m_vpLights.capacity() * sizeof(ptr_light_t), m_vpLights.size());
+		res.sceneReferences.add(m_vpCameras.capacity() * sizeof(ptr_camera_t), m_vpCameras.size());
+#ifdef ENABLE_BSP
+		m_pBSPTree->accountMemory(res);
+#endif
+#ifdef ENABLE_CACHE
+		if (m_pRenderCache) {
+			res.renderCache.add(m_pRenderCache->getMemoryUsage());
+			res.renderCacheDisk = m_pRenderCache->getSize();
+		}
+#endif
+		return res;
+	}
+
+	Size CScene::getResolution(void) const
+	{
+		ptr_camera_t activeCamera = getActiveCamera();
+		RT_ASSERT_MSG(activeCamera, "Camera is not found. Add at least one camera to the scene.");
+		return activeCamera->getResolution();
+	}
+
+	qword CScene::getDigest(void) const
+	{
+		CDigest digest;
+		digest << OPENRT_VERSION_MAJOR << OPENRT_VERSION_MINOR << OPENRT_VERSION_PATCH << maxRayCounter;
+		digest << m_bgColor << m_ambientColor;
+		
+		// The shaders are usually shared between many primitives, so every shader is hashed only once
+		std::unordered_map<const IShader*, size_t> shaderIds;
+		for (const auto& pPrim : m_vpPrims) {
+			const IShader* pShader = pPrim->getShader().get();
+			auto [it, isNew] = shaderIds.emplace(pShader, shaderIds.size());
+			digest << pPrim->getDigest() << it->second;
+			if (isNew) digest << (pShader ? pShader->getDigest() : qword(0));
+		}
+		
+		digest << m_vpLights.size();
+		for (const auto& pLight : m_vpLights)
+			digest << pLight->getDigest() << (pLight == m_pEnvironment);
+		
+		ptr_camera_t activeCamera = getActiveCamera();
+		digest << (activeCamera ? activeCamera->getDigest() : qword(0));
+		return digest.get();
+	}
+
 
 	// -------------------------------------- Service Methods --------------------------------------
 	bool CScene::intersect(Ray& ray) const
 	{
 #ifdef ENABLE_BSP
-		return m_pBSPTree->intersect(ray);
+		bool hit = m_pBSPTree->intersect(ray);
 #else
+		RT_STATS_ADD(primitiveTests, m_vpPrims.size());
 		bool hit = false;
 		for (auto& pPrim : m_vpPrims)
 			hit |= pPrim->intersect(ray);
-		return hit;
 #endif
+		if (hit) RT_STATS_INC(hits);
+		return hit;
 	}
 
 	bool CScene::if_intersect(const Ray& ray) const 
 	{
+		RT_STATS_INC(shadowRays);
+#ifdef ENABLE_PACKETS
+		for (const auto& record : shadowRecords)
+			if (record.org == ray.org && record.dir == ray.dir && record.t == ray.t)
+				return record.occluded;
+#endif
 #ifdef ENABLE_BSP
 		return m_pBSPTree->intersect(lvalue_cast(Ray(ray)));
 #else
-		for (auto& pPrim : m_vpPrims)
+		for (auto& pPrim : m_vpPrims) {
+			RT_STATS_INC(primitiveTests);
 			if (pPrim->if_intersect(ray)) return true;
+		}
 		return false;
 #endif
 	}
 
+	void CScene::intersectAll(const Ray& ray, std::vector<Ray>& vHits, double tMin, size_t maxHits, const hit_filter_t& filter) const
+	{
+#ifdef ENABLE_BSP
+		m_pBSPTree->intersectAll(ray, vHits, tMin, maxHits, filter);
+#else
+		RT_STATS_ADD(primitiveTests, m_vpPrims.size());
+		CHitCollector collector(vHits, tMin, maxHits, filter);
+		for (auto& pPrim : m_vpPrims)
+			pPrim->intersectAll(ray, collector.getHits());
+		collector.flush(Infty);
+#endif
+	}
+
+	dword CScene::intersect(RayPacket& packet) const
+	{
+#ifdef ENABLE_BSP
+		dword res = m_pBSPTree->intersect(packet);
+		RT_STATS_ADD(hits, stats::countBits(res));
+		return res;
+#else
+		dword res = 0;
+		for (size_t i = 0; i < packet.size; i++)
+			if (intersect(packet.rays[i])) res |= 1u << i;
+		return res;
+#endif
+	}
+
+	dword CScene::if_intersect(const RayPacket& packet) const
+	{
+#ifdef ENABLE_BSP
+		return m_pBSPTree->intersect(lvalue_cast(RayPacket(packet)));
+#else
+		dword res = 0;
+		for (size_t i = 0; i < packet.size; i++)
+			for (auto& pPrim : m_vpPrims) {
+				RT_STATS_INC(primitiveTests);
+				if (pPrim->if_intersect(packet.rays[i])) {
+					res |= 1u << i;
+					break;
+				}
+			}
+		return res;
+#endif
+	}
+
 	Vec3f CScene::rayTrace(Ray& ray) const 
 	{ 
-		return intersect(ray) ? ray.hit->getShader()->shade(ray) : m_bgColor; 
+		if (!intersect(ray)) return getBackgroundColor(ray.dir);
+		RT_STATS_INC(shadingCalls);
+		return ray.hit->getShader()->shade(ray);
 	}
 
 	double CScene::rayTraceDepth(Ray& ray) const 
@@ -170,4 +773,65 @@ namespace rt {
 		return intersect(ray) ? ray.t : std::numeric_limits<double>::infinity();
 	}
 
+
+#ifdef ENABLE_PACKETS
+	// -------------------------------------- Ray Packets --------------------------------------
+	void CScene::renderPacket(const Rect& tile, ptr_sampler_t pSampler, bool shadows, const std::function<void(const Point&, const Ray&)>& addSample) const
+	{
+		ptr_camera_t activeCamera = getActiveCamera();
+		const size_t nSamples = pSampler ? pSampler->getNumSamples() : 1;
+		
+		// The samples are drawn pixel by pixel, so every pixel gets the whole series of the sampler
+		std::vector<Vec2f> vSamples(tile.area() * nSamples);
+		for (auto& sample : vSamples)
+			sample = pSampler ? pSampler->getNextSample() : Vec2f::all(0.5f);
+
+		RayPacket packet;
+		for (size_t s = 0; s < nSamples; s++) {
+			packet.clear();
+			Ray ray;
+			for (int y = tile.y; y < tile.y + tile.height; y++)
+				for (int x = tile.x; x < tile.x + tile.width; x++) {
+					activeCamera->InitRay(ray, x, y, vSamples[packet.size * nSamples + s]);
+					RT_STATS_INC(primaryRays);
+					packet.add(ray);
+				}
+			
+			intersect(packet);
+			if (shadows) traceShadowPackets(packet);
+			
+			size_t i = 0;
+			for (int y = tile.y; y < tile.y + tile.height; y++)
+				for (int x = tile.x; x < tile.x + tile.width; x++, i++)
+					addSample(Point(x, y), packet.rays[i]);
+		}
+		shadowRecords.clear();
+	}
+
+	void CScene::traceShadowPackets(const RayPacket& packet) const
+	{
+		shadowRecords.clear();
+		
+		RayPacket shadowPacket;
+		for (auto& pLight : m_vpLights) {
+			if (!pLight->shadow() || !pLight->isPoint()) continue;
+			
+			shadowPacket.clear();
+			for (size_t i = 0; i < packet.size; i++) {
+				const Ray& ray = packet.rays[i];
+				if (!ray.hit) continue;
+				Ray I(ray.hitPoint(), Vec3f::all(0), 0, ray.time);
+				I.hit = ray.hit;
+				if (pLight->illuminate(I)) shadowPacket.add(I);
+			}
+			if (shadowPacket.size < 2) continue;			// a single shadow ray is traced by the shader
+			
+			dword occluded = if_intersect(shadowPacket);
+			for (size_t i = 0; i < shadowPacket.size; i++) {
+				const Ray& I = shadowPacket.rays[i];
+				shadowRecords.push_back({ I.org, I.dir, I.t, (occluded & (1u << i)) != 0 });
+			}
+		}
+	}
+#endif
 }
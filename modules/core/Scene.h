@@ -4,14 +4,47 @@
 
 #include "IPrim.h"
 #include "ILight.h"
+#include "LightEnvironment.h"
 #include "ICamera.h"
 #include "Sampler.h"
+#include "Stats.h"
+#include "MemoryReport.h"
+#include "Arena.h"
+#include "HitCollector.h"
 #ifdef ENABLE_BSP
 #include "BSPTree.h"
 #endif
+#ifdef ENABLE_CACHE
+#include "RenderCache.h"
+#endif
+#include <atomic>
+#include <mutex>
 
 namespace rt {
 	class CSolid;
+	struct RayPacket;
+	
+	// ================================ Render Outputs ================================
+	/// Types of the render output buffers (Arbitrary Output Variables)
+	enum class Aov {
+		Beauty,					///< Shaded color (type: CV_32FC3)
+		Depth,					///< Distance from the camera to the closest hit, or infinity for background (type: CV_64FC1)
+		Normal,					///< Shading normal, turned toward the camera (type: CV_32FC3)
+		Albedo,					///< Unlit surface color (type: CV_32FC3)
+		PrimitiveId,			///< Index of the hit primitive in the scene, or -1 for background (type: CV_32SC1)
+		ShaderId,				///< Index of the hit primitive's shader in the scene, or -1 for background (type: CV_32SC1)
+		SampleCount,			///< Number of samples taken per pixel (type: CV_32SC1)
+		NodeCount,				///< Number of the BSP Tree nodes visited by the primary rays, summed over the samples (type: CV_32SC1)
+		PrimitiveTestCount,		///< Number of the ray - primitive intersection tests of the primary rays, summed over the samples (type: CV_32SC1)
+		RayTreeNodeCount,		///< Number of the BSP Tree nodes visited by the whole ray trees, i.e. including the shadow and secondary rays, summed over the samples (type: CV_32SC1)
+		RayTreePrimitiveTestCount	///< Number of the ray - primitive intersection tests of the whole ray trees, summed over the samples (type: CV_32SC1)
+	};
+	
+	/// Tone mapping operators for the integer output images
+	enum class ToneMapping {
+		Clamp,			///< Values above 1 are clamped
+		Reinhard		///< Global Reinhard operator \f$ c / (1 + L) \f$, where \f$ L \f$ is luminance
+	};
 	
 	// ================================ Scene Class ================================
 	/**
@@ -46,6 +79,8 @@ namespace rt {
 
 		/**
 		 * @brief Clears the scene from geometry, lights and cameras (if any)
+		 * @details The acceleration structure is released and the scene gets a new arena (Ref. @ref getArena()).
+		 * The memory of the old arena is released at once, when the last primitive allocated in it is destroyed
 		 */
 		DllExport void					clear(void);
 		/**
@@ -68,6 +103,12 @@ namespace rt {
 		 * @param pCamera Pointer to the camera
 		 */
 		DllExport void					add(const ptr_camera_t pCamera);
+		/**
+		 * @brief Sets the environment of the scene
+		 * @details The environment is added to the lights of the scene and replaces the background color for the rays, which do not intersect any object
+		 * @param pEnvironment Pointer to the environment light
+		 */
+		DllExport void					setEnvironment(const ptr_light_environment_t pEnvironment);
 		/**
 		 * @brief Sets the active camera
 		 * @param activeCamera The new active camera index
@@ -83,24 +124,127 @@ namespace rt {
 		 * This parameters should be alway above 1.
 		 */
 		DllExport void					buildAccelStructure(size_t maxDepth = 20, size_t minPrimitives = 3);
+		/**
+		 * @brief Updates the BSP tree after the geometry in the scene was changed
+		 * @details Call this method instead of buildAccelStructure() after transforming some solids or instances or adding new primitives, \a e.g. between the frames of an animation.
+		 * The changed primitives are detected by their digests and only they are re-inserted into the tree, keeping the splitting planes. 
+		 * If the tree does not fit the geometry anymore, it is rebuilt with the parameters of the last buildAccelStructure() call (Ref. @ref CBSPTree::refit())
+		 * @note The geometry must not be changed while rendering
+		 * @retval true If the tree was updated in place
+		 * @retval false If the tree was rebuilt
+		 */
+		DllExport bool					updateAccelStructure(void);
 		/**
 		 * @brief Renders the view from the active camera
+		 * @details The floating-point image is returned in linear color space without any conversion. 
+		 * For the integer output types the image is tone-mapped with \b toneMapping operator and quantized.
+		 * If ENABLE_CACHE is on, the linear image is looked up in the render cache by the digest of the scene and the sampler (Ref. @ref getDigest()) and 
+		 * is rendered only if it is not found (Ref. @ref setRenderCache()). The image is rendered in a single pass, while its finished bands are cached as well, 
+		 * so an interrupted render is resumed from the finished bands
 		 * @param pSampler Pointer to the sampler to be used for anti-aliasing.
-		 * @returns The rendered image (type: CV_8UC3)
+		 * @param type The type of the output image: CV_32FC3, CV_16UC3 or CV_8UC3
+		 * @param toneMapping The tone mapping operator for integer output types (Ref. @ref ToneMapping)
+		 * @returns The rendered image (type: \b type)
 		 */
-		DllExport Mat					render(ptr_sampler_t pSampler = nullptr) const;
+		DllExport Mat					render(ptr_sampler_t pSampler = nullptr, int type = CV_8UC3, ToneMapping toneMapping = ToneMapping::Clamp) const;
+		/**
+		 * @brief Renders a tile of the view from the active camera
+		 * @details This method is used by the render workers of the distributed rendering (Ref. @ref CRenderWorker)
+		 * @param tile The region of the image
+		 * @param pSampler Pointer to the sampler to be used for anti-aliasing.
+		 * @returns The rendered tile in linear color space (size: \b tile.size(); type: CV_32FC3)
+		 */
+		DllExport Mat					renderTile(const Rect& tile, ptr_sampler_t pSampler = nullptr) const;
+		/**
+		 * @brief Renders the view from the active camera with periodic checkpoints
+		 * @details The image is rendered in passes, taking one sample per pixel in every pass. The accumulated colors and the per-pixel sample counts are 
+		 * written to file \b fileName at least every \b interval seconds and when the render is finished or interrupted (Ref. @ref interruptRender()).
+		 * If file \b fileName contains a checkpoint of the same scene and sampler, the render is resumed from it. 
+		 * The random numbers of every sample are drawn from a generator seeded by the scene digest, the pixel and the sample index, 
+		 * so a resumed render produces the same image as an uninterrupted one.
+		 * @note The primary rays are traced one by one, even if ENABLE_PACKETS is on
+		 * @param fileName The path to the checkpoint file
+		 * @param pSampler Pointer to the sampler to be used for anti-aliasing.
+		 * @param interval The minimal time between two checkpoints in seconds
+		 * @param type The type of the output image: CV_32FC3, CV_16UC3 or CV_8UC3
+		 * @param toneMapping The tone mapping operator for integer output types (Ref. @ref ToneMapping)
+		 * @returns The rendered image (type: \b type). If the render was interrupted, the image is averaged over the finished passes
+		 */
+		DllExport Mat					renderCheckpointed(const std::string& fileName, ptr_sampler_t pSampler = nullptr, double interval = 60, int type = CV_8UC3, ToneMapping toneMapping = ToneMapping::Clamp) const;
+		/**
+		 * @brief Interrupts the running renderCheckpointed() call
+		 * @details The render stops after the current row of pixels, writes the checkpoint of the finished passes and returns. 
+		 * This method is lock-free and may be called from a signal handler
+		 */
+		DllExport void					interruptRender(void) const { m_interruptRender = true; }
 		/**
 		 * @brief Renders the depth-map from the active camera
 		 * @param pSampler Pointer to the sampler to be used for anti-aliasing.
 		 * @returns The rendered image (type: CV_64FC1)
 		 */
 		DllExport Mat					renderDepth(ptr_sampler_t pSampler = nullptr) const;
+		/**
+		 * @brief Renders several output buffers from the active camera in a single pass
+		 * @details All the buffers are computed from the same primary rays. The per-sample values of the beauty, depth, normal and albedo buffers are averaged over the samples of a pixel, 
+		 * while the primitive and shader ids are taken from the first sample of a pixel, which hits an object. The traversal costs are summed over the samples of a pixel:
+		 * they are measured by tracing every primary ray once more on its own, so they are not affected by the ray packets. Use heatmap() to visualize them
+		 * @note The traversal costs are counted only if ENABLE_STATS is on
+		 * @param vAovs The types of the output buffers (Ref. @ref Aov)
+		 * @param pSampler Pointer to the sampler to be used for anti-aliasing.
+		 * @returns The vector of rendered buffers in the order given by \b vAovs
+		 */
+		DllExport std::vector<Mat>		render(const std::vector<Aov>& vAovs, ptr_sampler_t pSampler = nullptr) const;
 		/**
 		 * @brief Loads the last rendered image from cache.
-		 * @note This method can only be used if ENABLE_CACHE is on. It also uses the m_cachePath as a default location.
-		 * @return The last cached render.
+		 * @details The image is returned with the type and tone mapping of the last render() call. 
+		 * If the scene has been changed since the last render, the cached image is stale and is not returned
+		 * @note This method can only be used if ENABLE_CACHE is on and a render cache is set (Ref. @ref setRenderCache())
+		 * @return The last cached render, or an empty matrix if it is not available
 		 */
 		DllExport Mat					getLastRenderedImage(void) const;
+		/**
+		 * @brief Returns the ray-tracing statistics of the last render call
+		 * @details The statistics are collected over all the threads by every render method. Only the work of the render call is counted, even if other renders run concurrently.
+		 * If DEBUG_PRINT_INFO is on, they are also printed at the end of rendering
+		 * The parts of the image, which are taken from the render cache, are not traced and thus not counted
+		 * @note This method can only be used if ENABLE_STATS is on
+		 * @return The statistics of the last render (Ref. @ref RayStats)
+		 */
+		DllExport RayStats				getStats(void) const;
+		/**
+		 * @brief Returns the itemised memory usage of the scene
+		 * @details The report accounts for the primitives per type, the nodes and the leaf references of the BSP Trees, the textures and the render cache.
+		 * If DEBUG_PRINT_INFO is on, the report is also printed after building of the acceleration structure
+		 * @return The memory report (Ref. @ref MemoryReport)
+		 */
+		DllExport MemoryReport			getMemoryReport(void) const;
+		/**
+		 * @brief Returns the resolution of the active camera
+		 * @return The resolution of the rendered image
+		 */
+		DllExport Size					getResolution(void) const;
+		/**
+		 * @brief Returns the digest of the scene content
+		 * @details The digest accounts for the build options, the background and ambient colors, the primitives, their shaders, the lights and the active camera.
+		 * Two scenes with the same digest produce the same render
+		 * @return The 64-bit hash value of the scene content
+		 */
+		DllExport qword					getDigest(void) const;
+		/**
+		 * @brief Returns the arena of the scene
+		 * @details The solids, created within a CArena::CScope of this arena, allocate their primitives in the arena instead of the heap.
+		 * The primitives share the ownership of the arena, thus they remain valid after clear() or destruction of the scene
+		 * @return The pointer to the arena of the scene
+		 */
+		DllExport std::shared_ptr<CArena>	getArena(void) const { return m_pArena; }
+#ifdef ENABLE_CACHE
+		/**
+		 * @brief Sets the render cache
+		 * @details By default the scene does not use a render cache. The cache may be shared between several scenes
+		 * @param pRenderCache Pointer to the render cache, or nullptr to disable caching
+		 */
+		DllExport void					setRenderCache(const std::shared_ptr<CRenderCache>& pRenderCache) { m_pRenderCache = pRenderCache; }
+#endif
 
 	public:
 		/**
@@ -113,6 +257,12 @@ namespace rt {
 		 * @brief Returns the ambient
 		 */
 		Vec3f							getAmbientColor(void) const { return m_ambientColor; }
+		/**
+		 * @brief Returns the background color, \a i.e. the color of the rays, which do not intersect any object
+		 * @param dir The direction of the ray
+		 * @return The radiance of the environment in direction \b dir, if the environment is set (Ref. @ref setEnvironment()), or the background color otherwise
+		 */
+		Vec3f							getBackgroundColor(const Vec3f& dir) const { return m_pEnvironment ? m_pEnvironment->getRadiance(dir) : m_bgColor; }
 		/**
 		 * @brief Checks intersection between ray \b ray and the geometry present in scene
 		 * @details This function calls \b IPrim::intersect() method for all scene's primitives. If valid intersecton(s) is(are) found, the argument \b ray is updated:
@@ -133,6 +283,36 @@ namespace rt {
 		 * @retval false otherwise
 		 */
 		bool							if_intersect(const Ray& ray) const;
+		/**
+		 * @brief Collects the intersections between ray \b ray and the geometry present in scene in order of their distance
+		 * @details The acceleration structure is traversed only once, and the traversal stops as soon as \b maxHits hits are collected or the filter stops the query.
+		 * Every hit is a copy of \b ray with Ray::t and Ray::hit set as by intersect(). This method replaces the re-tracing of the ray from every hit, 
+		 * \a e.g. for transparent objects
+		 * @note This method is to be used only in OpenRT shaders
+		 * @param[in] ray The ray (Ref. @ref Ray for details). Only the hits closer than \b ray.t are collected
+		 * @param[in,out] vHits The vector, where the hits are appended to
+		 * @param[in] tMin The minimal distance of the collected hits
+		 * @param[in] maxHits The maximal number of the hits to be collected
+		 * @param[in] filter The hit filter, which is called for every hit in order of the distance (Ref. @ref HitDecision), or nullptr to collect every hit
+		 */
+		void							intersectAll(const Ray& ray, std::vector<Ray>& vHits, double tMin = 0, size_t maxHits = std::numeric_limits<size_t>::max(), const hit_filter_t& filter = nullptr) const;
+		/**
+		 * @brief Checks intersection between the rays of packet \b packet and the geometry present in scene
+		 * @details This function traverses the rays together through the acceleration structure. For every ray with valid intersection, 
+		 * Ray::t and Ray::hit are updated as in intersect(Ray&)
+		 * @note This method is to be used only in OpenRT shaders
+		 * @param[in,out] packet The ray packet (Ref. @ref RayPacket for details)
+		 * @returns The mask of the rays in \b packet, which intersect any object
+		 */
+		dword							intersect(RayPacket& packet) const;
+		/**
+		 * @brief Checks intersection between the rays of packet \b packet and the geometry present in scene
+		 * @details In contrast to the intersect(RayPacket&) method, this method does not modify argument \b packet
+		 * @note This method is to be used only in OpenRT shaders
+		 * @param packet The ray packet (Ref. @ref RayPacket for details)
+		 * @returns The mask of the rays in \b packet, whose origins are occluded
+		 */
+		dword							if_intersect(const RayPacket& packet) const;
 		/**
 		 * @brief Traces the given ray and shades it
 		 * @note This method is to be used only in OpenRT shaders
@@ -156,6 +336,41 @@ namespace rt {
 		 * @retval nullptr If there are no cameras added yet into the scene
 		 */
 		ptr_camera_t					getActiveCamera(void) const { return m_vpCameras.empty() ? nullptr : m_vpCameras.at(m_activeCamera); }
+		/**
+		 * @brief Renders several output buffers for the region \b roi of the image from the active camera
+		 * @param vAovs The types of the output buffers (Ref. @ref Aov)
+		 * @param pSampler Pointer to the sampler to be used for anti-aliasing.
+		 * @param roi The region of the image
+		 * @param onRowsDone Optional callback, which is called from the render threads as soon as the given rows of the region are finished. 
+		 * It receives the output buffers, where the finished rows hold the sums of their samples
+		 * @returns The vector of rendered buffers of size \b roi.size() in the order given by \b vAovs
+		 */
+		std::vector<Mat>				renderRegion(const std::vector<Aov>& vAovs, ptr_sampler_t pSampler, const Rect& roi, const std::function<void(const Range&, const std::vector<Mat>&)>& onRowsDone = nullptr) const;
+		/**
+		 * @brief Renders one pass of the checkpointed render, taking the sample \b pass for every pixel
+		 * @param key The digest of the scene and the sampler
+		 * @param pSampler Pointer to the sampler to be used for anti-aliasing.
+		 * @param pass The index of the sample
+		 * @returns The rendered image (type: CV_32FC3), or an empty matrix if the render was interrupted
+		 */
+		Mat								renderPass(qword key, ptr_sampler_t pSampler, size_t pass) const;
+#ifdef ENABLE_PACKETS
+		/**
+		 * @brief Traces the primary rays through the pixels of tile \b tile from the active camera in packets
+		 * @param tile The tile of the image, not larger than \b packetSize x \b packetSize pixels
+		 * @param pSampler Pointer to the sampler to be used for anti-aliasing.
+		 * @param shadows Flag indicating whether the shadow rays toward the point light sources should be traced in packets as well
+		 * @param addSample Function, which is called for every traced primary ray with the pixel coordinates and the ray intersected with the scene
+		 */
+		void							renderPacket(const Rect& tile, ptr_sampler_t pSampler, bool shadows, const std::function<void(const Point&, const Ray&)>& addSample) const;
+		/**
+		 * @brief Traces the shadow rays from the hitpoints of packet \b packet toward the point light sources in packets
+		 * @details The occlusion results are kept for the calling thread and are returned by if_intersect(const Ray&) when the shaders trace the same shadow rays, 
+		 * until the next call of this method
+		 * @param packet The packet of the primary rays, which have been already intersected with the scene
+		 */
+		void							traceShadowPackets(const RayPacket& packet) const;
+#endif
 		
 		
 	private:
@@ -163,13 +378,23 @@ namespace rt {
 		const Vec3f						m_ambientColor;				///< ambient color
 		std::vector<ptr_prim_t> 		m_vpPrims;					///< Primitives
 		std::vector<ptr_light_t>		m_vpLights;					///< Lights
+		ptr_light_environment_t			m_pEnvironment	= nullptr;	///< The environment, which replaces the background color
 		std::vector<ptr_camera_t>		m_vpCameras;				///< Cameras
 		size_t							m_activeCamera	= 0;		///< The index of the active camera
+		std::shared_ptr<CArena>			m_pArena		= std::make_shared<CArena>();	///< The arena for the primitives
 #ifdef ENABLE_BSP		
 		std::unique_ptr<CBSPTree>		m_pBSPTree		= nullptr;	///< Pointer to the acceleration structure
 #endif
+		mutable RayStats				m_stats;								///< Statistics of the last render
+		mutable std::mutex				m_statsMutex;							///< Mutex guarding the statistics of the last render
+		mutable std::atomic<bool>		m_interruptRender	= false;	///< Flag indicating that the checkpointed render should be interrupted
 #ifdef ENABLE_CACHE
-		const std::string m_lriFileName = "last_render.png";		///< Last rendered image filename
+		std::shared_ptr<CRenderCache>	m_pRenderCache	= nullptr;				///< Pointer to the render cache, or nullptr if caching is disabled
+		mutable std::optional<qword>	m_lriKey;								///< Cache key of the last rendered image
+		mutable qword					m_lriSamplerDigest	= 0;				///< Digest of the sampler used for the last rendered image
+		mutable int						m_lriType			= CV_8UC3;			///< Type of the last rendered image
+		mutable ToneMapping				m_lriToneMapping	= ToneMapping::Clamp;	///< Tone mapping of the last rendered image
+		mutable std::mutex				m_lriMutex;								///< Mutex guarding the last rendered image
 #endif
 	};
 }
@@ -0,0 +1,135 @@
+#include "SequenceRenderer.h"
+#include "Scene.h"
+#include "CameraPerspective.h"
+#include "Transform.h"
+#include "Trace.h"
+#include "macroses.h"
+#include <future>
+#include <algorithm>
+
+namespace rt {
+	namespace {
+		Vec3f lerp(const Vec3f& a, const Vec3f& b, float k) { return (1 - k) * a + k * b; }
+
+		// Returns the keys around frame \b frame and the interpolation weight of the second key. The keys are clamped outside of their range
+		template <class T>
+		std::tuple<const T&, const T&, float> getKeys(const std::map<size_t, T>& keys, size_t frame)
+		{
+			auto next = keys.lower_bound(frame);
+			if (next == keys.end()) return { keys.rbegin()->second, keys.rbegin()->second, 0.0f };
+			if (next->first == frame || next == keys.begin()) return { next->second, next->second, 0.0f };
+			auto prev = std::prev(next);
+			return { prev->second, next->second, static_cast<float>(frame - prev->first) / (next->first - prev->first) };
+		}
+	}
+
+	Mat CSequenceRenderer::Pose::get(void) const
+	{
+		return CTransform().scale(scale).rotate(Vec3f(1, 0, 0), rotation[0]).rotate(Vec3f(0, 1, 0), rotation[1]).rotate(Vec3f(0, 0, 1), rotation[2]).translate(translation).get();
+	}
+
+	Mat CSequenceRenderer::Pose::getInverse(void) const
+	{
+		return CTransform().translate(-translation).rotate(Vec3f(0, 0, 1), -rotation[2]).rotate(Vec3f(0, 1, 0), -rotation[1]).rotate(Vec3f(1, 0, 0), -rotation[0]).scale(Vec3f(1 / scale[0], 1 / scale[1], 1 / scale[2])).get();
+	}
+
+	// Constructor
+	CSequenceRenderer::CSequenceRenderer(CScene& scene, size_t nFrames)
+		: m_scene(scene)
+		, m_nFrames(nFrames)
+	{}
+
+	void CSequenceRenderer::addKey(const std::shared_ptr<CCameraPerspective>& pCamera, size_t frame, const Vec3f& pos, const Vec3f& target)
+	{
+		RT_ASSERT(pCamera);
+		CameraTrack& track = m_cameraTracks[pCamera.get()];
+		track.pCamera = pCamera;
+		track.keys[frame] = std::make_pair(pos, target);
+	}
+
+	void CSequenceRenderer::addKey(const CSolid& solid, size_t frame, const Pose& pose)
+	{
+		RT_ASSERT(!solid.getPrims().empty());
+		auto it = m_solidTracks.find(solid.getPrims().front().get());
+		if (it == m_solidTracks.end())
+			it = m_solidTracks.emplace(solid.getPrims().front().get(), SolidTrack{ solid, {}, Mat::eye(4, 4, CV_32FC1), Mat::eye(4, 4, CV_32FC1) }).first;
+		it->second.keys[frame] = pose;
+	}
+
+	void CSequenceRenderer::render(const std::function<void(size_t, const Mat&)>& onFrame, ptr_sampler_t pSampler, int type)
+	{
+		const int64 start = getTickCount();
+		std::future<void> writer;
+		for (size_t frame = 0; frame < m_nFrames; frame++) {
+			setup(frame);
+			Mat img = m_scene.render(pSampler, type);
+
+			// The previous frame must be written before the next one, so at most one frame is pending
+			if (writer.valid()) writer.get();
+			writer = std::async(std::launch::async, [&onFrame, frame, img] {
+				RT_TRACE_SCOPE("Write Frame", "io");
+				onFrame(frame, img);
+			});
+		}
+		if (writer.valid()) writer.get();
+
+		const double seconds = static_cast<double>(getTickCount() - start) / getTickFrequency();
+		m_framesPerHour = seconds > 0 ? 3600 * m_nFrames / seconds : 0;
+#ifdef DEBUG_PRINT_INFO
+		std::cout << "Rendered " << m_nFrames << " frames in " << seconds << " seconds (" << m_framesPerHour << " frames per hour)" << std::endl;
+#endif
+	}
+
+	void CSequenceRenderer::render(const std::string& fileName, ptr_sampler_t pSampler)
+	{
+		render([&fileName](size_t frame, const Mat& img) {
+			std::vector<char> buffer(fileName.size() + 32);
+			snprintf(buffer.data(), buffer.size(), fileName.c_str(), static_cast<int>(frame));
+			if (!imwrite(buffer.data(), img)) RT_WARNING("Unable to write the frame \"%s\"", buffer.data());
+		}, pSampler, CV_8UC3);
+	}
+
+	// ------------------------------------------------ Private ------------------------------------------------
+	void CSequenceRenderer::setup(size_t frame)
+	{
+		RT_TRACE_SCOPE("Setup Frame", "build");
+		for (auto& cameraTrack : m_cameraTracks) {
+			auto keys = getKeys(cameraTrack.second.keys, frame);
+			const float k = std::get<2>(keys);
+			const Vec3f pos = lerp(std::get<0>(keys).first, std::get<1>(keys).first, k);
+			const Vec3f target = lerp(std::get<0>(keys).second, std::get<1>(keys).second, k);
+			cameraTrack.second.pCamera->setPosition(pos);
+			cameraTrack.second.pCamera->setDirection(normalize(target - pos));
+		}
+
+		bool changed = false;
+		for (auto& solidTrack : m_solidTracks) {
+			SolidTrack& track = solidTrack.second;
+			auto keys = getKeys(track.keys, frame);
+			const float k = std::get<2>(keys);
+			const Pose& a = std::get<0>(keys);
+			const Pose& b = std::get<1>(keys);
+			const Pose pose(lerp(a.translation, b.translation, k), lerp(a.rotation, b.rotation, k), lerp(a.scale, b.scale, k));
+			Mat T = pose.get();
+
+			if (std::equal(T.ptr<float>(), T.ptr<float>() + T.total(), track.current.ptr<float>())) continue;
+
+			// The solid is moved from the previous pose with the exact inverse of that pose, and the product is taken in double precision,
+			// so that the rounding errors of the solid, transformed in place, do not build up over the frames.
+			// CSolid::transform() applies the linear part around the pivot point and moves the pivot point by the translation part
+			Mat T64, inverse64, delta;
+			T.convertTo(T64, CV_64FC1);
+			track.inverse.convertTo(inverse64, CV_64FC1);
+			Mat(T64 * inverse64).convertTo(delta, CV_32FC1);
+			for (int i = 0; i < 3; i++)
+				delta.at<float>(i, 3) = T.at<float>(i, 3) - track.current.at<float>(i, 3);
+			track.solid.transform(delta);
+			track.current = T;
+			track.inverse = pose.getInverse();
+			changed = true;
+		}
+#ifdef ENABLE_BSP
+		if (changed) m_scene.updateAccelStructure();
+#endif
+	}
+}
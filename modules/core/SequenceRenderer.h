@@ -0,0 +1,146 @@
+// Animation sequence renderer
+// Written by Dr. Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "Solid.h"
+#include "Sampler.h"
+#include <map>
+#include <functional>
+
+namespace rt {
+	class CScene;
+	class CCameraPerspective;
+
+	// ================================ Sequence Renderer Class ================================
+	/**
+	 * @brief Animation sequence renderer
+	 * @details The renderer animates the cameras and the solids of a scene with linearly interpolated keyframes and renders the frames one by one.
+	 * The scene is set up only once: the parsed geometry, the textures and the acceleration structure are kept between the frames, and only the
+	 * animated primitives are re-inserted into the acceleration structure (Ref. @ref CScene::updateAccelStructure()). Every rendered frame is
+	 * written out asynchronously, while the next frame is set up and rendered:
+	 * @code
+	 * CSequenceRenderer sequence(scene, 120);
+	 * sequence.addKey(pCamera, 0, Vec3f(0, 5, -10), Vec3f(0, 0, 0));
+	 * sequence.addKey(pCamera, 119, Vec3f(10, 5, 0), Vec3f(0, 0, 0));
+	 * sequence.addKey(solid, 0, CSequenceRenderer::Pose());
+	 * sequence.addKey(solid, 119, CSequenceRenderer::Pose(Vec3f::all(0), Vec3f(0, 360, 0)));		// turntable
+	 * sequence.render("frame_%04d.png");
+	 * @endcode
+	 * @note The scene is left in the pose of the last rendered frame. With ENABLE_CACHE on and if a render cache is set (Ref. CScene::setRenderCache()), the already rendered frames are taken from the render cache
+	 */
+	class CSequenceRenderer
+	{
+	public:
+		/// Pose of an animated solid relative to its initial position around its pivot point (Ref. @ref CSolid::getPivot())
+		struct Pose
+		{
+			Vec3f	translation;	///< Translation
+			Vec3f	rotation;		///< Rotation angles around the x-, y- and z-axis in \a degrees, applied in this order
+			Vec3f	scale;			///< Scaling factors
+
+			/**
+			 * @brief Constructor
+			 * @param translation Translation
+			 * @param rotation Rotation angles around the x-, y- and z-axis in \a degrees
+			 * @param scale Scaling factors
+			 */
+			Pose(const Vec3f& translation = Vec3f::all(0), const Vec3f& rotation = Vec3f::all(0), const Vec3f& scale = Vec3f::all(1))
+				: translation(translation), rotation(rotation), scale(scale)
+			{}
+			/**
+			 * @brief Returns the transformation matrix of the pose
+			 * @return The transformation matrix (size: 4 x 4; type: CV_32FC1)
+			 */
+			DllExport Mat	get(void) const;
+			/**
+			 * @brief Returns the inverse transformation matrix of the pose
+			 * @details The inverse is composed of the inverse scaling, rotations and translation, thus it does not suffer from the numerical inversion of the matrix
+			 * @return The transformation matrix (size: 4 x 4; type: CV_32FC1)
+			 */
+			DllExport Mat	getInverse(void) const;
+		};
+
+		/**
+		 * @brief Constructor
+		 * @param scene The scene to be animated
+		 * @param nFrames The number of frames in the sequence
+		 */
+		DllExport CSequenceRenderer(CScene& scene, size_t nFrames);
+		DllExport CSequenceRenderer(const CSequenceRenderer&) = delete;
+		DllExport ~CSequenceRenderer(void) = default;
+		DllExport const CSequenceRenderer& operator=(const CSequenceRenderer&) = delete;
+
+		/**
+		 * @brief Adds a keyframe for the camera \b pCamera
+		 * @param pCamera Pointer to the camera of the scene
+		 * @param frame The frame index
+		 * @param pos The camera position in the frame
+		 * @param target The point, the camera looks at in the frame
+		 */
+		DllExport void		addKey(const std::shared_ptr<CCameraPerspective>& pCamera, size_t frame, const Vec3f& pos, const Vec3f& target);
+		/**
+		 * @brief Adds a keyframe for the solid \b solid
+		 * @details The solid is identified by its first primitive, thus the keyframes of a solid may be added with different copies of the solid
+		 * @param solid The solid, which has been added to the scene
+		 * @param frame The frame index
+		 * @param pose The pose of the solid in the frame relative to its pose at the moment the first keyframe was added
+		 */
+		DllExport void		addKey(const CSolid& solid, size_t frame, const Pose& pose);
+		/**
+		 * @brief Adds a keyframe for the primitive \b pPrim, \a e.g. an instance (Ref. @ref CPrimInstance)
+		 * @param pPrim Pointer to the primitive, which has been added to the scene
+		 * @param frame The frame index
+		 * @param pose The pose of the primitive in the frame relative to its pose at the moment the first keyframe was added
+		 */
+		DllExport void		addKey(const ptr_prim_t& pPrim, size_t frame, const Pose& pose) { addKey(CSolid(pPrim), frame, pose); }
+
+		/**
+		 * @brief Renders the sequence
+		 * @details Function \b onFrame is called for every frame in order of the frames from a separate thread, concurrently with rendering of the next frame
+		 * @param onFrame The function, receiving the frame index and the rendered image
+		 * @param pSampler Pointer to the sampler to be used for anti-aliasing.
+		 * @param type The type of the output images: CV_32FC3, CV_16UC3 or CV_8UC3
+		 */
+		DllExport void		render(const std::function<void(size_t, const Mat&)>& onFrame, ptr_sampler_t pSampler = nullptr, int type = CV_8UC3);
+		/**
+		 * @brief Renders the sequence into the image files
+		 * @param fileName The printf-style pattern of the file names with the frame index, \a e.g. "frame_%04d.png"
+		 * @param pSampler Pointer to the sampler to be used for anti-aliasing.
+		 */
+		DllExport void		render(const std::string& fileName, ptr_sampler_t pSampler = nullptr);
+		/**
+		 * @brief Returns the throughput of the last render() call
+		 * @return The number of frames per hour, including setting up and writing of the frames
+		 */
+		DllExport double	getFramesPerHour(void) const { return m_framesPerHour; }
+
+
+	private:
+		/**
+		 * @brief Sets the cameras and the solids up for the frame \b frame and updates the acceleration structure
+		 * @param frame The frame index
+		 */
+		void	setup(size_t frame);
+
+
+	private:
+		/// Keyframes of a camera
+		struct CameraTrack {
+			std::shared_ptr<CCameraPerspective>				pCamera;
+			std::map<size_t, std::pair<Vec3f, Vec3f>>		keys;		///< The positions and the targets of the camera
+		};
+		/// Keyframes of a solid
+		struct SolidTrack {
+			CSolid											solid;
+			std::map<size_t, Pose>							keys;
+			Mat												current;	///< The transformation of the current pose
+			Mat												inverse;	///< The inverse transformation of the current pose
+		};
+
+		CScene&												m_scene;
+		const size_t										m_nFrames;
+		std::map<const CCameraPerspective*, CameraTrack>	m_cameraTracks;
+		std::map<const IPrim*, SolidTrack>					m_solidTracks;
+		double												m_framesPerHour	= 0;
+	};
+}
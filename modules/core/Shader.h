@@ -69,6 +69,10 @@ namespace rt {
 		DllExport virtual ~CShader(void) = default;
 		
 		DllExport virtual Vec3f shade(const Ray& ray) const override;
+		DllExport virtual qword getDigest(void) const override
+		{
+			return (CDigest() << CShaderFlat::getDigest() << m_ka << m_kd << m_ks << m_ke << m_km << m_kt << m_refractiveIndex << (m_pSampler ? m_pSampler->getDigest() : qword(0))).get();
+		}
 	
 	
 	private:
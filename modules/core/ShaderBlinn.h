@@ -53,6 +53,7 @@ namespace rt {
 		DllExport virtual ~CShaderBlinn(void) = default;
 		
 		DllExport virtual Vec3f shade(const Ray& ray) const override;
+		DllExport virtual qword getDigest(void) const override { return (CDigest() << CShaderFlat::getDigest() << m_ka << m_kd << m_ks << m_ke).get(); }
 
 		
 	private:
@@ -29,6 +29,7 @@ namespace rt {
 		DllExport virtual ~CShaderChrome(void) = default;
 		
 		DllExport virtual Vec3f shade(const Ray& ray) const override;
+		DllExport virtual qword getDigest(void) const override { return (CDigest() << IShader::getDigest() << (m_pSampler ? m_pSampler->getDigest() : qword(0))).get(); }
 		
 		
 	private:
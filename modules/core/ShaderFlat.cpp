@@ -4,6 +4,20 @@
 namespace rt {
 	Vec3f CShaderFlat::shade(const Ray& ray) const 
 	{
-		return m_pTexture ? m_pTexture->getTexel(ray.hit->getTextureCoords(ray)) : m_color;
+		if (!m_pTexture) return m_color;
+		
+		// The footprint of the pixel selects the mipmap level
+		const Vec2f uv = ray.hit->getTextureCoords(ray);
+		if (!ray.hasDifferentials) return m_pTexture->getTexel(uv);
+		auto [dUVdx, dUVdy] = ray.hit->getTextureDifferentials(ray);
+		return m_pTexture->getTexel(uv, dUVdx, dUVdy);
 	}
-}
\ No newline at end of file
+
+	qword CShaderFlat::getDigest(void) const
+	{
+		CDigest digest;
+		digest << IShader::getDigest() << m_color;
+		if (m_pTexture) digest << m_pTexture->getDigest();
+		return digest.get();
+	}
+}
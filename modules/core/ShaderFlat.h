@@ -4,6 +4,7 @@
 
 #include "IShader.h"
 #include "Texture.h"
+#include "MemoryReport.h"
 
 namespace rt {
 	// ================================ Flat Shader Class ================================
@@ -30,6 +31,9 @@ namespace rt {
 		DllExport virtual ~CShaderFlat(void) = default;
 
 		DllExport virtual Vec3f shade(const Ray& ray) const override;
+		DllExport virtual Vec3f getAlbedo(const Ray& ray) const override { return CShaderFlat::shade(ray); }
+		DllExport virtual qword getDigest(void) const override;
+		DllExport virtual void	accountMemory(MemoryReport& report) const override { if (m_pTexture) report.addTexture(*m_pTexture); }
 
 
 	private:
@@ -6,7 +6,30 @@ namespace rt
 {
 	Vec3f CShaderSSLT::shade(const Ray& ray) const
 	{
-		Ray I(ray.hitPoint(), ray.dir, ray.counter);
-		return m_opacity * CShaderFlat::shade(ray) + (1.0f - m_opacity) * I.reTrace(m_scene);
+		Vec3f res = m_opacity * CShaderFlat::shade(ray);
+		float transmittance = 1.0f - m_opacity;
+		if (ray.counter >= maxRayCounter) return res + transmittance * exitColor;
+
+		// The translucent layers behind the hit and the first opaque object are collected at once, instead of re-tracing the ray from every layer
+		Ray I(ray.hitPoint(), ray.dir, ray.counter, ray.time);
+#ifdef ENABLE_STATS
+		I.type = RayType::Refraction;
+#endif
+		std::vector<Ray> vHits;
+		m_scene.intersectAll(I, vHits, 0, maxRayCounter - ray.counter, [](const Ray& hit) {
+			return dynamic_cast<const CShaderSSLT*>(hit.hit->getShader().get()) ? HitDecision::Accept : HitDecision::AcceptAndStop;
+		});
+
+		size_t counter = ray.counter;
+		for (auto& hit : vHits) {
+			hit.counter = ++counter;
+			RT_STATS_INC(refractionRays);
+			RT_STATS_INC(shadingCalls);
+			auto pShader = dynamic_cast<const CShaderSSLT*>(hit.hit->getShader().get());
+			if (!pShader) return res + transmittance * hit.hit->getShader()->shade(hit);
+			res += transmittance * pShader->m_opacity * pShader->CShaderFlat::shade(hit);
+			transmittance *= 1.0f - pShader->m_opacity;
+		}
+		return res + transmittance * (counter >= maxRayCounter ? exitColor : m_scene.getBackgroundColor(ray.dir));
 	}
-}
\ No newline at end of file
+}
@@ -25,6 +25,7 @@ namespace rt {
 		{}
 
 		DllExport Vec3f shade(const Ray& ray) const override;
+		DllExport qword getDigest(void) const override { return (CDigest() << CShaderFlat::getDigest() << m_opacity).get(); }
 
 
 	private:
@@ -0,0 +1,170 @@
+#include "Socket.h"
+#include "macroses.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using socklen_t = int;
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace rt {
+	namespace {
+#ifdef _WIN32
+		// Initializes Winsock once per process
+		struct WinsockInit {
+			WinsockInit(void) { WSADATA data; WSAStartup(MAKEWORD(2, 2), &data); }
+			~WinsockInit(void) { WSACleanup(); }
+		} winsockInit;
+		using native_t = SOCKET;
+		inline void closeNative(native_t s) { closesocket(s); }
+#else
+		using native_t = int;
+		inline void closeNative(native_t s) { ::close(s); }
+#endif
+		inline native_t native(std::intptr_t s) { return static_cast<native_t>(s); }
+
+#ifdef MSG_NOSIGNAL
+		const int sendFlags = MSG_NOSIGNAL;		// a closed connection must not raise SIGPIPE
+#else
+		const int sendFlags = 0;
+#endif
+	}
+
+	CSocket& CSocket::operator=(CSocket&& other) noexcept
+	{
+		if (this != &other) {
+			close();
+			m_socket = other.m_socket;
+			other.m_socket = invalid;
+		}
+		return *this;
+	}
+
+	CSocket CSocket::listen(unsigned short port)
+	{
+		native_t s = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (s == native(invalid)) return CSocket();
+
+		int reuse = 1;
+		setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+		sockaddr_in addr = {};
+		addr.sin_family			= AF_INET;
+		addr.sin_addr.s_addr	= htonl(INADDR_ANY);
+		addr.sin_port			= htons(port);
+		if (::bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(s, SOMAXCONN) != 0) {
+			RT_WARNING("Unable to listen on port %u", port);
+			closeNative(s);
+			return CSocket();
+		}
+		return CSocket(static_cast<std::intptr_t>(s));
+	}
+
+	CSocket CSocket::connect(const std::string& host, unsigned short port)
+	{
+		addrinfo hints = {};
+		hints.ai_family		= AF_INET;
+		hints.ai_socktype	= SOCK_STREAM;
+		addrinfo* pAddr = nullptr;
+		if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &pAddr) != 0) return CSocket();
+
+		CSocket res;
+		for (addrinfo* p = pAddr; p; p = p->ai_next) {
+			native_t s = ::socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+			if (s == native(invalid)) continue;
+			if (::connect(s, p->ai_addr, static_cast<socklen_t>(p->ai_addrlen)) == 0) {
+				int noDelay = 1;
+				setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+				res = CSocket(static_cast<std::intptr_t>(s));
+				break;
+			}
+			closeNative(s);
+		}
+		freeaddrinfo(pAddr);
+		return res;
+	}
+
+	CSocket CSocket::accept(double timeout) const
+	{
+		fd_set set;
+		FD_ZERO(&set);
+		FD_SET(native(m_socket), &set);
+		timeval tv;
+		tv.tv_sec	= static_cast<long>(timeout);
+		tv.tv_usec	= static_cast<long>((timeout - tv.tv_sec) * 1e6);
+		if (::select(static_cast<int>(native(m_socket)) + 1, &set, nullptr, nullptr, &tv) <= 0) return CSocket();
+
+		native_t s = ::accept(native(m_socket), nullptr, nullptr);
+		if (s == native(invalid)) return CSocket();
+		int noDelay = 1;
+		setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+		return CSocket(static_cast<std::intptr_t>(s));
+	}
+
+	bool CSocket::send(const void* data, size_t size) const
+	{
+		const char* pData = static_cast<const char*>(data);
+		while (size > 0) {
+			auto n = ::send(native(m_socket), pData, static_cast<int>(MIN(size, static_cast<size_t>(1 << 30))), sendFlags);
+			if (n <= 0) return false;
+			pData += n;
+			size -= n;
+		}
+		return true;
+	}
+
+	bool CSocket::recv(void* data, size_t size) const
+	{
+		char* pData = static_cast<char*>(data);
+		while (size > 0) {
+			auto n = ::recv(native(m_socket), pData, static_cast<int>(MIN(size, static_cast<size_t>(1 << 30))), 0);
+			if (n <= 0) return false;
+			pData += n;
+			size -= n;
+		}
+		return true;
+	}
+
+	void CSocket::setTimeout(double timeout) const
+	{
+#ifdef _WIN32
+		DWORD tv = static_cast<DWORD>(timeout * 1000);
+#else
+		timeval tv;
+		tv.tv_sec	= static_cast<long>(timeout);
+		tv.tv_usec	= static_cast<long>((timeout - tv.tv_sec) * 1e6);
+#endif
+		setsockopt(native(m_socket), SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&tv), sizeof(tv));
+	}
+
+	unsigned short CSocket::getPort(void) const
+	{
+		sockaddr_in addr = {};
+		socklen_t len = sizeof(addr);
+		if (getsockname(native(m_socket), reinterpret_cast<sockaddr*>(&addr), &len) != 0) return 0;
+		return ntohs(addr.sin_port);
+	}
+
+	void CSocket::shutdown(void) const
+	{
+#ifdef _WIN32
+		if (isValid()) ::shutdown(native(m_socket), SD_BOTH);
+#else
+		if (isValid()) ::shutdown(native(m_socket), SHUT_RDWR);
+#endif
+	}
+
+	void CSocket::close(void)
+	{
+		if (isValid()) closeNative(native(m_socket));
+		m_socket = invalid;
+	}
+}
@@ -0,0 +1,113 @@
+// TCP socket class
+// Written by Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "types.h"
+
+namespace rt {
+	// ================================ Socket Class ================================
+	/**
+	 * @brief Minimal blocking TCP socket
+	 * @details This class wraps the BSD sockets (Winsock on Windows) and is used for the communication between the render coordinator and the render workers.
+	 * All the methods return a failure instead of throwing, so that a lost connection may be handled as a failed worker
+	 * @author Sergey G. Kosov, sergey.kosov@project-10.de
+	 */
+	class CSocket
+	{
+	public:
+		DllExport CSocket(void) = default;
+		DllExport CSocket(const CSocket&) = delete;
+		DllExport CSocket(CSocket&& other) noexcept : m_socket(other.m_socket) { other.m_socket = invalid; }
+		DllExport ~CSocket(void) { close(); }
+		DllExport const CSocket& operator=(const CSocket&) = delete;
+		DllExport CSocket& operator=(CSocket&& other) noexcept;
+
+		/**
+		 * @brief Creates a socket, listening for the incoming connections on all network interfaces
+		 * @param port The port number. If it is 0, a free port is chosen by the system (Ref. @ref getPort())
+		 * @return The listening socket, or an invalid socket if the port is not available
+		 */
+		DllExport static CSocket	listen(unsigned short port);
+		/**
+		 * @brief Connects to a listening socket
+		 * @param host The host name or address
+		 * @param port The port number
+		 * @return The connected socket, or an invalid socket if the connection failed
+		 */
+		DllExport static CSocket	connect(const std::string& host, unsigned short port);
+		/**
+		 * @brief Accepts an incoming connection
+		 * @param timeout The maximal waiting time in seconds
+		 * @return The connected socket, or an invalid socket if there were no incoming connections within \b timeout
+		 */
+		DllExport CSocket			accept(double timeout) const;
+		/**
+		 * @brief Sends a block of data
+		 * @param data Pointer to the data
+		 * @param size The size of the data in bytes
+		 * @retval true If all the data was sent
+		 * @retval false Otherwise
+		 */
+		DllExport bool				send(const void* data, size_t size) const;
+		/**
+		 * @brief Receives a block of data
+		 * @details This method blocks until \b size bytes are received, the connection is closed or the timeout expires (Ref. @ref setTimeout())
+		 * @param data Pointer to the buffer
+		 * @param size The size of the data in bytes
+		 * @retval true If all the data was received
+		 * @retval false Otherwise
+		 */
+		DllExport bool				recv(void* data, size_t size) const;
+		/**
+		 * @brief Sends a value of a trivially copyable type
+		 * @param value The value
+		 * @retval true If the value was sent
+		 * @retval false Otherwise
+		 */
+		template <typename T>
+		bool						send(const T& value) const { return send(&value, sizeof(T)); }
+		/**
+		 * @brief Receives a value of a trivially copyable type
+		 * @param[out] value The value
+		 * @retval true If the value was received
+		 * @retval false Otherwise
+		 */
+		template <typename T>
+		bool						recv(T& value) const { return recv(&value, sizeof(T)); }
+		/**
+		 * @brief Sets the timeout for the receiving operations
+		 * @param timeout The timeout in seconds, or 0 for waiting infinitely
+		 */
+		DllExport void				setTimeout(double timeout) const;
+		/**
+		 * @brief Returns the local port number of the socket
+		 * @return The port number
+		 */
+		DllExport unsigned short	getPort(void) const;
+		/**
+		 * @brief Checks whether the socket is valid
+		 * @retval true If the socket is open
+		 * @retval false Otherwise
+		 */
+		DllExport bool				isValid(void) const { return m_socket != invalid; }
+		/**
+		 * @brief Shuts the connection down
+		 * @details The blocking operations of other threads on this socket return with a failure. The socket remains valid until close() is called
+		 */
+		DllExport void				shutdown(void) const;
+		/**
+		 * @brief Closes the socket
+		 */
+		DllExport void				close(void);
+
+
+	private:
+		static constexpr std::intptr_t	invalid = -1;
+
+		explicit CSocket(std::intptr_t socket) : m_socket(socket) {}
+
+
+	private:
+		std::intptr_t	m_socket = invalid;		///< The native socket handle
+	};
+}
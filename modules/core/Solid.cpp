@@ -1,6 +1,7 @@
 #include "Solid.h"
 #include "PrimTriangle.h"
 #include "Transform.h"
+#include "Trace.h"
 #include <fstream> 
 #include <utility>
 
@@ -8,6 +9,7 @@ namespace rt {
 	// Constructor
 	CSolid::CSolid(ptr_shader_t pShader, const std::string& fileName) : m_pivot(Vec3f::all(0))
 	{
+		RT_TRACE_SCOPE("Parse OBJ", "io");
 		std::ifstream file(fileName);
 
 		if (file.is_open()) {
@@ -58,7 +60,7 @@ namespace rt {
 					//add(std::make_shared<CPrimTriangle>(pShader, vVertexes[V.val[0]], vVertexes[V.val[1]], vVertexes[V.val[2]]));
 					//add(std::make_shared<CPrimTriangleSmooth>(pShader,  vVertexes[V.val[0]], vVertexes[V.val[1]], vVertexes[V.val[2]],
 					//													vNormals[N.val[0]], vNormals[N.val[1]], vNormals[N.val[2]]));
-					add(std::make_shared<CPrimTriangle>(pShader, vVertexes[V.val[0]], vVertexes[V.val[1]], vVertexes[V.val[2]],
+					add(makeShared<CPrimTriangle>(pShader, vVertexes[V.val[0]], vVertexes[V.val[1]], vVertexes[V.val[2]],
 																 vTextures[T.val[0]], vTextures[T.val[1]], vTextures[T.val[2]],
 																 vNormals[N.val[0]], vNormals[N.val[1]], vNormals[N.val[2]]));
 	
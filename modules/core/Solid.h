@@ -3,6 +3,7 @@
 #pragma once
 
 #include "IPrim.h"
+#include "Arena.h"
 
 namespace rt {
 	// ================================ Solid Base Class ================================
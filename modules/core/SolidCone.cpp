@@ -45,14 +45,14 @@ namespace rt {
 			// Top Sides: triangles
 			if (height >= 0) {
 				if (smooth)
-					add(std::make_shared<CPrimTriangle>(pShader,
+					add(makeShared<CPrimTriangle>(pShader,
 						org + top,
 						p1 + h0 * (top - radius * dir1),
 						p0 + h0 * (top - radius * dir0),
 						Vec2f(0.5f, 0), Vec2f(t1, 1 - h0), Vec2f(t0, 1 - h0),
 						normalize(n0 + n1), n1, n0));
 				else
-					add(std::make_shared<CPrimTriangle>(pShader,
+					add(makeShared<CPrimTriangle>(pShader,
 						org + top,
 						p1 + h0 * (top - radius * dir1),
 						p0 + h0 * (top - radius * dir0),
@@ -60,14 +60,14 @@ namespace rt {
 			}
 			else {
 				if (smooth)
-					add(std::make_shared<CPrimTriangle>(pShader,
+					add(makeShared<CPrimTriangle>(pShader,
 						org + top,
 						p0 + h0 * (top - radius * dir0),
 						p1 + h0 * (top - radius * dir1),
 						Vec2f(0.5f, 0), Vec2f(t0, 1 - h0), Vec2f(t1, 1 - h0),
 						normalize(n0 + n1), n0, n1));
 				else
-					add(std::make_shared<CPrimTriangle>(pShader,
+					add(makeShared<CPrimTriangle>(pShader,
 						org + top,
 						p0 + h0 * (top - radius * dir0),
 						p1 + h0 * (top - radius * dir1),
@@ -75,8 +75,8 @@ namespace rt {
 			}
 
 			// Cap
-			if (height >= 0)	add(std::make_shared<CPrimTriangle>(pShader, org, p1, p0, Vec2f(0.5f, 1), Vec2f(t1, 1), Vec2f(t0, 1)));
-			else				add(std::make_shared<CPrimTriangle>(pShader, org, p0, p1, Vec2f(0.5f, 1), Vec2f(t0, 1), Vec2f(t1, 1)));
+			if (height >= 0)	add(makeShared<CPrimTriangle>(pShader, org, p1, p0, Vec2f(0.5f, 1), Vec2f(t1, 1), Vec2f(t0, 1)));
+			else				add(makeShared<CPrimTriangle>(pShader, org, p0, p1, Vec2f(0.5f, 1), Vec2f(t0, 1), Vec2f(t1, 1)));
 
 
 			dir0 = dir1;
@@ -18,8 +18,8 @@ namespace rt {
 		Vec2f tc(1, 1);
 		Vec2f td(0, 1);
 
-		add(std::make_shared<CPrimTriangle>(pShader, a, b, c, ta, tb, tc));
-		add(std::make_shared<CPrimTriangle>(pShader, a, c, d, ta, tc, td));
+		add(makeShared<CPrimTriangle>(pShader, a, b, c, ta, tb, tc));
+		add(makeShared<CPrimTriangle>(pShader, a, c, d, ta, tc, td));
 	}
 
 	// Constructor
@@ -29,7 +29,7 @@ namespace rt {
 		std::optional<Vec3f> na, std::optional<Vec3f> nb, std::optional<Vec3f> nc, std::optional<Vec3f> nd
 	) : CSolid(0.25f * (a + b + c + d))
 	{
-		add(std::make_shared<CPrimTriangle>(pShader, a, b, c, ta, tb, tc, na, nb, nc));
-		add(std::make_shared<CPrimTriangle>(pShader, a, c, d, ta, tc, td, na, nc, nd));
+		add(makeShared<CPrimTriangle>(pShader, a, b, c, ta, tb, tc, na, nb, nc));
+		add(makeShared<CPrimTriangle>(pShader, a, c, d, ta, tc, td, na, nc, nd));
 	}
 }
@@ -0,0 +1,73 @@
+#include "Stats.h"
+#include "macroses.h"
+
+namespace rt {
+	RayStats& RayStats::operator+=(const RayStats& other)
+	{
+		primaryRays		+= other.primaryRays;
+		shadowRays		+= other.shadowRays;
+		reflectionRays	+= other.reflectionRays;
+		refractionRays	+= other.refractionRays;
+		nodesVisited	+= other.nodesVisited;
+		leavesVisited	+= other.leavesVisited;
+		primitiveTests	+= other.primitiveTests;
+		mailboxHits		+= other.mailboxHits;
+		hits			+= other.hits;
+		shadingCalls	+= other.shadingCalls;
+		return *this;
+	}
+
+	RayStats& RayStats::operator-=(const RayStats& other)
+	{
+		primaryRays		-= other.primaryRays;
+		shadowRays		-= other.shadowRays;
+		reflectionRays	-= other.reflectionRays;
+		refractionRays	-= other.refractionRays;
+		nodesVisited	-= other.nodesVisited;
+		leavesVisited	-= other.leavesVisited;
+		primitiveTests	-= other.primitiveTests;
+		mailboxHits		-= other.mailboxHits;
+		hits			-= other.hits;
+		shadingCalls	-= other.shadingCalls;
+		return *this;
+	}
+
+	std::ostream& operator<<(std::ostream& os, const RayStats& stats)
+	{
+		const qword nRays = stats.primaryRays + stats.shadowRays + stats.reflectionRays + stats.refractionRays;
+		os << "Primary rays: "		<< stats.primaryRays	<< std::endl;
+		os << "Shadow rays: "		<< stats.shadowRays		<< std::endl;
+		os << "Reflection rays: "	<< stats.reflectionRays	<< std::endl;
+		os << "Refraction rays: "	<< stats.refractionRays	<< std::endl;
+		os << "Nodes visited: "		<< stats.nodesVisited	<< " (" << (nRays ? static_cast<double>(stats.nodesVisited) / nRays : 0) << " per ray)" << std::endl;
+		os << "Leaves visited: "	<< stats.leavesVisited	<< " (" << (nRays ? static_cast<double>(stats.leavesVisited) / nRays : 0) << " per ray)" << std::endl;
+		os << "Primitive tests: "	<< stats.primitiveTests	<< " (" << (nRays ? static_cast<double>(stats.primitiveTests) / nRays : 0) << " per ray)" << std::endl;
+		os << "Mailbox hits: "		<< stats.mailboxHits	<< " (" << (stats.primitiveTests + stats.mailboxHits ? 100.0 * stats.mailboxHits / (stats.primitiveTests + stats.mailboxHits) : 0) << "% of the tests skipped)" << std::endl;
+		os << "Hits: "				<< stats.hits			<< std::endl;
+		os << "Shading calls: "		<< stats.shadingCalls	<< std::endl;
+		return os;
+	}
+
+	Mat heatmap(const Mat& counts, int maxCount)
+	{
+		RT_ASSERT_MSG(counts.type() == CV_32SC1, "The counts must be of type CV_32SC1");
+		if (maxCount <= 0) 
+			for (int y = 0; y < counts.rows; y++)
+				for (int x = 0; x < counts.cols; x++)
+					maxCount = MAX(maxCount, counts.at<int>(y, x));
+		
+		// color stops, equally spaced between 0 and maxCount
+		const Vec3f stops[] = { RGB(0, 0, 0), RGB(0, 0, 1), RGB(0, 1, 1), RGB(0, 1, 0), RGB(1, 1, 0), RGB(1, 0, 0) };
+		const int nIntervals = sizeof(stops) / sizeof(stops[0]) - 1;
+
+		Mat res(counts.size(), CV_8UC3);
+		for (int y = 0; y < counts.rows; y++)
+			for (int x = 0; x < counts.cols; x++) {
+				float t = maxCount > 0 ? MIN(1.0f, MAX(0.0f, static_cast<float>(counts.at<int>(y, x)) / maxCount)) * nIntervals : 0;
+				int i = MIN(static_cast<int>(t), nIntervals - 1);
+				Vec3f color = stops[i] + (t - i) * (stops[i + 1] - stops[i]);
+				res.at<Vec3b>(y, x) = Vec3b(static_cast<byte>(255 * color[0] + 0.5f), static_cast<byte>(255 * color[1] + 0.5f), static_cast<byte>(255 * color[2] + 0.5f));
+			}
+		return res;
+	}
+}
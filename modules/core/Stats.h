@@ -0,0 +1,87 @@
+// Ray-tracing statistics
+// Written by Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "types.h"
+
+namespace rt {
+	/// Types of the rays
+	enum class RayType : byte {
+		Primary,		///< Camera ray
+		Shadow,			///< Occlusion test toward a light source
+		Reflection,		///< Secondary ray in the reflected direction
+		Refraction		///< Secondary ray in the refracted direction
+	};
+
+	// ================================ Ray Statistics Structure ================================
+	/**
+	 * @brief Ray-tracing statistics
+	 * @details The counters are collected only if ENABLE_STATS is on (Ref. @ref CScene::getStats())
+	 */
+	struct RayStats
+	{
+		qword	primaryRays		= 0;	///< Number of the camera rays
+		qword	shadowRays		= 0;	///< Number of the occlusion tests toward the light sources
+		qword	reflectionRays	= 0;	///< Number of the traced reflected rays
+		qword	refractionRays	= 0;	///< Number of the traced refracted rays
+		qword	nodesVisited	= 0;	///< Number of the visited BSP Tree nodes (including the leaves) per ray
+		qword	leavesVisited	= 0;	///< Number of the visited BSP Tree leaves per ray
+		qword	primitiveTests	= 0;	///< Number of the ray - primitive intersection tests
+		qword	mailboxHits		= 0;	///< Number of the redundant tests of the primitives, referenced by several BSP Tree leaves, which were skipped by mailboxing
+		qword	hits			= 0;	///< Number of the closest-hit queries, which hit a primitive
+		qword	shadingCalls	= 0;	///< Number of the shader calls
+
+		/**
+		 * @brief Adds the counters of \b other to this counters
+		 * @param other The statistics to be added
+		 * @return The reference to this statistics
+		 */
+		DllExport RayStats& operator+=(const RayStats& other);
+		/**
+		 * @brief Subtracts the counters of \b other from this counters
+		 * @param other The statistics to be subtracted, \a e.g. the counters at the beginning of a measurement
+		 * @return The reference to this statistics
+		 */
+		DllExport RayStats& operator-=(const RayStats& other);
+		DllExport friend std::ostream& operator<<(std::ostream& os, const RayStats& stats);
+	};
+
+	/**
+	 * @brief Visualizes a map of counts, e.g. the traversal costs of the pixels (Ref. @ref Aov::NodeCount), as a false-color image
+	 * @details The colors go from black for zero over blue, cyan, green and yellow to red for \b maxCount and above
+	 * @param counts The counts (type: CV_32SC1)
+	 * @param maxCount The count to be mapped to red. If it is 0, the maximal value of \b counts is used
+	 * @return The false-color image (type: CV_8UC3)
+	 */
+	DllExport Mat heatmap(const Mat& counts, int maxCount = 0);
+
+#ifdef ENABLE_STATS
+	/**
+	 * @brief Collection of the ray-tracing statistics
+	 * @details Every thread increments its own counters, so counting does not need any synchronization. The counters are never reset:
+	 * the statistics of a piece of work are the difference of the counters before and after it (Ref. @ref CScene::getStats())
+	 */
+	namespace stats {
+		/// The counters of the calling thread
+		inline thread_local RayStats local;
+
+		/**
+		 * @brief Returns the number of the set bits, e.g. the number of the active rays in a packet mask
+		 * @param mask The bit mask
+		 * @return The number of the set bits in \b mask
+		 */
+		inline qword		countBits(dword mask) 
+		{ 
+			qword res = 0;
+			for (; mask; mask &= mask - 1) res++;
+			return res;
+		}
+	}
+
+#define RT_STATS_INC(_counter_)				(++rt::stats::local._counter_)
+#define RT_STATS_ADD(_counter_, _value_)	(rt::stats::local._counter_ += (_value_))
+#else
+#define RT_STATS_INC(_counter_)				((void)0)
+#define RT_STATS_ADD(_counter_, _value_)	((void)0)
+#endif
+}
@@ -0,0 +1,82 @@
+// Decoding of the texels stored in compact formats
+// Written by Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "types.h"
+#include "macroses.h"
+
+namespace rt {
+	/**
+	 * @brief Function returning texel (\b x, \b y) of image \b img as a color
+	 * @details The 8-bit and 16-bit integer texels are normalized to [0; 1], the single-channel texels are replicated to all three color channels
+	 */
+	using texel_fetch_t = Vec3f(*)(const Mat& img, int x, int y);
+
+	/**
+	 * @brief Converts a 16-bit (half-precision) floating-point value to float
+	 * @param h The binary representation of the half-precision value
+	 * @return The single-precision value
+	 */
+	inline float halfToFloat(word h)
+	{
+		const dword sign = static_cast<dword>(h & 0x8000) << 16;
+		dword exponent = (h >> 10) & 0x1F;
+		dword mantissa = h & 0x3FF;
+		dword bits;
+		if (exponent == 0) {
+			if (mantissa == 0) bits = sign;
+			else {		// subnormal value is normalized
+				exponent = 127 - 15 + 1;
+				while (!(mantissa & 0x400)) {
+					mantissa <<= 1;
+					exponent--;
+				}
+				bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+			}
+		}
+		else if (exponent == 0x1F) bits = sign | 0x7F800000 | (mantissa << 13);
+		else bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+
+		float res;
+		memcpy(&res, &bits, sizeof(float));
+		return res;
+	}
+
+	namespace impl {
+		struct Unorm8	{ using type = byte;	static float decode(byte value) { return value * (1.0f / 255); } };
+		struct Unorm16	{ using type = word;	static float decode(word value) { return value * (1.0f / 65535); } };
+		struct Half		{ using type = word;	static float decode(word value) { return halfToFloat(value); } };
+		struct Float	{ using type = float;	static float decode(float value) { return value; } };
+
+		template <typename F, int CN>
+		Vec3f fetch(const Mat& img, int x, int y)
+		{
+			const typename F::type* pTexel = img.ptr<typename F::type>(y) + CN * x;
+			if constexpr (CN == 1) return Vec3f::all(F::decode(pTexel[0]));
+			else return Vec3f(F::decode(pTexel[0]), F::decode(pTexel[1]), F::decode(pTexel[2]));
+		}
+	}
+
+	/**
+	 * @brief Returns the texel fetch function for the images of type \b type
+	 * @details The function is specialized for the storage format, thus the format is resolved once per image and not once per texel
+	 * @param type The type of the image: one of CV_8UC1, CV_8UC3, CV_16UC1, CV_16UC3, CV_16FC1, CV_16FC3, CV_32FC1 or CV_32FC3
+	 * @return The texel fetch function
+	 */
+	inline texel_fetch_t getTexelFetch(int type)
+	{
+		switch (type) {
+			case CV_8UC1:	return impl::fetch<impl::Unorm8, 1>;
+			case CV_8UC3:	return impl::fetch<impl::Unorm8, 3>;
+			case CV_16UC1:	return impl::fetch<impl::Unorm16, 1>;
+			case CV_16UC3:	return impl::fetch<impl::Unorm16, 3>;
+			case CV_16FC1:	return impl::fetch<impl::Half, 1>;
+			case CV_16FC3:	return impl::fetch<impl::Half, 3>;
+			case CV_32FC1:	return impl::fetch<impl::Float, 1>;
+			case CV_32FC3:	return impl::fetch<impl::Float, 3>;
+			default:
+				RT_ASSERT_MSG(false, "Unsupported texel type %d", type);
+				return nullptr;
+		}
+	}
+}
@@ -1,10 +1,11 @@
 #include "Texture.h"
 #include "macroses.h"
+#include "digest.h"
 #include <math.h>
 
 namespace rt{
 	// Constructor
-	CTexture::CTexture(const std::string& fileName) : CTexture(imread(fileName))
+	CTexture::CTexture(const std::string& fileName) : CTexture(imread(fileName, IMREAD_ANYDEPTH | IMREAD_ANYCOLOR))
 	{
 		RT_ASSERT_MSG(!empty(), "Can't read file %s", fileName.c_str());
 	}
@@ -14,12 +15,32 @@ namespace rt{
 	CTexture::CTexture(const Mat& img) : Mat(img)
 	{
 		if (!empty()) {
-			RT_ASSERT_MSG(img.channels() == 3, "Can't create texture from %d-channels images. A 3-channels image is needed.", img.channels());
-			if (img.type() != CV_32FC3)
-				(*this).convertTo(*this, CV_32FC3, 1.0 / 255);
+			RT_ASSERT_MSG(img.channels() == 1 || img.channels() == 3, "Can't create texture from %d-channels images. A 1- or 3-channels image is needed.", img.channels());
+			const int depth = img.depth();
+			if (depth != CV_8U && depth != CV_16U && depth != CV_16F && depth != CV_32F)
+				(*this).convertTo(*this, CV_MAKETYPE(CV_32F, img.channels()));
+			m_fetch = getTexelFetch(type());
+			
+			// Mipmap pyramid: the levels are filtered in floating-point and stored in the format of the texture
+			Mat level;
+			(*this).convertTo(level, CV_MAKETYPE(CV_32F, channels()));
+			while (level.cols > 1 || level.rows > 1) {
+				Mat next;
+				resize(level, next, Size(MAX(1, level.cols / 2), MAX(1, level.rows / 2)), 0, 0, INTER_AREA);
+				m_vMipmaps.emplace_back();
+				next.convertTo(m_vMipmaps.back(), type());
+				level = next;
+			}
 		}
 	}
 
+	// Constructor
+	CTexture::CTexture(const std::string& fileName, const ptr_texture_cache_t& pCache) 
+		: Mat()
+		, m_pCache(pCache)
+		, m_id(pCache->add(fileName))
+	{}
+
 	Vec3f CTexture::getTexel(const Vec2f& uv) const
 	{
 		float t;
@@ -29,7 +50,8 @@ namespace rt{
 		if (u < 0) u += 1;
 		if (v < 0) v += 1;
 		
-		if (empty()) {	// Empty texture generates chess pattern
+		const std::vector<Size>& vLevelSizes = getLevelSizes();
+		if (vLevelSizes.empty()) {	// Empty texture generates chess pattern
 			bool ax = u < 0.5f ? true : false;
 			bool ay = v > 0.5f ? true : false;
 		
@@ -37,11 +59,83 @@ namespace rt{
 			return c ? Vec3f::all(1) : Vec3f::all(0);
 		} else {
 			// find texel indices
-			int x = static_cast<int>(cols * u);
-			int y = static_cast<int>(rows * v);
+			const Size size = vLevelSizes[0];
+			int x = MIN(static_cast<int>(size.width * u), size.width - 1);
+			int y = MIN(static_cast<int>(size.height * v), size.height - 1);
 
-			return (*this).at<Vec3f>(y, x);
+			return texel(0, x, y);
 		}
 	}
-}
 
+	Vec3f CTexture::getTexel(const Vec2f& uv, const Vec2f& dUVdx, const Vec2f& dUVdy) const
+	{
+		float t;
+		float u = modff(uv.val[0] + Epsilon, &t);
+		float v = modff(uv.val[1] + Epsilon, &t);
+
+		if (u < 0) u += 1;
+		if (v < 0) v += 1;
+		
+		const std::vector<Size>& vLevelSizes = getLevelSizes();
+		if (vLevelSizes.empty()) {	// Empty texture generates chess pattern
+			bool ax = u < 0.5f ? true : false;
+			bool ay = v > 0.5f ? true : false;
+		
+			bool c = ax ^ ay;
+			return c ? Vec3f::all(1) : Vec3f::all(0);
+		} else {
+			// the footprint of the pixel in texels of the full-resolution level
+			const Size size = vLevelSizes[0];
+			const float dx = static_cast<float>(norm(Vec2f(dUVdx.val[0] * size.width, dUVdx.val[1] * size.height)));
+			const float dy = static_cast<float>(norm(Vec2f(dUVdy.val[0] * size.width, dUVdy.val[1] * size.height)));
+			const float lod = MIN(log2f(MAX(MAX(dx, dy), 1.0f)), static_cast<float>(vLevelSizes.size() - 1));
+			
+			const size_t level = static_cast<size_t>(lod);
+			const float w = lod - level;
+			Vec3f res = bilinear(level, u, v);
+			if (w > 0) res = (1 - w) * res + w * bilinear(level + 1, u, v);
+			return res;
+		}
+	}
+
+	qword CTexture::getDigest(void) const
+	{
+		return m_pCache ? m_pCache->getDigest(m_id) : (CDigest() << static_cast<const Mat&>(*this)).get();
+	}
+
+	// ---------------------- private ----------------------
+	const std::vector<Size>& CTexture::getLevelSizes(void) const
+	{
+		std::call_once(m_levelSizesFlag, [this] {
+			if (m_pCache) m_vLevelSizes = m_pCache->getLevels(m_id);
+			else if (!empty())
+				for (size_t level = 0; level <= m_vMipmaps.size(); level++)
+					m_vLevelSizes.push_back(getLevel(level).size());
+		});
+		return m_vLevelSizes;
+	}
+
+	Vec3f CTexture::bilinear(size_t level, float u, float v) const
+	{
+		// the texel centers are at half-integer coordinates, the texture is repeated
+		const Size size = getLevelSizes()[level];
+		const float x = u * size.width - 0.5f;
+		const float y = v * size.height - 0.5f;
+		const float x0 = floorf(x);
+		const float y0 = floorf(y);
+		const float wx = x - x0;
+		const float wy = y - y0;
+		const int x1 = (static_cast<int>(x0) + size.width) % size.width;
+		const int y1 = (static_cast<int>(y0) + size.height) % size.height;
+		const int x2 = (x1 + 1) % size.width;
+		const int y2 = (y1 + 1) % size.height;
+
+		return (1 - wy) * ((1 - wx) * texel(level, x1, y1) + wx * texel(level, x2, y1)) 
+			 + wy * ((1 - wx) * texel(level, x1, y2) + wx * texel(level, x2, y2));
+	}
+
+	Vec3f CTexture::texel(size_t level, int x, int y) const
+	{
+		return m_pCache ? m_pCache->getTexel(m_id, level, x, y) : m_fetch(getLevel(level), x, y);
+	}
+}
@@ -3,11 +3,16 @@
 #pragma once
 
 #include "types.h"
+#include "TextureCache.h"
 
 namespace rt {
 	// ================================ Texture Class ================================
 	/**
 	 * @brief Texture class
+	 * @details The mipmap pyramid of the texture is generated at construction: every level halves the resolution of the previous one by box filtering, down to 1 x 1 texel.
+	 * The texels are filtered bilinearly within a level and trilinearly between the levels, where the level is chosen by the footprint of the pixel in the texture.
+	 * The texels are stored in the format of the image (8-bit, 16-bit, half- or single-precision floating-point; 1 or 3 channels) and are converted to colors at lookup (Ref. @ref getTexelFetch()).
+	 * A texture may be kept in a texture cache instead of the memory: then the tiles of the pyramid are paged in on demand (Ref. @ref CTextureCache)
 	 * @author Dr. Sergey G. Kosov, sergey.kosov@project-10.de
 	 */
 	class CTexture : public Mat {
@@ -18,24 +23,97 @@ namespace rt {
 		DllExport CTexture(void) : Mat() {}
 		/**
 		 * @brief Constructor
+		 * @details The bit depth and the number of channels of the file are preserved
 		 * @param fileName The path to the texture file
 		 */
 		DllExport CTexture(const std::string& fileName);
 		/**
 		 * @brief Constructor
-		 * @param img The texture image
+		 * @details The images of types CV_8U, CV_16U, CV_16F and CV_32F keep their format, the images of other depths are converted to CV_32F
+		 * @param img The texture image with 1 or 3 channels
 		 */
 		DllExport CTexture(const Mat& img);
+		/**
+		 * @brief Constructor
+		 * @details The texture is kept in the texture cache \b pCache, and the file is read only when the texture is used for the first time
+		 * @param fileName The path to the texture file
+		 * @param pCache Pointer to the texture cache
+		 */
+		DllExport CTexture(const std::string& fileName, const ptr_texture_cache_t& pCache);
 		DllExport CTexture(const CTexture&) = delete;
 		DllExport ~CTexture(void) = default;
 		DllExport const CTexture& operator=(const CTexture&) = delete;
 		
 		/**
 		 * @brief Returns the texture element with coordinates \b (uv)
+		 * @details The nearest texel of the full-resolution level is returned without filtering
 		 * @param uv The textel coordinates in the texture space, \f$ u,v\in [-1; 1 ] \f$
 		 * @return The texture elment (color)
 		 */
 		DllExport Vec3f getTexel(const Vec2f& uv) const;
+		/**
+		 * @brief Returns the texture element with coordinates \b (uv), filtered over the footprint of a pixel
+		 * @details The mipmap level is chosen by the longer derivative of the texture coordinates, and the texels of the two nearest levels are filtered trilinearly
+		 * @param uv The textel coordinates in the texture space, \f$ u,v\in [-1; 1 ] \f$
+		 * @param dUVdx The derivative of the texture coordinates with respect to the image x-coordinate (Ref. @ref IPrim::getTextureDifferentials())
+		 * @param dUVdy The derivative of the texture coordinates with respect to the image y-coordinate
+		 * @return The texture elment (color)
+		 */
+		DllExport Vec3f getTexel(const Vec2f& uv, const Vec2f& dUVdx, const Vec2f& dUVdy) const;
+		/**
+		 * @brief Returns the number of the mipmap levels
+		 * @return The number of the levels including the full-resolution one, or 0 for the empty texture
+		 */
+		DllExport size_t getNumLevels(void) const { return getLevelSizes().size(); }
+		/**
+		 * @brief Returns the mipmap level \b level
+		 * @note The levels of the textures kept in a texture cache are not available
+		 * @param level The index of the level, where 0 is the full-resolution level
+		 * @return The image of the level in the format of the texture
+		 */
+		DllExport const Mat& getLevel(size_t level) const { return level == 0 ? static_cast<const Mat&>(*this) : m_vMipmaps.at(level - 1); }
+		/**
+		 * @brief Returns the texture cache, which keeps the texture
+		 * @return The pointer to the texture cache, or nullptr if the texture is kept in memory
+		 */
+		DllExport ptr_texture_cache_t getCache(void) const { return m_pCache; }
+		/**
+		 * @brief Returns the digest of the texture
+		 * @return The 64-bit hash value of the texels, or of the file for the textures kept in a texture cache
+		 */
+		DllExport qword getDigest(void) const;
+
+	private:
+		/**
+		 * @brief Returns the resolutions of the mipmap levels
+		 * @return The resolutions of the levels, starting from the full-resolution level
+		 */
+		const std::vector<Size>& getLevelSizes(void) const;
+		/**
+		 * @brief Returns the bilinearly filtered texel of the mipmap level \b level
+		 * @param level The index of the level
+		 * @param u The u-coordinate, \f$ u\in [0; 1) \f$
+		 * @param v The v-coordinate, \f$ v\in [0; 1) \f$
+		 * @return The texture elment (color)
+		 */
+		Vec3f bilinear(size_t level, float u, float v) const;
+		/**
+		 * @brief Returns the texel (\b x, \b y) of the mipmap level \b level
+		 * @param level The index of the level
+		 * @param x The x-coordinate of the texel within the level
+		 * @param y The y-coordinate of the texel within the level
+		 * @return The texture elment (color)
+		 */
+		Vec3f texel(size_t level, int x, int y) const;
+
+
+	private:
+		std::vector<Mat>			m_vMipmaps;				///< The mipmap levels from the half resolution down to 1 x 1 texel
+		ptr_texture_cache_t			m_pCache	= nullptr;	///< The texture cache, which keeps the texture, or nullptr
+		size_t						m_id		= 0;		///< The index of the texture in the texture cache
+		mutable std::vector<Size>	m_vLevelSizes;			///< The resolutions of the mipmap levels
+		mutable std::once_flag		m_levelSizesFlag;		///< Flag for the lazy initialization of the resolutions
+		texel_fetch_t				m_fetch		= nullptr;	///< The decoding function of the texels kept in memory
 	};
 
 	using ptr_texture_t = std::shared_ptr<CTexture>;
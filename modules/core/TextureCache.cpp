@@ -0,0 +1,272 @@
+#include "TextureCache.h"
+#include "macroses.h"
+#include "digest.h"
+#include "Trace.h"
+#include "TexelFetch.h"
+#include <atomic>
+#include <filesystem>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace rt {
+	namespace {
+		/// Header of the tile file
+		struct Header {
+			int	width;			///< The width of the full-resolution level
+			int	height;			///< The height of the full-resolution level
+			int	tileSize;		///< The side of a tile in texels
+			int	format;			///< The storage format of the tiles
+		};
+
+		int getType(TileFormat format)
+		{
+			switch (format) {
+				case TileFormat::Float:	return CV_32FC3;
+				case TileFormat::Half:	return CV_16FC3;
+				default:				return CV_8UC3;
+			}
+		}
+
+		qword getTileKey(size_t id, size_t level, int tx, int ty)
+		{
+			return (static_cast<qword>(id) << 40) | (static_cast<qword>(level) << 32) | (static_cast<qword>(ty) << 16) | static_cast<qword>(tx);
+		}
+
+		std::atomic<qword> instanceCounter = 0;
+
+		/// The two tiles, which the calling thread has used last
+		template <typename TileData>
+		struct LastTiles {
+			struct Slot {
+				qword						key		= 0;
+				std::shared_ptr<TileData>	pData	= nullptr;
+			};
+			qword	instance	= 0;
+			Slot	slots[2];
+			size_t	mru			= 0;		///< The index of the most recently used slot
+		};
+	}
+
+	// Constructor
+	CTextureCache::CTextureCache(const std::string& path, size_t maxSize, int tileSize, TileFormat format)
+		: m_path(path)
+		, m_maxSize(maxSize)
+		, m_tileSize(tileSize)
+		, m_format(format)
+		, m_instance(++instanceCounter)
+		, m_fetch(getTexelFetch(getType(format)))
+	{
+		RT_ASSERT(tileSize > 0 && tileSize <= 0x10000);
+		std::error_code ec;
+		fs::create_directories(m_path, ec);
+		if (ec) RT_WARNING("Unable to create the texture cache folder \"%s\"", m_path.c_str());
+	}
+
+	size_t CTextureCache::add(const std::string& fileName)
+	{
+		std::error_code ec;
+		const auto size = fs::file_size(fileName, ec);
+		RT_ASSERT_MSG(!ec, "Can't read file %s", fileName.c_str());
+		const auto time = fs::last_write_time(fileName, ec).time_since_epoch().count();
+
+		auto pTexture = std::make_unique<Texture>();
+		pTexture->fileName = fileName;
+		pTexture->digest = (CDigest() << fileName << static_cast<qword>(size) << time).get();
+
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_vpTextures.push_back(std::move(pTexture));
+		return m_vpTextures.size() - 1;
+	}
+
+	std::vector<Size> CTextureCache::getLevels(size_t id)
+	{
+		return prepare(id).vLevels;
+	}
+
+	Vec3f CTextureCache::getTexel(size_t id, size_t level, int x, int y)
+	{
+		thread_local LastTiles<TileData> lastTiles;
+		if (lastTiles.instance != m_instance) lastTiles = { m_instance };
+
+		const int tx = x / m_tileSize;
+		const int ty = y / m_tileSize;
+		const qword key = getTileKey(id, level, tx, ty);
+		size_t index = 2;
+		for (size_t i = 0; i < 2; i++) {
+			auto& slot = lastTiles.slots[i];
+			if (slot.pData && slot.pData->evicted.load(std::memory_order_relaxed)) slot = {};		// release the evicted tile
+			if (slot.pData && slot.key == key) index = i;
+		}
+
+		if (index < 2) {
+			// mark the tile as used for the eviction, writing the stamp only when the clock has advanced
+			const qword clock = m_clock.load(std::memory_order_relaxed);
+			if (lastTiles.slots[index].pData->stamp.load(std::memory_order_relaxed) != clock) lastTiles.slots[index].pData->stamp.store(clock, std::memory_order_relaxed);
+		}
+		else {
+			index = lastTiles.mru ^ 1;
+			prepare(id);
+			std::lock_guard<std::mutex> lck(m_mutex);
+			lastTiles.slots[index] = { key, getTile(id, level, tx, ty) };
+		}
+		lastTiles.mru = index;
+
+		return m_fetch(lastTiles.slots[index].pData->data, x % m_tileSize, y % m_tileSize);
+	}
+
+	qword CTextureCache::getDigest(size_t id) const
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		return m_vpTextures.at(id)->digest;
+	}
+
+	void CTextureCache::setMaxSize(size_t maxSize)
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_maxSize = maxSize;
+		evict();
+	}
+
+	size_t CTextureCache::getSize(void) const
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		return m_size;
+	}
+
+	size_t CTextureCache::getNumReads(void) const
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		return m_nReads;
+	}
+
+	// ------------------------------------------------ Private ------------------------------------------------
+	CTextureCache::Texture& CTextureCache::prepare(size_t id)
+	{
+		Texture* pTexture;
+		{
+			std::lock_guard<std::mutex> lck(m_mutex);
+			pTexture = m_vpTextures.at(id).get();
+		}
+		
+		// The other threads wait only for the tiling of this texture, the cache stays unlocked
+		std::call_once(pTexture->prepared, [&] { createTiles(*pTexture); });
+		return *pTexture;
+	}
+
+	void CTextureCache::createTiles(Texture& texture) const
+	{
+		std::stringstream ss;
+		ss << std::hex << (CDigest() << texture.digest << m_tileSize << m_format).get() << ".tiles";
+		const fs::path path = fs::path(m_path) / ss.str();
+		const size_t tileBytes = static_cast<size_t>(m_tileSize) * m_tileSize * CV_ELEM_SIZE(getType(m_format));
+
+		auto computeLevels = [&](Size size) {
+			texture.vLevels.clear();
+			texture.vOffsets.clear();
+			size_t nTiles = 0;
+			for (;;) {
+				texture.vLevels.push_back(size);
+				texture.vOffsets.push_back(nTiles);
+				nTiles += static_cast<size_t>((size.width + m_tileSize - 1) / m_tileSize) * ((size.height + m_tileSize - 1) / m_tileSize);
+				if (size.width == 1 && size.height == 1) break;
+				size = Size(MAX(1, size.width / 2), MAX(1, size.height / 2));
+			}
+			return sizeof(Header) + nTiles * tileBytes;
+		};
+
+		// The tile file of the previous sessions
+		texture.file.open(path, std::ios::binary);
+		Header header;
+		if (texture.file.read(reinterpret_cast<char*>(&header), sizeof(Header)) && header.tileSize == m_tileSize && header.format == static_cast<int>(m_format)) {
+			std::error_code ec;
+			if (computeLevels(Size(header.width, header.height)) == fs::file_size(path, ec)) return;
+		}
+		texture.file.close();
+
+		// Split the mipmap pyramid into tiles
+		RT_TRACE_SCOPE("Tile texture", "io");
+		Mat img = imread(texture.fileName, IMREAD_ANYDEPTH | IMREAD_ANYCOLOR);
+		RT_ASSERT_MSG(!img.empty(), "Can't read file %s", texture.fileName.c_str());
+		img.convertTo(img, CV_MAKETYPE(CV_32F, img.channels()), img.depth() == CV_8U ? 1.0 / 255 : img.depth() == CV_16U ? 1.0 / 65535 : 1.0);
+		if (img.channels() == 1) cvtColor(img, img, COLOR_GRAY2BGR);
+		computeLevels(img.size());
+		header = { img.cols, img.rows, m_tileSize, static_cast<int>(m_format) };
+		{
+			std::ofstream file(path, std::ios::binary);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+			Mat tile(m_tileSize, m_tileSize, CV_32FC3);
+			Mat stored;
+			for (size_t level = 0; level < texture.vLevels.size(); level++) {
+				if (level > 0) {
+					Mat next;
+					resize(img, next, texture.vLevels[level], 0, 0, INTER_AREA);
+					img = next;
+				}
+				for (int y = 0; y < img.rows; y += m_tileSize)
+					for (int x = 0; x < img.cols; x += m_tileSize) {
+						const Rect roi = Rect(x, y, m_tileSize, m_tileSize) & Rect(0, 0, img.cols, img.rows);
+						tile.setTo(Scalar::all(0));
+						img(roi).copyTo(tile(Rect(0, 0, roi.width, roi.height)));
+						tile.convertTo(stored, getType(m_format), m_format == TileFormat::Byte ? 255 : 1);
+						file.write(reinterpret_cast<const char*>(stored.data), tileBytes);
+					}
+			}
+			RT_ASSERT_MSG(file.good(), "Can't write file %s", path.string().c_str());
+		}
+		texture.file.open(path, std::ios::binary);
+	}
+
+	std::shared_ptr<CTextureCache::TileData> CTextureCache::getTile(size_t id, size_t level, int tx, int ty)
+	{
+		const qword clock = ++m_clock;
+		const qword key = getTileKey(id, level, tx, ty);
+		auto it = m_tiles.find(key);
+		if (it != m_tiles.end()) {
+			m_lru.splice(m_lru.begin(), m_lru, it->second.itLru);
+			it->second.stamp = clock;
+			it->second.pData->stamp.store(clock, std::memory_order_relaxed);
+			return it->second.pData;
+		}
+
+		// Page the tile in from the tile file, the texture has been prepared by the caller
+		Texture& texture = *m_vpTextures.at(id);
+		const int nTilesX = (texture.vLevels.at(level).width + m_tileSize - 1) / m_tileSize;
+		auto pData = std::make_shared<TileData>();
+		pData->data.create(m_tileSize, m_tileSize, getType(m_format));
+		pData->stamp.store(clock, std::memory_order_relaxed);
+		const size_t tileBytes = pData->data.total() * pData->data.elemSize();
+		texture.file.clear();
+		texture.file.seekg(sizeof(Header) + (texture.vOffsets[level] + static_cast<size_t>(ty) * nTilesX + tx) * tileBytes);
+		texture.file.read(reinterpret_cast<char*>(pData->data.data), tileBytes);
+		RT_ASSERT_MSG(texture.file.good(), "Can't read the tiles of file %s", texture.fileName.c_str());
+		m_nReads++;
+
+		m_lru.push_front(key);
+		m_tiles[key] = { pData, m_lru.begin(), clock };
+		m_size += tileBytes;
+		evict();
+		return pData;
+	}
+
+	void CTextureCache::evict(void)
+	{
+		// The most recently used tile is kept even if it exceeds the limit alone
+		while (m_size > m_maxSize && m_lru.size() > 1) {
+			auto it = m_tiles.find(m_lru.back());
+			
+			// The tile, used by a thread without locking the cache since it was moved to the front of the list, gets a second chance
+			const qword stamp = it->second.pData->stamp.load(std::memory_order_relaxed);
+			if (stamp > it->second.stamp) {
+				it->second.stamp = stamp;
+				m_lru.splice(m_lru.begin(), m_lru, it->second.itLru);
+				continue;
+			}
+			
+			it->second.pData->evicted.store(true, std::memory_order_relaxed);
+			m_size -= it->second.pData->data.total() * it->second.pData->data.elemSize();
+			m_tiles.erase(it);
+			m_lru.pop_back();
+		}
+	}
+}
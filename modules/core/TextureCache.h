@@ -0,0 +1,147 @@
+// Texture cache class
+// Written by Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "types.h"
+#include "TexelFetch.h"
+#include <atomic>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace rt {
+	/// Storage formats of the texture tiles
+	enum class TileFormat {
+		Float,			///< 32-bit floating-point texels (12 bytes per texel)
+		Half,			///< 16-bit floating-point texels (6 bytes per texel)
+		Byte			///< 8-bit texels (3 bytes per texel)
+	};
+
+	// ================================ Texture Cache Class ================================
+	/**
+	 * @brief Cache of the tiled textures with a memory limit
+	 * @details A texture file, added to the cache, is not read until its first texel is requested. Then the image is read once, its mipmap pyramid is split into
+	 * square tiles, and the tiles are written into a tile file in the cache folder, where they are found by the next sessions as long as the image file is not changed.
+	 * The tiles are paged in from the tile file on demand, and the least recently used tiles are evicted, when the total size of the tiles in memory exceeds the limit.
+	 * Every thread remembers the two tiles it has used last, thus the neighbouring lookups and the bilinear taps across a tile border do not lock the cache.
+	 * Such lookups mark the tile as used with an atomic stamp, and the eviction gives the marked tiles a second chance. A thread releases the evicted tiles,
+	 * which it remembers, at its next lookup. The images are read and tiled without locking the cache, once per texture.
+	 * > This class is thread-safe
+	 * @author Sergey G. Kosov, sergey.kosov@project-10.de
+	 */
+	class CTextureCache
+	{
+	public:
+		/**
+		 * @brief Constructor
+		 * @param path The path to the folder for the tile files
+		 * @param maxSize The maximal size of the tiles in memory in bytes
+		 * @param tileSize The side of a tile in texels
+		 * @param format The storage format of the tiles
+		 */
+		DllExport CTextureCache(const std::string& path = "texture_cache", size_t maxSize = 256 * 1024 * 1024, int tileSize = 64, TileFormat format = TileFormat::Byte);
+		DllExport CTextureCache(const CTextureCache&) = delete;
+		DllExport ~CTextureCache(void) = default;
+		DllExport const CTextureCache& operator=(const CTextureCache&) = delete;
+
+		/**
+		 * @brief Adds a texture file to the cache
+		 * @details The file is not read until the texture is used
+		 * @param fileName The path to the image file
+		 * @return The index of the texture in the cache
+		 */
+		DllExport size_t	add(const std::string& fileName);
+		/**
+		 * @brief Returns the resolutions of the mipmap levels of texture \b id
+		 * @details If the texture has not been used yet, it is loaded and tiled
+		 * @param id The index of the texture
+		 * @return The resolutions of the levels, starting from the full-resolution level
+		 */
+		DllExport std::vector<Size>	getLevels(size_t id);
+		/**
+		 * @brief Returns the texel of texture \b id
+		 * @param id The index of the texture
+		 * @param level The index of the mipmap level
+		 * @param x The x-coordinate of the texel within the level
+		 * @param y The y-coordinate of the texel within the level
+		 * @return The texel (color)
+		 */
+		DllExport Vec3f		getTexel(size_t id, size_t level, int x, int y);
+		/**
+		 * @brief Returns the digest of texture \b id
+		 * @details The digest accounts for the path, the size and the modification time of the image file
+		 * @param id The index of the texture
+		 * @return The 64-bit hash value of the texture
+		 */
+		DllExport qword		getDigest(size_t id) const;
+		/**
+		 * @brief Sets the maximal size of the tiles in memory
+		 * @details If the current size exceeds the new limit, the least recently used tiles are evicted
+		 * @param maxSize The maximal size in bytes
+		 */
+		DllExport void		setMaxSize(size_t maxSize);
+		/**
+		 * @brief Returns the maximal size of the tiles in memory
+		 * @return The maximal size in bytes
+		 */
+		DllExport size_t	getMaxSize(void) const { return m_maxSize; }
+		/**
+		 * @brief Returns the current size of the tiles in memory
+		 * @return The total size of the tiles in bytes
+		 */
+		DllExport size_t	getSize(void) const;
+		/**
+		 * @brief Returns the number of the tiles read from the tile files
+		 * @return The number of the tile misses since the creation of the cache
+		 */
+		DllExport size_t	getNumReads(void) const;
+
+
+	private:
+		/// Tiled texture
+		struct Texture {
+			std::string			fileName;			///< The path to the image file
+			qword				digest;				///< The digest of the image file
+			std::vector<Size>	vLevels;			///< The resolutions of the mipmap levels, or empty if the texture is not tiled yet
+			std::vector<size_t>	vOffsets;			///< The indices of the first tile of every level in the tile file
+			std::ifstream		file;				///< The tile file
+			std::once_flag		prepared;			///< Flag for the one-time tiling of the image
+		};
+		/// Texels of a tile, shared with the threads
+		struct TileData {
+			Mat					data;				///< The texels of the tile
+			std::atomic<qword>	stamp	= 0;		///< The value of the clock at the last use of the tile
+			std::atomic<bool>	evicted = false;	///< Flag indicating whether the tile has been evicted from the cache
+		};
+		/// Tile in memory
+		struct Tile {
+			std::shared_ptr<TileData>	pData;		///< The texels of the tile
+			std::list<qword>::iterator	itLru;		///< The position of the tile in the LRU list
+			qword						stamp;		///< The value of the clock, when the tile was moved to the front of the LRU list
+		};
+
+		Texture&					prepare(size_t id);
+		void						createTiles(Texture& texture) const;
+		std::shared_ptr<TileData>	getTile(size_t id, size_t level, int tx, int ty);
+		void						evict(void);
+
+
+	private:
+		const std::string						m_path;					///< The path to the folder for the tile files
+		size_t									m_maxSize;				///< The maximal size of the tiles in memory in bytes
+		const int								m_tileSize;				///< The side of a tile in texels
+		const TileFormat						m_format;				///< The storage format of the tiles
+		const qword								m_instance;				///< The unique index of the cache, distinguishing the tiles remembered by the threads
+		const texel_fetch_t						m_fetch;				///< The decoding function of the tile texels
+		size_t									m_size		= 0;		///< The current size of the tiles in memory in bytes
+		size_t									m_nReads	= 0;		///< The number of the tiles read from the tile files
+		std::vector<std::unique_ptr<Texture>>	m_vpTextures;			///< The textures
+		std::unordered_map<qword, Tile>			m_tiles;				///< The tiles in memory
+		std::list<qword>						m_lru;					///< The keys of the tiles in memory, the most recently used first
+		std::atomic<qword>						m_clock		= 0;		///< The clock of the tile stamps, which advances at every lookup under the lock
+		mutable std::mutex						m_mutex;				///< Mutex guarding the members
+	};
+
+	using ptr_texture_cache_t = std::shared_ptr<CTextureCache>;
+}
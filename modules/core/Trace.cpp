@@ -0,0 +1,119 @@
+#include "Trace.h"
+
+#ifdef ENABLE_TRACE
+#include "macroses.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+
+namespace rt {
+	namespace trace {
+		namespace {
+			struct Event {
+				const char*	name;
+				const char*	category;
+				double		start;		// microseconds since the start of recording
+				double		duration;	// microseconds
+				dword		tid;
+			};
+
+			std::mutex							mtx;
+			std::atomic<bool>					recording = false;
+			std::atomic<std::chrono::steady_clock::rep> origin = 0;	// start of recording in the ticks of the steady clock
+			std::vector<Event>					retired;		// events of the finished threads
+			dword								nThreads = 0;
+
+			// Events of one thread, which are accessible for start() and stop() for the lifetime of the thread.
+			// The buffer has its own mutex, which is contended only while start() or stop() runs
+			struct ThreadEvents {
+				ThreadEvents(void)
+				{
+					std::lock_guard<std::mutex> lck(mtx);
+					tid = ++nThreads;
+					vThreads.push_back(this);
+				}
+				~ThreadEvents(void)
+				{
+					std::lock_guard<std::mutex> lck(mtx);
+					std::lock_guard<std::mutex> lckEvents(mtxEvents);
+					retired.insert(retired.end(), vEvents.begin(), vEvents.end());
+					vThreads.erase(std::find(vThreads.begin(), vThreads.end(), this));
+				}
+
+				dword								tid;
+				std::vector<Event>					vEvents;
+				std::mutex							mtxEvents;		// guards vEvents
+				static std::vector<ThreadEvents*>	vThreads;
+			};
+			std::vector<ThreadEvents*> ThreadEvents::vThreads;
+
+			thread_local ThreadEvents local;
+
+			double now(void)
+			{
+				return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch() - std::chrono::steady_clock::duration(origin)).count();
+			}
+		}
+
+		void start(void)
+		{
+			std::lock_guard<std::mutex> lck(mtx);
+			retired.clear();
+			for (auto pThread : ThreadEvents::vThreads) {
+				std::lock_guard<std::mutex> lckEvents(pThread->mtxEvents);
+				pThread->vEvents.clear();
+			}
+			origin = std::chrono::steady_clock::now().time_since_epoch().count();
+			recording = true;
+		}
+
+		bool stop(const std::string& fileName)
+		{
+			recording = false;
+			std::lock_guard<std::mutex> lck(mtx);
+			std::vector<Event> vEvents = retired;
+			for (auto pThread : ThreadEvents::vThreads) {
+				std::lock_guard<std::mutex> lckEvents(pThread->mtxEvents);
+				vEvents.insert(vEvents.end(), pThread->vEvents.begin(), pThread->vEvents.end());
+			}
+			std::sort(vEvents.begin(), vEvents.end(), [](const Event& a, const Event& b) { return a.start < b.start; });
+
+			std::ofstream file(fileName);
+			if (!file) {
+				RT_WARNING("Unable to write the trace file %s", fileName.c_str());
+				return false;
+			}
+			file << std::fixed << std::setprecision(3);
+			file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+			for (size_t i = 0; i < vEvents.size(); i++) {
+				const Event& event = vEvents[i];
+				file << "{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"ts\":" << event.start
+					 << ",\"dur\":" << event.duration << ",\"pid\":1,\"tid\":" << event.tid << "}" << (i + 1 < vEvents.size() ? "," : "") << std::endl;
+			}
+			file << "]}" << std::endl;
+			return file.good();
+		}
+
+		bool isRecording(void)
+		{
+			return recording;
+		}
+
+		CScope::CScope(const char* name, const char* category)
+			: m_name(name)
+			, m_category(category)
+			, m_start(recording ? now() : -1)
+		{}
+
+		CScope::~CScope(void)
+		{
+			if (m_start < 0 || !recording) return;
+			std::lock_guard<std::mutex> lck(local.mtxEvents);
+			local.vEvents.push_back({ m_name, m_category, m_start, now() - m_start, local.tid });
+		}
+	}
+}
+#endif
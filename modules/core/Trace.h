@@ -0,0 +1,64 @@
+// Timeline tracing
+// Written by Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "types.h"
+
+#ifdef ENABLE_TRACE
+namespace rt {
+	/**
+	 * @brief Timeline tracing of the render phases
+	 * @details The scoped events, e.g. parsing, building of the BSP Tree, rendering of the image rows or writing of the cache, are recorded with the thread ids and timestamps
+	 * and written in the Chrome trace event format, which may be viewed in chrome://tracing or https://ui.perfetto.dev. Every thread records its events into its own buffer,
+	 * which is guarded by its own mutex, so the threads do not contend with each other and start() or stop() may be called while other threads are recording. If the recording is not started, a scoped event costs only a check of a flag
+	 */
+	namespace trace {
+		/**
+		 * @brief Discards the previously recorded events and starts recording
+		 */
+		DllExport void	start(void);
+		/**
+		 * @brief Stops recording and writes the recorded events into a Chrome trace JSON file
+		 * @param fileName The name of the file
+		 * @retval true If the file was written
+		 * @retval false Otherwise
+		 */
+		DllExport bool	stop(const std::string& fileName);
+		/**
+		 * @brief Checks whether the events are being recorded
+		 * @retval true If start() was called and stop() was not called yet
+		 * @retval false Otherwise
+		 */
+		DllExport bool	isRecording(void);
+
+		// ================================ Scope Class ================================
+		/**
+		 * @brief Scoped event, which lasts from the construction to the destruction of the object
+		 * @note Use RT_TRACE_SCOPE macro instead of this class
+		 */
+		class CScope {
+		public:
+			/**
+			 * @brief Constructor
+			 * @param name The name of the event. It must be a string literal
+			 * @param category The category of the event. It must be a string literal
+			 */
+			DllExport CScope(const char* name, const char* category);
+			DllExport ~CScope(void);
+			CScope(const CScope&) = delete;
+			const CScope& operator=(const CScope&) = delete;
+
+		private:
+			const char*	m_name;
+			const char*	m_category;
+			double		m_start;		///< Start time in microseconds, or a negative value if the event is not recorded
+		};
+	}
+}
+
+#define RT_TRACE_CONCAT_(_a_, _b_)				_a_##_b_
+#define RT_TRACE_CONCAT(_a_, _b_)				RT_TRACE_CONCAT_(_a_, _b_)
+#define RT_TRACE_SCOPE(_name_, _category_)		rt::trace::CScope RT_TRACE_CONCAT(traceScope, __LINE__)(_name_, _category_)
+#else
+#define RT_TRACE_SCOPE(_name_, _category_)
+#endif
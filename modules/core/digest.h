@@ -0,0 +1,86 @@
+// Content digest
+// Written by Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "types.h"
+#include <typeinfo>
+
+namespace rt {
+	// ================================ Digest Class ==============================
+	/**
+	* @brief 64-bit FNV-1a content digest
+	* @details This class accumulates the binary representation of values into a 64-bit hash value.
+	* It is used for addressing the render results by the content of the scene
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CDigest
+	{
+	public:
+		CDigest(void) = default;
+		~CDigest(void) = default;
+
+		/**
+		* @brief Adds a block of memory to the digest
+		* @param data Pointer to the memory block
+		* @param size The size of the memory block in bytes
+		* @return The reference to this digest
+		*/
+		CDigest& add(const void* data, size_t size)
+		{
+			const byte* pData = static_cast<const byte*>(data);
+			for (size_t i = 0; i < size; i++) {
+				m_value ^= pData[i];
+				m_value *= 0x100000001b3ULL;
+			}
+			return *this;
+		}
+		/**
+		* @brief Adds a value of a trivially copyable type to the digest
+		* @tparam T A trivially copyable type: arithmetic types or OpenCV vectors like \a Vec3f
+		* @param value The value
+		* @return The reference to this digest
+		*/
+		template <typename T>
+		CDigest& operator<<(const T& value) { return add(&value, sizeof(T)); }
+		/**
+		* @brief Adds a string to the digest
+		* @param str The string
+		* @return The reference to this digest
+		*/
+		CDigest& operator<<(const std::string& str) { return add(str.data(), str.size()); }
+		/**
+		* @brief Adds a string to the digest
+		* @param str The null-terminated string
+		* @return The reference to this digest
+		*/
+		CDigest& operator<<(const char* str) { return add(str, strlen(str)); }
+		/**
+		* @brief Adds an optional value to the digest
+		* @param value The optional value
+		* @return The reference to this digest
+		*/
+		template <typename T>
+		CDigest& operator<<(const std::optional<T>& value) { return value ? (*this << true << value.value()) : (*this << false); }
+		/**
+		* @brief Adds the size, type and the content of a matrix to the digest
+		* @param mat The matrix
+		* @return The reference to this digest
+		*/
+		CDigest& operator<<(const Mat& mat)
+		{
+			*this << mat.rows << mat.cols << mat.type();
+			for (int y = 0; y < mat.rows; y++)
+				add(mat.ptr(y), mat.cols * mat.elemSize());
+			return *this;
+		}
+		/**
+		* @brief Returns the digest value
+		* @return The digest value
+		*/
+		qword get(void) const { return m_value; }
+
+
+	private:
+		qword m_value = 0xcbf29ce484222325ULL;	///< The current hash value
+	};
+}
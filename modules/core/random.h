@@ -14,6 +14,35 @@ namespace rt {
 	* @author Sergey G. Kosov, sergey.kosov@project-10.de
 	*/
 	namespace random {
+		/**
+		* @brief Returns the random number generator of the calling thread
+		* @details The generator is seeded with the current time and thread id, unless it is re-seeded with seed() method
+		* @return The reference to the generator
+		*/
+		inline std::mt19937& generator(void)
+		{
+			static thread_local std::mt19937 generator(static_cast<unsigned int>(clock() + std::hash<std::thread::id>()(std::this_thread::get_id())));
+			return generator;
+		}
+		/**
+		* @brief Returns the OpenCV random number generator of the calling thread
+		* @return The reference to the generator
+		*/
+		inline RNG& rng(void)
+		{
+			static thread_local RNG rng(static_cast<unsigned int>(clock() + std::hash<std::thread::id>()(std::this_thread::get_id())));
+			return rng;
+		}
+		/**
+		* @brief Re-seeds the random number generators of the calling thread
+		* @details After re-seeding with the same value the generators produce the same sequence of random numbers, which makes the rendering reproducible
+		* @param value The seed value
+		*/
+		inline void seed(qword value)
+		{
+			generator().seed(static_cast<std::mt19937::result_type>(value ^ (value >> 32)));
+			rng() = RNG(value);
+		}
 		/**
 		* @brief Returns an integer random number with uniform distribution
 		* @details This function produces random integer values \a i, uniformly distributed on the closed interval [\b min, \b max], that is, distributed according to the discrete probability function:
@@ -27,9 +56,8 @@ namespace rt {
 		template <typename T>
 		inline T u(T min, T max)
 		{
-			static thread_local std::mt19937 generator(static_cast<unsigned int>(clock() + std::hash<std::thread::id>()(std::this_thread::get_id())));
 			std::uniform_int_distribution<T> distribution(min, max);
-			return distribution(generator);
+			return distribution(generator());
 		}
 		/**
 		* @brief Returns a floating-point random number with uniform distribution
@@ -44,9 +72,8 @@ namespace rt {
 		template <typename T>
 		inline T U(T min = 0, T max = 1)
 		{
-			static thread_local std::mt19937 generator(static_cast<unsigned int>(clock() + std::hash<std::thread::id>()(std::this_thread::get_id())));
 			std::uniform_real_distribution<T> distribution(min, max);
-			return distribution(generator);
+			return distribution(generator());
 		}
 		/**
 		* @brief Returns a floating-point random number with normal distribution
@@ -61,9 +88,8 @@ namespace rt {
 		template <typename T>
 		inline T N(T mu = 0, T sigma = 1)
 		{
-			static thread_local std::mt19937 generator(static_cast<unsigned int>(clock() + std::hash<std::thread::id>()(std::this_thread::get_id())));
 			std::normal_distribution<T> distribution(mu, sigma);
-			return distribution(generator);
+			return distribution(generator());
 		}
 
 
@@ -77,9 +103,8 @@ namespace rt {
 		*/
 		inline Mat U(cv::Size size, int type, double min = 0, double max = 1)
 		{
-			static thread_local RNG rng(static_cast<unsigned int>(clock() + std::hash<std::thread::id>()(std::this_thread::get_id())));
 			Mat res(size, type);
-			rng.fill(res, RNG::UNIFORM, min, max);
+			rng().fill(res, RNG::UNIFORM, min, max);
 			return res;
 		}
 		/**
@@ -92,9 +117,8 @@ namespace rt {
 		*/
 		inline Mat N(cv::Size size, int type, double mu = 0, double sigma = 1)
 		{
-			static thread_local RNG rng(static_cast<unsigned int>(clock() + std::hash<std::thread::id>()(std::this_thread::get_id())));
 			Mat res(size, type);
-			rng.fill(res, RNG::NORMAL, mu, sigma);
+			rng().fill(res, RNG::NORMAL, mu, sigma);
 			return res;
 		}
 
@@ -0,0 +1,46 @@
+// Binary serialization of matrices
+// Written by Sergey G. Kosov in 2019 for Project X
+#pragma once
+
+#include "types.h"
+#include <iostream>
+
+namespace rt {
+	// ================================ Serialization Namespace ==============================
+	/**
+	* @brief Binary serialization of matrices
+	* @details The matrix is stored as its number of rows, number of columns and type (as 32-bit integers), followed by the raw elements, row by row
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	namespace serialize {
+		/**
+		* @brief Writes a matrix to a binary stream
+		* @param stream The output stream
+		* @param mat The matrix
+		* @return The number of bytes written
+		*/
+		inline size_t writeMat(std::ostream& stream, const Mat& mat)
+		{
+			const int header[3] = { mat.rows, mat.cols, mat.type() };
+			stream.write(reinterpret_cast<const char*>(header), sizeof(header));
+			for (int y = 0; y < mat.rows; y++)
+				stream.write(reinterpret_cast<const char*>(mat.ptr(y)), mat.cols * mat.elemSize());
+			return sizeof(header) + mat.total() * mat.elemSize();
+		}
+		/**
+		* @brief Reads a matrix from a binary stream
+		* @param stream The input stream
+		* @return The matrix, or an empty matrix if the stream is corrupted
+		*/
+		inline Mat readMat(std::istream& stream)
+		{
+			int header[3];
+			if (!stream.read(reinterpret_cast<char*>(header), sizeof(header))) return Mat();
+			if (header[0] <= 0 || header[1] <= 0) return Mat();
+			Mat res(header[0], header[1], header[2]);
+			for (int y = 0; y < res.rows; y++)
+				if (!stream.read(reinterpret_cast<char*>(res.ptr(y)), res.cols * res.elemSize())) return Mat();
+			return res;
+		}
+	}
+}
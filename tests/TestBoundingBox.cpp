@@ -26,3 +26,46 @@ TEST_F(CTestBoundingBox, solid_sphere) {
     EXPECT_NEAR(boxCenter[1], 0, Epsilon);
     EXPECT_NEAR(boxCenter[2], 0, Epsilon);
 }
+
+TEST_F(CTestBoundingBox, clip) {
+    CBoundingBox box(Vec3f(0, 0, 0), Vec3f(1, 1, 1));
+    EXPECT_TRUE(CBoundingBox().isEmpty());
+    EXPECT_FALSE(box.isEmpty());
+
+    CBoundingBox clipped = box.clip(CBoundingBox(Vec3f(0.5f, -1, 0.25f), Vec3f(2, 0.5f, 0.75f)));
+    EXPECT_EQ(clipped.getMinPoint(), Vec3f(0.5f, 0, 0.25f));
+    EXPECT_EQ(clipped.getMaxPoint(), Vec3f(1, 0.5f, 0.75f));
+    EXPECT_TRUE(box.clip(CBoundingBox(Vec3f(2, 2, 2), Vec3f(3, 3, 3))).isEmpty());
+    EXPECT_TRUE(box.clip(CBoundingBox(Vec3f(1.001f, 0, 0), Vec3f(2, 1, 1))).isEmpty());
+    
+    // The touching boxes result in a flat box
+    clipped = box.clip(CBoundingBox(Vec3f(1, 0, 0), Vec3f(2, 1, 1)));
+    EXPECT_FALSE(clipped.isEmpty());
+    EXPECT_EQ(clipped.getMinPoint()[0], clipped.getMaxPoint()[0]);
+}
+
+TEST_F(CTestBoundingBox, triangle_clipping) {
+    // A long diagonal triangle, whose bounding box is much larger than the triangle
+    CPrimTriangle triangle(std::make_shared<CShaderFlat>(RGB(1, 1, 1)), Vec3f(0, 0, 0), Vec3f(10, 10, 0), Vec3f(10, 10.5f, 0));
+
+    // The box overlaps the bounding box, but not the triangle
+    CBoundingBox box(Vec3f(8, 0, -1), Vec3f(9, 1, 1));
+    EXPECT_TRUE(box.overlaps(triangle.getBoundingBox()));
+    EXPECT_TRUE(triangle.getClippedBoundingBox(box).isEmpty());
+
+    // The box crosses the triangle
+    box = CBoundingBox(Vec3f(4, 0, -1), Vec3f(6, 10, 1));
+    CBoundingBox clipped = triangle.getClippedBoundingBox(box);
+    ASSERT_FALSE(clipped.isEmpty());
+    EXPECT_NEAR(clipped.getMinPoint()[0], 4, Epsilon);
+    EXPECT_NEAR(clipped.getMaxPoint()[0], 6, Epsilon);
+    EXPECT_NEAR(clipped.getMinPoint()[1], 4, Epsilon);
+    EXPECT_NEAR(clipped.getMaxPoint()[1], 6.3f, Epsilon);
+    EXPECT_EQ(clipped.getMinPoint()[2], 0);
+    EXPECT_EQ(clipped.getMaxPoint()[2], 0);
+
+    // The box contains the triangle
+    box = CBoundingBox(Vec3f(-1, -1, -1), Vec3f(11, 11, 1));
+    EXPECT_EQ(triangle.getClippedBoundingBox(box).getMinPoint(), triangle.getBoundingBox().getMinPoint());
+    EXPECT_EQ(triangle.getClippedBoundingBox(box).getMaxPoint(), triangle.getBoundingBox().getMaxPoint());
+}
@@ -0,0 +1,107 @@
+#include "TestDistributed.h"
+#include "core/RenderProtocol.h"
+#include <thread>
+
+using namespace rt;
+
+namespace {
+    void buildScene(CScene& scene, const Vec3f& color = RGB(1, 0.5f, 0.25f))
+    {
+        scene.add(CSolidSphere(std::make_shared<CShaderEyelight>(color), Vec3f(0, 0, 0), 1.0f, 16));
+        scene.add(CSolidBox(std::make_shared<CShaderFlat>(RGB(0, 1, 0)), Vec3f(2, 0, 1), 0.8f));
+        scene.add(std::make_shared<CCameraPerspective>(Size(50, 30), Vec3f(0, 0, -5), Vec3f(0, 0, 1), Vec3f(0, 1, 0), 45.0f));
+        scene.buildAccelStructure(20, 3);
+    }
+}
+
+TEST_F(CTestDistributed, render) {
+    CScene scene;
+    buildScene(scene);
+    CRenderCoordinator coordinator(0, 8);
+    ASSERT_NE(coordinator.getPort(), 0);
+
+    // Every worker holds its own copy of the scene, as a separate process would do
+    std::vector<std::thread> vWorkers;
+    for (int i = 0; i < 3; i++)
+        vWorkers.emplace_back([port = coordinator.getPort()]() {
+            CScene workerScene;
+            buildScene(workerScene);
+            CRenderWorker(workerScene).run("localhost", port);
+        });
+
+    Mat img = coordinator.render(scene);
+    for (auto& worker : vWorkers) worker.join();
+    
+    ASSERT_EQ(img.type(), CV_32FC3);
+    EXPECT_EQ(norm(img, scene.renderTile(Rect(Point(0, 0), scene.getResolution())), NORM_INF), 0);
+}
+
+TEST_F(CTestDistributed, failed_and_rejected_workers) {
+    CScene scene;
+    buildScene(scene);
+    CRenderCoordinator coordinator(0, 16);
+    const unsigned short port = coordinator.getPort();
+
+    // The gtest assertions are not reliable off the main thread: the worker thread only collects the results
+    bool rejected = true;
+    bool connected = false;
+    bool tileReceived = false;
+    int32_t tileId = -1;
+    bool rendered = false;
+    std::thread worker([&]() {
+        // A worker with another scene is rejected
+        CScene otherScene;
+        buildScene(otherScene, RGB(0, 0, 1));
+        rejected = !CRenderWorker(otherScene).run("localhost", port);
+
+        // A worker, which takes a tile and crashes
+        {
+            CSocket socket = CSocket::connect("localhost", port);
+            connected = socket.isValid();
+            protocol::Hello hello;
+            memcpy(hello.signature, protocol::signature, sizeof(hello.signature));
+            hello.version = protocol::version;
+            hello.key = (CDigest() << scene.getDigest() << qword(0)).get();
+            protocol::Tile tile;
+            tileReceived = connected && socket.send(hello) && socket.recv(tile);
+            if (tileReceived) tileId = tile.id;
+        }
+
+        // The lost tile is rendered by the next worker
+        CScene workerScene;
+        buildScene(workerScene);
+        rendered = CRenderWorker(workerScene).run("localhost", port);
+    });
+
+    Mat img = coordinator.render(scene, nullptr, 60);
+    worker.join();
+    EXPECT_TRUE(rejected);
+    ASSERT_TRUE(connected);
+    ASSERT_TRUE(tileReceived);
+    EXPECT_GE(tileId, 0);
+    EXPECT_TRUE(rendered);
+    EXPECT_EQ(norm(img, scene.renderTile(Rect(Point(0, 0), scene.getResolution())), NORM_INF), 0);
+}
+
+TEST_F(CTestDistributed, malformed_tile) {
+    // A coordinator, which asks for a tile outside of the image
+    CSocket listener = CSocket::listen(0);
+    ASSERT_TRUE(listener.isValid());
+    bool result = true;
+    std::thread worker([&result, port = listener.getPort()]() {
+        CScene workerScene;
+        buildScene(workerScene);
+        result = CRenderWorker(workerScene).run("localhost", port);
+    });
+
+    CSocket socket = listener.accept(10);
+    protocol::Hello hello;
+    const bool greeted = socket.isValid() && socket.recv(hello);
+    if (greeted) socket.send(protocol::Tile{ 0, 40, 20, 100, 100 });
+    socket.close();
+    listener.close();
+    worker.join();
+    
+    ASSERT_TRUE(greeted);
+    EXPECT_FALSE(result);
+}
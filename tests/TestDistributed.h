@@ -0,0 +1,11 @@
+#pragma once
+
+#include "gtest/gtest.h"
+#include "types.h"
+#include "openrt.h"
+
+class CTestDistributed : public ::testing::Test {
+public:
+    CTestDistributed(void) = default;
+	~CTestDistributed(void) = default;
+};
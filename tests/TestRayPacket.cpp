@@ -0,0 +1,106 @@
+#include "TestRayPacket.h"
+#include "core/RayPacket.h"
+#include "core/random.h"
+
+using namespace rt;
+
+namespace {
+    void buildScene(CScene& scene)
+    {
+        auto pShader = std::make_shared<CShaderEyelight>(RGB(1, 1, 1));
+        scene.add(CSolidTorus(pShader, Vec3f(0, 0, 0), 2.0f, 0.5f, 24));
+        scene.add(CSolidSphere(pShader, Vec3f(3, 1, 0), 1.0f, 16));
+        scene.add(CSolidBox(pShader, Vec3f(-3, -1, 1), 1.0f));
+        scene.add(CSolidQuad(pShader, Vec3f(0, -2, 0), Vec3f(0, 1, 0), Vec3f(1, 0, 0), 10.0f));
+        scene.buildAccelStructure(20, 3);
+    }
+
+    // Intersects the rays of the packet one by one and compares the results with the packet traversal
+    void checkPacket(const CScene& scene, const RayPacket& packet)
+    {
+        RayPacket res = packet;
+        dword mask = scene.intersect(res);
+        for (size_t i = 0; i < packet.size; i++) {
+            Ray ray = packet.rays[i];
+            bool hit = scene.intersect(ray);
+            EXPECT_EQ(hit, (mask & (1u << i)) != 0);
+            if (hit) EXPECT_NEAR(ray.t, res.rays[i].t, Epsilon);
+        }
+    }
+}
+
+TEST_F(CTestRayPacket, coherent_primary_rays) {
+    CScene scene;
+    buildScene(scene);
+    auto pCamera = std::make_shared<CCameraPerspective>(Size(64, 48), Vec3f(0, 3, -10), Vec3f(0, -0.3f, 1), Vec3f(0, 1, 0), 45.0f);
+
+    RayPacket packet;
+    Ray ray;
+    for (int y = 0; y < 48; y += static_cast<int>(packetSize))
+        for (int x = 0; x < 64; x += static_cast<int>(packetSize)) {
+            packet.clear();
+            for (size_t dy = 0; dy < packetSize; dy++)
+                for (size_t dx = 0; dx < packetSize; dx++) {
+                    pCamera->InitRay(ray, x + static_cast<int>(dx), y + static_cast<int>(dy), Vec2f::all(0.5f));
+                    packet.add(ray);
+                }
+            checkPacket(scene, packet);
+        }
+}
+
+TEST_F(CTestRayPacket, incoherent_rays) {
+    CScene scene;
+    buildScene(scene);
+
+    RayPacket packet;
+    for (int k = 0; k < 100; k++) {
+        packet.clear();
+        for (size_t i = 0; i < RayPacket::capacity; i++)
+            packet.add(Ray(Vec3f(random::U<float>(-5, 5), random::U<float>(-1, 4), random::U<float>(-8, -4)), normalize(Vec3f(random::U<float>(-1, 1), random::U<float>(-1, 1), random::U<float>(-1, 1)))));
+        checkPacket(scene, packet);
+    }
+}
+
+TEST_F(CTestRayPacket, shadow_rays) {
+    CScene scene;
+    buildScene(scene);
+    CLightOmni light(RGB(1, 1, 1), Vec3f(0, 10, 0));
+
+    RayPacket packet;
+    for (int k = 0; k < 100; k++) {
+        packet.clear();
+        for (size_t i = 0; i < RayPacket::capacity; i++) {
+            Ray ray(Vec3f(random::U<float>(-5, 5), -2, random::U<float>(-5, 5)));
+            light.illuminate(ray);
+            packet.add(ray);
+        }
+        dword occluded = scene.if_intersect(packet);
+        for (size_t i = 0; i < packet.size; i++)
+            EXPECT_EQ(scene.if_intersect(packet.rays[i]), (occluded & (1u << i)) != 0);
+    }
+}
+
+TEST_F(CTestRayPacket, render) {
+    CScene scene;
+    auto pShader = std::make_shared<CShaderPhong>(scene, RGB(0.8f, 0.6f, 0.4f), 0.1f, 0.6f, 0.3f, 20.0f);
+    scene.add(CSolidTorus(pShader, Vec3f(0, 0, 0), 2.0f, 0.5f, 24));
+    scene.add(CSolidQuad(pShader, Vec3f(0, -1, 0), Vec3f(0, 1, 0), Vec3f(1, 0, 0), 10.0f));
+    scene.add(std::make_shared<CLightOmni>(RGB(20, 20, 20), Vec3f(2, 6, -2)));
+    scene.add(std::make_shared<CLightSpot>(RGB(20, 20, 20), Vec3f(-2, 6, -2), Vec3f(0.3f, -1, 0.3f), 30.0f, 10.0f));
+    auto pCamera = std::make_shared<CCameraPerspective>(Size(37, 23), Vec3f(0, 4, -8), Vec3f(0, -0.5f, 1), Vec3f(0, 1, 0), 45.0f);
+    scene.add(pCamera);
+    scene.buildAccelStructure(20, 3);
+
+    Mat img = scene.render();
+    ASSERT_EQ(img.size(), pCamera->getResolution());
+
+    // Reference: ray-by-ray rendering
+    Ray ray;
+    for (int y = 0; y < img.rows; y++)
+        for (int x = 0; x < img.cols; x++) {
+            pCamera->InitRay(ray, x, y, Vec2f::all(0.5f));
+            Vec3f color = scene.rayTrace(ray);
+            for (int c = 0; c < 3; c++)
+                EXPECT_NEAR(img.at<Vec3b>(y, x)[c], 255 * MIN(1.0f, color[c]), 1);
+        }
+}
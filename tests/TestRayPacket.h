@@ -0,0 +1,11 @@
+#pragma once
+
+#include "gtest/gtest.h"
+#include "types.h"
+#include "openrt.h"
+
+class CTestRayPacket : public ::testing::Test {
+public:
+    CTestRayPacket(void) = default;
+	~CTestRayPacket(void) = default;
+};
@@ -0,0 +1,1012 @@
+#include "TestScene.h"
+#include "core/random.h"
+#include "core/Ray.h"
+#include <fstream>
+
+using namespace rt;
+
+TEST_F(CTestScene, render_aovs) {
+    CScene scene(RGB(0.2f, 0.3f, 0.4f));
+    auto pRed   = std::make_shared<CShaderFlat>(RGB(1, 0, 0));
+    auto pGreen = std::make_shared<CShaderFlat>(RGB(0, 1, 0));
+    scene.add(CSolidSphere(pRed, Vec3f(-1.5f, 0, 0), 1.0f, 16));
+    scene.add(CSolidBox(pGreen, Vec3f(1.5f, 0, 0), 0.8f));
+    auto pCamera = std::make_shared<CCameraPerspective>(Size(40, 30), Vec3f(0, 0, -8), Vec3f(0, 0, 1), Vec3f(0, 1, 0), 45.0f);
+    scene.add(pCamera);
+    scene.buildAccelStructure(20, 3);
+
+    const std::vector<Aov> vAovs = { Aov::Beauty, Aov::Depth, Aov::Normal, Aov::Albedo, Aov::PrimitiveId, Aov::ShaderId, Aov::SampleCount };
+    auto vBuffers = scene.render(vAovs);
+    ASSERT_EQ(vBuffers.size(), vAovs.size());
+    EXPECT_EQ(vBuffers[0].type(), CV_32FC3);
+    EXPECT_EQ(vBuffers[1].type(), CV_64FC1);
+    EXPECT_EQ(vBuffers[2].type(), CV_32FC3);
+    EXPECT_EQ(vBuffers[3].type(), CV_32FC3);
+    EXPECT_EQ(vBuffers[4].type(), CV_32SC1);
+    EXPECT_EQ(vBuffers[5].type(), CV_32SC1);
+    EXPECT_EQ(vBuffers[6].type(), CV_32SC1);
+
+    Mat depth = scene.renderDepth();
+    size_t nHits = 0;
+    for (int y = 0; y < depth.rows; y++)
+        for (int x = 0; x < depth.cols; x++) {
+            double d = depth.at<double>(y, x);
+            EXPECT_EQ(d, vBuffers[1].at<double>(y, x));
+            EXPECT_EQ(vBuffers[6].at<int>(y, x), 1);
+            int primId = vBuffers[4].at<int>(y, x);
+            int shaderId = vBuffers[5].at<int>(y, x);
+            if (std::isinf(d)) {
+                EXPECT_EQ(primId, -1);
+                EXPECT_EQ(shaderId, -1);
+                EXPECT_EQ(vBuffers[0].at<Vec3f>(y, x), RGB(0.2f, 0.3f, 0.4f));
+                EXPECT_EQ(vBuffers[3].at<Vec3f>(y, x), Vec3f::all(0));
+            } else {
+                nHits++;
+                EXPECT_GE(primId, 0);
+                EXPECT_EQ(shaderId, vBuffers[0].at<Vec3f>(y, x) == RGB(1, 0, 0) ? 0 : 1);
+                EXPECT_EQ(vBuffers[0].at<Vec3f>(y, x), vBuffers[3].at<Vec3f>(y, x));
+                Vec3f normal = vBuffers[2].at<Vec3f>(y, x);
+                EXPECT_NEAR(norm(normal), 1, Epsilon);
+                EXPECT_LE(normal[2], 0);
+            }
+        }
+    EXPECT_GT(nHits, 0);
+}
+
+TEST_F(CTestScene, render_aovs_supersampled) {
+    CScene scene;
+    scene.add(CSolidSphere(std::make_shared<CShaderFlat>(RGB(1, 1, 1)), Vec3f(0, 0, 0), 1.0f, 16));
+    scene.add(std::make_shared<CCameraPerspective>(Size(17, 13), Vec3f(0, 0, -4), Vec3f(0, 0, 1), Vec3f(0, 1, 0), 45.0f));
+    scene.buildAccelStructure(20, 3);
+
+    auto vBuffers = scene.render({ Aov::Beauty, Aov::SampleCount }, std::make_shared<CSamplerStratified>(3));
+    for (int y = 0; y < vBuffers[1].rows; y++)
+        for (int x = 0; x < vBuffers[1].cols; x++) {
+            EXPECT_EQ(vBuffers[1].at<int>(y, x), 9);
+            for (int c = 0; c < 3; c++) {
+                EXPECT_GE(vBuffers[0].at<Vec3f>(y, x)[c], 0);
+                EXPECT_LE(vBuffers[0].at<Vec3f>(y, x)[c], 1 + Epsilon);
+            }
+        }
+}
+
+TEST_F(CTestScene, render_hdr) {
+    const Vec3f color = RGB(2.0f, 0.5f, 0.25f);
+    CScene scene;
+    scene.add(CSolidQuad(std::make_shared<CShaderFlat>(color), Vec3f(0, 0, 0), Vec3f(0, 0, -1), Vec3f(1, 0, 0), 10.0f));
+    scene.add(std::make_shared<CCameraPerspective>(Size(8, 6), Vec3f(0, 0, -4), Vec3f(0, 0, 1), Vec3f(0, 1, 0), 45.0f));
+    scene.buildAccelStructure(20, 3);
+
+    Mat hdr = scene.render(nullptr, CV_32FC3);
+    ASSERT_EQ(hdr.type(), CV_32FC3);
+    Mat img16 = scene.render(nullptr, CV_16UC3);
+    ASSERT_EQ(img16.type(), CV_16UC3);
+    Mat img8 = scene.render(nullptr, CV_8UC3);
+    ASSERT_EQ(img8.type(), CV_8UC3);
+    Mat tonemapped = scene.render(nullptr, CV_8UC3, ToneMapping::Reinhard);
+    ASSERT_EQ(tonemapped.type(), CV_8UC3);
+
+    const float luminance = 0.0722f * color[0] + 0.7152f * color[1] + 0.2126f * color[2];
+    for (int y = 0; y < hdr.rows; y++)
+        for (int x = 0; x < hdr.cols; x++)
+            for (int c = 0; c < 3; c++) {
+                EXPECT_FLOAT_EQ(hdr.at<Vec3f>(y, x)[c], color[c]);                 // linear values above 1 are preserved
+                EXPECT_NEAR(img16.at<Vec3w>(y, x)[c], 65535 * MIN(1.0f, color[c]), 1);
+                EXPECT_NEAR(img8.at<Vec3b>(y, x)[c], 255 * MIN(1.0f, color[c]), 1);
+                EXPECT_NEAR(tonemapped.at<Vec3b>(y, x)[c], 255 * MIN(1.0f, color[c] / (1 + luminance)), 1);
+            }
+}
+
+#ifdef ENABLE_CACHE
+TEST_F(CTestScene, render_cache) {
+    auto pCache = std::make_shared<CRenderCache>("test_render_cache", 1024 * 1024, 4);
+    pCache->clear();
+
+    CScene scene;
+    auto pShader = std::make_shared<CShaderFlat>(RGB(0.5f, 0.5f, 0.5f));
+    scene.add(CSolidSphere(pShader, Vec3f(0, 0, 0), 1.0f, 16));
+    scene.add(std::make_shared<CCameraPerspective>(Size(16, 10), Vec3f(0, 0, -4), Vec3f(0, 0, 1), Vec3f(0, 1, 0), 45.0f));
+    scene.buildAccelStructure(20, 3);
+    scene.setRenderCache(pCache);
+
+    Mat img = scene.render(nullptr, CV_32FC3);
+    const qword key = (CDigest() << scene.getDigest() << qword(0)).get();
+    Mat cached = pCache->get(key);
+    ASSERT_FALSE(cached.empty());
+    EXPECT_EQ(norm(img, cached, NORM_INF), 0);
+    for (int b = 0; b < 3; b++) 
+        EXPECT_TRUE(pCache->get(key, b).empty());
+
+    // The second render is taken from the cache
+    Mat marked = cached.clone();
+    marked.at<Vec3f>(0, 0) = Vec3f::all(7);
+    pCache->put(key, marked);
+    EXPECT_EQ(scene.render(nullptr, CV_32FC3).at<Vec3f>(0, 0), Vec3f::all(7));
+    EXPECT_EQ(scene.getLastRenderedImage().at<Vec3f>(0, 0), Vec3f::all(7));
+
+    // The missing frame is assembled from the cached bands
+    pCache->remove(key);
+    pCache->put(key, marked(Rect(0, 0, 16, 4)).clone(), 0);
+    Mat resumed = scene.render(nullptr, CV_32FC3);
+    EXPECT_EQ(resumed.at<Vec3f>(0, 0), Vec3f::all(7));
+    EXPECT_EQ(norm(resumed(Rect(0, 4, 16, 6)), img(Rect(0, 4, 16, 6)), NORM_INF), 0);
+
+    // Any change of the scene invalidates the last render
+    scene.add(std::make_shared<CLightOmni>(Vec3f::all(1), Vec3f(0, 4, 0)));
+    EXPECT_NE((CDigest() << scene.getDigest() << qword(0)).get(), key);
+    EXPECT_TRUE(scene.getLastRenderedImage().empty());
+    pCache->clear();
+    EXPECT_EQ(pCache->getSize(), 0u);
+
+    // The scenes do not use a render cache unless it is set explicitly
+    CScene plain;
+    plain.add(std::make_shared<CCameraPerspective>(Size(4, 4), Vec3f(0, 0, -4), Vec3f(0, 0, 1), Vec3f(0, 1, 0), 45.0f));
+    plain.render();
+    EXPECT_TRUE(plain.getLastRenderedImage().empty());
+}
+
+TEST_F(CTestScene, render_cache_eviction) {
+    CRenderCache cache("test_render_cache", 1024 * 1024, 0);
+    cache.clear();
+    Mat img(16, 16, CV_32FC3, Scalar::all(1));
+    const size_t imgSize = 3 * sizeof(int) + img.total() * img.elemSize();
+
+    for (qword key = 1; key <= 3; key++) {
+        cache.put(key, img);
+        cache.flush();
+    }
+    EXPECT_FALSE(cache.get(1).empty());		// entry 2 becomes the least recently used
+    EXPECT_EQ(cache.getSize(), 3 * imgSize);
+
+    cache.setMaxSize(2 * imgSize);
+    EXPECT_EQ(cache.getSize(), 2 * imgSize);
+    EXPECT_FALSE(cache.get(1).empty());
+    EXPECT_TRUE(cache.get(2).empty());
+    EXPECT_FALSE(cache.get(3).empty());
+
+    // The index is restored from the cache folder
+    CRenderCache other("test_render_cache", 2 * imgSize, 0);
+    EXPECT_EQ(other.getSize(), 2 * imgSize);
+    EXPECT_EQ(norm(other.get(3), img, NORM_INF), 0);
+    cache.clear();
+}
+#endif
+
+namespace {
+    // Flat shader, which interrupts the checkpointed render after a given number of samples
+    class CShaderInterrupt : public CShaderFlat {
+    public:
+        CShaderInterrupt(const CScene& scene, const Vec3f& color, size_t nSamples) : CShaderFlat(color), m_scene(scene), m_nSamples(nSamples) {}
+        virtual Vec3f shade(const Ray& ray) const override {
+            if (++m_counter == m_nSamples) m_scene.interruptRender();
+            return CShaderFlat::shade(ray) * random::U<float>();
+        }
+
+    private:
+        const CScene&               m_scene;
+        const size_t                m_nSamples;
+        mutable std::atomic<size_t> m_counter = 0;
+    };
+}
+
+TEST_F(CTestScene, sampler_indexed) {
+    // The single samples are reproducible, independent of the state of the sampler and fall into their strata
+    CSamplerStratified stratified(4);
+    for (size_t i = 0; i < stratified.getNumSamples(); i++) {
+        const Vec2f sample = stratified.getSample(42, i);
+        EXPECT_EQ(sample, stratified.getSample(42, i));
+        EXPECT_EQ(static_cast<size_t>(sample[0] * 4), i % 4);
+        EXPECT_EQ(static_cast<size_t>(sample[1] * 4), i / 4);
+    }
+    EXPECT_NE(stratified.getSample(42, 0), stratified.getSample(43, 0));
+
+    CSamplerRandom randomSampler(3);
+    Vec2f mean = Vec2f::all(0);
+    for (qword seed = 0; seed < 1000; seed++) {
+        const Vec2f sample = randomSampler.getSample(seed, seed % randomSampler.getNumSamples());
+        EXPECT_GE(sample[0], 0);
+        EXPECT_LT(sample[1], 1);
+        mean += sample / 1000;
+    }
+    EXPECT_NEAR(mean[0], 0.5f, 0.05f);
+    EXPECT_NEAR(mean[1], 0.5f, 0.05f);
+}
+
+TEST_F(CTestScene, render_checkpoint) {
+    const std::string fileName = "test_render.ckpt";
+    std::remove(fileName.c_str());
+    
+    CScene scene(RGB(0.1f, 0.1f, 0.1f));
+    const Size resolution(12, 8);
+    scene.add(CSolidQuad(std::make_shared<CShaderInterrupt>(scene, RGB(1, 0.5f, 0.25f), 2 * resolution.area() + 5), Vec3f(0, 0, 0), Vec3f(0, 0, -1), Vec3f(1, 0, 0), 10.0f));
+    scene.add(std::make_shared<CCameraPerspective>(resolution, Vec3f(0, 0, -4), Vec3f(0, 0, 1), Vec3f(0, 1, 0), 45.0f));
+    scene.buildAccelStructure(20, 3);
+    auto pSampler = std::make_shared<CSamplerRandom>(2);
+
+    // The render is interrupted in the third pass and only two passes are kept
+    Mat partial = scene.renderCheckpointed(fileName, pSampler, 1000, CV_32FC3);
+    ASSERT_FALSE(partial.empty());
+    
+    // The resumed render is equal to the uninterrupted one
+    Mat resumed = scene.renderCheckpointed(fileName, pSampler, 1000, CV_32FC3);
+    std::remove(fileName.c_str());
+    Mat full = scene.renderCheckpointed(fileName, pSampler, 0, CV_32FC3);
+    EXPECT_GT(norm(partial, full, NORM_INF), 0);
+    EXPECT_EQ(norm(resumed, full, NORM_INF), 0);
+
+    // The finished checkpoint is returned without rendering
+    EXPECT_EQ(norm(scene.renderCheckpointed(fileName, pSampler, 0, CV_32FC3), full, NORM_INF), 0);
+    std::remove(fileName.c_str());
+}
+
+namespace {
+    // A quad covering the whole view with a sphere over it and a light source, which makes the quad cast shadow rays
+    void buildStatsScene(CScene& scene, const Size& resolution)
+    {
+        scene.add(CSolidQuad(std::make_shared<CShaderPhong>(scene, RGB(1, 1, 1), 0.1f, 0.9f, 0, 40), Vec3f(0, 0, 0), Vec3f(0, 0, -1), Vec3f(1, 0, 0), 10.0f));
+        scene.add(CSolidSphere(std::make_shared<CShaderFlat>(RGB(1, 0, 0)), Vec3f(0, 0, -1), 0.5f, 8));
+        scene.add(std::make_shared<CLightOmni>(RGB(10, 10, 10), Vec3f(0, 2, -3)));
+        scene.add(std::make_shared<CCameraPerspective>(resolution, Vec3f(0, 0, -4), Vec3f(0, 0, 1), Vec3f(0, 1, 0), 45.0f));
+        scene.buildAccelStructure(20, 3);
+    }
+}
+
+TEST_F(CTestScene, render_stats) {
+    const Size resolution(16, 12);
+    CScene scene(RGB(0.1f, 0.1f, 0.1f));
+    buildStatsScene(scene, resolution);
+
+    scene.render();
+    RayStats stats = scene.getStats();
+#ifndef ENABLE_STATS
+    // Nothing is counted
+    EXPECT_EQ(stats.primaryRays + stats.shadowRays + stats.primitiveTests + stats.hits + stats.shadingCalls, 0);
+#else
+    EXPECT_EQ(stats.primaryRays, static_cast<qword>(resolution.area()));
+    EXPECT_EQ(stats.hits, stats.primaryRays);                   // the quad covers the whole view
+    EXPECT_EQ(stats.shadingCalls, stats.hits);
+    EXPECT_GT(stats.shadowRays, 0);
+    EXPECT_LT(stats.shadowRays, stats.primaryRays);             // only the quad casts shadow rays
+    EXPECT_EQ(stats.reflectionRays + stats.refractionRays, 0);
+    EXPECT_GE(stats.primitiveTests, stats.primaryRays);
+#ifdef ENABLE_BSP
+    EXPECT_GE(stats.nodesVisited, stats.leavesVisited);
+    EXPECT_GE(stats.leavesVisited, stats.primaryRays);
+#endif
+
+    // The statistics are reset by every render
+    scene.render();
+    RayStats again = scene.getStats();
+    EXPECT_EQ(again.primaryRays, stats.primaryRays);
+    EXPECT_EQ(again.shadowRays, stats.shadowRays);
+#endif
+
+    // The concurrent renders do not disturb each other's statistics
+    std::vector<std::shared_ptr<CScene>> vpScenes;
+    for (int i = 0; i < 3; i++) {
+        vpScenes.push_back(std::make_shared<CScene>(RGB(0.1f, 0.1f, 0.1f)));
+        buildStatsScene(*vpScenes.back(), resolution);
+    }
+    std::vector<std::thread> vThreads;
+    for (const auto& pScene : vpScenes)
+        vThreads.emplace_back([pScene]() { for (int i = 0; i < 3; i++) pScene->render(); });
+    for (auto& thread : vThreads) thread.join();
+    for (const auto& pScene : vpScenes) {
+        EXPECT_EQ(pScene->getStats().primaryRays, stats.primaryRays);
+        EXPECT_EQ(pScene->getStats().shadowRays, stats.shadowRays);
+        EXPECT_EQ(pScene->getStats().primitiveTests, stats.primitiveTests);
+    }
+}
+
+TEST_F(CTestScene, render_traversal_cost) {
+    const Size resolution(16, 12);
+    CScene scene(RGB(0.1f, 0.1f, 0.1f));
+    buildStatsScene(scene, resolution);
+
+    auto vBuffers = scene.render({ Aov::NodeCount, Aov::PrimitiveTestCount, Aov::RayTreeNodeCount, Aov::RayTreePrimitiveTestCount });
+    ASSERT_EQ(vBuffers.size(), 4);
+#ifndef ENABLE_STATS
+    // The costs are not counted
+    for (const Mat& buffer : vBuffers) EXPECT_EQ(countNonZero(buffer), 0);
+#else
+    qword nTests = 0;
+    bool shadowed = false;
+    for (int y = 0; y < resolution.height; y++)
+        for (int x = 0; x < resolution.width; x++) {
+            EXPECT_GT(vBuffers[1].at<int>(y, x), 0);
+            EXPECT_GE(vBuffers[2].at<int>(y, x), vBuffers[0].at<int>(y, x));
+            EXPECT_GE(vBuffers[3].at<int>(y, x), vBuffers[1].at<int>(y, x));
+            shadowed |= vBuffers[3].at<int>(y, x) > vBuffers[1].at<int>(y, x);
+            nTests += vBuffers[1].at<int>(y, x);
+#ifdef ENABLE_BSP
+            EXPECT_GT(vBuffers[0].at<int>(y, x), 0);
+#endif
+        }
+    EXPECT_TRUE(shadowed);
+    // Measuring the costs does not change the statistics of the render
+#ifndef ENABLE_PACKETS
+    EXPECT_EQ(scene.getStats().primitiveTests, nTests);
+#endif
+    EXPECT_EQ(scene.getStats().shadowRays, 0);
+
+    Mat img = heatmap(vBuffers[1]);
+    ASSERT_EQ(img.type(), CV_8UC3);
+    ASSERT_EQ(img.size(), resolution);
+    double maxCount = 0;
+    Point maxLoc;
+    minMaxLoc(vBuffers[1], nullptr, &maxCount, nullptr, &maxLoc);
+    EXPECT_EQ(img.at<Vec3b>(maxLoc), Vec3b(0, 0, 255));
+    EXPECT_EQ(heatmap(Mat(resolution, CV_32SC1, Scalar(0))).at<Vec3b>(0, 0), Vec3b(0, 0, 0));
+
+    // Together with the beauty pass, whose shadow rays may be traced in packets, the costs are still the ones of the rays traced one by one
+    auto vCosts = scene.render({ Aov::Beauty, Aov::RayTreeNodeCount, Aov::RayTreePrimitiveTestCount });
+    CCameraPerspective camera(resolution, Vec3f(0, 0, -4), Vec3f(0, 0, 1), Vec3f(0, 1, 0), 45.0f);
+    for (int y = 0; y < resolution.height; y++)
+        for (int x = 0; x < resolution.width; x++) {
+            Ray ray;
+            camera.InitRay(ray, x, y);
+            const RayStats start = stats::local;
+            if (scene.intersect(ray)) ray.hit->getShader()->shade(ray);
+            RayStats cost = stats::local;
+            cost -= start;
+            EXPECT_EQ(vCosts[1].at<int>(y, x), static_cast<int>(cost.nodesVisited));
+            EXPECT_EQ(vCosts[2].at<int>(y, x), static_cast<int>(cost.primitiveTests));
+        }
+#endif
+}
+
+TEST_F(CTestScene, render_sequence) {
+    const size_t nFrames = 4;
+    auto pShader = std::make_shared<CShaderEyelight>(RGB(1, 1, 1));
+    auto pMesh = std::make_shared<CMesh>(CSolidSphere(pShader, Vec3f(0, 0, 0), 0.5f, 8));
+    
+    // Renders the frame with the geometry set up from scratch
+    auto renderFrame = [&](size_t frame) {
+        CScene scene(RGB(0.1f, 0.2f, 0.3f));
+        const float k = static_cast<float>(frame) / (nFrames - 1);
+        CSolidBox box(pShader, Vec3f(0, 1, 0), 0.5f);
+        box.transform(CTransform().rotate(Vec3f(0, 1, 0), 90 * k).translate(2 * k, 0, 0).get());
+        scene.add(box);
+        scene.add(std::make_shared<CPrimInstance>(pShader, pMesh, CTransform().translate(-1, 1 + k, 0).get()));
+        scene.add(std::make_shared<CCameraPerspective>(Size(32, 24), Vec3f(k, 1, -6), Vec3f(0, 0, 1), Vec3f(0, 1, 0), 45.0f));
+        scene.buildAccelStructure(20, 3);
+        return scene.render();
+    };
+    
+    CScene scene(RGB(0.1f, 0.2f, 0.3f));
+    CSolidBox box(pShader, Vec3f(0, 1, 0), 0.5f);
+    auto pInstance = std::make_shared<CPrimInstance>(pShader, pMesh, CTransform().translate(-1, 1, 0).get());
+    auto pCamera = std::make_shared<CCameraPerspective>(Size(32, 24), Vec3f(0, 1, -6), Vec3f(0, 0, 1), Vec3f(0, 1, 0), 45.0f);
+    scene.add(box);
+    scene.add(pInstance);
+    scene.add(pCamera);
+    scene.buildAccelStructure(20, 3);
+    
+    CSequenceRenderer sequence(scene, nFrames);
+    sequence.addKey(pCamera, 0, Vec3f(0, 1, -6), Vec3f(0, 1, 0));
+    sequence.addKey(pCamera, nFrames - 1, Vec3f(1, 1, -6), Vec3f(1, 1, 0));
+    sequence.addKey(box, 0, CSequenceRenderer::Pose());
+    sequence.addKey(box, nFrames - 1, CSequenceRenderer::Pose(Vec3f(2, 0, 0), Vec3f(0, 90, 0)));
+    sequence.addKey(pInstance, 0, CSequenceRenderer::Pose());
+    sequence.addKey(pInstance, nFrames - 1, CSequenceRenderer::Pose(Vec3f(0, 1, 0)));
+    
+    std::vector<size_t> vFrames;
+    std::vector<Mat> vImgs;
+    sequence.render([&](size_t frame, const Mat& img) {
+        vFrames.push_back(frame);
+        vImgs.push_back(img);
+    });
+    ASSERT_EQ(vFrames.size(), nFrames);
+    for (size_t frame = 0; frame < nFrames; frame++) {
+        EXPECT_EQ(vFrames[frame], frame);
+        // The incrementally transformed geometry may differ from the reference at the edges of the objects in rounding only
+        EXPECT_LE(norm(vImgs[frame], renderFrame(frame), NORM_L1) / vImgs[frame].total(), 1.0) << "frame " << frame;
+    }
+    EXPECT_GT(sequence.getFramesPerHour(), 0);
+}
+
+TEST_F(CTestScene, render_sequence_round_trip) {
+    // A long animation, which returns the box to its initial pose
+    const size_t nFrames = 101;
+    auto pShader = std::make_shared<CShaderEyelight>(RGB(1, 1, 1));
+    CScene scene;
+    CSolidBox box(pShader, Vec3f(0, 1, 0), 0.5f);
+    scene.add(box);
+    scene.add(std::make_shared<CCameraPerspective>(Size(8, 6), Vec3f(0, 1, -6), Vec3f(0, 0, 1), Vec3f(0, 1, 0), 45.0f));
+    scene.buildAccelStructure(20, 3);
+    std::vector<CBoundingBox> vRest;
+    for (const auto& pPrim : box.getPrims()) vRest.push_back(pPrim->getBoundingBox());
+
+    CSequenceRenderer sequence(scene, nFrames);
+    sequence.addKey(box, 0, CSequenceRenderer::Pose());
+    sequence.addKey(box, nFrames / 2, CSequenceRenderer::Pose(Vec3f(2, 0, 1), Vec3f(30, 180, 0), Vec3f::all(2)));
+    sequence.addKey(box, nFrames - 1, CSequenceRenderer::Pose());
+    sequence.render([](size_t, const Mat&) {});
+
+    // The rounding errors of the frames do not build up
+    for (size_t i = 0; i < vRest.size(); i++) {
+        const CBoundingBox bounds = box.getPrims()[i]->getBoundingBox();
+        for (int j = 0; j < 3; j++) {
+            EXPECT_NEAR(bounds.getMinPoint()[j], vRest[i].getMinPoint()[j], 5e-5f);
+            EXPECT_NEAR(bounds.getMaxPoint()[j], vRest[i].getMaxPoint()[j], 5e-5f);
+        }
+    }
+}
+
+TEST_F(CTestScene, texture_mipmaps) {
+    // Checkerboard of single texels
+    Mat img(64, 64, CV_32FC3);
+    for (int y = 0; y < img.rows; y++)
+        for (int x = 0; x < img.cols; x++)
+            img.at<Vec3f>(y, x) = Vec3f::all(static_cast<float>((x + y) % 2));
+    auto pTexture = std::make_shared<CTexture>(img);
+    ASSERT_EQ(pTexture->getNumLevels(), 7);
+    EXPECT_EQ(pTexture->getLevel(6).size(), Size(1, 1));
+    EXPECT_NEAR(pTexture->getLevel(6).at<Vec3f>(0, 0)[0], 0.5f, 1e-4);
+
+    // The texel centers are reproduced, while the large footprints are averaged
+    const Vec2f uv(3.5f / 64 - Epsilon, 5.5f / 64 - Epsilon);
+    EXPECT_NEAR(pTexture->getTexel(uv)[0], 0.0f, 1e-3);
+    EXPECT_NEAR(pTexture->getTexel(uv + Vec2f(1.0f / 64, 0))[0], 1.0f, 1e-3);
+
+    // The lookup without differentials returns the nearest texel, while the filtered lookup blends the neighbours
+    const Vec2f between(3.9f / 64 - Epsilon, 5.5f / 64 - Epsilon);
+    EXPECT_EQ(pTexture->getTexel(between)[0], 0.0f);
+    EXPECT_NEAR(pTexture->getTexel(between, Vec2f::all(0), Vec2f::all(0))[0], 0.4f, 1e-3);
+    EXPECT_NEAR(pTexture->getTexel(uv, Vec2f(0.25f, 0), Vec2f(0, 0.25f))[0], 0.5f, 1e-3);
+
+    // The far quad is filtered by the ray differentials of the camera, the near one keeps the details
+    auto render = [&](float distance) {
+        CScene scene;
+        scene.add(CSolidQuad(std::make_shared<CShaderFlat>(pTexture), Vec3f(0, 0, distance), Vec3f(0, 0, -1), Vec3f(1, 0, 0), 1.0f));
+        scene.add(std::make_shared<CCameraPerspective>(Size(16, 16), Vec3f(0, 0, 0), Vec3f(0, 0, 1), Vec3f(0, 1, 0), 45.0f));
+        scene.buildAccelStructure(20, 3);
+        return scene.render({ Aov::Beauty, Aov::Depth });
+    };
+    auto vFar = render(8);
+    size_t nHits = 0;
+    for (int y = 0; y < vFar[0].rows; y++)
+        for (int x = 0; x < vFar[0].cols; x++)
+            if (!std::isinf(vFar[1].at<double>(y, x))) {
+                nHits++;
+                EXPECT_NEAR(vFar[0].at<Vec3f>(y, x)[0], 0.5f, 0.05f);
+            }
+    EXPECT_GT(nHits, 0);
+    
+    double minVal, maxVal;
+    minMaxLoc(render(0.5f)[0].reshape(1), &minVal, &maxVal);
+    EXPECT_GT(maxVal - minVal, 0.5);
+}
+
+TEST_F(CTestScene, texture_cache) {
+    // Random image, which is not a multiple of the tile size
+    Mat img(70, 100, CV_8UC3);
+    randu(img, Scalar::all(0), Scalar::all(256));
+    const std::string fileName = "test_texture_cache.png";
+    ASSERT_TRUE(imwrite(fileName, img));
+
+    const size_t tileBytes = 32 * 32 * 3;
+    auto pCache = std::make_shared<CTextureCache>("test_texture_cache", 4 * tileBytes, 32, TileFormat::Byte);
+    CTexture tiled(fileName, pCache);
+    EXPECT_EQ(pCache->getNumReads(), 0);
+    CTexture inMemory(img);
+    ASSERT_EQ(tiled.getNumLevels(), inMemory.getNumLevels());
+    EXPECT_EQ(tiled.getDigest(), pCache->getDigest(0));
+
+    // The tiled texture matches the in-memory one up to the quantization of the tiles
+    for (int i = 0; i < 200; i++) {
+        const Vec2f uv(random::U<float>(), random::U<float>());
+        const Vec2f dUV(random::U<float>() / 8, 0);
+        EXPECT_LE(norm(tiled.getTexel(uv, dUV, Vec2f(dUV[1], dUV[0])) - inMemory.getTexel(uv, dUV, Vec2f(dUV[1], dUV[0])), NORM_INF), 3e-3f);
+    }
+    EXPECT_GT(pCache->getNumReads(), 0);
+    EXPECT_LE(pCache->getSize(), pCache->getMaxSize());
+
+    // The tiles are re-used from the tile file by another cache
+    CTextureCache other("test_texture_cache", 4 * tileBytes, 32, TileFormat::Byte);
+    EXPECT_EQ(other.getLevels(other.add(fileName)).size(), inMemory.getNumLevels());
+
+    // The tile, used without locking the cache, is not evicted: only the other tiles are read again
+    CTextureCache lru("test_texture_cache", 2 * tileBytes, 32, TileFormat::Byte);
+    const size_t id = lru.add(fileName);
+    for (int i = 0; i < 3; i++)
+        for (int tx = 1; tx < 4; tx++) {
+            lru.getTexel(id, 0, 0, 0);
+            lru.getTexel(id, 0, 32 * tx, 0);
+        }
+    EXPECT_EQ(lru.getNumReads(), 1 + 3 * 3);
+    std::remove(fileName.c_str());
+
+    // The 16-bit images keep their precision in the floating-point tiles
+    Mat img16(40, 40, CV_16UC3);
+    randu(img16, Scalar::all(0), Scalar::all(65536));
+    const std::string fileName16 = "test_texture_cache_16.png";
+    ASSERT_TRUE(imwrite(fileName16, img16));
+    CTextureCache precise("test_texture_cache", 16 * tileBytes, 32, TileFormat::Float);
+    const size_t id16 = precise.add(fileName16);
+    for (int i = 0; i < 100; i++) {
+        const int x = i % 40;
+        const int y = (7 * i) % 40;
+        EXPECT_LE(norm(precise.getTexel(id16, 0, x, y) - Vec3f(img16.at<Vec3w>(y, x)) / 65535, NORM_INF), 1e-6f);
+    }
+    std::remove(fileName16.c_str());
+}
+
+TEST_F(CTestScene, texture_formats) {
+    Mat img(48, 40, CV_32FC3);
+    randu(img, Scalar::all(0), Scalar::all(1));
+    CTexture reference(img);
+
+    // The compact textures keep their format and match the reference up to the quantization
+    for (int type : { CV_8UC3, CV_16UC3, CV_16FC3 }) {
+        Mat compact;
+        img.convertTo(compact, type, CV_MAT_DEPTH(type) == CV_8U ? 255 : CV_MAT_DEPTH(type) == CV_16U ? 65535 : 1);
+        CTexture texture(compact);
+        ASSERT_EQ(texture.type(), type);
+        ASSERT_EQ(texture.getNumLevels(), reference.getNumLevels());
+        EXPECT_EQ(texture.getLevel(1).type(), type);
+        for (int i = 0; i < 100; i++) {
+            const Vec2f uv(random::U<float>(), random::U<float>());
+            const Vec2f dUV(random::U<float>() / 4, 0);
+            EXPECT_LE(norm(texture.getTexel(uv, dUV, dUV) - reference.getTexel(uv, dUV, dUV), NORM_INF), 3e-3f) << "type " << type;
+        }
+    }
+
+    // The single-channel texture is replicated to the gray color
+    Mat mask(16, 16, CV_8UC1, Scalar(51));
+    CTexture gray(mask);
+    EXPECT_EQ(gray.getLevel(0).elemSize(), 1);
+    const Vec3f texel = gray.getTexel(Vec2f(0.5f, 0.5f));
+    EXPECT_NEAR(texel[0], 0.2f, 1e-5);
+    EXPECT_EQ(texel[0], texel[1]);
+    EXPECT_EQ(texel[0], texel[2]);
+}
+
+TEST_F(CTestScene, environment_light) {
+    // A white diffuse surface under the uniform environment receives the radiance of the environment
+    auto pUniform = std::make_shared<CLightEnvironment>(Mat(16, 32, CV_32FC3, Scalar::all(0.5)), Vec3f::all(1), std::make_shared<CSamplerStratified>(32, true, true));
+    Vec3f irradiance = Vec3f::all(0);
+    const size_t nSamples = pUniform->getNumSamples();
+    for (size_t s = 0; s < nSamples; s++) {
+        Ray ray(Vec3f::all(0), Vec3f(0, 1, 0));
+        auto radiance = pUniform->illuminate(ray);
+        ASSERT_TRUE(radiance);
+        EXPECT_NEAR(norm(ray.dir), 1.0, 1e-4);
+        if (ray.dir[1] > 0) irradiance += ray.dir[1] * radiance.value();
+    }
+    EXPECT_NEAR(irradiance[0] / nSamples, 0.5f, 0.02f);
+
+    // The samples follow the bright patch of the environment
+    Mat img(32, 64, CV_32FC3, Scalar::all(0));
+    img(Rect(40, 8, 8, 4)).setTo(Scalar::all(100));
+    CLightEnvironment patch(img);
+    size_t nBright = 0;
+    for (int i = 0; i < 1000; i++) {
+        float pdf;
+        const Vec3f dir = patch.sample(Vec2f(random::U<float>(), random::U<float>()), pdf);
+        EXPECT_GT(pdf, 0);
+        EXPECT_NEAR(pdf, patch.getPdf(dir), 0.01f * pdf + 1e-3f);
+        if (patch.getRadiance(dir)[0] > 0) nBright++;
+    }
+    EXPECT_GE(nBright, 950);
+
+    // The rays missing the geometry see the environment instead of the background color
+    CScene scene(RGB(1, 0, 0));
+    scene.add(std::make_shared<CCameraPerspective>(Size(8, 8), Vec3f(0, 0, 0), Vec3f(0, 0, 1), Vec3f(0, 1, 0), 45.0f));
+    const qword digest = scene.getDigest();
+    scene.setEnvironment(pUniform);
+    EXPECT_EQ(scene.getLights().size(), 1);
+    EXPECT_NE(scene.getDigest(), digest);
+    Mat beauty = scene.render({ Aov::Beauty })[0];
+    EXPECT_LE(norm(beauty, Mat(beauty.size(), CV_32FC3, Scalar::all(0.5)), NORM_INF), 1e-4);
+
+    scene.setEnvironment(nullptr);
+    EXPECT_TRUE(scene.getLights().empty());
+    EXPECT_EQ(scene.getDigest(), digest);
+}
+
+TEST_F(CTestScene, memory_report) {
+    CScene scene(RGB(0.1f, 0.1f, 0.1f));
+    auto pTexture = std::make_shared<CTexture>(Mat(32, 64, CV_8UC3, Scalar::all(255)));
+    auto pShader = std::make_shared<CShaderFlat>(pTexture);
+    scene.add(CSolidQuad(pShader, Vec3f(-1, 0, -1), Vec3f(-1, 0, 1), Vec3f(1, 0, 1), Vec3f(1, 0, -1)));
+    scene.add(CSolidQuad(std::make_shared<CShaderFlat>(pTexture), Vec3f(-1, 2, -1), Vec3f(-1, 2, 1), Vec3f(1, 2, 1), Vec3f(1, 2, -1)));
+    for (int i = 0; i < 3; i++)
+        scene.add(std::make_shared<CPrimSphere>(pShader, Vec3f(static_cast<float>(i), 1, 0), 0.25f));
+    scene.add(std::make_shared<CLightOmni>(RGB(10, 10, 10), Vec3f(0, 4, 0)));
+    scene.add(std::make_shared<CCameraPerspective>(Size(16, 12), Vec3f(0, 1, -4), Vec3f(0, 0, 1), Vec3f(0, 1, 0), 45.0f));
+    scene.buildAccelStructure(10, 1);
+
+    MemoryReport report = scene.getMemoryReport();
+    ASSERT_EQ(report.primitives.size(), 2);
+    EXPECT_EQ(report.primitives["CPrimTriangle"].count, 4);
+    EXPECT_EQ(report.primitives["CPrimSphere"].count, 3);
+    EXPECT_GE(report.primitives["CPrimTriangle"].bytes, 4 * sizeof(CPrimTriangle));
+    EXPECT_EQ(report.sceneReferences.count, 9);
+    
+    // The texture is shared by the shaders and is accounted only once
+    EXPECT_EQ(report.textures.count, 1);
+    EXPECT_GE(report.textures.bytes, 32 * 64 * 3);
+
+#ifdef ENABLE_BSP
+    EXPECT_EQ(report.bspPrimitives, 7);
+    EXPECT_EQ(report.bspNodes.count + 1, report.bspLeaves.count);
+    EXPECT_GE(report.leafReferences.count, 7);
+    EXPECT_GE(report.getDuplicationFactor(), 1.0);
+    EXPECT_GE(report.leafReferences.bytes, report.leafReferences.count * sizeof(ptr_prim_t));
+#else
+    EXPECT_EQ(report.bspLeaves.count, 0);
+    EXPECT_EQ(report.getDuplicationFactor(), 0);
+#endif
+    size_t total = report.sceneReferences.bytes + report.bspNodes.bytes + report.bspLeaves.bytes + report.leafReferences.bytes + report.textures.bytes + report.renderCache.bytes;
+    for (const auto& primitive : report.primitives) total += primitive.second.bytes;
+    EXPECT_EQ(report.getTotal(), total);
+
+    // Printing the report leaves the format of the stream untouched
+    std::ostringstream os;
+    os << report << 0.5;
+    EXPECT_NE(os.str().find("Total memory: "), std::string::npos);
+    EXPECT_EQ(os.str().substr(os.str().size() - 3), "0.5");
+}
+
+TEST_F(CTestScene, arena) {
+    auto pShader = std::make_shared<CShaderFlat>(RGB(1, 1, 1));
+    std::vector<ptr_prim_t> vpPrims;
+    {
+        CScene scene;
+        auto pArena = scene.getArena();
+        {
+            CArena::CScope scope(pArena);
+            EXPECT_EQ(CArena::getActive(), pArena.get());
+            CSolidSphere sphere(pShader, Vec3f(0, 0, 0), 1.0f, 8);
+            vpPrims = sphere.getPrims();
+            scene.add(sphere);
+        }
+        EXPECT_EQ(CArena::getActive(), nullptr);
+        const size_t size = pArena->getSize();
+        EXPECT_GE(size, vpPrims.size() * sizeof(CPrimTriangle));
+
+        // Outside of the scope the primitives are allocated on the heap
+        scene.add(CSolidQuad(pShader, Vec3f(0, -1, 0), Vec3f(0, 1, 0), Vec3f(1, 0, 0), 5.0f));
+        EXPECT_EQ(pArena->getSize(), size);
+        scene.buildAccelStructure(20, 3);
+
+        scene.clear();
+        EXPECT_NE(scene.getArena(), pArena);
+    }
+
+    // The primitives keep their arena alive after the scene is destroyed
+    CBoundingBox box;
+    for (const auto& pPrim : vpPrims) box.extend(pPrim->getBoundingBox());
+    EXPECT_NEAR(box.getMaxPoint()[1], 1.0f, Epsilon);
+    EXPECT_NEAR(box.getMinPoint()[1], -1.0f, Epsilon);
+}
+
+#ifdef ENABLE_BSP
+TEST_F(CTestScene, bsp_mailbox) {
+    // A large quad, which is referenced by many leaves of the tree, split around the small spheres above it
+    CScene scene;
+    auto pShader = std::make_shared<CShaderFlat>(RGB(1, 1, 1));
+    std::vector<ptr_prim_t> vpPrims;
+    auto add = [&](const CSolid& solid) {
+        scene.add(solid);
+        vpPrims.insert(vpPrims.end(), solid.getPrims().begin(), solid.getPrims().end());
+    };
+    add(CSolidQuad(pShader, Vec3f(0, 0, 0), Vec3f(0, 1, 0), Vec3f(1, 0, 0), 10.0f));
+    for (int i = 0; i < 10; i++) 
+        add(CSolidSphere(pShader, Vec3f(i - 4.5f, 0.5f, 0), 0.3f, 6));
+    scene.buildAccelStructure(20, 3);
+
+    // The mailboxing does not change the closest hits
+    random::seed(7);
+    for (int i = 0; i < 1000; i++) {
+        Vec3f org(random::U<float>(-6, 6), random::U<float>(0.01f, 1), random::U<float>(-6, 6));
+        Vec3f dir = normalize(Vec3f(random::U<float>(-1, 1), random::U<float>(-1, 1), random::U<float>(-1, 1)));
+        Ray ray(org, dir);
+        Ray reference(org, dir);
+        scene.intersect(ray);
+        for (const auto& pPrim : vpPrims) pPrim->intersect(reference);
+        ASSERT_EQ(ray.hit, reference.hit);
+        if (ray.hit) EXPECT_FLOAT_EQ(ray.t, reference.t);
+    }
+
+#ifdef ENABLE_STATS
+    // A ray parallel to the quad crosses many leaves, referencing the quad, but tests every primitive at most once
+    Ray ray(Vec3f(-6, 0.05f, 3), Vec3f(1, 0, 0));
+    const RayStats start = stats::local;
+    EXPECT_FALSE(scene.intersect(ray));
+    RayStats res = stats::local;
+    res -= start;
+    EXPECT_GT(res.mailboxHits, 0);
+    EXPECT_LE(res.primitiveTests, vpPrims.size());
+#endif
+}
+#endif
+
+TEST_F(CTestScene, intersect_all) {
+    // Parallel quads, crossed by a ray at every integer distance
+    CScene scene;
+    auto pShader = std::make_shared<CShaderFlat>(RGB(1, 1, 1));
+    for (int i = 1; i <= 8; i++)
+        scene.add(CSolidQuad(pShader, Vec3f(0, 0, static_cast<float>(i)), Vec3f(0, 0, -1), Vec3f(1, 0, 0), 2.0f));
+    scene.add(CSolidSphere(pShader, Vec3f(0.3f, 0.1f, 4.5f), 0.25f, 8));
+    scene.buildAccelStructure(20, 3);
+
+    // All the hits are sorted and match the re-traced ones
+    const Vec3f org(0.1f, 0.2f, 0);
+    const Vec3f dir = normalize(Vec3f(0.05f, -0.02f, 1));
+    std::vector<Ray> vReference;
+    for (Ray ray(org, dir); scene.intersect(ray); ray = Ray(ray.hitPoint(), dir)) {
+        vReference.push_back(ray);
+        vReference.back().t = ray.t + (vReference.size() > 1 ? vReference[vReference.size() - 2].t : 0);
+    }
+    std::vector<Ray> vHits;
+    scene.intersectAll(Ray(org, dir), vHits);
+    ASSERT_EQ(vHits.size(), 10);
+    ASSERT_EQ(vHits.size(), vReference.size());
+    for (size_t i = 0; i < vHits.size(); i++) {
+        EXPECT_EQ(vHits[i].hit, vReference[i].hit);
+        EXPECT_NEAR(vHits[i].t, vReference[i].t, 1e-4);
+        if (i > 0) EXPECT_GT(vHits[i].t, vHits[i - 1].t);
+    }
+
+    // The range, the cap and the filter
+    Ray ray(org, dir);
+    ray.t = 6.5;
+    vHits.clear();
+    scene.intersectAll(ray, vHits, 2.5, 3);
+    ASSERT_EQ(vHits.size(), 3);
+    EXPECT_NEAR(vHits.front().t, vReference[2].t, 1e-4);
+    vHits.clear();
+    scene.intersectAll(ray, vHits, 2.5);
+    EXPECT_EQ(vHits.size(), 6);
+    EXPECT_LT(vHits.back().t, 6.5);
+
+    std::vector<Ray> vFiltered;
+    scene.intersectAll(Ray(org, dir), vFiltered, 0, std::numeric_limits<size_t>::max(), [](const Ray& hit) {
+        if (hit.t > 5) return HitDecision::AcceptAndStop;
+        return std::dynamic_pointer_cast<const CPrimTriangle>(hit.hit) && fabs(hit.hitPoint()[2] - 4.5f) < 0.4f ? HitDecision::Reject : HitDecision::Accept;
+    });
+    ASSERT_EQ(vFiltered.size(), 5);
+    EXPECT_GT(vFiltered.back().t, 5);
+}
+
+#ifdef ENABLE_BSP
+TEST_F(CTestScene, bsp_refit) {
+    CScene scene;
+    auto pShader = std::make_shared<CShaderFlat>(RGB(1, 1, 1));
+    CSolidQuad quad(pShader, Vec3f(0, 0, 0), Vec3f(0, 1, 0), Vec3f(1, 0, 0), 10.0f);
+    scene.add(quad);
+    std::vector<CSolidSphere> vSpheres;
+    for (int i = 0; i < 10; i++) {
+        vSpheres.emplace_back(pShader, Vec3f(i - 4.5f, 0.5f, 0), 0.3f, 6);
+        scene.add(vSpheres.back());
+    }
+    auto pTriangle = std::make_shared<CPrimTriangle>(pShader, Vec3f(-5, 0, -3), Vec3f(5, 0, -3), Vec3f(-5, 3, -3));
+    scene.add(pTriangle);
+    scene.buildAccelStructure(20, 3);
+    
+    // Compares the closest hits with the brute force search
+    auto check = [&] {
+        std::vector<ptr_prim_t> vpPrims = quad.getPrims();
+        for (const auto& sphere : vSpheres) vpPrims.insert(vpPrims.end(), sphere.getPrims().begin(), sphere.getPrims().end());
+        vpPrims.push_back(pTriangle);
+        random::seed(5);
+        for (int i = 0; i < 500; i++) {
+            Vec3f org(random::U<float>(-6, 6), random::U<float>(0.01f, 3), random::U<float>(-6, 6));
+            Vec3f dir = normalize(Vec3f(random::U<float>(-1, 1), random::U<float>(-1, 1), random::U<float>(-1, 1)));
+            Ray ray(org, dir);
+            Ray reference(org, dir);
+            scene.intersect(ray);
+            for (const auto& pPrim : vpPrims) pPrim->intersect(reference);
+            ASSERT_EQ(ray.hit, reference.hit);
+            if (ray.hit) EXPECT_FLOAT_EQ(ray.t, reference.t);
+        }
+    };
+    
+    // Nothing has changed
+    EXPECT_TRUE(scene.updateAccelStructure());
+
+    // The triangle is mirrored within the same bounding box
+    pTriangle->transform(CTransform().reflectX().get());
+    EXPECT_TRUE(scene.updateAccelStructure());
+    check();
+    
+    // A few spheres are moved and a new one is added: the tree is updated in place
+    vSpheres[0].transform(CTransform().translate(0, 1.5f, 2).get());
+    vSpheres[5].transform(CTransform().translate(0.5f, 0, -1).get());
+    vSpheres.emplace_back(pShader, Vec3f(0, 2, 2), 0.5f, 6);
+    scene.add(vSpheres.back());
+    EXPECT_TRUE(scene.updateAccelStructure());
+    check();
+    
+    // A sphere leaves the bounds of the scene
+    vSpheres[3].transform(CTransform().translate(0, 0, 20).get());
+    scene.updateAccelStructure();
+    check();
+    
+    // Most of the geometry has changed: the tree is rebuilt
+    for (auto& sphere : vSpheres) sphere.transform(CTransform().translate(0, 1, 0).get());
+    EXPECT_FALSE(scene.updateAccelStructure());
+    check();
+}
+#endif
+
+TEST_F(CTestScene, instancing) {
+    CScene scene;
+    auto pShader = std::make_shared<CShaderFlat>(RGB(1, 1, 1));
+    auto pMesh = std::make_shared<CMesh>(CSolidSphere(pShader, Vec3f(0, 0, 0), 1.0f, 8));
+    
+    // The reference geometry is copied and transformed for every instance
+    std::vector<ptr_prim_t> vpPrims;
+    for (int i = 0; i < 5; i++)
+        for (int j = 0; j < 5; j++) {
+            Mat T = CTransform().scale(0.2f + 0.1f * i).rotate(Vec3f(0, 1, 0), 15.0f * j).translate(3.0f * i, 0, 3.0f * j).get();
+            scene.add(std::make_shared<CPrimInstance>(pShader, pMesh, T));
+            CSolidSphere sphere(pShader, Vec3f(0, 0, 0), 1.0f, 8);
+            for (const auto& pPrim : sphere.getPrims()) {
+                pPrim->transform(T);
+                vpPrims.push_back(pPrim);
+            }
+        }
+    scene.buildAccelStructure(20, 3);
+
+    random::seed(11);
+    size_t nHits = 0;
+    for (int i = 0; i < 1000; i++) {
+        Vec3f org(random::U<float>(-2, 14), 5, random::U<float>(-2, 14));
+        Vec3f dir = normalize(Vec3f(random::U<float>(-0.5f, 0.5f), -1, random::U<float>(-0.5f, 0.5f)));
+        Ray ray(org, dir);
+        Ray reference(org, dir);
+        scene.intersect(ray);
+        for (const auto& pPrim : vpPrims) pPrim->intersect(reference);
+        ASSERT_EQ(static_cast<bool>(ray.hit), static_cast<bool>(reference.hit));
+        if (!ray.hit) continue;
+        nHits++;
+        EXPECT_NEAR(ray.t, reference.t, 1e-3);
+        EXPECT_NE(ray.instancedHit, nullptr);
+        Vec3f normal = ray.hit->getNormal(ray);
+        Vec3f referenceNormal = normalize(reference.hit->getNormal(reference));
+        for (int dim = 0; dim < 3; dim++) EXPECT_NEAR(normal[dim], referenceNormal[dim], 1e-3);
+        EXPECT_TRUE(scene.if_intersect(Ray(org, dir)));
+    }
+    EXPECT_GT(nHits, 20);
+    
+    // The geometry of the mesh is accounted only once
+    MemoryReport report = scene.getMemoryReport();
+    EXPECT_EQ(report.primitives["CPrimInstance"].count, 25);
+    EXPECT_EQ(report.primitives["CPrimTriangle"].count, pMesh->getPrims().size());
+}
+
+TEST_F(CTestScene, motion_blur) {
+    CScene scene;
+    auto pShader = std::make_shared<CShaderFlat>(RGB(1, 1, 1));
+    auto pMesh = std::make_shared<CMesh>(CSolidSphere(pShader, Vec3f(0, 0, 0), 1.0f, 8));
+    
+    // The instances move along the polylines of 3 transformations, which rotate, scale and move the mesh: 
+    // the transformation at the moment between the keys is given by the fractional key
+    auto getTransform = [](int i, int j, float key) {
+        return CTransform().scale(0.3f + 0.1f * key).rotate(Vec3f(0, 1, 0), 30.0f * key * j).translate(3.0f * i + (1 - fabsf(1 - key)) * (j % 3), 0, 3.0f * j).get();
+    };
+    std::vector<std::pair<int, int>> vInstances;
+    for (int i = 0; i < 5; i++)
+        for (int j = 0; j < 5; j++) {
+            std::vector<Mat> vT;
+            for (int key = 0; key < 3; key++)
+                vT.push_back(getTransform(i, j, static_cast<float>(key)));
+            scene.add(std::make_shared<CPrimInstance>(pShader, pMesh, vT));
+            vInstances.emplace_back(i, j);
+        }
+    scene.buildAccelStructure(20, 3);
+    
+    random::seed(12);
+    size_t nHits = 0;
+    for (int i = 0; i < 1000; i++) {
+        Vec3f org(random::U<float>(-2, 14), 5, random::U<float>(-2, 14));
+        Vec3f dir = normalize(Vec3f(random::U<float>(-0.5f, 0.5f), -1, random::U<float>(-0.5f, 0.5f)));
+        const float time = random::U<float>();
+        Ray ray(org, dir, 0, time);
+        scene.intersect(ray);
+        
+        // The reference instances stand still in the interpolated poses
+        Ray reference(org, dir);
+        for (const auto& [i, j] : vInstances)
+            std::make_shared<CPrimInstance>(pShader, pMesh, getTransform(i, j, 2 * time))->intersect(reference);
+        ASSERT_EQ(static_cast<bool>(ray.hit), static_cast<bool>(reference.hit));
+        if (!ray.hit) continue;
+        nHits++;
+        EXPECT_NEAR(ray.t, reference.t, 1e-3);
+        Vec3f normal = ray.hit->getNormal(ray);
+        Vec3f referenceNormal = reference.hit->getNormal(reference);
+        for (int dim = 0; dim < 3; dim++) EXPECT_NEAR(normal[dim], referenceNormal[dim], 1e-3);
+        EXPECT_TRUE(scene.if_intersect(Ray(org, dir, 0, time)));
+    }
+    EXPECT_GT(nHits, 20);
+    
+    // A ball, moving across the center of the image, covers the central pixel about a half of the shutter interval
+    CScene ball(RGB(0, 0, 0));
+    auto pBall = std::make_shared<CMesh>(CSolid(std::make_shared<CPrimSphere>(pShader, Vec3f(0, 0, 0), 0.5f)));
+    auto pCamera = std::make_shared<CCameraPerspective>(Size(9, 9), Vec3f(0, 0, -5), Vec3f(0, 0, 1), Vec3f(0, 1, 0), 20.0f);
+    ball.add(std::make_shared<CPrimInstance>(pShader, pBall, std::vector<Mat>{ CTransform().translate(-1, 0, 0).get(), CTransform().translate(1, 0, 0).get() }));
+    ball.add(pCamera);
+    ball.buildAccelStructure(20, 3);
+    auto pSampler = std::make_shared<CSamplerStratified>(8, true, true);
+    EXPECT_EQ(ball.render(pSampler, CV_32FC3).at<Vec3f>(4, 4)[0], 0);
+    pCamera->setShutter(0, 1);
+    const float blurred = ball.render(pSampler, CV_32FC3).at<Vec3f>(4, 4)[0];
+    EXPECT_GT(blurred, 0.25f);
+    EXPECT_LT(blurred, 0.75f);
+
+    // A ball, which turns by 180 degrees around the origin, moves rigidly along the half circle
+    CScene turn;
+    auto pOffset = std::make_shared<CMesh>(CSolid(std::make_shared<CPrimSphere>(pShader, Vec3f(1, 0, 0), 0.5f)));
+    turn.add(std::make_shared<CPrimInstance>(pShader, pOffset, std::vector<Mat>{ Mat::eye(4, 4, CV_32FC1), CTransform().rotate(Vec3f(0, 1, 0), 180).get() }));
+    turn.buildAccelStructure(20, 3);
+    Ray start(Vec3f(1, 0, -5), Vec3f(0, 0, 1), 0, 0);
+    ASSERT_TRUE(turn.intersect(start));
+    EXPECT_NEAR(start.t, 4.5, 1e-4);
+    Ray end(Vec3f(-1, 0, -5), Vec3f(0, 0, 1), 0, 1);
+    ASSERT_TRUE(turn.intersect(end));
+    EXPECT_NEAR(end.t, 4.5, 1e-4);
+    // At the middle of the motion the ball is turned by 90 degrees in either direction: its center is at (0, 0, -1) or (0, 0, 1)
+    Ray middle(Vec3f(0, 0, -5), Vec3f(0, 0, 1), 0, 0.5f);
+    ASSERT_TRUE(turn.intersect(middle));
+    EXPECT_NEAR(MIN(fabs(middle.t - 3.5), fabs(middle.t - 5.5)), 0, 1e-3);
+    const Vec3f normal = middle.hit->getNormal(middle);
+    EXPECT_NEAR(normal[2], -1, 1e-3);
+    Ray side(Vec3f(-5, 0, 0), Vec3f(1, 0, 0), 0, 0.5f);
+    EXPECT_FALSE(turn.intersect(side));
+}
+
+#ifdef ENABLE_TRACE
+TEST_F(CTestScene, render_trace) {
+    const std::string fileName = "test_trace.json";
+    CScene scene(RGB(0.1f, 0.1f, 0.1f));
+    scene.add(CSolidSphere(std::make_shared<CShaderFlat>(RGB(1, 0, 0)), Vec3f(0, 0, 0), 1.0f, 16));
+    scene.add(std::make_shared<CCameraPerspective>(Size(32, 24), Vec3f(0, 0, -4), Vec3f(0, 0, 1), Vec3f(0, 1, 0), 45.0f));
+
+    EXPECT_FALSE(trace::isRecording());
+    trace::start();
+    EXPECT_TRUE(trace::isRecording());
+    scene.buildAccelStructure(20, 3);
+    scene.render(nullptr, CV_8UC3);
+    ASSERT_TRUE(trace::stop(fileName));
+    EXPECT_FALSE(trace::isRecording());
+    
+    std::ifstream file(fileName);
+    std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+    std::remove(fileName.c_str());
+    EXPECT_EQ(json.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["), 0);
+    EXPECT_NE(json.find("\"name\":\"Render rows\""), std::string::npos);
+    EXPECT_NE(json.find("\"name\":\"Convert image\""), std::string::npos);
+#ifdef ENABLE_BSP
+    EXPECT_NE(json.find("\"name\":\"Build BSP Tree\""), std::string::npos);
+#endif
+    // The events, recorded after stop(), are discarded by the next start()
+    scene.render();
+    trace::start();
+    ASSERT_TRUE(trace::stop(fileName));
+    file.open(fileName);
+    json.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+    std::remove(fileName.c_str());
+    EXPECT_EQ(json.find("\"ph\""), std::string::npos);
+
+    // The recording may be stopped while other threads are recording
+    std::atomic<bool> done = false;
+    trace::start();
+    std::vector<std::thread> vThreads;
+    for (int i = 0; i < 4; i++)
+        vThreads.emplace_back([&done]() { while (!done) { RT_TRACE_SCOPE("Busy", "test"); } });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_TRUE(trace::stop(fileName));
+    done = true;
+    for (auto& thread : vThreads) thread.join();
+    file.open(fileName);
+    json.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+    std::remove(fileName.c_str());
+    EXPECT_NE(json.find("\"name\":\"Busy\""), std::string::npos);
+}
+#endif
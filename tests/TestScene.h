@@ -0,0 +1,11 @@
+#pragma once
+
+#include "gtest/gtest.h"
+#include "types.h"
+#include "openrt.h"
+
+class CTestScene : public ::testing::Test {
+public:
+    CTestScene(void) = default;
+	~CTestScene(void) = default;
+};
@@ -1,5 +1,7 @@
 ﻿#include "TestSolid.h"
 #include "core/BoundingBox.h"
+#include "core/Ray.h"
+#include "core/random.h"
 
 using namespace rt;
 TEST_F(CTestSolid, solid_sphere) {
@@ -18,3 +20,180 @@ TEST_F(CTestSolid, solid_sphere) {
     for (auto pt_value : box.getMaxPoint().val)
         EXPECT_NEAR(pt_value, radius, 0.2);
 }
+
+TEST_F(CTestSolid, analytic_primitives) {
+    auto shader = std::make_shared<CShaderFlat>(RGB(1, 1, 1));
+    const Vec3f origin(1, 2, 3);
+    
+    // The analytic primitives and the fine tessellations of the same shapes
+    std::vector<std::pair<ptr_prim_t, CSolid>> vShapes = {
+        { std::make_shared<CPrimCylinder>(shader, origin, 1.0f, 2.0f), CSolidCylinder(shader, origin, 1.0f, 2.0f, 1, 256) },
+        { std::make_shared<CPrimCone>(shader, origin, 1.0f, 2.0f), CSolidCone(shader, origin, 1.0f, 2.0f, 1, 256) },
+        { std::make_shared<CPrimTorus>(shader, origin, 2.0f, 0.5f), CSolidTorus(shader, origin, 2.0f, 0.5f, 128) }
+    };
+    
+    random::seed(44);
+    for (const auto& [pPrim, solid] : vShapes) {
+        // The bounding box contains the tessellation
+        CBoundingBox box;
+        for (const auto& pTriangle : solid.getPrims()) box.extend(pTriangle->getBoundingBox());
+        for (int dim = 0; dim < 3; dim++) {
+            EXPECT_NEAR(pPrim->getBoundingBox().getMinPoint()[dim], box.getMinPoint()[dim], 1e-3);
+            EXPECT_NEAR(pPrim->getBoundingBox().getMaxPoint()[dim], box.getMaxPoint()[dim], 1e-3);
+        }
+        
+        size_t nHits = 0;
+        size_t nMismatches = 0;
+        for (int i = 0; i < 1000; i++) {
+            Vec3f org = box.getCenter() + 5 * normalize(Vec3f(random::N<float>(), random::N<float>(), random::N<float>()));
+            Vec3f target = box.getMinPoint() + Vec3f(random::U<float>(), random::U<float>(), random::U<float>()).mul(box.getMaxPoint() - box.getMinPoint());
+            Ray ray(org, normalize(target - org));
+            Ray reference(org, normalize(target - org));
+            pPrim->intersect(ray);
+            for (const auto& pTriangle : solid.getPrims()) pTriangle->intersect(reference);
+            if (static_cast<bool>(ray.hit) != static_cast<bool>(reference.hit)) {		// only grazing rays may differ
+                nMismatches++;
+                continue;
+            }
+            if (!ray.hit) continue;
+            nHits++;
+            EXPECT_NEAR(ray.t, reference.t, 1e-2);
+            EXPECT_TRUE(pPrim->if_intersect(Ray(org, ray.dir)));
+            
+            // The ray, starting outside, enters and leaves the shape
+            std::vector<Ray> vHits;
+            pPrim->intersectAll(Ray(org, ray.dir), vHits);
+            ASSERT_FALSE(vHits.empty());
+            EXPECT_EQ(vHits.front().t, ray.t);
+            EXPECT_EQ(vHits.size() % 2, 0);
+            for (size_t h = 1; h < vHits.size(); h++)
+                EXPECT_GE(vHits[h].t, vHits[h - 1].t);
+            Vec3f normal = pPrim->getNormal(ray);
+            EXPECT_NEAR(norm(normal), 1, 1e-4);
+            EXPECT_GT(normal.dot(normalize(reference.hit->getNormal(reference))), 0.99f);
+            
+            // The ray, starting inside, leaves the shape
+            Ray inner(ray.hitPoint() + 0.05f * ray.dir, ray.dir);
+            Ray innerReference(inner.org, inner.dir);
+            for (const auto& pTriangle : solid.getPrims()) pTriangle->intersect(innerReference);
+            if (innerReference.hit) {
+                EXPECT_TRUE(pPrim->intersect(inner));
+                EXPECT_NEAR(inner.t, innerReference.t, 1e-2);
+            }
+        }
+        EXPECT_GT(nHits, 200);
+        EXPECT_LT(nMismatches, 10);
+    }
+}
+
+TEST_F(CTestSolid, analytic_primitives_transform) {
+    auto shader = std::make_shared<CShaderFlat>(RGB(1, 1, 1));
+    
+    // The stretch along the axis keeps the cross-section of the cylinder and the cone circular
+    auto pCylinder = std::make_shared<CPrimCylinder>(shader, Vec3f::all(0), 1.0f, 2.0f);
+    auto pCone = std::make_shared<CPrimCone>(shader, Vec3f::all(0), 1.0f, 2.0f);
+    auto pTorus = std::make_shared<CPrimTorus>(shader, Vec3f::all(0), 2.0f, 0.5f);
+    pCylinder->transform(CTransform().scale(2, 3, 2).get());
+    pCone->transform(CTransform().scale(2, 3, 2).get());
+    pTorus->transform(CTransform().scale(2).get());
+    for (int dim = 0; dim < 3; dim++) {
+        EXPECT_NEAR(pCylinder->getBoundingBox().getMinPoint()[dim], dim == 1 ? 0 : -2, 1e-4);
+        EXPECT_NEAR(pCylinder->getBoundingBox().getMaxPoint()[dim], dim == 1 ? 6 : 2, 1e-4);
+        EXPECT_NEAR(pCone->getBoundingBox().getMaxPoint()[dim], dim == 1 ? 6 : 2, 1e-4);
+        EXPECT_NEAR(pTorus->getBoundingBox().getMaxPoint()[dim], dim == 2 ? 1 : 5, 1e-4);
+    }
+    
+    // The radius is scaled exactly: the ray along the diameter hits the side at the distances 3 and 7
+    std::vector<Ray> vHits;
+    pCylinder->intersectAll(Ray(Vec3f(-5, 1, 0), Vec3f(1, 0, 0)), vHits);
+    ASSERT_EQ(vHits.size(), 2);
+    EXPECT_NEAR(vHits[0].t, 3, 1e-4);
+    EXPECT_NEAR(vHits[1].t, 7, 1e-4);
+    
+    // The torus is hit 4 times along its diameter
+    vHits.clear();
+    pTorus->intersectAll(Ray(Vec3f(-10, 0, 0), Vec3f(1, 0, 0)), vHits);
+    ASSERT_EQ(vHits.size(), 4);
+    EXPECT_NEAR(vHits[0].t, 5, 1e-3);
+    EXPECT_NEAR(vHits[1].t, 7, 1e-3);
+    EXPECT_NEAR(vHits[2].t, 13, 1e-3);
+    EXPECT_NEAR(vHits[3].t, 15, 1e-3);
+    
+    // The non-uniform scale is rejected
+    EXPECT_DEATH(pCylinder->transform(CTransform().scale(2, 1, 1).get()), "");
+    EXPECT_DEATH(pCone->transform(CTransform().scale(1, 1, 2).get()), "");
+    EXPECT_DEATH(pTorus->transform(CTransform().scale(1, 2, 1).get()), "");
+}
+
+TEST_F(CTestSolid, csg) {
+    auto shader = std::make_shared<CShaderFlat>(RGB(1, 1, 1));
+
+    // ((box - sphere) | cylinder) & tessellated sphere: a non-convex difference nested twice
+    auto pDifference = std::make_shared<CCompositeGeometry>(CSolidBox(shader, Vec3f::all(0), 1.0f), CSolid(std::make_shared<CPrimSphere>(shader, Vec3f::all(0), 1.25f)), BoolOp::Difference);
+    auto pUnion = std::make_shared<CCompositeGeometry>(CSolid(pDifference), CSolid(std::make_shared<CPrimCylinder>(shader, Vec3f(0, -2, 0), 0.4f, 4.0f)), BoolOp::Union);
+    auto pComposite = std::make_shared<CCompositeGeometry>(CSolid(pUnion), CSolidSphere(shader, Vec3f::all(0), 1.6f, 64), BoolOp::Intersection);
+    auto inside = [](const Vec3f& p) {
+        const bool inBox = fabs(p[0]) < 1 && fabs(p[1]) < 1 && fabs(p[2]) < 1;
+        const bool inSphere = norm(p) < 1.25f;
+        const bool inCylinder = p[0] * p[0] + p[2] * p[2] < 0.4f * 0.4f && fabs(p[1]) < 2;
+        return ((inBox && !inSphere) || inCylinder) && norm(p) < 1.6f;
+    };
+    
+    random::seed(45);
+    size_t nHits = 0;
+    size_t nMismatches = 0;
+    for (int i = 0; i < 1000; i++) {
+        // The rays start outside and, every second one, at a random point of the bounding box
+        Vec3f org = i % 2 ? 5 * normalize(Vec3f(random::N<float>(), random::N<float>(), random::N<float>())) : Vec3f(random::U(-1.6f, 1.6f), random::U(-1.6f, 1.6f), random::U(-1.6f, 1.6f));
+        Vec3f dir = i % 2 ? normalize(Vec3f(random::U(-1.0f, 1.0f), random::U(-1.0f, 1.0f), random::U(-1.0f, 1.0f)) - org) : normalize(Vec3f(random::N<float>(), random::N<float>(), random::N<float>()));
+        
+        // The reference: the first change of the point membership along the ray
+        double reference = Infty;
+        const bool start = inside(org + Epsilon * dir);
+        for (double t = Epsilon; t < 10; t += 1e-3)
+            if (inside(org + static_cast<float>(t) * dir) != start) {
+                reference = t;
+                break;
+            }
+
+        Ray ray(org, dir);
+        if (pComposite->intersect(ray) != (reference < Infty) || (ray.hit && fabs(ray.t - reference) > 2e-2)) {     // only grazing rays may differ
+            nMismatches++;
+            continue;
+        }
+        if (!ray.hit) continue;
+        nHits++;
+        EXPECT_TRUE(pComposite->if_intersect(Ray(org, dir)));
+        
+        // All the hits alternate between entering and leaving the composite
+        std::vector<Ray> vHits;
+        pComposite->intersectAll(Ray(org, dir), vHits);
+        ASSERT_FALSE(vHits.empty());
+        EXPECT_EQ(vHits.front().t, ray.t);
+        EXPECT_EQ(vHits.size() % 2 == 1, start);
+        for (size_t h = 1; h < vHits.size(); h++)
+            EXPECT_GT(vHits[h].t, vHits[h - 1].t);
+    }
+    EXPECT_GT(nHits, 300);
+    EXPECT_LT(nMismatches, 10);
+}
+
+TEST_F(CTestSolid, csg_thin) {
+    auto shader = std::make_shared<CShaderFlat>(RGB(1, 1, 1));
+    
+    // The surfaces of the sphere thinner than Epsilon are both found
+    std::vector<Ray> vHits;
+    std::make_shared<CPrimSphere>(shader, Vec3f(0, 0, 0), 0.004f)->intersectAll(Ray(Vec3f(0, 0, -1), Vec3f(0, 0, 1)), vHits);
+    ASSERT_EQ(vHits.size(), 2);
+    EXPECT_NEAR(vHits[0].t, 0.996, 1e-5);
+    EXPECT_NEAR(vHits[1].t, 1.004, 1e-5);
+    
+    // The shell thinner than Epsilon is entered and left twice
+    auto pShell = std::make_shared<CCompositeGeometry>(CSolid(std::make_shared<CPrimSphere>(shader, Vec3f::all(0), 1.005f)), CSolid(std::make_shared<CPrimSphere>(shader, Vec3f::all(0), 1.0f)), BoolOp::Difference);
+    vHits.clear();
+    pShell->intersectAll(Ray(Vec3f(0, 0, -5), Vec3f(0, 0, 1)), vHits);
+    ASSERT_EQ(vHits.size(), 4);
+    const double reference[] = { 3.995, 4.0, 6.0, 6.005 };
+    for (size_t h = 0; h < 4; h++)
+        EXPECT_NEAR(vHits[h].t, reference[h], 1e-4);
+}